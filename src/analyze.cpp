@@ -0,0 +1,190 @@
+#include "analyze.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <map>
+#include <random>
+
+#include "path_utils.h"
+#include "value.h"
+
+namespace {
+constexpr size_t kSampleSize = 30000;  // values per column behind a histogram
+constexpr size_t kBuckets = 100;
+constexpr int kSketchBits = 12;        // 4096 registers, about 1.6% error
+
+uint64_t Hash64(const std::string& s) {
+  uint64_t h = 1469598103934665603ULL;
+  for (unsigned char c : s) h = (h ^ c) * 1099511628211ULL;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// HyperLogLog distinct count
+class Sketch {
+ public:
+  Sketch() : registers_(size_t{1} << kSketchBits, 0) {}
+
+  void Add(uint64_t h) {
+    const size_t idx = static_cast<size_t>(h >> (64 - kSketchBits));
+    const uint64_t rest = (h << kSketchBits) | (uint64_t{1} << (kSketchBits - 1));
+    uint8_t rank = 1;
+    while (!(rest & (uint64_t{1} << (64 - rank)))) ++rank;
+    registers_[idx] = std::max(registers_[idx], rank);
+  }
+
+  uint64_t Estimate() const {
+    const double m = static_cast<double>(registers_.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : registers_) {
+      sum += std::ldexp(1.0, -r);
+      if (r == 0) ++zeros;
+    }
+    double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (e <= 2.5 * m && zeros > 0) e = m * std::log(m / static_cast<double>(zeros));  // small counts
+    return static_cast<uint64_t>(e + 0.5);
+  }
+
+ private:
+  std::vector<uint8_t> registers_;
+};
+
+// Values are ordered by their AppendKey encoding (NULL < numbers < text),
+// a total order that agrees with how predicates compare them.
+struct Sampled {
+  std::string key;
+  std::string text;
+};
+
+struct ColumnState {
+  uint64_t nulls = 0;
+  uint64_t values = 0;  // non-NULL
+  Sketch sketch;
+  Sampled min, max;
+  std::vector<Sampled> sample;  // reservoir
+};
+
+void Finish(ColumnState& c, uint64_t rows, ColumnStats& out) {
+  out.nullFraction = rows > 0 ? static_cast<double>(c.nulls) / static_cast<double>(rows) : 0;
+  out.hasRange = c.values > 0;
+  if (!out.hasRange) return;
+  out.min = c.min.text;
+  out.max = c.max.text;
+
+  auto& s = c.sample;
+  std::sort(s.begin(), s.end(), [](const Sampled& a, const Sampled& b) { return a.key < b.key; });
+  if (c.values == s.size()) {
+    // Every value is in the sample: count exactly.
+    out.distinct = 1;
+    for (size_t i = 1; i < s.size(); ++i) {
+      if (s[i].key != s[i - 1].key) ++out.distinct;
+    }
+  } else {
+    out.distinct = std::min(std::max<uint64_t>(c.sketch.Estimate(), 1), c.values);
+  }
+
+  const size_t buckets = std::min(kBuckets, s.size());
+  out.bounds.push_back(out.min);
+  for (size_t b = 1; b <= buckets; ++b) {
+    const size_t from = (b - 1) * s.size() / buckets;
+    const size_t to = b * s.size() / buckets;
+    out.bounds.push_back(b == buckets ? out.max : s[to - 1].text);
+    // Rows scaled from the sample to the whole column
+    out.bucketRows.push_back(c.values * to / s.size() - c.values * from / s.size());
+  }
+}
+}  // namespace
+
+bool AnalyzeService::Collect(const std::string& datPath, const TableSchema& schema, TableStats& out, std::string& err) {
+  out = TableStats();
+  const size_t n = schema.fields.size();
+  std::vector<ColumnKind> kinds(n);
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t width = 0;
+    kinds[i] = ColumnKindOf(schema.fields[i], width);
+  }
+  std::vector<ColumnState> cols(n);
+  std::mt19937_64 rng(0x5eed);  // same data, same histograms
+
+  TableScanCursor cursor;
+  if (!engine_.OpenScan(datPath, schema, cursor, err, false)) return false;
+  int64_t offset = 0;
+  RecordView row;
+  std::string key;
+  while (cursor.Next(offset, row)) {
+    if (!row.valid) {
+      ++out.deadRows;
+      continue;
+    }
+    ++out.rowCount;
+    for (size_t i = 0; i < n; ++i) {
+      ColumnState& c = cols[i];
+      const Value v = Value::Of(i < row.values.size() ? row.values[i] : std::string_view("NULL"), kinds[i]);
+      if (v.type == Value::Type::kNull) {
+        ++c.nulls;
+        continue;
+      }
+      key.clear();
+      AppendKey(v, key);
+      c.sketch.Add(Hash64(key));
+      if (c.values == 0 || key < c.min.key) c.min = {key, std::string(v.text)};
+      if (c.values == 0 || key > c.max.key) c.max = {key, std::string(v.text)};
+      ++c.values;
+      if (c.sample.size() < kSampleSize) {
+        c.sample.push_back({key, std::string(v.text)});
+      } else {
+        const uint64_t j = rng() % c.values;
+        if (j < kSampleSize) c.sample[j] = {key, std::string(v.text)};
+      }
+    }
+  }
+  if (!cursor.error().empty()) {
+    err = cursor.error();
+    return false;
+  }
+
+  out.analyzedAt = static_cast<uint64_t>(std::time(nullptr));
+  out.sampleRows = std::min<uint64_t>(out.rowCount, kSampleSize);
+  out.columns.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    out.columns[i].name = schema.fields[i].name;
+    Finish(cols[i], out.rowCount, out.columns[i]);
+  }
+  return true;
+}
+
+bool AnalyzeService::Analyze(const std::string& dbName, const std::string& tableName,
+                             std::vector<std::pair<std::string, std::shared_ptr<const TableStats>>>& out, std::string& err) {
+  out.clear();
+  const std::string dbf = dbms_paths::DbfPath(dbName);
+  const std::string dat = dbms_paths::DatPath(dbName);
+  std::vector<TableSchema> schemas;
+  if (!engine_.LoadSchemas(dbf, schemas, err)) return false;
+  std::map<std::string, std::shared_ptr<const TableStats>> collected;
+  for (const auto& schema : schemas) {
+    if (schema.isView) continue;
+    if (!tableName.empty() && schema.tableName != tableName) continue;
+    auto stats = std::make_shared<TableStats>();
+    if (!Collect(dat, schema, *stats, err)) return false;
+    collected[schema.tableName] = stats;
+    out.emplace_back(schema.tableName, stats);
+  }
+  if (!tableName.empty() && out.empty()) {
+    err = "Table not found: " + tableName;
+    return false;
+  }
+
+  // Read the schemas again so DDL that ran during the scans is kept.
+  if (!engine_.LoadSchemas(dbf, schemas, err)) return false;
+  for (auto& schema : schemas) {
+    auto it = collected.find(schema.tableName);
+    if (it != collected.end() && !schema.isView) schema.stats = it->second;
+  }
+  return engine_.SaveSchemas(dbf, schemas, err);
+}
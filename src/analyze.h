@@ -0,0 +1,26 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "db_types.h"
+#include "storage_engine.h"
+
+// ANALYZE: table statistics for plan choices, saved with the schema in the
+// .dbf. Row counts, NULL fractions and min/max are exact and distinct
+// counts are HyperLogLog estimates, all from one full scan; histograms come
+// from a fixed-size random sample of each column's values. Reads a snapshot
+// like any scan, so it takes no locks.
+class AnalyzeService {
+ public:
+  explicit AnalyzeService(StorageEngine& engine) : engine_(engine) {}
+
+  // Analyze one table, or every table of the database when tableName is empty.
+  bool Analyze(const std::string& dbName, const std::string& tableName,
+               std::vector<std::pair<std::string, std::shared_ptr<const TableStats>>>& out, std::string& err);
+
+  bool Collect(const std::string& datPath, const TableSchema& schema, TableStats& out, std::string& err);
+
+ private:
+  StorageEngine& engine_;
+};
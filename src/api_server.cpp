@@ -365,6 +365,7 @@ ApiServer::ApiServer(StorageEngine& engine,
     LogManager& log,
     TxnManager& txn_manager,
     LockManager& lock_manager,
+    VacuumService& vacuum,
     const std::string& dbfPath,
     const std::string& datPath)
     : engine_(engine),
@@ -374,7 +375,10 @@ ApiServer::ApiServer(StorageEngine& engine,
     log_(log),
     txn_manager_(txn_manager),
     lock_manager_(lock_manager),
-    auth_(engine, ddl, dml), // Init Auth
+    vacuum_(vacuum),
+    loader_(engine, ddl, lock_manager),
+    analyzer_(engine),
+    auth_(engine, ddl, dml, lock_manager), // Init Auth
     dbfPath_(dbfPath),
     datPath_(datPath),
     currentDbf_(dbfPath),
@@ -453,14 +457,12 @@ std::string ApiServer::DataPath(const std::string& table) const {
 }
 
 bool ApiServer::LoadSchema(const std::string& table, TableSchema& out, std::string& err) {
-  std::vector<TableSchema> schemas;
-  if (!engine_.LoadSchemas(currentDbf_, schemas, err)) return false;
-  auto needle = ToLower(table);
-  for (const auto& s : schemas) {
-    if (ToLower(s.tableName) == needle) { out = s; return true; }
-  }
-  err = "Table not found";
-  return false;
+  auto catalog = engine_.LoadCatalog(currentDbf_, err);
+  if (!catalog) return false;
+  const TableSchema* s = catalog->FindNoCase(table);
+  if (!s) { err = "Table not found"; return false; }
+  out = *s;
+  return true;
 }
 
 std::vector<TableSchema> ApiServer::ListSchemas() {
@@ -697,6 +699,7 @@ void ApiServer::HandleExecuteSql(const HttpRequest& req, HttpResponse& resp) {
             LSN lsn = log_.Append(rec, err);
             if (lsn == 0) { resp.status=500; resp.body=Error(err); return; }
             if (!log_.Flush(lsn, err)) { resp.status=500; resp.body=Error(err); return; }
+            if (!engine_.FlushBufferPool(err)) { resp.status=500; resp.body=Error(err); return; }
             if (!log_.TruncateWithBackup(err)) { resp.status=500; resp.body=Error(err); return; }
             lastStatus = 200; lastResultBody = "{\"ok\":true,\"message\":\"Checkpoint created\"}";
             continue;
@@ -791,6 +794,10 @@ void ApiServer::HandleExecuteSql(const HttpRequest& req, HttpResponse& resp) {
             case CommandType::kDrop:   accessNeeded="DROP"; break;
             case CommandType::kAlter:  accessNeeded="ALTER"; break; // Custom priv
             case CommandType::kCheckpoint: accessNeeded="CREATE"; break;
+            case CommandType::kVacuum: accessNeeded="ALTER"; break;
+            case CommandType::kAnalyze: accessNeeded="ALTER"; break;
+            case CommandType::kCheckTable: accessNeeded="SELECT"; break;
+            case CommandType::kCopy: accessNeeded="INSERT"; break;
             case CommandType::kCreateIndex: accessNeeded="INDEX"; break;
             case CommandType::kDropIndex: accessNeeded="INDEX"; break;
             // ...
@@ -806,6 +813,89 @@ void ApiServer::HandleExecuteSql(const HttpRequest& req, HttpResponse& resp) {
              }
         }
 
+        if (cmd.type == CommandType::kVacuum) {
+            if (session.current_txn) { resp.status=400; resp.body=Error("VACUUM not allowed in active transaction"); return; }
+            std::vector<std::pair<std::string, CompactStats>> vacuumed;
+            if (!vacuum_.Vacuum(currentDbName_, cmd.tableName, vacuumed, err)) { resp.status=500; resp.body=Error(err); return; }
+            uint64_t reclaimed = 0;
+            std::ostringstream tables;
+            for (size_t i = 0; i < vacuumed.size(); ++i) {
+                const CompactStats& st = vacuumed[i].second;
+                reclaimed += st.Reclaimed();
+                if (i) tables << ',';
+                tables << "{\"table\":\"" << JsonEscape(vacuumed[i].first) << "\",\"liveRows\":" << st.liveRows
+                       << ",\"deadRows\":" << st.deadRows << ",\"bytesBefore\":" << st.bytesBefore
+                       << ",\"bytesAfter\":" << st.bytesAfter << '}';
+            }
+            lastStatus = 200;
+            lastResultBody = "{\"ok\":true,\"message\":\"Vacuum reclaimed " + std::to_string(reclaimed) +
+                             " bytes\",\"reclaimedBytes\":" + std::to_string(reclaimed) + ",\"tables\":[" + tables.str() + "]}";
+            continue;
+        }
+
+        if (cmd.type == CommandType::kAnalyze) {
+            if (session.current_txn) { resp.status=400; resp.body=Error("ANALYZE not allowed in active transaction"); return; }
+            std::vector<std::pair<std::string, std::shared_ptr<const TableStats>>> analyzed;
+            if (!analyzer_.Analyze(currentDbName_, cmd.tableName, analyzed, err)) { resp.status=400; resp.body=Error(err); return; }
+            std::ostringstream tables;
+            for (size_t i = 0; i < analyzed.size(); ++i) {
+                const TableStats& st = *analyzed[i].second;
+                if (i) tables << ',';
+                tables << "{\"table\":\"" << JsonEscape(analyzed[i].first) << "\",\"rows\":" << st.rowCount
+                       << ",\"deadRows\":" << st.deadRows << ",\"columns\":[";
+                for (size_t c = 0; c < st.columns.size(); ++c) {
+                    const ColumnStats& col = st.columns[c];
+                    if (c) tables << ',';
+                    tables << "{\"name\":\"" << JsonEscape(col.name) << "\",\"distinct\":" << col.distinct
+                           << ",\"nullFraction\":" << col.nullFraction;
+                    if (col.hasRange) tables << ",\"min\":\"" << JsonEscape(col.min) << "\",\"max\":\"" << JsonEscape(col.max) << '"';
+                    tables << ",\"buckets\":" << col.bucketRows.size() << '}';
+                }
+                tables << "]}";
+            }
+            lastStatus = 200;
+            lastResultBody = "{\"ok\":true,\"message\":\"Analyzed " + std::to_string(analyzed.size()) +
+                             " table(s)\",\"tables\":[" + tables.str() + "]}";
+            continue;
+        }
+
+        if (cmd.type == CommandType::kCheckTable) {
+            TableSchema schema;
+            if (!LoadSchema(cmd.tableName, schema, err)) { resp.status=400; resp.body=Error(err); return; }
+            if (schema.isView) { resp.status=400; resp.body=Error("Cannot check a view"); return; }
+            CheckReport report;
+            if (!engine_.CheckTable(currentDat_, schema, report, err)) { resp.status=500; resp.body=Error(err); return; }
+            const char* unit = schema.storage == StorageFormat::kRow ? "offset" : "page";
+            std::ostringstream bad;
+            for (size_t i = 0; i < report.bad.size(); ++i) {
+                if (i) bad << ',';
+                bad << "{\"" << unit << "\":" << report.bad[i].first << ",\"problem\":\"" << JsonEscape(report.bad[i].second) << "\"}";
+            }
+            lastStatus = 200;
+            const std::string message = report.bad.empty() ? "OK" : std::to_string(report.bad.size()) + " problem(s) found";
+            lastResultBody = "{\"ok\":true,\"message\":\"" + message + "\"" +
+                             ",\"table\":\"" + JsonEscape(schema.tableName) + "\",\"checked\":" + std::to_string(report.checked) +
+                             ",\"unverified\":" + std::to_string(report.unverified) + ",\"bad\":[" + bad.str() + "]}";
+            continue;
+        }
+
+        if (cmd.type == CommandType::kCopy) {
+            // Reads a file on the server, like BACKUP writes one
+            if (user != "admin") { resp.status=403; resp.body=Error("Permission denied: Only admin can COPY from a server file"); return; }
+            if (session.current_txn) { resp.status=400; resp.body=Error("COPY not allowed in active transaction"); return; }
+            TableSchema schema;
+            if (!LoadSchema(cmd.tableName, schema, err)) { resp.status=400; resp.body=Error(err); return; }
+            LoadOptions options;
+            options.header = cmd.copyHeader;
+            options.delimiter = cmd.copyDelimiter;
+            LoadStats stats;
+            if (!loader_.Load(currentDbName_, schema, cmd.copyPath, options, stats, err)) { resp.status=400; resp.body=Error(err); return; }
+            lastStatus = 200;
+            lastResultBody = "{\"ok\":true,\"message\":\"Loaded " + std::to_string(stats.rows) + " rows\",\"rows\":" +
+                             std::to_string(stats.rows) + ",\"bytes\":" + std::to_string(stats.bytes) + "}";
+            continue;
+        }
+
         if (cmd.type == CommandType::kCreateDatabase) {
            if (session.current_txn) { resp.status=400; resp.body=Error("DDL not allowed in active transaction"); return; }
            if (!engine_.CreateDatabase(cmd.dbName, err)) {
@@ -1436,10 +1526,11 @@ ApiServer::SessionContext& ApiServer::GetSession(const std::string& token) {
 bool ApiServer::CommitTxn(SessionContext& session, std::string& err) {
     if (!session.current_txn) { err = "No active transaction"; return false; }
     if (!txn_manager_.Commit(session.current_txn, err)) return false;
-    lock_manager_.ReleaseAll(session.current_txn->id);
+    // Still under the table locks: VACUUM must not move rows mid-rebuild.
     for (const auto& table : session.current_txn->touched_tables) {
         ddl_.RebuildIndexes(currentDbf_, currentDat_, table, err);
     }
+    lock_manager_.ReleaseAll(session.current_txn->id);
     delete session.current_txn;
     session.current_txn = nullptr;
     session.autocommit = true;
@@ -1449,10 +1540,10 @@ bool ApiServer::CommitTxn(SessionContext& session, std::string& err) {
 bool ApiServer::RollbackTxn(SessionContext& session, std::string& err) {
     if (!session.current_txn) { err = "No active transaction"; return false; }
     if (!txn_manager_.Rollback(session.current_txn, err)) return false;
-    lock_manager_.ReleaseAll(session.current_txn->id);
     for (const auto& table : session.current_txn->touched_tables) {
         ddl_.RebuildIndexes(currentDbf_, currentDat_, table, err);
     }
+    lock_manager_.ReleaseAll(session.current_txn->id);
     delete session.current_txn;
     session.current_txn = nullptr;
     session.autocommit = true;
@@ -1767,6 +1858,7 @@ void ApiServer::HandleCreateTable(const HttpRequest& req, HttpResponse& resp) {
             f.type = fv.Get("type") ? fv.Get("type")->AsString("int") : "int";
             f.isKey = fv.Get("isKey") ? (fv.Get("isKey")->AsBool(false)) : false;
             f.nullable = fv.Get("nullable") ? (fv.Get("nullable")->AsBool(true)) : true;
+            f.bloom = fv.Get("bloom") ? (fv.Get("bloom")->AsBool(false)) : false;
             f.valid = true;
             f.size = 0;
             if (!f.name.empty()) schema.fields.push_back(f);
@@ -1841,6 +1933,7 @@ static std::string SerializeSchemaObj(const TableSchema& s) {
             << "\"size\":" << f.size << ","
             << "\"isKey\":" << (f.isKey ? "true" : "false") << ","
             << "\"nullable\":" << (f.nullable ? "true" : "false") << ","
+            << "\"bloom\":" << (f.bloom ? "true" : "false") << ","
             << "\"valid\":" << (f.valid ? "true" : "false")
             << "}";
     }
@@ -11,6 +11,9 @@
 #include "txn/txn_manager.h"
 #include "txn/log_manager.h"
 #include "txn/lock_manager.h"
+#include "vacuum.h"
+#include "bulk_load.h"
+#include "analyze.h"
 #include <map>
 
 class ApiServer {
@@ -22,7 +25,7 @@ public:
     };
 
     ApiServer(StorageEngine& engine, DDLService& ddl, DMLService& dml, QueryService& query,
-        LogManager& log, TxnManager& txn_manager, LockManager& lock_manager,
+        LogManager& log, TxnManager& txn_manager, LockManager& lock_manager, VacuumService& vacuum,
         const std::string& dbfPath, const std::string& datPath);
     void Run(uint16_t port = 8080);
 
@@ -34,6 +37,9 @@ private:
     LogManager& log_;
     TxnManager& txn_manager_;
     LockManager& lock_manager_;
+    VacuumService& vacuum_;
+    BulkLoader loader_;
+    AnalyzeService analyzer_;
     AuthManager auth_; // Added AuthManager
 
     std::string dbfPath_;
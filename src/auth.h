@@ -6,10 +6,12 @@
 #include "dml.h"
 #include "ddl.h"
 
+class LockManager;
+
 // Simple AuthManager using "system" database
 class AuthManager {
 public:
-    AuthManager(StorageEngine& engine, DDLService& ddl, DMLService& dml);
+    AuthManager(StorageEngine& engine, DDLService& ddl, DMLService& dml, LockManager& lock_manager);
 
     // Initialize system tables if not exist
     bool Init(std::string& err);
@@ -34,6 +36,7 @@ private:
     StorageEngine& engine_;
     DDLService& ddl_;
     DMLService& dml_;
+    LockManager& lock_manager_;
 
     std::unordered_map<std::string, std::string> token_user_;
 
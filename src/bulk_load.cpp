@@ -0,0 +1,610 @@
+#include "bulk_load.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <unordered_set>
+
+#include "ddl.h"
+#include "path_utils.h"
+#include "storage/pax_page.h"
+#include "storage/slotted_page.h"
+#include "txn/lock_manager.h"
+#include "value.h"
+
+namespace {
+constexpr size_t kChunkBytes = 16 << 20;
+constexpr size_t kMaxThreads = 16;
+const std::string kNull = "NULL";
+
+std::string Lower(const std::string& s) {
+  std::string out = s;
+  std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return out;
+}
+
+std::string Trim(std::string s) {
+  auto notSpace = [](unsigned char ch) { return !std::isspace(ch); };
+  s.erase(s.begin(), std::find_if(s.begin(), s.end(), notSpace));
+  s.erase(std::find_if(s.rbegin(), s.rend(), notSpace).base(), s.end());
+  return s;
+}
+
+std::string NormalizeValue(const std::string& s) {
+  if (s.size() >= 2 && ((s.front() == '\'' && s.back() == '\'') || (s.front() == '"' && s.back() == '"'))) {
+    return s.substr(1, s.size() - 2);
+  }
+  return s;
+}
+
+bool IsNullValue(const std::string& s) {
+  const std::string v = Trim(NormalizeValue(s));
+  return v.empty() || Lower(v) == "null";
+}
+
+// Identifier as written in a schema: quotes or backticks stripped.
+std::string Ident(const std::string& s) {
+  std::string v = Trim(s);
+  if (v.size() >= 2 && (v.front() == '`' || v.front() == '"' || v.front() == '\'') && v.back() == v.front()) {
+    v = v.substr(1, v.size() - 2);
+  }
+  return v;
+}
+
+bool FindField(const TableSchema& schema, const std::string& name, size_t& out) {
+  const std::string low = Lower(Ident(name));
+  for (size_t i = 0; i < schema.fields.size(); ++i) {
+    if (Lower(schema.fields[i].name) == low) {
+      out = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// A run of whole CSV records and the line it starts on.
+struct Slice {
+  const char* begin = nullptr;
+  const char* end = nullptr;
+  uint64_t line = 0;
+};
+
+// Reads a CSV file in chunks cut at record ends (a newline outside quotes)
+// and splits each chunk into about `parts` slices for parallel parsing. A
+// record longer than a chunk grows the chunk.
+class ChunkReader {
+ public:
+  ChunkReader(const std::string& path, size_t parts, bool header)
+      : in_(path, std::ios::binary), parts_(parts), skipHeader_(header) {}
+
+  bool is_open() const { return in_.is_open(); }
+  uint64_t bytes() const { return bytes_; }
+  // Slices point into the reader and stay valid until the next call; false
+  // at the end of the file.
+  bool Next(std::vector<Slice>& slices);
+
+ private:
+  std::ifstream in_;
+  size_t parts_;
+  bool skipHeader_;
+  bool eof_ = false;
+  std::string buf_;
+  size_t used_ = 0;  // bytes of buf_ handed out by the previous call
+  uint64_t line_ = 1;
+  uint64_t bytes_ = 0;
+};
+
+bool ChunkReader::Next(std::vector<Slice>& slices) {
+  slices.clear();
+  buf_.erase(0, used_);
+  used_ = 0;
+
+  // Slice ends and the newlines before them; quotes toggle exactly as in
+  // ParseSlice, so both agree on where records end.
+  std::vector<std::pair<size_t, uint64_t>> cuts;
+  size_t pos = 0;
+  size_t cut = 0;
+  uint64_t newlines = 0;
+  uint64_t newlinesAtCut = 0;
+  bool quoted = false;
+  while (true) {
+    if (!eof_) {
+      const size_t old = buf_.size();
+      buf_.resize(old + kChunkBytes);
+      in_.read(&buf_[old], static_cast<std::streamsize>(kChunkBytes));
+      const size_t got = static_cast<size_t>(in_.gcount());
+      buf_.resize(old + got);
+      bytes_ += got;
+      eof_ = got < kChunkBytes;
+    }
+    const size_t step = std::max<size_t>(1, buf_.size() / parts_);
+    for (; pos < buf_.size(); ++pos) {
+      const char c = buf_[pos];
+      if (c == '"') {
+        quoted = !quoted;
+      } else if (c == '\n') {
+        ++newlines;
+        if (quoted) continue;
+        cut = pos + 1;
+        newlinesAtCut = newlines;
+        if (cut >= (cuts.empty() ? 0 : cuts.back().first) + step) cuts.push_back({cut, newlines});
+      }
+    }
+    if (eof_) {
+      cut = buf_.size();  // the last record may lack its newline
+      newlinesAtCut = newlines;
+      break;
+    }
+    if (cut > 0) break;
+  }
+  if (cut == 0) return false;
+  if (cuts.empty() || cuts.back().first != cut) cuts.push_back({cut, newlinesAtCut});
+
+  size_t begin = 0;
+  uint64_t linesBefore = 0;
+  for (const auto& c : cuts) {
+    slices.push_back({buf_.data() + begin, buf_.data() + c.first, line_ + linesBefore});
+    begin = c.first;
+    linesBefore = c.second;
+  }
+  if (skipHeader_) {
+    skipHeader_ = false;
+    Slice& first = slices.front();
+    quoted = false;
+    const char* p = first.begin;
+    for (; p < first.end && (quoted || *p != '\n'); ++p) {
+      if (*p == '"') quoted = !quoted;
+      if (*p == '\n') ++first.line;
+    }
+    first.begin = p < first.end ? p + 1 : p;
+    ++first.line;
+  }
+  line_ += newlinesAtCut;
+  used_ = cut;
+  return true;
+}
+
+// Splits a slice into records: fields[0, n) and the line each starts on go
+// to row(fields, n, line), which returns false to stop. Quotes may open and
+// close anywhere in a field and "" inside them is a quote; an unquoted empty
+// field is NULL. Blank lines are skipped.
+template <typename Row>
+bool ParseSlice(const Slice& s, char delimiter, std::vector<std::string>& fields, std::string& err, Row&& row) {
+  const char* p = s.begin;
+  uint64_t line = s.line;
+  while (p < s.end) {
+    if (*p == '\n' || (*p == '\r' && p + 1 < s.end && p[1] == '\n')) {
+      p += *p == '\n' ? 1 : 2;
+      ++line;
+      continue;
+    }
+    const uint64_t start = line;
+    size_t n = 0;
+    bool quoted = false;
+    bool hadQuotes = false;
+    auto next = [&]() -> std::string& {
+      if (n == fields.size()) fields.emplace_back();
+      fields[n].clear();
+      return fields[n++];
+    };
+    auto finish = [&](std::string& f) {
+      if (!hadQuotes && f.empty()) f = kNull;
+      hadQuotes = false;
+    };
+    std::string* cur = &next();
+    while (true) {
+      if (p == s.end) {
+        if (quoted) {
+          err = "Unterminated quoted field at line " + std::to_string(start);
+          return false;
+        }
+        break;
+      }
+      const char c = *p++;
+      if (quoted) {
+        if (c != '"') {
+          if (c == '\n') ++line;
+          cur->push_back(c);
+        } else if (p < s.end && *p == '"') {
+          cur->push_back('"');
+          ++p;
+        } else {
+          quoted = false;
+        }
+      } else if (c == '"') {
+        quoted = hadQuotes = true;
+      } else if (c == delimiter) {
+        finish(*cur);
+        cur = &next();
+      } else if (c == '\n') {
+        ++line;
+        if (p - 2 >= s.begin && p[-2] == '\r' && !cur->empty()) cur->pop_back();
+        break;
+      } else {
+        cur->push_back(c);
+      }
+    }
+    finish(*cur);
+    if (!row(fields, n, start)) return false;
+  }
+  return true;
+}
+
+// Runs work(i) for every slice on its own thread; the first failing slice
+// (in file order) supplies err.
+template <typename Work>
+bool ForEachSlice(const std::vector<Slice>& slices, Work&& work, std::string& err) {
+  std::vector<std::string> errs(slices.size());
+  std::vector<std::thread> threads;
+  threads.reserve(slices.size());
+  for (size_t i = 0; i < slices.size(); ++i) threads.emplace_back([&, i] { work(i, errs[i]); });
+  for (auto& t : threads) t.join();
+  for (const auto& e : errs) {
+    if (!e.empty()) {
+      err = e;
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t HashKey(size_t constraint, const std::string& key) {
+  uint64_t h = 1469598103934665603ULL ^ (constraint * 0x9E3779B97F4A7C15ULL);
+  for (unsigned char c : key) h = (h ^ c) * 1099511628211ULL;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Open-addressing set of key hashes, half full at most.
+class HashSet {
+ public:
+  // false when h was already there
+  bool Insert(uint64_t h) {
+    if (h == 0) h = 1;  // 0 marks a free slot
+    if ((size_ + 1) * 2 > slots_.size()) Grow();
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+      if (slots_[i] == h) return false;
+      if (slots_[i] == 0) {
+        slots_[i] = h;
+        ++size_;
+        return true;
+      }
+    }
+  }
+
+ private:
+  void Grow() {
+    std::vector<uint64_t> old(std::max<size_t>(1024, slots_.size() * 2), 0);
+    old.swap(slots_);
+    size_ = 0;
+    for (uint64_t h : old) {
+      if (h != 0) Insert(h);
+    }
+  }
+
+  std::vector<uint64_t> slots_;
+  size_t size_ = 0;
+};
+
+// The primary key or a unique index: rows may not share its key.
+struct Constraint {
+  std::vector<size_t> cols;
+  bool nullsDistinct = false;  // unique indexes ignore NULLs
+  std::string name;            // for the error message
+};
+
+// Same key text as the INSERT duplicate check; false when exempt (NULL).
+template <typename Values>
+bool ConstraintKey(const Constraint& c, const Values& values, std::string& key) {
+  key.clear();
+  for (size_t i = 0; i < c.cols.size(); ++i) {
+    const std::string v = NormalizeValue(std::string(values[c.cols[i]]));
+    if (c.nullsDistinct && IsNullValue(v)) return false;
+    if (i) key.push_back('\x1f');
+    key += v;
+  }
+  return true;
+}
+
+// Referenced keys of one foreign key, read once from the parent table.
+struct ParentKeys {
+  std::vector<size_t> cols;  // child columns
+  std::unordered_set<std::string> keys;
+};
+
+// Numbers compare by value, as FK lookups do (1 matches 1.0).
+void AppendFkPart(const Value& v, std::string& key) {
+  if (v.numeric()) {
+    double d = v.AsDouble();
+    if (d == 0) d = 0;  // -0.0
+    key.push_back('\x01');
+    key.append(reinterpret_cast<const char*>(&d), sizeof(d));
+  } else {
+    key.push_back('\x02');
+    key.append(v.text);
+  }
+  key.push_back('\x1f');
+}
+
+bool LoadParentKeys(StorageEngine& engine, const std::string& dbName, const TableSchema& schema,
+                    const ForeignKeyDef& fkRaw, ParentKeys& out, std::string& err) {
+  auto catalog = engine.LoadCatalog(dbms_paths::DbfPath(dbName), err);
+  if (!catalog) return false;
+  std::string refName = Ident(fkRaw.refTable);
+  const size_t lp = refName.find('(');
+  if (lp != std::string::npos) refName = Ident(refName.substr(0, lp));
+  const TableSchema* ref = catalog->Find(refName);
+  if (!ref) ref = catalog->FindNoCase(refName);
+  if (!ref) {
+    err = "Referenced table not found: " + refName;
+    return false;
+  }
+  std::vector<std::string> refCols = fkRaw.refColumns;
+  if (refCols.empty()) {
+    for (const auto& f : ref->fields) {
+      if (f.isKey) refCols.push_back(f.name);
+    }
+    if (refCols.size() != fkRaw.columns.size()) refCols = fkRaw.columns;  // as ResolveRefColumns
+  }
+  if (refCols.size() != fkRaw.columns.size()) {
+    err = "Foreign key column count mismatch on table '" + schema.tableName + "'";
+    return false;
+  }
+  std::vector<size_t> parentCols(refCols.size());
+  std::vector<ColumnKind> kinds(refCols.size());
+  out.cols.resize(fkRaw.columns.size());
+  for (size_t i = 0; i < refCols.size(); ++i) {
+    if (!FindField(*ref, refCols[i], parentCols[i])) {
+      err = "Referenced column not found: " + refCols[i];
+      return false;
+    }
+    if (!FindField(schema, fkRaw.columns[i], out.cols[i])) {
+      err = "Foreign key column not found: " + fkRaw.columns[i];
+      return false;
+    }
+    uint32_t width = 0;
+    kinds[i] = ColumnKindOf(ref->fields[parentCols[i]], width);
+  }
+
+  TableScanCursor cursor;
+  if (!engine.OpenScan(dbms_paths::DatPath(dbName), *ref, cursor, err)) return false;
+  int64_t offset = 0;
+  RecordView row;
+  std::string key;
+  while (cursor.Next(offset, row)) {
+    key.clear();
+    for (size_t i = 0; i < parentCols.size(); ++i) {
+      const std::string v = Trim(NormalizeValue(std::string(row.values[parentCols[i]])));
+      AppendFkPart(Value::Of(v, kinds[i]), key);
+    }
+    out.keys.insert(key);
+  }
+  err = cursor.error();
+  return err.empty();
+}
+
+// false when a non-NULL child key has no parent row.
+bool HasParent(const ParentKeys& fk, const std::vector<std::string>& fields, std::string& key) {
+  key.clear();
+  for (size_t c : fk.cols) {
+    const std::string v = Trim(NormalizeValue(fields[c]));
+    if (IsNullValue(v)) return true;
+    AppendFkPart(Value::Untyped(v), key);
+  }
+  return fk.keys.count(key) > 0;
+}
+
+std::string DuplicateMessage(const Constraint& c, const std::string& key, uint64_t line) {
+  std::string shown = key;
+  std::replace(shown.begin(), shown.end(), '\x1f', ',');
+  const std::string what = c.name.empty() ? "primary key" : "key '" + c.name + "'";
+  return "Duplicate entry '" + shown + "' for " + what + " at line " + std::to_string(line);
+}
+}  // namespace
+
+bool BulkLoader::Load(const std::string& dbName, const TableSchema& schema, const std::string& csvPath,
+                      const LoadOptions& options, LoadStats& stats, std::string& err) {
+  stats = LoadStats();
+  if (schema.isView) {
+    err = "Cannot COPY into a view";
+    return false;
+  }
+  const size_t fieldCount = schema.fields.size();
+  const size_t threads = std::min(kMaxThreads, std::max<size_t>(1, std::thread::hardware_concurrency()));
+  const std::string dat = dbms_paths::DatPath(dbName);
+  {
+    ChunkReader probe(csvPath, threads, options.header);
+    if (!probe.is_open()) {
+      err = "Cannot open file: " + csvPath;
+      return false;
+    }
+  }
+
+  std::vector<Constraint> constraints;
+  {
+    Constraint pk;
+    for (size_t i = 0; i < fieldCount; ++i) {
+      if (schema.fields[i].isKey) pk.cols.push_back(i);
+    }
+    if (!pk.cols.empty()) constraints.push_back(pk);
+    for (const auto& idx : schema.indexes) {
+      Constraint u;
+      u.cols.resize(1);
+      if (!idx.isUnique || !FindField(schema, idx.fieldName, u.cols[0])) continue;
+      u.nullsDistinct = true;
+      u.name = idx.name;
+      constraints.push_back(u);
+    }
+  }
+  const bool paged = schema.storage != StorageFormat::kRow;
+  const size_t maxRecord = schema.storage == StorageFormat::kColumnar ? PaxPage::MaxRecordSize(fieldCount + 1)
+                                                                     : SlottedPage::MaxRecordSize();
+  const RecordCodec codec(schema);
+
+  // An owner of its own: table locks are re-entrant per owner, so a shared
+  // one would let two loads into the same table in at once.
+  const TxnId owner = LockManager::TransientOwner();
+  if (!locks_.LockTableExclusive(owner, schema.tableName, err)) return false;
+  if (!engine_.SchemaStillCurrent(dbms_paths::DbfPath(dbName), schema, err)) {
+    locks_.ReleaseAll(owner);
+    return false;
+  }
+  bool writing = false;
+  auto run = [&]() -> bool {
+    std::vector<ParentKeys> parents(schema.foreignKeys.size());
+    for (size_t i = 0; i < parents.size(); ++i) {
+      if (!LoadParentKeys(engine_, dbName, schema, schema.foreignKeys[i], parents[i], err)) return false;
+    }
+
+    // Pass 1: every key of the table and the file goes into one hash set;
+    // a hash seen twice is a suspect, settled exactly below.
+    HashSet seen;
+    std::unordered_set<uint64_t> suspects;
+    std::string key;
+    if (!constraints.empty()) {
+      TableScanCursor cursor;
+      if (!engine_.OpenScan(dat, schema, cursor, err)) return false;
+      int64_t offset = 0;
+      RecordView row;
+      while (cursor.Next(offset, row)) {
+        for (size_t c = 0; c < constraints.size(); ++c) {
+          if (!ConstraintKey(constraints[c], row.values, key)) continue;
+          const uint64_t h = HashKey(c, key);
+          if (!seen.Insert(h)) suspects.insert(h);
+        }
+      }
+      if (!cursor.error().empty()) {
+        err = cursor.error();
+        return false;
+      }
+    }
+
+    ChunkReader reader(csvPath, threads, options.header);
+    std::vector<Slice> slices;
+    std::vector<std::vector<uint64_t>> hashes;
+    std::vector<uint64_t> rows;
+    while (reader.Next(slices)) {
+      hashes.assign(slices.size(), {});
+      rows.assign(slices.size(), 0);
+      auto check = [&](size_t i, std::string& sliceErr) {
+        std::vector<std::string> fields;
+        std::string k;
+        Record rec;
+        std::vector<uint8_t> bytes;
+        ParseSlice(slices[i], options.delimiter, fields, sliceErr, [&](std::vector<std::string>& f, size_t n, uint64_t line) {
+          if (n != fieldCount) {
+            sliceErr = "Line " + std::to_string(line) + ": expected " + std::to_string(fieldCount) + " fields, got " + std::to_string(n);
+            return false;
+          }
+          for (const auto& fk : parents) {
+            if (!HasParent(fk, f, k)) {
+              sliceErr = "Foreign key constraint fails on table '" + schema.tableName + "' at line " + std::to_string(line);
+              return false;
+            }
+          }
+          if (paged) {
+            rec.values.assign(f.begin(), f.begin() + static_cast<std::ptrdiff_t>(n));
+            Overflow::Shrink(codec, rec);  // long values will not take room in the page
+            codec.Encode(rec, bytes);
+            if (bytes.size() > maxRecord) {
+              sliceErr = "Record too large for a page at line " + std::to_string(line);
+              return false;
+            }
+          }
+          for (size_t c = 0; c < constraints.size(); ++c) {
+            if (ConstraintKey(constraints[c], f, k)) hashes[i].push_back(HashKey(c, k));
+          }
+          ++rows[i];
+          return true;
+        });
+      };
+      if (!ForEachSlice(slices, check, err)) return false;
+      for (size_t i = 0; i < slices.size(); ++i) {
+        for (uint64_t h : hashes[i]) {
+          if (!seen.Insert(h)) suspects.insert(h);
+        }
+        stats.rows += rows[i];
+      }
+    }
+    stats.bytes = reader.bytes();
+
+    if (!suspects.empty()) {
+      // Exact count of each suspect key: one occurrence in the file next to
+      // any other is a duplicate; a hash collision is not.
+      std::map<std::pair<size_t, std::string>, uint64_t> counts;
+      TableScanCursor cursor;
+      if (!engine_.OpenScan(dat, schema, cursor, err)) return false;
+      int64_t offset = 0;
+      RecordView row;
+      while (cursor.Next(offset, row)) {
+        for (size_t c = 0; c < constraints.size(); ++c) {
+          if (ConstraintKey(constraints[c], row.values, key) && suspects.count(HashKey(c, key))) ++counts[{c, key}];
+        }
+      }
+      if (!cursor.error().empty()) {
+        err = cursor.error();
+        return false;
+      }
+      ChunkReader again(csvPath, 1, options.header);
+      std::vector<std::string> fields;
+      while (again.Next(slices)) {
+        for (const auto& s : slices) {
+          bool dup = false;
+          const bool parsed = ParseSlice(s, options.delimiter, fields, err, [&](std::vector<std::string>& f, size_t, uint64_t line) {
+            for (size_t c = 0; c < constraints.size(); ++c) {
+              if (!ConstraintKey(constraints[c], f, key) || !suspects.count(HashKey(c, key))) continue;
+              if (++counts[{c, key}] > 1) {
+                err = DuplicateMessage(constraints[c], key, line);
+                dup = true;
+                return false;
+              }
+            }
+            return true;
+          });
+          if (dup || !parsed) return false;
+        }
+      }
+    }
+
+    // Pass 2: parse again and append each slice as one block (or run of
+    // pages) in file order.
+    writing = true;
+    ChunkReader writer(csvPath, threads, options.header);
+    std::vector<std::vector<Record>> batches;
+    while (writer.Next(slices)) {
+      batches.assign(slices.size(), {});
+      auto parse = [&](size_t i, std::string& sliceErr) {
+        std::vector<std::string> fields;
+        ParseSlice(slices[i], options.delimiter, fields, sliceErr, [&](std::vector<std::string>& f, size_t n, uint64_t) {
+          Record rec;
+          rec.values.reserve(n);
+          for (size_t k = 0; k < n; ++k) rec.values.push_back(std::move(f[k]));
+          batches[i].push_back(std::move(rec));
+          return true;
+        });
+      };
+      if (!ForEachSlice(slices, parse, err)) return false;
+      for (const auto& batch : batches) {
+        if (!engine_.AppendRecords(dat, schema, batch, err)) return false;
+      }
+    }
+    return true;
+  };
+  bool ok = run();
+  // Still exclusive: VACUUM must not move rows between the scan and the
+  // save. Rows a failed write pass left behind get indexed too.
+  if (writing) {
+    std::string indexErr;
+    if (!ddl_.RebuildIndexes(dbms_paths::DbfPath(dbName), dat, schema.tableName, indexErr) && ok) {
+      err = indexErr;
+      ok = false;
+    }
+  }
+  locks_.ReleaseAll(owner);
+  return ok;
+}
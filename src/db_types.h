@@ -1,5 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -11,6 +13,7 @@ struct Field {
   bool isKey = false;    // primary key flag
   bool nullable = true;  // allow NULL
   bool valid = true;     // soft-delete flag for column
+  bool bloom = false;    // per-zone Bloom filter for = / IN (storage/zone_map.h)
 };
 
 struct IndexDef {
@@ -34,6 +37,51 @@ struct ForeignKeyDef {
   ReferentialAction onUpdate = ReferentialAction::kRestrict;
 };
 
+// On-disk layout of a table's data file
+enum class StorageFormat {
+  kRow,      // variable-length '~' blocks (default)
+  kPaged,    // 8 KiB slotted pages, RID = (page, slot)
+  kColumnar  // 8 KiB PAX pages, one row group stored by column, RID = (page, row)
+};
+
+// Record layout inside the data file (see storage/record_codec.h)
+enum class RecordEncoding {
+  kText,   // every value as length-prefixed text (tables created before typed encoding)
+  kTyped   // binary ints/doubles, fixed-width char[n], null bitmap
+};
+
+// Statistics of one column (ANALYZE). NULLs are left out of everything but
+// nullFraction.
+struct ColumnStats {
+  std::string name;
+  uint64_t distinct = 0;    // estimated number of distinct values
+  double nullFraction = 0;  // of live rows
+  bool hasRange = false;    // false when every value is NULL
+  std::string min;
+  std::string max;
+  // Equi-depth histogram: bucket i covers (bounds[i], bounds[i + 1]], the
+  // first one bounds[0] too, and holds bucketRows[i] rows.
+  std::vector<std::string> bounds;
+  std::vector<uint64_t> bucketRows;
+};
+
+// Statistics of one table as of its last ANALYZE, saved in the .dbf.
+struct TableStats {
+  uint64_t analyzedAt = 0;  // unix seconds
+  uint64_t rowCount = 0;    // live rows
+  uint64_t deadRows = 0;    // deleted rows still in the data file
+  uint64_t sampleRows = 0;  // rows the histograms were built from
+  std::vector<ColumnStats> columns;
+
+  // nullptr when the column was not analyzed (added or renamed since)
+  const ColumnStats* Find(const std::string& column) const {
+    for (const auto& c : columns) {
+      if (c.name == column) return &c;
+    }
+    return nullptr;
+  }
+};
+
 // Table schema
 struct TableSchema {
   std::string tableName;
@@ -42,12 +90,55 @@ struct TableSchema {
   std::vector<ForeignKeyDef> foreignKeys;
   bool isView = false;            // view flag
   std::string viewSql;            // original CREATE VIEW SELECT text
+  StorageFormat storage = StorageFormat::kRow;
+  RecordEncoding encoding = RecordEncoding::kText;
+  std::shared_ptr<const TableStats> stats;  // nullptr until ANALYZE
 };
 
 // Single record
 struct Record {
   bool valid = true;                 // record valid flag (soft delete)
   std::vector<std::string> values;   // values aligned with fields
+  // Per field: values[i] is a pointer into the overflow sidecar, not the
+  // value. Set only between storing / loading a row and resolving it;
+  // empty when no field is.
+  std::vector<bool> overflow;
+
+  bool Overflowed(size_t i) const { return i < overflow.size() && overflow[i]; }
+  void SetOverflowed(size_t i) {
+    if (overflow.size() <= i) overflow.resize(i + 1);
+    overflow[i] = true;
+  }
+};
+
+// A typed INT/DOUBLE cell as stored, before it was rendered to text.
+struct StoredNumber {
+  enum class Type : uint8_t { kNone, kInt, kDouble };
+  Type type = Type::kNone;
+  int64_t i = 0;
+  double d = 0;
+};
+
+// Non-owning record whose values point into a page or file mapping; only
+// valid inside the scan callback that produced it.
+struct RecordView {
+  bool valid = true;
+  std::vector<std::string_view> values;
+  // Typed records: per field, the binary number behind values[i] (kNone for
+  // other cells), so filters need not parse it back; empty otherwise.
+  std::vector<StoredNumber> numbers;
+  std::vector<bool> overflow;  // as in Record
+
+  bool Overflowed(size_t i) const { return i < overflow.size() && overflow[i]; }
+
+  Record Materialize() const {
+    Record r;
+    r.valid = valid;
+    r.values.reserve(values.size());
+    for (const auto& v : values) r.values.emplace_back(v);
+    r.overflow = overflow;
+    return r;
+  }
 };
 
 // Loop dependency resolution
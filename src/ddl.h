@@ -4,9 +4,12 @@
 #include "db_types.h"
 #include "storage_engine.h"
 
+class LockManager;
+class LogManager;
+
 class DDLService {
  public:
-  explicit DDLService(StorageEngine& engine) : engine_(engine) {}
+  DDLService(StorageEngine& engine, LogManager& log, LockManager& locks) : engine_(engine), log_(log), locks_(locks) {}
 
   bool CreateTable(const std::string& dbfPath, const std::string& datPath, const TableSchema& schema, std::string& err);
   bool RenameTable(const std::string& dbfPath, const std::string& datPath, const std::string& oldName, const std::string& newName, std::string& err);
@@ -33,5 +36,10 @@ class DDLService {
 
  private:
   StorageEngine& engine_;
+  LogManager& log_;
+  LockManager& locks_;
   std::string GetIndexPath(const std::string& datPath, const std::string& tableName, const std::string& fieldName);
+  // Before a table's data file is rewritten or replaced: sync it, then mark
+  // the WAL so recovery does not replay older offsets into the new file.
+  bool MarkRewrite(const std::string& datPath, const TableSchema& schema, std::string& err);
 };
@@ -3,8 +3,10 @@
 #include <cctype>
 #include <string>
 #include <map>
+#include <set>
 #include <unordered_set>
 #include "path_utils.h"
+#include "value.h"
 #include "txn/log_manager.h"
 #include "txn/lock_manager.h"
 
@@ -37,6 +39,34 @@ void AddTouchedTable(Txn* txn, const std::string& table) {
   if (it == txn->touched_tables.end()) txn->touched_tables.push_back(table);
 }
 
+// Holds the tables a statement writes shared, so VACUUM and DDL (which lock a
+// table exclusive) cannot rewrite one between the statement's scan and its
+// writes. The schema was loaded before the lock, so it is checked again once
+// held. A transaction keeps them until it ends; outside one they go on return.
+class TableLocks {
+ public:
+  TableLocks(StorageEngine& engine, const std::string& dbfPath, LockManager* locks, Txn* txn)
+      : engine_(engine), dbfPath_(dbfPath), locks_(locks),
+        owner_(txn ? txn->id : LockManager::TransientOwner()), transient_(!txn) {}
+  ~TableLocks() {
+    if (locks_ && transient_) locks_->ReleaseAll(owner_);
+  }
+  TableLocks(const TableLocks&) = delete;
+  TableLocks& operator=(const TableLocks&) = delete;
+
+  bool Lock(const TableSchema& schema, std::string& err) {
+    return !locks_ || (locks_->LockTableShared(owner_, schema.tableName, err) &&
+                       engine_.SchemaStillCurrent(dbfPath_, schema, err));
+  }
+
+ private:
+  StorageEngine& engine_;
+  const std::string& dbfPath_;
+  LockManager* locks_;
+  TxnId owner_;
+  bool transient_;
+};
+
 std::string BuildCompositeKey(const Record& rec, const std::vector<size_t>& keyIdxs) {
   std::string key;
   for (size_t i = 0; i < keyIdxs.size(); ++i) {
@@ -71,6 +101,69 @@ bool FindFieldIndex(const TableSchema& schema, const std::string& name, size_t&
   return false;
 }
 
+// WHERE of a DML statement resolved once: field slots, column kinds and
+// literal operands, so rows are matched without re-parsing the literals.
+class RowFilter {
+ public:
+  RowFilter(const TableSchema& schema, const std::vector<Condition>& conditions) {
+    terms_.reserve(conditions.size());
+    for (const auto& cond : conditions) {
+      if (cond.fieldName.empty()) continue;
+      Term t;
+      t.cond = &cond;
+      t.found = FindFieldIndex(schema, cond.fieldName, t.field);
+      uint32_t width = 0;
+      if (t.found) t.kind = ColumnKindOf(schema.fields[t.field], width);
+      t.hasOp = ParseCompareOp(cond.op, t.op);
+      t.operand = NormalizeValue(cond.value);
+      for (const auto& v : cond.values) t.list.push_back(NormalizeValue(v));
+      terms_.push_back(std::move(t));
+    }
+    // Values view the terms' strings, which no longer move.
+    for (auto& t : terms_) {
+      t.operandValue = Value::Untyped(t.operand);
+      for (const auto& v : t.list) t.listValues.push_back(Value::Untyped(v));
+    }
+  }
+  RowFilter(const RowFilter&) = delete;
+  RowFilter& operator=(const RowFilter&) = delete;
+
+  bool operator()(const Record& rec) const {
+    for (const auto& t : terms_) {
+      if (!t.found || t.field >= rec.values.size()) return false;
+      const std::string val = NormalizeValue(rec.values[t.field]);
+      const Value v = Value::Of(val, t.kind);
+      bool match = false;
+      if (t.cond->op == "IN") {
+        for (size_t i = 0; i < t.list.size() && !match; ++i) {
+          match = Satisfies(v, CompareOp::kEq, t.listValues[i]) || val == t.list[i];
+        }
+      } else if (t.cond->op == "CONTAINS") {
+        match = val.find(t.operand) != std::string::npos;
+      } else if (t.hasOp) {
+        match = Satisfies(v, t.op, t.operandValue);
+      }
+      if (!match) return false;
+    }
+    return true;
+  }
+
+ private:
+  struct Term {
+    const Condition* cond = nullptr;
+    bool found = false;
+    size_t field = 0;
+    ColumnKind kind = ColumnKind::kText;
+    bool hasOp = false;
+    CompareOp op = CompareOp::kEq;
+    std::string operand;
+    std::vector<std::string> list;
+    Value operandValue;
+    std::vector<Value> listValues;
+  };
+  std::vector<Term> terms_;
+};
+
 bool IsNullableColumn(const TableSchema& schema, const std::string& name) {
   size_t idx = 0;
   if (!FindFieldIndex(schema, name, idx)) return false;
@@ -157,16 +250,13 @@ bool FindReferencedRecord(StorageEngine& engine, const std::string& datPath, con
                           const std::vector<std::string>& refCols, const std::vector<std::string>& values,
                           std::string& err) {
   if (refCols.size() != values.size()) return false;
-  auto asNumber = [](const std::string& s, double& out) {
-    try { size_t i = 0; out = std::stod(s, &i); return i == s.size(); } catch (...) { return false; }
-  };
   if (refCols.size() == 1 && HasUniqueIndexOn(refSchema, refCols[0])) {
     std::string idxName;
     for (const auto& idx : refSchema.indexes) {
       if (Lower(idx.fieldName) == Lower(refCols[0])) { idxName = idx.name; break; }
     }
     if (idxName.empty()) idxName = "PRIMARY";
-    std::map<std::string, long> idx;
+    std::map<std::string, int64_t> idx;
     std::string ignErr;
     std::string idxPath = dbms_paths::IndexPathFromDat(datPath, refSchema.tableName, idxName);
     if (engine.LoadIndex(idxPath, idx, ignErr)) {
@@ -182,60 +272,64 @@ bool FindReferencedRecord(StorageEngine& engine, const std::string& datPath, con
     }
   }
 
-  std::vector<Record> records;
-  if (!engine.ReadRecords(datPath, refSchema, records, err)) return false;
-  for (const auto& r : records) {
-    if (!r.valid) continue;
+  // Referenced columns and target values are resolved once for the scan.
+  std::vector<size_t> cols(refCols.size());
+  std::vector<ColumnKind> kinds(refCols.size());
+  std::vector<std::string> targets(refCols.size());
+  for (size_t i = 0; i < refCols.size(); ++i) {
+    if (!FindFieldIndex(refSchema, refCols[i], cols[i])) return false;
+    uint32_t width = 0;
+    kinds[i] = ColumnKindOf(refSchema.fields[cols[i]], width);
+    targets[i] = NormalizeScalar(values[i]);
+  }
+  std::vector<Value> targetValues;
+  for (const auto& t : targets) targetValues.push_back(Value::Untyped(t));
+
+  TableScanCursor cursor;
+  if (!engine.OpenScan(datPath, refSchema, cursor, err)) return false;
+  int64_t offset = 0;
+  Record r;
+  while (cursor.Next(offset, r)) {
     bool match = true;
-    for (size_t i = 0; i < refCols.size(); ++i) {
-      size_t idx = 0;
-      if (!FindFieldIndex(refSchema, refCols[i], idx)) { match = false; break; }
-      std::string val = (idx < r.values.size()) ? NormalizeScalar(r.values[idx]) : "";
-      std::string target = NormalizeScalar(values[i]);
-      if (val != target) {
-        double v1 = 0, v2 = 0;
-        if (!(asNumber(val, v1) && asNumber(target, v2) && std::abs(v1 - v2) < 1e-9)) {
-          match = false;
-          break;
-        }
-      }
+    for (size_t i = 0; i < refCols.size() && match; ++i) {
+      std::string val = (cols[i] < r.values.size()) ? NormalizeScalar(r.values[cols[i]]) : "";
+      match = val == targets[i] || Satisfies(Value::Of(val, kinds[i]), CompareOp::kEq, targetValues[i]);
     }
     if (match) return true;
   }
+  err = cursor.error();
   return false;
 }
 
-bool RebuildIndexesForTable(StorageEngine& engine, const std::string& datPath, const TableSchema& schema, std::string& err) {
-  if (schema.indexes.empty()) return true;
-  std::vector<std::pair<long, Record>> newRecords;
-  if (!engine.ReadRecordsWithOffsets(datPath, schema, newRecords, err)) return false;
-  if (!dbms_paths::EnsureIndexDirFromDat(datPath, err)) return false;
-  for (const auto& idxDef : schema.indexes) {
-    std::map<std::string, long> idxMap;
-    size_t fIdx = static_cast<size_t>(-1);
-    for (size_t i = 0; i < schema.fields.size(); ++i) {
-      if (schema.fields[i].name == idxDef.fieldName) { fIdx = i; break; }
-    }
-    if (fIdx == static_cast<size_t>(-1)) continue;
-    for (const auto& p : newRecords) {
-      if (fIdx < p.second.values.size()) {
-        std::string val = NormalizeValue(p.second.values[fIdx]);
-        idxMap[val] = p.first;
-      }
-    }
-    if (!engine.SaveIndex(GetIdxPath(datPath, schema.tableName, idxDef.name), idxMap, err)) return false;
+// The images of an in-place change of the row at offset: before exactly as
+// stored, after (afterRec, changed to match) as it will be stored. Values
+// afterRec shares with the old row keep their stored form, so an out-of-line
+// one keeps its pointer; new long values move to the overflow sidecar.
+bool RowImages(StorageEngine& engine, const std::string& datPath, const TableSchema& schema, int64_t offset,
+               const Record& beforeRec, Record& afterRec, std::vector<uint8_t>& before, std::vector<uint8_t>& after,
+               std::string& err) {
+  if (!engine.ReadRecordBytesAt(datPath, schema, offset, before, err)) return false;
+  Record stored;
+  if (!RecordCodec(schema).Decode(before.data(), before.size(), stored)) {
+    err = "Read fields failed";
+    return false;
   }
-  return true;
+  for (size_t i = 0; i < afterRec.values.size() && i < beforeRec.values.size() && i < stored.values.size(); ++i) {
+    if (afterRec.values[i] != beforeRec.values[i]) continue;
+    afterRec.values[i] = stored.values[i];
+    if (stored.Overflowed(i)) afterRec.SetOverflowed(i);
+  }
+  return engine.SerializeRecord(datPath, schema, afterRec, after, err);
 }
 
-bool ApplyDeleteAt(StorageEngine& engine, const std::string& datPath, const TableSchema& schema, long offset,
-                   const Record& rec, Txn* txn, LogManager* log, LockManager* lock_manager, std::string& err) {
+bool ApplyDeleteAt(StorageEngine& engine, const std::string& datPath, const TableSchema& schema, int64_t offset,
+                   Txn* txn, LogManager* log, LockManager* lock_manager, std::string& err) {
   if (lock_manager && txn) {
     RID rid{schema.tableName, static_cast<uint64_t>(offset)};
     if (!lock_manager->LockExclusive(txn->id, rid, err)) return false;
   }
   std::vector<uint8_t> before;
-  if (!engine.SerializeRecord(schema, rec, before, err)) return false;
+  if (!engine.ReadRecordBytesAt(datPath, schema, offset, before, err)) return false;
   LogRecord lr;
   lr.txn_id = txn->id;
   lr.type = LogType::DELETE;
@@ -247,10 +341,10 @@ bool ApplyDeleteAt(StorageEngine& engine, const std::string& datPath, const Tabl
   txn->undo_chain.push_back(lsn);
   std::vector<uint8_t> after = before;
   if (!after.empty()) after[0] = 0;
-  return engine.WriteRecordBytesAt(datPath, offset, after, err);
+  return engine.WriteRecordBytesAt(datPath, schema, offset, after, err, lsn);
 }
 
-bool ApplyUpdateAt(StorageEngine& engine, const std::string& datPath, const TableSchema& schema, long offset,
+bool ApplyUpdateAt(StorageEngine& engine, const std::string& datPath, const TableSchema& schema, int64_t offset,
                    const Record& beforeRec, const Record& afterRec,
                    Txn* txn, LogManager* log, LockManager* lock_manager, std::string& err) {
   if (lock_manager && txn) {
@@ -259,9 +353,9 @@ bool ApplyUpdateAt(StorageEngine& engine, const std::string& datPath, const Tabl
   }
   std::vector<uint8_t> before;
   std::vector<uint8_t> after;
-  if (!engine.SerializeRecord(schema, beforeRec, before, err)) return false;
-  if (!engine.SerializeRecord(schema, afterRec, after, err)) return false;
-  if (before.size() != after.size()) {
+  Record stored = afterRec;
+  if (!RowImages(engine, datPath, schema, offset, beforeRec, stored, before, after, err)) return false;
+  if (!engine.CanOverwrite(datPath, schema, offset, before, after)) {
     if (!txn || !log) { err = "Update size mismatch for SET NULL"; return false; }
     // Fallback: represent size-changing update as DELETE + INSERT to keep WAL consistent.
     LogRecord del;
@@ -274,8 +368,8 @@ bool ApplyUpdateAt(StorageEngine& engine, const std::string& datPath, const Tabl
     if (delLsn == 0) return false;
     txn->undo_chain.push_back(delLsn);
 
-    long newOffset = 0;
-    if (!engine.ComputeAppendRecordOffset(datPath, schema, newOffset, err)) return false;
+    int64_t newOffset = 0;
+    if (!engine.ComputeAppendRecordOffset(datPath, schema, after, newOffset, err)) return false;
     if (lock_manager) {
       RID newRid{schema.tableName, static_cast<uint64_t>(newOffset)};
       if (!lock_manager->LockExclusive(txn->id, newRid, err)) return false;
@@ -293,10 +387,10 @@ bool ApplyUpdateAt(StorageEngine& engine, const std::string& datPath, const Tabl
 
     std::vector<uint8_t> tomb = before;
     if (!tomb.empty()) tomb[0] = 0;
-    if (!engine.WriteRecordBytesAt(datPath, offset, tomb, err)) return false;
+    if (!engine.WriteRecordBytesAt(datPath, schema, offset, tomb, err, delLsn)) return false;
 
-    long realOffset = 0;
-    if (!engine.AppendRecord(datPath, schema, afterRec, realOffset, err)) return false;
+    int64_t realOffset = 0;
+    if (!engine.AppendRecord(datPath, schema, stored, realOffset, err)) return false;
     if (realOffset != newOffset) {
       err = "Append offset mismatch for WAL";
       return false;
@@ -313,82 +407,131 @@ bool ApplyUpdateAt(StorageEngine& engine, const std::string& datPath, const Tabl
   LSN lsn = log->Append(lr, err);
   if (lsn == 0) return false;
   txn->undo_chain.push_back(lsn);
-  return engine.WriteRecordBytesAt(datPath, offset, after, err);
+  return engine.WriteRecordBytesAt(datPath, schema, offset, after, err, lsn);
 }
+
+// Non-transactional change of one row without rewriting the table: a
+// tombstone (after == nullptr), a same-size overwrite, or a tombstone plus an
+// append when the size changes. outOffset = where the row lives afterwards.
+bool WriteRowInPlace(StorageEngine& engine, const std::string& datPath, const TableSchema& schema, int64_t offset,
+                     const Record& beforeRec, const Record* afterRec, int64_t& outOffset, std::string& err) {
+  std::vector<uint8_t> before;
+  outOffset = offset;
+  Record stored;
+  if (afterRec) {
+    stored = *afterRec;
+    std::vector<uint8_t> after;
+    if (!RowImages(engine, datPath, schema, offset, beforeRec, stored, before, after, err)) return false;
+    if (engine.CanOverwrite(datPath, schema, offset, before, after)) return engine.WriteRecordBytesAt(datPath, schema, offset, after, err);
+  } else if (!engine.ReadRecordBytesAt(datPath, schema, offset, before, err)) {
+    return false;
+  }
+  std::vector<uint8_t> tomb = before;
+  if (!tomb.empty()) tomb[0] = 0;
+  if (!engine.WriteRecordBytesAt(datPath, schema, offset, tomb, err)) return false;
+  return !afterRec || engine.AppendRecord(datPath, schema, stored, outOffset, err);
 }
 
-bool DMLService::Match(const TableSchema& schema, const Record& rec, const std::vector<Condition>& conditions) const {
-  if (conditions.empty()) return true;
+// A table's index files, loaded on first use, patched per changed row and
+// saved once.
+class IndexPatch {
+ public:
+  IndexPatch(StorageEngine& engine, const std::string& datPath, const TableSchema& schema)
+      : engine_(engine), datPath_(datPath), schema_(schema) {}
+
+  // Drop the row's keys that still point at offset. Another live row may
+  // share the key of a non-unique index; Save points it there.
+  void Remove(const Record& rec, int64_t offset) {
+    Load();
+    for (auto& idx : indexes_) {
+      if (idx.field >= rec.values.size()) continue;
+      auto it = idx.map.find(NormalizeValue(rec.values[idx.field]));
+      if (it != idx.map.end() && it->second == offset) {
+        if (!idx.unique) idx.recheck.insert(it->first);
+        idx.map.erase(it);
+        idx.dirty = true;
+      }
+    }
+  }
 
-  auto asNumber = [](const std::string& s, double& out) {
-      try {
-          size_t idx = 0;
-          out = std::stod(s, &idx);
-          // ensure backend is not garbage
-          return idx == s.size(); 
-      } catch (...) { return false; }
-  };
+  void Add(const Record& rec, int64_t offset) {
+    Load();
+    for (auto& idx : indexes_) {
+      if (idx.field >= rec.values.size()) continue;
+      idx.map[NormalizeValue(rec.values[idx.field])] = offset;
+      idx.dirty = true;
+    }
+  }
 
-  for (const auto& cond : conditions) {
-      if (cond.fieldName.empty()) continue;
+  bool Save(std::string& err) {
+    if (!Recheck(err)) return false;
+    for (const auto& idx : indexes_) {
+      if (idx.dirty && !engine_.SaveIndex(idx.path, idx.map, err)) return false;
+    }
+    return true;
+  }
 
-      auto it = std::find_if(schema.fields.begin(), schema.fields.end(), [&](const Field& f) { return Lower(f.name) == Lower(cond.fieldName); });
-      if (it == schema.fields.end()) return false;
-      size_t idx = static_cast<size_t>(std::distance(schema.fields.begin(), it));
-      if (idx >= rec.values.size()) return false;
-      std::string val = NormalizeValue(rec.values[idx]);
-      std::string condVal = NormalizeValue(cond.value);
+ private:
+  struct Index {
+    std::string path;
+    size_t field = 0;
+    bool unique = false;
+    std::map<std::string, int64_t> map;
+    std::set<std::string> recheck;  // keys removed from a non-unique index
+    bool dirty = false;
+  };
 
-      bool match = false;
-      if (cond.op == "IN") {
-          for(const auto& v : cond.values) {
-              std::string nv = NormalizeValue(v);
-              // Try numeric comparison first
-              double valNum = 0, vNum = 0;
-              if (asNumber(val, valNum) && asNumber(nv, vNum)) {
-                  if (std::abs(valNum - vNum) < 1e-9) { match = true; break; }
-              }
-              // Fallback to string comparison
-              if (val == nv) { match = true; break; }
-          }
-      } 
-      else if (cond.op == "=") {
-          double valNum = 0, cNum = 0;
-          if (asNumber(val, valNum) && asNumber(condVal, cNum)) {
-              match = (std::abs(valNum - cNum) < 1e-9);
-          } else {
-              match = (val == condVal);
-          }
-      }
-      else if (cond.op == "!=") {
-          // Inverse of =
-          double valNum = 0, cNum = 0;
-          if (asNumber(val, valNum) && asNumber(condVal, cNum)) {
-              match = (std::abs(valNum - cNum) >= 1e-9);
-          } else {
-              match = (val != condVal);
-          }
-      }
-      else if (cond.op == "CONTAINS") match = (val.find(condVal) != std::string::npos);
-      else if (cond.op == ">" || cond.op == ">=" || cond.op == "<" || cond.op == "<=") {
-        double lv = 0, rv = 0;
-        if (asNumber(val, lv) && asNumber(condVal, rv)) {
-            if (cond.op == ">") match = lv > rv;
-            else if (cond.op == ">=") match = lv >= rv;
-            else if (cond.op == "<") match = lv < rv;
-            else if (cond.op == "<=") match = lv <= rv;
-        } else {
-            // Fallback to string comparison
-            if (cond.op == ">") match = val > condVal;
-            else if (cond.op == ">=") match = val >= condVal;
-            else if (cond.op == "<") match = val < condVal;
-            else if (cond.op == "<=") match = val <= condVal;
-        }
+  // One scan gives each rechecked key the last live row holding it, the row
+  // RebuildIndexes would pick.
+  bool Recheck(std::string& err) {
+    std::vector<bool> columns(schema_.fields.size(), false);
+    bool any = false;
+    for (const auto& idx : indexes_) {
+      if (idx.recheck.empty()) continue;
+      columns[idx.field] = any = true;
+    }
+    if (!any) return true;
+    TableScanCursor cursor;
+    if (!engine_.OpenScan(datPath_, schema_, cursor, err)) return false;
+    cursor.SetColumns(std::move(columns));
+    int64_t offset = 0;
+    RecordView row;
+    while (cursor.Next(offset, row)) {
+      for (auto& idx : indexes_) {
+        if (idx.recheck.empty() || idx.field >= row.values.size()) continue;
+        std::string key = NormalizeValue(std::string(row.values[idx.field]));
+        if (idx.recheck.count(key)) idx.map[std::move(key)] = offset;
       }
+    }
+    for (auto& idx : indexes_) idx.recheck.clear();
+    err = cursor.error();
+    return err.empty();
+  }
 
-      if (!match) return false;
+  void Load() {
+    if (loaded_) return;
+    loaded_ = true;
+    for (const auto& def : schema_.indexes) {
+      Index idx;
+      if (!FindFieldIndex(schema_, def.fieldName, idx.field)) continue;
+      idx.unique = def.isUnique;
+      idx.path = GetIdxPath(datPath_, schema_.tableName, def.name);
+      std::string ignore;
+      engine_.LoadIndex(idx.path, idx.map, ignore);  // missing file = empty index
+      indexes_.push_back(std::move(idx));
+    }
   }
-  return true;
+
+  StorageEngine& engine_;
+  const std::string& datPath_;
+  const TableSchema& schema_;
+  std::vector<Index> indexes_;
+  bool loaded_ = false;
+};
+}
+
+bool DMLService::Match(const TableSchema& schema, const Record& rec, const std::vector<Condition>& conditions) const {
+  return RowFilter(schema, conditions)(rec);
 }
 
 // moved to top of file
@@ -396,6 +539,8 @@ bool DMLService::Match(const TableSchema& schema, const Record& rec, const std::
 bool DMLService::Insert(const std::string& datPath, const std::string& dbfPath, const TableSchema& schema, const std::vector<Record>& records, std::string& err,
                         Txn* txn, LogManager* log, LockManager* lock_manager) {
   if (schema.isView) { err = "Cannot INSERT into a view"; return false; }
+  TableLocks tableLocks(engine_, dbfPath, lock_manager, txn);
+  if (!tableLocks.Lock(schema, err)) return false;
   // Map field names to indices
   std::map<std::string, size_t> fieldMap;
   for(size_t i=0; i<schema.fields.size(); ++i) fieldMap[schema.fields[i].name] = i;
@@ -450,14 +595,15 @@ bool DMLService::Insert(const std::string& datPath, const std::string& dbfPath,
 
   if (txn && log) {
       for (const auto& r : records) {
-          long offset = 0;
-          if (!engine_.ComputeAppendRecordOffset(datPath, schema, offset, err)) return false;
+          std::vector<uint8_t> after;
+          Record stored = r;
+          if (!engine_.SerializeRecord(datPath, schema, stored, after, err)) return false;
+          int64_t offset = 0;
+          if (!engine_.ComputeAppendRecordOffset(datPath, schema, after, offset, err)) return false;
           if (lock_manager) {
               RID rid{schema.tableName, static_cast<uint64_t>(offset)};
               if (!lock_manager->LockExclusive(txn->id, rid, err)) return false;
           }
-          std::vector<uint8_t> after;
-          if (!engine_.SerializeRecord(schema, r, after, err)) return false;
 
           LogRecord rec;
           rec.txn_id = txn->id;
@@ -469,8 +615,8 @@ bool DMLService::Insert(const std::string& datPath, const std::string& dbfPath,
           if (lsn == 0) return false;
           txn->undo_chain.push_back(lsn);
 
-          long realOffset = 0;
-          if (!engine_.AppendRecord(datPath, schema, r, realOffset, err)) return false;
+          int64_t realOffset = 0;
+          if (!engine_.AppendRecord(datPath, schema, stored, realOffset, err)) return false;
           if (realOffset != offset) {
               err = "Append offset mismatch for WAL";
               return false;
@@ -483,9 +629,9 @@ bool DMLService::Insert(const std::string& datPath, const std::string& dbfPath,
   if (!dbms_paths::EnsureIndexDirFromDat(datPath, err)) return false;
 
   // Non-transactional path (legacy behavior)
-  std::map<std::string, std::map<std::string, long>> openIndexes;
+  std::map<std::string, std::map<std::string, int64_t>> openIndexes;
   for (const auto& idxDef : schema.indexes) {
-      std::map<std::string, long> idx;
+      std::map<std::string, int64_t> idx;
       engine_.LoadIndex(GetIdxPath(datPath, schema.tableName, idxDef.name), idx, err);
       openIndexes[idxDef.name] = idx;
   }
@@ -511,7 +657,7 @@ bool DMLService::Insert(const std::string& datPath, const std::string& dbfPath,
   }
 
   for (const auto& r : records) {
-      long offset = 0;
+      int64_t offset = 0;
       if (!engine_.AppendRecord(datPath, schema, r, offset, err)) return false;
       for (auto& pair : openIndexes) {
           std::string idxName = pair.first;
@@ -538,6 +684,8 @@ bool DMLService::Delete(const std::string& datPath, const std::string& dbfPath,
                         const std::vector<Condition>& conditions, ReferentialAction action, bool actionSpecified,
                         std::string& err, Txn* txn, LogManager* log, LockManager* lock_manager) {
   if (schema.isView) { err = "Cannot DELETE from a view"; return false; }
+  TableLocks tableLocks(engine_, dbfPath, lock_manager, txn);
+  if (!tableLocks.Lock(schema, err)) return false;
   std::vector<TableSchema> allSchemas;
   if (!engine_.LoadSchemas(dbfPath, allSchemas, err)) return false;
 
@@ -564,11 +712,11 @@ bool DMLService::Delete(const std::string& datPath, const std::string& dbfPath,
           childIdxs.push_back(idx);
         }
         if (txn && log) {
-          std::vector<std::pair<long, Record>> childRecords;
-          if (!engine_.ReadRecordsWithOffsets(datPath, childSchema, childRecords, err)) return false;
-          for (const auto& p : childRecords) {
-            const Record& r = p.second;
-            if (!r.valid) continue;
+          TableScanCursor cursor;
+          if (!tableLocks.Lock(childSchema, err) || !engine_.OpenScan(datPath, childSchema, cursor, err)) return false;
+          int64_t childOffset = 0;
+          Record r;
+          while (cursor.Next(childOffset, r)) {
             bool match = true;
             for (size_t i = 0; i < childIdxs.size(); ++i) {
               std::string cval = (childIdxs[i] < r.values.size()) ? r.values[childIdxs[i]] : "";
@@ -591,23 +739,25 @@ bool DMLService::Delete(const std::string& datPath, const std::string& dbfPath,
             }
             if (act == ReferentialAction::kCascade) {
               if (!self(childSchema, r, false, overrideAction, self)) return false;
-              if (!ApplyDeleteAt(engine_, datPath, childSchema, p.first, r, txn, log, lock_manager, err)) return false;
+              if (!ApplyDeleteAt(engine_, datPath, childSchema, childOffset, txn, log, lock_manager, err)) return false;
               AddTouchedTable(txn, childSchema.tableName);
             } else if (act == ReferentialAction::kSetNull) {
               Record updated = r;
               for (size_t idx : childIdxs) {
                 if (idx < updated.values.size()) updated.values[idx] = "NULL";
               }
-              if (!ApplyUpdateAt(engine_, datPath, childSchema, p.first, r, updated, txn, log, lock_manager, err)) return false;
+              if (!ApplyUpdateAt(engine_, datPath, childSchema, childOffset, r, updated, txn, log, lock_manager, err)) return false;
               AddTouchedTable(txn, childSchema.tableName);
             }
           }
+          if (!cursor.error().empty()) { err = cursor.error(); return false; }
         } else {
-          std::vector<Record> childRecords;
-          if (!engine_.ReadRecords(datPath, childSchema, childRecords, err)) return false;
-          bool changed = false;
-          for (auto& r : childRecords) {
-            if (!r.valid) continue;
+          TableScanCursor cursor;
+          if (!tableLocks.Lock(childSchema, err) || !engine_.OpenScan(datPath, childSchema, cursor, err)) return false;
+          IndexPatch childIndexes(engine_, datPath, childSchema);
+          int64_t childOffset = 0;
+          Record r;
+          while (cursor.Next(childOffset, r)) {
             bool match = true;
             for (size_t i = 0; i < childIdxs.size(); ++i) {
               std::string cval = (childIdxs[i] < r.values.size()) ? r.values[childIdxs[i]] : "";
@@ -628,21 +778,23 @@ bool DMLService::Delete(const std::string& datPath, const std::string& dbfPath,
               err = "Delete restricted by foreign key";
               return false;
             }
+            int64_t newOffset = childOffset;
             if (act == ReferentialAction::kCascade) {
               if (!self(childSchema, r, false, overrideAction, self)) return false;
-              r.valid = false;
-              changed = true;
+              if (!WriteRowInPlace(engine_, datPath, childSchema, childOffset, r, nullptr, newOffset, err)) return false;
+              childIndexes.Remove(r, childOffset);
             } else if (act == ReferentialAction::kSetNull) {
+              Record updated = r;
               for (size_t idx : childIdxs) {
-                if (idx < r.values.size()) r.values[idx] = "NULL";
+                if (idx < updated.values.size()) updated.values[idx] = "NULL";
               }
-              changed = true;
+              if (!WriteRowInPlace(engine_, datPath, childSchema, childOffset, r, &updated, newOffset, err)) return false;
+              childIndexes.Remove(r, childOffset);
+              childIndexes.Add(updated, newOffset);
             }
           }
-          if (changed) {
-            if (!engine_.SaveRecords(datPath, childSchema, childRecords, err)) return false;
-            if (!RebuildIndexesForTable(engine_, datPath, childSchema, err)) return false;
-          }
+          if (!cursor.error().empty()) { err = cursor.error(); return false; }
+          if (!engine_.FlushTable(datPath, childSchema, err) || !childIndexes.Save(err)) return false;
         }
       }
     }
@@ -650,32 +802,45 @@ bool DMLService::Delete(const std::string& datPath, const std::string& dbfPath,
   };
 
   if (txn && log) {
-    std::vector<std::pair<long, Record>> records;
-    if (!engine_.ReadRecordsWithOffsets(datPath, schema, records, err)) return false;
+    // Rows are pulled one at a time; the cursor's snapshot never returns
+    // records written by this statement.
+    TableScanCursor cursor;
+    if (!engine_.OpenScan(datPath, schema, cursor, err)) return false;
     bool hit = false;
-    for (const auto& p : records) {
-      if (!Match(schema, p.second, conditions)) continue;
+    const RowFilter filter(schema, conditions);
+    int64_t offset = 0;
+    Record rec;
+    while (cursor.Next(offset, rec)) {
+      if (!filter(rec)) continue;
       hit = true;
-      if (!applyConstraints(schema, p.second, actionSpecified, action, applyConstraints)) return false;
-      if (!ApplyDeleteAt(engine_, datPath, schema, p.first, p.second, txn, log, lock_manager, err)) return false;
+      if (!applyConstraints(schema, rec, actionSpecified, action, applyConstraints)) return false;
+      if (!ApplyDeleteAt(engine_, datPath, schema, offset, txn, log, lock_manager, err)) return false;
       AddTouchedTable(txn, schema.tableName);
     }
+    if (!cursor.error().empty()) { err = cursor.error(); return false; }
     if (!hit) { err = "No record matched"; return false; }
     return true;
   }
 
-  std::vector<Record> records;
-  if (!engine_.ReadRecords(datPath, schema, records, err)) return false;
+  // Non-transactional: tombstone matching rows in place and patch only their index entries.
+  TableScanCursor cursor;
+  if (!engine_.OpenScan(datPath, schema, cursor, err)) return false;
+  IndexPatch indexes(engine_, datPath, schema);
   bool hit = false;
-  for (auto& r : records) {
-    if (!Match(schema, r, conditions)) continue;
+  const RowFilter filter(schema, conditions);
+  int64_t offset = 0;
+  Record r;
+  while (cursor.Next(offset, r)) {
+    if (!filter(r)) continue;
     hit = true;
     if (!applyConstraints(schema, r, actionSpecified, action, applyConstraints)) return false;
-    r.valid = false;
+    int64_t unused = 0;
+    if (!WriteRowInPlace(engine_, datPath, schema, offset, r, nullptr, unused, err)) return false;
+    indexes.Remove(r, offset);
   }
+  if (!cursor.error().empty()) { err = cursor.error(); return false; }
+  if (!engine_.FlushTable(datPath, schema, err) || !indexes.Save(err)) return false;
   if (!hit) { err = "No record matched"; return false; }
-  if (!engine_.SaveRecords(datPath, schema, records, err)) return false;
-  if (!RebuildIndexesForTable(engine_, datPath, schema, err)) return false;
   return true;
 }
 
@@ -683,6 +848,8 @@ bool DMLService::Update(const std::string& datPath, const std::string& dbfPath,
                         const std::vector<std::pair<std::string, std::string>>& assignments, std::string& err,
                         Txn* txn, LogManager* log, LockManager* lock_manager) {
   if (schema.isView) { err = "Cannot UPDATE a view"; return false; }
+  TableLocks tableLocks(engine_, dbfPath, lock_manager, txn);
+  if (!tableLocks.Lock(schema, err)) return false;
   std::map<std::string, TableSchema> schemaCache;
   auto applyAssignments = [&](const Record& src) {
     Record updated = src;
@@ -727,11 +894,15 @@ bool DMLService::Update(const std::string& datPath, const std::string& dbfPath,
   };
 
   if (txn && log) {
-      std::vector<std::pair<long, Record>> records;
-      if (!engine_.ReadRecordsWithOffsets(datPath, schema, records, err)) return false;
+      // Changed rows that move are appended past the cursor's snapshot, so
+      // they are not visited again.
+      TableScanCursor cursor;
+      if (!engine_.OpenScan(datPath, schema, cursor, err)) return false;
       bool hit = false;
-      for (auto& p : records) {
-          if (!Match(schema, p.second, conditions)) continue;
+      const RowFilter filter(schema, conditions);
+      std::pair<int64_t, Record> p;
+      while (cursor.Next(p.first, p.second)) {
+          if (!filter(p.second)) continue;
           hit = true;
           if (lock_manager) {
               RID rid{schema.tableName, static_cast<uint64_t>(p.first)};
@@ -742,9 +913,9 @@ bool DMLService::Update(const std::string& datPath, const std::string& dbfPath,
 
           std::vector<uint8_t> before;
           std::vector<uint8_t> after;
-          if (!engine_.SerializeRecord(schema, p.second, before, err)) return false;
-          if (!engine_.SerializeRecord(schema, updated, after, err)) return false;
-            if (before.size() != after.size()) {
+          Record stored = updated;
+          if (!RowImages(engine_, datPath, schema, p.first, p.second, stored, before, after, err)) return false;
+            if (!engine_.CanOverwrite(datPath, schema, p.first, before, after)) {
                 // Fallback: treat as DELETE + INSERT (stable offsets for old record, new record appended)
                 LogRecord del;
                 del.txn_id = txn->id;
@@ -756,8 +927,8 @@ bool DMLService::Update(const std::string& datPath, const std::string& dbfPath,
                 if (delLsn == 0) return false;
                 txn->undo_chain.push_back(delLsn);
 
-                long newOffset = 0;
-                if (!engine_.ComputeAppendRecordOffset(datPath, schema, newOffset, err)) return false;
+                int64_t newOffset = 0;
+                if (!engine_.ComputeAppendRecordOffset(datPath, schema, after, newOffset, err)) return false;
                 if (lock_manager) {
                     RID newRid{schema.tableName, static_cast<uint64_t>(newOffset)};
                     if (!lock_manager->LockExclusive(txn->id, newRid, err)) return false;
@@ -775,10 +946,10 @@ bool DMLService::Update(const std::string& datPath, const std::string& dbfPath,
 
                 std::vector<uint8_t> tomb = before;
                 if (!tomb.empty()) tomb[0] = 0;
-                if (!engine_.WriteRecordBytesAt(datPath, p.first, tomb, err)) return false;
+                if (!engine_.WriteRecordBytesAt(datPath, schema, p.first, tomb, err, delLsn)) return false;
 
-                long realOffset = 0;
-                if (!engine_.AppendRecord(datPath, schema, updated, realOffset, err)) return false;
+                int64_t realOffset = 0;
+                if (!engine_.AppendRecord(datPath, schema, stored, realOffset, err)) return false;
                 if (realOffset != newOffset) {
                     err = "Append offset mismatch for WAL";
                     return false;
@@ -796,48 +967,36 @@ bool DMLService::Update(const std::string& datPath, const std::string& dbfPath,
                 if (lsn == 0) return false;
                 txn->undo_chain.push_back(lsn);
 
-                if (!engine_.WriteRecordBytesAt(datPath, p.first, after, err)) return false;
+                if (!engine_.WriteRecordBytesAt(datPath, schema, p.first, after, err, lsn)) return false;
                 AddTouchedTable(txn, schema.tableName);
             }
       }
+      if (!cursor.error().empty()) { err = cursor.error(); return false; }
       if (!hit) err = "No record matched";
       return true;
   }
 
-  std::vector<Record> records;
-  if (!engine_.ReadRecords(datPath, schema, records, err)) return false;
+  // Non-transactional: rewrite only the matching rows; moved rows are appended
+  // past the cursor's snapshot and their index entries follow them.
+  TableScanCursor cursor;
+  if (!engine_.OpenScan(datPath, schema, cursor, err)) return false;
+  IndexPatch indexes(engine_, datPath, schema);
   bool hit = false;
-  for (auto& r : records) {
-    if (!Match(schema, r, conditions)) continue;
+  const RowFilter filter(schema, conditions);
+  int64_t offset = 0;
+  Record r;
+  while (cursor.Next(offset, r)) {
+    if (!filter(r)) continue;
     hit = true;
     Record updated = applyAssignments(r);
     if (!checkForeignKeys(updated)) return false;
-    r = updated;
+    int64_t newOffset = offset;
+    if (!WriteRowInPlace(engine_, datPath, schema, offset, r, &updated, newOffset, err)) return false;
+    indexes.Remove(r, offset);
+    indexes.Add(updated, newOffset);
   }
+  if (!cursor.error().empty()) { err = cursor.error(); return false; }
+  if (!engine_.FlushTable(datPath, schema, err) || !indexes.Save(err)) return false;
   if (!hit) err = "No record matched";
-  if (!engine_.SaveRecords(datPath, schema, records, err)) return false;
-
-  if (!schema.indexes.empty()) {
-      std::vector<std::pair<long, Record>> newRecords;
-      if (!engine_.ReadRecordsWithOffsets(datPath, schema, newRecords, err)) return false;
-
-      if (!dbms_paths::EnsureIndexDirFromDat(datPath, err)) return false;
-      for (const auto& idxDef : schema.indexes) {
-           std::map<std::string, long> idxMap;
-           size_t fIdx = -1;
-           for (size_t i = 0; i < schema.fields.size(); ++i) {
-               if (schema.fields[i].name == idxDef.fieldName) { fIdx = i; break; }
-           }
-           if (fIdx == static_cast<size_t>(-1)) continue;
-
-           for (const auto& p : newRecords) {
-               if (fIdx < p.second.values.size()) {
-                   std::string val = NormalizeValue(p.second.values[fIdx]);
-                   idxMap[val] = p.first;
-               }
-           }
-           engine_.SaveIndex(GetIdxPath(datPath, schema.tableName, idxDef.name), idxMap, err);
-      }
-  }
   return true;
 }
@@ -12,6 +12,7 @@
 #include "query.h"
 #include "storage_engine.h"
 #include "path_utils.h"
+#include "vacuum.h"
 
 #include "txn/log_manager.h"
 #include "txn/txn_manager.h"
@@ -70,11 +71,19 @@ static std::string DbNameFromDbfPath(const fs::path& p) {
 
 int main() {
     StorageEngine engine;
-    DDLService ddl(engine);
+    // Dirty pages may only reach the data files after their WAL records.
+    engine.SetWalFlusher([](const std::string& db, uint64_t lsn, std::string& walErr) {
+        LogManager wal(db);
+        return wal.Flush(lsn, walErr);
+    });
+    const std::string default_db = "MyDB";
+    // Shared by every request and VACUUM; its LSNs resume after recovery.
+    LogManager log(default_db);
+    LockManager lock_manager;
+    DDLService ddl(engine, log, lock_manager);
     DMLService dml(engine);
     QueryService query(engine);
 
-    const std::string default_db = "MyDB";
     std::string err;
     dbms_paths::EnsureDbDir(default_db, err);
 
@@ -100,16 +109,27 @@ int main() {
             std::cerr << "[Recovery] data dir not found: " << data_dir << "\n";
         }
 
+        // Collect first: migration below creates directories under data_dir.
+        std::vector<std::string> dbNames;
         for (const auto& entry : fs::recursive_directory_iterator(data_dir)) {
             if (!entry.is_regular_file()) continue;
 
             const fs::path p = entry.path();
             if (p.extension() != ".dbf") continue;
 
-            const std::string dbName = DbNameFromDbfPath(p); // "xxx"
+            dbNames.push_back(DbNameFromDbfPath(p)); // "xxx"
+        }
+
+        for (const auto& dbName : dbNames) {
             std::string recErr;
             LSN dbMaxLsn = 0;
 
+            // A table rewrite cut short goes in whole before its WAL is replayed.
+            if (!engine.FinishInstalls(dbName, recErr)) {
+                std::cerr << "[Recovery] db=" << dbName << " install failed: " << recErr << "\n";
+                recErr.clear();
+            }
+
             TxnId t = Recovery::Run(engine, dbName, recErr, &dbMaxLsn);
 
             if (!recErr.empty()) {
@@ -118,20 +138,43 @@ int main() {
 
             if (t > maxTxn) maxTxn = t;
             if (dbMaxLsn > maxLsn) maxLsn = dbMaxLsn;
+
+            // Legacy shared .dat -> per-table segments. WAL offsets point into the
+            // old file, so it is retired (recovery has already been applied).
+            if (engine.NeedsSegmentMigration(dbName)) {
+                std::string migErr;
+                LogManager wal(dbName);
+                if (!wal.TruncateWithBackup(migErr) || !engine.MigrateToSegments(dbName, migErr)) {
+                    std::cerr << "[Migrate] db=" << dbName << " failed: " << migErr << "\n";
+                    continue;
+                }
+                const std::string mdbf = dbms_paths::DbfPath(dbName);
+                const std::string mdat = dbms_paths::DatPath(dbName);
+                std::vector<TableSchema> tables;
+                engine.LoadSchemas(mdbf, tables, migErr);
+                for (const auto& t : tables) {
+                    if (t.isView || t.indexes.empty()) continue;
+                    if (!ddl.RebuildIndexes(mdbf, mdat, t.tableName, migErr)) {
+                        std::cerr << "[Migrate] db=" << dbName << " index rebuild failed: " << migErr << "\n";
+                    }
+                }
+                std::cerr << "[Migrate] db=" << dbName << " moved to per-table segments\n";
+            }
         }
     } catch (const std::exception& e) {
         std::cerr << "[Recovery] scan failed: " << e.what() << "\n";
         // 扫描失败不一定要退出，取决于你想要的策略；这里选择继续启动
     }
 
-    LogManager log(default_db);
     TxnManager txn_manager(engine, log);
-    LockManager lock_manager;
 
     txn_manager.SetNextTxnId(maxTxn + 1);
     log.SetNextLsn(maxLsn + 1);
 
-    ApiServer server(engine, ddl, dml, query, log, txn_manager, lock_manager, dbf, dat);
+    VacuumService vacuum(engine, lock_manager, log);
+    vacuum.Start();
+
+    ApiServer server(engine, ddl, dml, query, log, txn_manager, lock_manager, vacuum, dbf, dat);
     server.Run(8080);
 
     return 0;
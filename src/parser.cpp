@@ -668,6 +668,92 @@ ParsedCommand Parser::Parse(const std::string& rawSql, std::string& err) {
       return cmd;
   }
 
+  // VACUUM [table]
+  if (upper == "VACUUM" || upper.find("VACUUM ") == 0) {
+      cmd.type = CommandType::kVacuum;
+      cmd.tableName = StripIdentQuotes(Trim(sql.substr(strlen("VACUUM"))));
+      return cmd;
+  }
+
+  // ANALYZE [table]
+  if (upper == "ANALYZE" || upper.find("ANALYZE ") == 0) {
+      cmd.type = CommandType::kAnalyze;
+      cmd.tableName = StripIdentQuotes(Trim(sql.substr(strlen("ANALYZE"))));
+      return cmd;
+  }
+
+  // CHECK TABLE name
+  if (upper.find("CHECK TABLE ") == 0) {
+      cmd.type = CommandType::kCheckTable;
+      cmd.tableName = StripIdentQuotes(Trim(sql.substr(strlen("CHECK TABLE"))));
+      if (cmd.tableName.empty()) err = "Table name required";
+      return cmd;
+  }
+
+  // COPY table FROM 'file' [WITH] [(] [HEADER] [DELIMITER 'c'] [)]
+  if (upper.find("COPY ") == 0) {
+      cmd.type = CommandType::kCopy;
+      std::string rest = Trim(sql.substr(strlen("COPY")));
+      auto fromPos = ToUpper(rest).find(" FROM ");
+      if (fromPos == std::string::npos) {
+          err = "Syntax error: expected FROM";
+          return cmd;
+      }
+      cmd.tableName = StripIdentQuotes(Trim(rest.substr(0, fromPos)));
+      rest = Trim(rest.substr(fromPos + strlen(" FROM ")));
+      if (rest.empty() || (rest[0] != '\'' && rest[0] != '"')) {
+          err = "Syntax error: file path must be quoted";
+          return cmd;
+      }
+      auto close = rest.find(rest[0], 1);
+      if (close == std::string::npos) {
+          err = "Syntax error: unterminated file path";
+          return cmd;
+      }
+      cmd.copyPath = rest.substr(1, close - 1);
+
+      // Options: words and quoted values, separated by spaces, commas or parens
+      std::vector<std::string> opts;
+      for (size_t i = close + 1; i < rest.size();) {
+          char c = rest[i];
+          if (isspace(static_cast<unsigned char>(c)) || c == ',' || c == '(' || c == ')') { ++i; continue; }
+          size_t end = i + 1;
+          if (c == '\'' || c == '"') {
+              end = rest.find(c, i + 1);
+              if (end == std::string::npos) { err = "Syntax error: unterminated option value"; return cmd; }
+              opts.push_back(rest.substr(i, end + 1 - i));
+              i = end + 1;
+              continue;
+          }
+          while (end < rest.size() && !isspace(static_cast<unsigned char>(rest[end])) && rest[end] != ',' && rest[end] != '(' && rest[end] != ')') ++end;
+          opts.push_back(ToUpper(rest.substr(i, end - i)));
+          i = end;
+      }
+      for (size_t i = 0; i < opts.size(); ++i) {
+          if (opts[i] == "WITH") continue;
+          if (opts[i] == "FORMAT") {
+              if (i + 1 >= opts.size() || opts[++i] != "CSV") { err = "Only FORMAT CSV is supported"; return cmd; }
+              continue;
+          }
+          if (opts[i] == "HEADER") {
+              cmd.copyHeader = true;
+              if (i + 1 < opts.size() && (opts[i + 1] == "TRUE" || opts[i + 1] == "FALSE")) cmd.copyHeader = opts[++i] == "TRUE";
+              continue;
+          }
+          if (opts[i] == "DELIMITER" && i + 1 < opts.size()) {
+              std::string d = TrimQuotes(opts[++i]);
+              if (d == "\\t") d = "\t";
+              if (d.size() != 1 || d[0] == '"' || d[0] == '\n' || d[0] == '\r') { err = "DELIMITER must be a single character"; return cmd; }
+              cmd.copyDelimiter = d[0];
+              continue;
+          }
+          err = "Unknown COPY option: " + opts[i];
+          return cmd;
+      }
+      if (cmd.tableName.empty() || cmd.copyPath.empty()) err = "Table name and file path required";
+      return cmd;
+  }
+
   // DCL: CREATE USER
   if (upper.find("CREATE USER") == 0) {
       cmd.type = CommandType::kCreateUser;
@@ -867,6 +953,8 @@ ParsedCommand Parser::Parse(const std::string& rawSql, std::string& err) {
                       cmd.columnDef.isKey = true; cmd.columnDef.nullable = false; ++i;
                   } else if (p == "NOT" && i+1 < parts.size() && ToUpper(parts[i+1])=="NULL") {
                       cmd.columnDef.nullable = false; ++i;
+                  } else if (p == "BLOOM") {
+                      cmd.columnDef.bloom = true;
                   }
            }
            return cmd;
@@ -918,6 +1006,8 @@ ParsedCommand Parser::Parse(const std::string& rawSql, std::string& err) {
                       cmd.columnDef.isKey = true; cmd.columnDef.nullable = false; ++i;
                   } else if (p == "NOT" && i+1 < parts.size() && ToUpper(parts[i+1])=="NULL") {
                       cmd.columnDef.nullable = false; ++i;
+                  } else if (p == "BLOOM") {
+                      cmd.columnDef.bloom = true;
                   }
            }
            return cmd;
@@ -1053,6 +1143,30 @@ ParsedCommand Parser::Parse(const std::string& rawSql, std::string& err) {
       cmd.tableName = Trim(createBody.substr(0, parenL));
       std::string fieldList = createBody.substr(parenL + 1, parenR - parenL - 1);
 
+      // Table options after the field list: STORAGE=ROW|PAGED|COLUMNAR ENCODING=TYPED|TEXT.
+      // New tables use the typed record encoding unless asked otherwise.
+      cmd.schema.encoding = RecordEncoding::kTyped;
+      std::string options = ToUpper(Trim(createBody.substr(parenR + 1)));
+      std::string normalized;
+      for (char c : options) {
+          if (c == '=') while (!normalized.empty() && normalized.back() == ' ') normalized.pop_back();
+          if (c == ' ' && !normalized.empty() && normalized.back() == '=') continue;
+          normalized.push_back(c);
+      }
+      std::istringstream optStream(normalized);
+      std::string option;
+      while (optStream >> option) {
+          if (option == "STORAGE=PAGED") cmd.schema.storage = StorageFormat::kPaged;
+          else if (option == "STORAGE=COLUMNAR") cmd.schema.storage = StorageFormat::kColumnar;
+          else if (option == "STORAGE=ROW") cmd.schema.storage = StorageFormat::kRow;
+          else if (option == "ENCODING=TYPED") cmd.schema.encoding = RecordEncoding::kTyped;
+          else if (option == "ENCODING=TEXT") cmd.schema.encoding = RecordEncoding::kText;
+          else {
+              err = "Unknown table option: " + Trim(createBody.substr(parenR + 1));
+              return cmd;
+          }
+      }
+
       auto fields = SplitTopLevel(fieldList, ',');
       for (auto& raw : fields) {
           std::string fstr = Trim(raw);
@@ -1077,7 +1191,7 @@ ParsedCommand Parser::Parse(const std::string& rawSql, std::string& err) {
           field.valid = true;
 
           // Parse constraints (very simple)
-          // supports: PRIMARY KEY, NOT NULL
+          // supports: PRIMARY KEY, NOT NULL, BLOOM
           for (size_t i = 2; i < parts.size(); ++i) {
               std::string p = ToUpper(parts[i]);
               if (p == "PRIMARY") {
@@ -1093,6 +1207,9 @@ ParsedCommand Parser::Parse(const std::string& rawSql, std::string& err) {
                       ++i;
                   }
               }
+              else if (p == "BLOOM") {
+                  field.bloom = true;
+              }
           }
 
           cmd.schema.fields.push_back(field);
@@ -33,7 +33,11 @@ enum class CommandType {
   kGrant,
   kRevoke,
   kCheckpoint,
-  kBackup
+  kBackup,
+  kVacuum,
+  kCheckTable,
+  kCopy,
+  kAnalyze
 };
 
 enum class AlterOperation {
@@ -60,6 +64,9 @@ struct ParsedCommand {
   std::vector<std::pair<std::string, std::string>> assignments;  // UPDATE set list
   std::string newName;                // for RENAME
   std::string backupPath;             // for BACKUP
+  std::string copyPath;               // for COPY
+  bool copyHeader = false;
+  char copyDelimiter = ',';
   
   std::string username;
   std::string password;
@@ -66,6 +66,22 @@ bool EnsureIndexDirFromDat(const std::string& dat_path, std::string& err) {
   }
 }
 
+bool EnsureSegmentDirFromDat(const std::string& dat_path, std::string& err) {
+  try {
+    auto dir = SegmentDirFromDat(dat_path);
+    if (!std::filesystem::exists(dir)) {
+      if (!std::filesystem::create_directories(dir)) {
+        err = "Failed to create segment directory: " + dir.string();
+        return false;
+      }
+    }
+    return true;
+  } catch (const std::filesystem::filesystem_error& e) {
+    err = std::string("Filesystem error: ") + e.what();
+    return false;
+  }
+}
+
 std::filesystem::path DbDirPath(const std::string& db_name) {
   return DataDirPath() / db_name;
 }
@@ -97,4 +113,17 @@ std::string IndexPathFromDat(const std::string& dat_path, const std::string& tab
   return (dir / file).string();
 }
 
+std::string DbNameFromDat(const std::string& dat_path) {
+  return std::filesystem::path(dat_path).stem().string();
+}
+
+std::filesystem::path SegmentDirFromDat(const std::string& dat_path) {
+  std::filesystem::path dat = dat_path;
+  return dat.parent_path() / "segments";
+}
+
+std::string SegmentPathFromDat(const std::string& dat_path, const std::string& table_name) {
+  return (SegmentDirFromDat(dat_path) / (table_name + ".dat")).string();
+}
+
 }  // namespace dbms_paths
@@ -15,6 +15,10 @@ std::filesystem::path IndexDirFromDat(const std::string& dat_path);
 std::string DbfPath(const std::string& db_name);
 std::string DatPath(const std::string& db_name);
 std::string WalPath(const std::string& db_name);
+std::string DbNameFromDat(const std::string& dat_path);
 std::string IndexPathFromDat(const std::string& dat_path, const std::string& table_name, const std::string& index_name);
+bool EnsureSegmentDirFromDat(const std::string& dat_path, std::string& err);
+std::filesystem::path SegmentDirFromDat(const std::string& dat_path);
+std::string SegmentPathFromDat(const std::string& dat_path, const std::string& table_name);
 
 }  // namespace dbms_paths
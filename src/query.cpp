@@ -1,10 +1,10 @@
 #include "query.h"
 #include <algorithm>
 #include <cctype>
-#include <cmath>
 #include <string>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <functional>
 #include "parser.h"
 #include "txn/lock_manager.h"
@@ -25,53 +25,63 @@ std::string NormalizeValue(std::string s) {
   }
   return s;
 }
-}
 
-// Helper to get value dynamically, supporting "Table.Column" or just "Column"
-static bool GetFieldValue(const TableSchema& schema, const Record& rec, const std::string& fieldName, std::string& outVal) {
-    if (fieldName.empty()) return false;
-    std::string lowName = Lower(fieldName);
-    
-    // Strict match first?
-    for (size_t i = 0; i < schema.fields.size(); ++i) {
-        if (Lower(schema.fields[i].name) == lowName) {
-            if(i < rec.values.size()) { outVal = rec.values[i]; return true; }
-            return false;
-        }
-    }
-    
-    // If fieldName has no '.', try to match suffix? e.g. "id" matches "T1.id"
-    if (fieldName.find('.') == std::string::npos) {
-         for (size_t i = 0; i < schema.fields.size(); ++i) {
-             std::string fName = Lower(schema.fields[i].name);
-             size_t dot = fName.find('.');
-             if (dot != std::string::npos) {
-                 if (fName.substr(dot + 1) == lowName) {
-                    if(i < rec.values.size()) { outVal = rec.values[i]; return true; }
-                    return false;
-                 }
-             }
-         }
+std::string_view NormalizeView(std::string_view s) {
+  if (s.size() >= 2) {
+    if ((s.front() == '\'' && s.back() == '\'') || (s.front() == '"' && s.back() == '"')) {
+      return s.substr(1, s.size() - 2);
     }
-    return false;
+  }
+  return s;
+}
+
+bool EqualsNoCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) return false;
+  }
+  return true;
+}
 }
 
-static bool FieldExists(const TableSchema& schema, const std::string& fieldName) {
-    if (fieldName.empty()) return false;
-    std::string lowName = Lower(fieldName);
-    for (const auto& f : schema.fields) {
-        if (Lower(f.name) == lowName) return true;
+// Resolve "Table.Column" or just "Column" ("id" matches "T1.id"); -1 if absent.
+static int FieldIndex(const TableSchema& schema, const std::string& fieldName) {
+    if (fieldName.empty()) return -1;
+    for (size_t i = 0; i < schema.fields.size(); ++i) {
+        if (EqualsNoCase(schema.fields[i].name, fieldName)) return static_cast<int>(i);
     }
     if (fieldName.find('.') == std::string::npos) {
-        for (const auto& f : schema.fields) {
-            std::string fName = Lower(f.name);
+        for (size_t i = 0; i < schema.fields.size(); ++i) {
+            std::string_view fName = schema.fields[i].name;
             size_t dot = fName.find('.');
-            if (dot != std::string::npos && fName.substr(dot + 1) == lowName) return true;
+            if (dot != std::string_view::npos && EqualsNoCase(fName.substr(dot + 1), fieldName)) return static_cast<int>(i);
         }
     }
-    return false;
+    return -1;
+}
+
+// Helper to get value dynamically, supporting "Table.Column" or just "Column"
+static bool GetFieldValue(const TableSchema& schema, const Record& rec, const std::string& fieldName, std::string& outVal) {
+    int i = FieldIndex(schema, fieldName);
+    if (i < 0 || static_cast<size_t>(i) >= rec.values.size()) return false;
+    outVal = rec.values[i];
+    return true;
 }
 
+static bool GetFieldView(const TableSchema& schema, const RecordView& rec, const std::string& fieldName, std::string_view& outVal) {
+    int i = FieldIndex(schema, fieldName);
+    if (i < 0 || static_cast<size_t>(i) >= rec.values.size()) return false;
+    outVal = rec.values[i];
+    return true;
+}
+
+// The number a typed scan decoded for field i (see RecordView::numbers).
+static const StoredNumber* StoredAt(const Record&, size_t) { return nullptr; }
+static const StoredNumber* StoredAt(const RecordView& rec, size_t i) { return i < rec.numbers.size() ? &rec.numbers[i] : nullptr; }
+
+static Record ToRecord(const Record& rec) { return rec; }
+static Record ToRecord(const RecordView& rec) { return rec.Materialize(); }
+
 // Helper to infer schema from a subquery result for outer query usage
 static TableSchema InferSchemaFromPlan(const TableSchema& srcSchema, const QueryPlan& plan) {
     TableSchema out;
@@ -173,20 +183,48 @@ bool QueryService::EvaluateView(const std::string& datPath, const std::string& d
     return Select(datPath, dbfPath, baseSchema, cmd.query, out, err, txn, lock_manager);
 }
 
-static bool GetFieldValueForOrder(const TableSchema& schema, const Record& rec, const std::string& fieldName,
-                                  const std::map<std::string, std::string>& aliasMap, std::string& outVal) {
-    std::string name = fieldName;
-    auto it = aliasMap.find(Lower(fieldName));
-    if (it != aliasMap.end()) name = it->second;
-    return GetFieldValue(schema, rec, name, outVal);
+std::vector<QueryService::BoundCondition> QueryService::Bind(const TableSchema& schema, const std::vector<Condition>& conds) const {
+  std::vector<BoundCondition> bound;
+  bound.reserve(conds.size());
+  for (const auto& c : conds) {
+    BoundCondition b;
+    b.cond = &c;
+    b.field = FieldIndex(schema, c.fieldName);
+    if (b.field >= 0) {
+      uint32_t width = 0;
+      b.kind = ColumnKindOf(schema.fields[b.field], width);
+    }
+    b.hasOp = ParseCompareOp(c.op, b.op);
+    b.operand = Value::Untyped(NormalizeView(c.value));
+    for (const auto& v : c.values) b.list.push_back(Value::Untyped(NormalizeView(v)));
+    bound.push_back(std::move(b));
+  }
+  return bound;
 }
 
-bool QueryService::MatchConditions(const TableSchema& schema, const Record& rec, const std::vector<Condition>& conds, const std::string& datPath, const std::string& dbfPath) {
-  return MatchConditions(schema, rec, conds, datPath, dbfPath, nullptr, nullptr);
+namespace {
+bool MatchLike(std::string_view val, std::string_view pattern) {
+  // %: matches any sequence of characters (including empty)
+  if (pattern.empty()) return val.empty();
+  if (pattern.size() >= 2 && pattern.front() == '%' && pattern.back() == '%') {
+    return val.find(pattern.substr(1, pattern.size() - 2)) != std::string_view::npos;
+  }
+  if (pattern.front() == '%') {
+    std::string_view suffix = pattern.substr(1);
+    return val.size() >= suffix.size() && val.substr(val.size() - suffix.size()) == suffix;
+  }
+  if (pattern.back() == '%') {
+    std::string_view prefix = pattern.substr(0, pattern.size() - 1);
+    return val.size() >= prefix.size() && val.substr(0, prefix.size()) == prefix;
+  }
+  return val == pattern;
 }
+}  // namespace
 
-bool QueryService::MatchConditions(const TableSchema& schema, const Record& rec, const std::vector<Condition>& conds, const std::string& datPath, const std::string& dbfPath, const Record* outerRec, const TableSchema* outerSchema) {
-  auto matchSingle = [&](const Condition& cond) {
+template <typename Row>
+bool QueryService::MatchBound(const Row& rec, const std::vector<BoundCondition>& conds, const std::string& datPath, const std::string& dbfPath, const Record* outerRec, const TableSchema* outerSchema) {
+  auto matchSingle = [&](const BoundCondition& b) {
+    const Condition& cond = *b.cond;
     // Handle EXISTS/NOT EXISTS
     if (cond.op == "EXISTS" || cond.op == "NOT EXISTS") {
         if (cond.isSubQuery && cond.subQueryPlan) {
@@ -198,162 +236,55 @@ bool QueryService::MatchConditions(const TableSchema& schema, const Record& rec,
         }
         return false;
     }
-    
+
     if (cond.fieldName.empty()) return true;
-    std::string val;
-    if (!GetFieldValue(schema, rec, cond.fieldName, val)) return false;
-    val = NormalizeValue(val);
-    
-    std::string condVal;
-    
+    if (b.field < 0 || static_cast<size_t>(b.field) >= rec.values.size()) return false;
+    const std::string_view text = NormalizeView(std::string_view(rec.values[b.field]));
+    const Value val = Value::Of(text, b.kind, StoredAt(rec, b.field));
+
+    Value operand = b.operand;
+    std::string subVal;
     if (cond.isSubQuery && cond.subQueryPlan) {
         std::vector<Record> subRows;
         std::string subErr;
         if (!ExecuteSubQuery(datPath, dbfPath, *cond.subQueryPlan, subRows, subErr, outerRec, outerSchema)) return false;
-        
+
         if (cond.op == "IN") {
-            for(const auto& r : subRows) {
-                if(!r.values.empty() && r.values[0] == val) return true;
-                try {
-                     double v1 = std::stod(val);
-                     double v2 = std::stod(r.values[0]);
-                     if (std::abs(v1-v2)<1e-9) return true;
-                } catch(...) {}
+            for (const auto& r : subRows) {
+                if (r.values.empty()) continue;
+                if (r.values[0] == text || Satisfies(val, CompareOp::kEq, Value::Untyped(r.values[0]))) return true;
             }
             return false;
         }
-        
+
         if (subRows.empty() || subRows[0].values.empty()) return false;
-        condVal = subRows[0].values[0];
-    } else {
-        condVal = NormalizeValue(cond.value);
+        subVal = std::move(subRows[0].values[0]);
+        operand = Value::Untyped(subVal);
     }
 
-    auto asNumber = [](const std::string& s, double& out) {
-      try { size_t i=0; out = std::stod(s, &i); return i == s.size(); } catch (...) { return false; }
-    };
-
     if (cond.op == "BETWEEN") {
-        if (cond.values.size() != 2) return false;
-        std::string minVal = NormalizeValue(cond.values[0]);
-        std::string maxVal = NormalizeValue(cond.values[1]);
-        
-        double valNum = 0, minNum = 0, maxNum = 0;
-        if (asNumber(val, valNum) && asNumber(minVal, minNum) && asNumber(maxVal, maxNum)) {
-            return valNum >= minNum && valNum <= maxNum;
+        if (b.list.size() != 2) return false;
+        const Value& lo = b.list[0];
+        const Value& hi = b.list[1];
+        if (val.numeric() && lo.numeric() && hi.numeric()) {
+            return Satisfies(val, CompareOp::kGe, lo) && Satisfies(val, CompareOp::kLe, hi);
         }
         // String comparison as fallback
-        return val >= minVal && val <= maxVal;
-    }
-
-    if (cond.op == "LIKE") {
-        std::string pattern = NormalizeValue(cond.value);
-        
-        // Convert SQL LIKE pattern to simple matching
-        // %: matches any sequence of characters (including empty)
-        // Note: SQL also supports _ for single character, but implementing % first
-        
-        if (pattern.empty()) return val.empty();
-        
-        // Case 1: %text% - contains
-        if (pattern.size() >= 2 && pattern.front() == '%' && pattern.back() == '%') {
-            std::string searchStr = pattern.substr(1, pattern.size() - 2);
-            return val.find(searchStr) != std::string::npos;
-        }
-        
-        // Case 2: %text - ends with
-        if (pattern.size() >= 1 && pattern.front() == '%') {
-            std::string suffix = pattern.substr(1);
-            if (val.size() >= suffix.size()) {
-                return val.substr(val.size() - suffix.size()) == suffix;
-            }
-            return false;
-        }
-        
-        // Case 3: text% - starts with
-        if (pattern.size() >= 1 && pattern.back() == '%') {
-            std::string prefix = pattern.substr(0, pattern.size() - 1);
-            if (val.size() >= prefix.size()) {
-                return val.substr(0, prefix.size()) == prefix;
-            }
-            return false;
-        }
-        
-        // Case 4: exact match (no wildcards)
-        return val == pattern;
+        return text >= lo.text && text <= hi.text;
     }
 
-    if (cond.op == "NOT LIKE") {
-        std::string pattern = NormalizeValue(cond.value);
-        
-        // Use the same LIKE matching logic but negate the result
-        if (pattern.empty()) return !val.empty();
-        
-        // Case 1: %text% - does not contain
-        if (pattern.size() >= 2 && pattern.front() == '%' && pattern.back() == '%') {
-            std::string searchStr = pattern.substr(1, pattern.size() - 2);
-            return val.find(searchStr) == std::string::npos;
-        }
-        
-        // Case 2: %text - does not end with
-        if (pattern.size() >= 1 && pattern.front() == '%') {
-            std::string suffix = pattern.substr(1);
-            if (val.size() >= suffix.size()) {
-                return val.substr(val.size() - suffix.size()) != suffix;
-            }
-            return true;
-        }
-        
-        // Case 3: text% - does not start with
-        if (pattern.size() >= 1 && pattern.back() == '%') {
-            std::string prefix = pattern.substr(0, pattern.size() - 1);
-            if (val.size() >= prefix.size()) {
-                return val.substr(0, prefix.size()) != prefix;
-            }
-            return true;
-        }
-        
-        // Case 4: not exact match (no wildcards)
-        return val != pattern;
-    }
+    if (cond.op == "LIKE") return MatchLike(text, b.operand.text);
+    if (cond.op == "NOT LIKE") return !MatchLike(text, b.operand.text);
 
     if (cond.op == "IN" && !cond.isSubQuery) {
-        for (const auto& v : cond.values) {
-           std::string nv = NormalizeValue(v);
-           double valNum = 0, vNum = 0;
-           if (asNumber(val, valNum) && asNumber(nv, vNum)) {
-               if (std::abs(valNum - vNum) < 1e-9) return true;
-           }
-           if (val == nv) return true;
+        for (const auto& v : b.list) {
+            if (Satisfies(val, CompareOp::kEq, v) || text == v.text) return true;
         }
         return false;
     }
 
-    if (cond.op == "=") {
-         double k1=0, k2=0;
-         if (asNumber(val, k1) && asNumber(condVal, k2)) return std::abs(k1-k2)<1e-9;
-         return val == condVal;
-    }
-    if (cond.op == "!=") {
-         double k1=0, k2=0;
-         if (asNumber(val, k1) && asNumber(condVal, k2)) return std::abs(k1-k2)>=1e-9;
-         return val != condVal;
-    }
-    if (cond.op == "CONTAINS") return val.find(condVal) != std::string::npos;
-    if (cond.op == ">" || cond.op == ">=" || cond.op == "<" || cond.op == "<=") {
-      double lv = 0, rv = 0;
-      if (asNumber(val, lv) && asNumber(condVal, rv)) {
-        if (cond.op == ">") return lv > rv;
-        if (cond.op == ">=") return lv >= rv;
-        if (cond.op == "<") return lv < rv;
-        if (cond.op == "<=") return lv <= rv;
-      }
-      if (cond.op == ">") return val > condVal;
-      if (cond.op == ">=") return val >= condVal;
-      if (cond.op == "<") return val < condVal;
-      if (cond.op == "<=") return val <= condVal;
-    }
-    return false;
+    if (cond.op == "CONTAINS") return text.find(operand.text) != std::string_view::npos;
+    return b.hasOp && Satisfies(val, b.op, operand);
   };
 
   for (const auto& c : conds) {
@@ -362,6 +293,139 @@ bool QueryService::MatchConditions(const TableSchema& schema, const Record& rec,
   return true;
 }
 
+namespace {
+// Whether some value in [lo, hi] can satisfy `op operand` under Satisfies.
+bool RangeMay(const Value& lo, const Value& hi, bool hiOpen, CompareOp op, const Value& operand) {
+  const bool loLe = Satisfies(lo, CompareOp::kLe, operand) || Satisfies(lo, CompareOp::kEq, operand);
+  const bool hiGe = hiOpen || Satisfies(hi, CompareOp::kGe, operand) || Satisfies(hi, CompareOp::kEq, operand);
+  switch (op) {
+    case CompareOp::kEq: return loLe && hiGe;
+    case CompareOp::kLt: return Satisfies(lo, CompareOp::kLt, operand);
+    case CompareOp::kLe: return loLe;
+    case CompareOp::kGt: return hiOpen || Satisfies(hi, CompareOp::kGt, operand);
+    case CompareOp::kGe: return hiGe;
+    case CompareOp::kNe: return true;
+  }
+  return true;
+}
+
+// Zone bounds as Values. Numbers go through double so the checks hold for
+// ints and doubles mixed in one column; text bounds compare as text.
+Value ZoneNumber(const std::string& text, ColumnKind kind) {
+  Value v = Value::Of(text, kind);
+  if (v.numeric()) {
+    v.d = v.AsDouble();
+    v.type = Value::Type::kDouble;
+  }
+  return v;
+}
+
+Value ZoneText(const std::string& text) {
+  Value v;
+  v.text = text;
+  return v;
+}
+
+// Some value in [lo, hi] BETWEEN from AND to (a superset when from > to).
+bool Overlaps(const Value& lo, const Value& hi, bool hiOpen, const Value& from, const Value& to) {
+  return RangeMay(lo, hi, hiOpen, CompareOp::kGe, from) && RangeMay(lo, hi, hiOpen, CompareOp::kLe, to);
+}
+
+bool ColumnMay(const ColumnZone& z, ColumnKind kind, CompareOp op, const Value& operand) {
+  if (op == CompareOp::kEq && !z.MayEqual(operand)) return false;
+  if (z.flags & ColumnZone::kUnordered) return true;
+  // Numbers meet a numeric operand numerically; any other pair compares as text.
+  if (operand.numeric() && (z.flags & ColumnZone::kNumbers) &&
+      RangeMay(ZoneNumber(z.numMin, kind), ZoneNumber(z.numMax, kind), false, op, operand)) {
+    return true;
+  }
+  const bool textRows = (z.flags & ColumnZone::kTexts) || (!operand.numeric() && (z.flags & ColumnZone::kNumbers));
+  return textRows && RangeMay(ZoneText(z.textMin), ZoneText(z.textMax), (z.flags & ColumnZone::kTextMaxOpen) != 0, op, operand);
+}
+}  // namespace
+
+bool QueryService::UsesZones(const BoundCondition& b) {
+  const Condition& c = *b.cond;
+  if (c.isSubQuery || b.field < 0) return false;
+  if (c.op == "BETWEEN") return b.list.size() == 2;
+  if (c.op == "IN") return !b.list.empty();
+  return b.hasOp && b.op != CompareOp::kNe;
+}
+
+bool QueryService::ZoneMayMatch(const std::vector<BoundCondition>& conds, const std::vector<ColumnZone>& zone) {
+  for (const auto& b : conds) {
+    if (!UsesZones(b) || static_cast<size_t>(b.field) >= zone.size()) continue;
+    const ColumnZone& z = zone[b.field];
+    const Condition& c = *b.cond;
+    bool may = false;
+    if (c.op == "BETWEEN") {
+      const Value& lo = b.list[0];
+      const Value& hi = b.list[1];
+      const bool numeric = lo.numeric() && hi.numeric();
+      may = (z.flags & ColumnZone::kUnordered) ||
+            (numeric && (z.flags & ColumnZone::kNumbers) &&
+             Overlaps(ZoneNumber(z.numMin, b.kind), ZoneNumber(z.numMax, b.kind), false, lo, hi)) ||
+            (((z.flags & ColumnZone::kTexts) || (!numeric && (z.flags & ColumnZone::kNumbers))) &&
+             Overlaps(ZoneText(z.textMin), ZoneText(z.textMax), (z.flags & ColumnZone::kTextMaxOpen) != 0, lo, hi));
+    } else if (c.op == "IN") {
+      for (const auto& v : b.list) {
+        if (ColumnMay(z, b.kind, CompareOp::kEq, v)) {
+          may = true;
+          break;
+        }
+      }
+    } else {
+      may = ColumnMay(z, b.kind, b.op, b.operand);
+    }
+    if (!may) return false;
+  }
+  return true;
+}
+
+void QueryService::FilterChunk(const ColumnChunk& chunk, const std::vector<BoundCondition>& conds, const std::string& datPath,
+                               const std::string& dbfPath, std::vector<uint32_t>& rows) {
+  rows.clear();
+  std::vector<BoundCondition> rest;
+  std::vector<std::pair<size_t, std::vector<uint8_t>>> coded;  // field, pass flag per code
+  RecordView probe;
+  probe.valid = true;
+  for (const auto& b : conds) {
+    const Condition& c = *b.cond;
+    const bool byCode = !c.isSubQuery && !c.fieldName.empty() && c.op != "EXISTS" && c.op != "NOT EXISTS" &&
+                        b.field >= 0 && static_cast<size_t>(b.field) < chunk.codes.size() &&
+                        chunk.size() > 0 && chunk.codes[b.field].size() == chunk.size();
+    if (!byCode) {
+      rest.push_back(b);
+      continue;
+    }
+    const std::vector<BoundCondition> one{b};
+    probe.values.assign(chunk.columns.size(), std::string_view());
+    std::vector<uint8_t> pass;
+    pass.reserve(chunk.dictionary[b.field].size());
+    for (std::string_view v : chunk.dictionary[b.field]) {
+      probe.values[b.field] = v;
+      pass.push_back(MatchBound(probe, one, datPath, dbfPath) ? 1 : 0);
+    }
+    coded.emplace_back(static_cast<size_t>(b.field), std::move(pass));
+  }
+  RecordView r;
+  for (size_t k = 0; k < chunk.size(); ++k) {
+    bool ok = true;
+    for (const auto& c : coded) {
+      if (!c.second[chunk.codes[c.first][k]]) {
+        ok = false;
+        break;
+      }
+    }
+    if (!ok) continue;
+    if (!rest.empty()) {
+      chunk.Row(k, r);
+      if (!MatchBound(r, rest, datPath, dbfPath)) continue;
+    }
+    rows.push_back(static_cast<uint32_t>(k));
+  }
+}
+
 Record QueryService::Project(const TableSchema& schema, const Record& rec, const std::vector<std::string>& projection) const {
   if (projection.empty()) return rec;
   Record out;
@@ -378,6 +442,362 @@ Record QueryService::Project(const TableSchema& schema, const Record& rec, const
   return out;
 }
 
+Record QueryService::Project(const TableSchema& schema, const RecordView& rec, const std::vector<std::string>& projection) const {
+  if (projection.empty()) return rec.Materialize();
+  Record out;
+  out.valid = rec.valid;
+  for (const auto& name : projection) {
+    if (name == "*") return rec.Materialize();
+    std::string_view val;
+    if (GetFieldView(schema, rec, name, val)) out.values.emplace_back(val);
+    else out.values.push_back("NULL");
+  }
+  return out;
+}
+
+namespace {
+// GROUP BY and aggregates of one SELECT. Columns are resolved and typed once;
+// groups are keyed by their typed values (AppendKey), so numeric groups come
+// out in numeric order.
+class Aggregator {
+ public:
+  Aggregator(const TableSchema& schema, const QueryPlan& plan) : plan_(plan) {
+    for (const auto& g : plan.groupBy) groupCols_.push_back(Resolve(schema, g));
+    for (const auto& a : plan.aggregates) aggCols_.push_back(Resolve(schema, a.field));
+  }
+
+  // Row is Record or RecordView.
+  template <typename Row>
+  bool Add(const Row& r, std::string& err) {
+    GroupData* g = Find(r, err);
+    return g && AddTo(*g, r, err);
+  }
+
+  // The rows of a columnar chunk that passed WHERE. Without GROUP BY each
+  // aggregate runs down its column; grouped input goes row by row.
+  bool AddChunk(const ColumnChunk& chunk, const std::vector<uint32_t>& rows, std::string& err) {
+    if (!groupCols_.empty()) {
+      // When every GROUP BY column is dictionary coded, rows find their group
+      // by the tuple of codes; the string key is built once per tuple.
+      bool coded = groupCols_.size() <= 4;
+      for (const auto& col : groupCols_) {
+        coded = coded && col.index >= 0 && static_cast<size_t>(col.index) < chunk.codes.size() &&
+                chunk.codes[col.index].size() == chunk.size();
+      }
+      byCode_.clear();
+      RecordView r;
+      for (uint32_t k : rows) {
+        chunk.Row(k, r);
+        GroupData* g = nullptr;
+        if (coded) {
+          uint64_t code = 0;
+          for (const auto& col : groupCols_) code = code << 16 | chunk.codes[col.index][k];
+          auto it = byCode_.find(code);
+          if (it == byCode_.end()) it = byCode_.emplace(code, Find(r, err)).first;
+          g = it->second;
+        } else {
+          g = Find(r, err);
+        }
+        if (!g || !AddTo(*g, r, err)) return false;
+      }
+      return true;
+    }
+    if (rows.empty()) return true;
+    GroupData& g = groups_[std::string()];
+    g.aggs.resize(plan_.aggregates.size());
+    for (size_t k = 0; k < plan_.aggregates.size(); ++k) {
+      const AggregateExpr& a = plan_.aggregates[k];
+      AggState& st = g.aggs[k];
+      if (CountsRows(a)) {
+        st.count += static_cast<long>(rows.size());
+        continue;
+      }
+      if (!Supported(a)) continue;
+      const int index = aggCols_[k].index;
+      if (index < 0 || static_cast<size_t>(index) >= chunk.columns.size() || chunk.columns[index].size() != chunk.size()) {
+        err = a.func + " field not found: " + a.field;
+        return false;
+      }
+      const auto& column = chunk.columns[index];
+      const StoredNumber* numbers = static_cast<size_t>(index) < chunk.numbers.size() && !chunk.numbers[index].empty()
+                                        ? chunk.numbers[index].data() : nullptr;
+      for (uint32_t row : rows) {
+        if (!Accumulate(st, k, column[row], numbers ? numbers + row : nullptr, err)) return false;
+      }
+    }
+    return true;
+  }
+
+  // One output row per group, in SELECT-list order.
+  std::vector<Record> Finish() const {
+    std::vector<Record> out;
+    for (const auto& kv : groups_) {
+      const GroupData& gd = kv.second;
+      Record rec;
+      rec.valid = true;
+      size_t aggIndex = 0;
+      for (const auto& sel : plan_.selectExprs) {
+        if (sel.isAggregate) {
+          const AggState& st = gd.aggs[aggIndex];
+          const std::string& func = plan_.aggregates[aggIndex++].func;
+          if (func == "COUNT") rec.values.push_back(std::to_string(st.count));
+          else if (func == "SUM") rec.values.push_back(std::to_string(st.sum));
+          else if (func == "AVG") {
+            if (st.count == 0) rec.values.push_back("NULL");
+            else rec.values.push_back(std::to_string(st.sum / st.count));
+          } else if (func == "MIN") rec.values.push_back(st.hasVal ? st.minVal : "NULL");
+          else if (func == "MAX") rec.values.push_back(st.hasVal ? st.maxVal : "NULL");
+          else rec.values.push_back("NULL");
+        } else {
+          std::string val = "NULL";
+          for (size_t g = 0; g < plan_.groupBy.size(); ++g) {
+            if (Lower(plan_.groupBy[g]) == Lower(sel.field)) val = gd.groupVals[g];
+          }
+          rec.values.push_back(val);
+        }
+      }
+      out.push_back(std::move(rec));
+    }
+    return out;
+  }
+
+ private:
+  struct Column {
+    int index = -1;
+    ColumnKind kind = ColumnKind::kText;
+  };
+  struct AggState {
+    long count = 0;
+    double sum = 0;
+    std::string minVal;
+    std::string maxVal;
+    Value min, max;  // minVal / maxVal typed
+    bool hasVal = false;
+  };
+  struct GroupData {
+    std::vector<std::string> groupVals;  // aligned with plan.groupBy
+    std::vector<AggState> aggs;          // aligned with plan.aggregates
+  };
+
+  // The group of row r, created on first sight.
+  template <typename Row>
+  GroupData* Find(const Row& r, std::string& err) {
+    key_.clear();
+    for (size_t g = 0; g < groupCols_.size(); ++g) {
+      std::string_view v;
+      if (!Get(r, groupCols_[g], v)) {
+        err = "GROUP BY field not found: " + plan_.groupBy[g];
+        return nullptr;
+      }
+      AppendKey(Value::Of(v, groupCols_[g].kind, StoredAt(r, groupCols_[g].index)), key_);
+    }
+
+    auto it = groups_.find(key_);
+    if (it == groups_.end()) {
+      GroupData init;
+      for (const auto& col : groupCols_) {
+        std::string_view v;
+        Get(r, col, v);
+        init.groupVals.emplace_back(v);
+      }
+      init.aggs.resize(plan_.aggregates.size());
+      it = groups_.emplace(key_, std::move(init)).first;
+    }
+    return &it->second;
+  }
+
+  template <typename Row>
+  bool AddTo(GroupData& g, const Row& r, std::string& err) {
+    for (size_t k = 0; k < plan_.aggregates.size(); ++k) {
+      const AggregateExpr& a = plan_.aggregates[k];
+      AggState& st = g.aggs[k];
+      if (CountsRows(a)) {
+        st.count++;
+        continue;
+      }
+      if (!Supported(a)) continue;
+      std::string_view v;
+      if (!Get(r, aggCols_[k], v)) {
+        err = a.func + " field not found: " + a.field;
+        return false;
+      }
+      if (!Accumulate(st, k, v, StoredAt(r, aggCols_[k].index), err)) return false;
+    }
+    return true;
+  }
+
+  static bool CountsRows(const AggregateExpr& a) { return a.func == "COUNT" && (a.field == "*" || a.field.empty()); }
+  static bool Supported(const AggregateExpr& a) {
+    return a.func == "COUNT" || a.func == "SUM" || a.func == "AVG" || a.func == "MIN" || a.func == "MAX";
+  }
+
+  // Folds one value of aggregate k into its state; stored is its binary
+  // form when the scan kept one.
+  bool Accumulate(AggState& st, size_t k, std::string_view v, const StoredNumber* stored, std::string& err) const {
+    const AggregateExpr& a = plan_.aggregates[k];
+    if (a.func == "COUNT") {
+      if (!v.empty() && v != "NULL") st.count++;
+    } else if (a.func == "SUM" || a.func == "AVG") {
+      const Value num = Value::Of(v, aggCols_[k].kind, stored);
+      if (!num.numeric()) {
+        err = a.func + " requires numeric field: " + a.field;
+        return false;
+      }
+      st.sum += num.AsDouble();
+      st.count++;
+    } else {
+      const Value cur = Value::Of(v, aggCols_[k].kind, stored);
+      if (!st.hasVal || CompareValues(cur, st.min) < 0) Keep(cur, st.minVal, st.min);
+      if (!st.hasVal || CompareValues(st.max, cur) < 0) Keep(cur, st.maxVal, st.max);
+      st.hasVal = true;
+    }
+    return true;
+  }
+
+  // bound = v, with its text copied into text.
+  static void Keep(const Value& v, std::string& text, Value& bound) {
+    text.assign(v.text);
+    bound = v;
+    bound.text = text;
+  }
+
+  static Column Resolve(const TableSchema& schema, const std::string& name) {
+    Column c;
+    c.index = FieldIndex(schema, name);
+    uint32_t width = 0;
+    if (c.index >= 0) c.kind = ColumnKindOf(schema.fields[c.index], width);
+    return c;
+  }
+  template <typename Row>
+  static bool Get(const Row& r, const Column& c, std::string_view& out) {
+    if (c.index < 0 || static_cast<size_t>(c.index) >= r.values.size()) return false;
+    out = r.values[c.index];
+    return true;
+  }
+
+  const QueryPlan& plan_;
+  std::vector<Column> groupCols_;
+  std::vector<Column> aggCols_;
+  std::map<std::string, GroupData> groups_;
+  std::string key_;
+  std::unordered_map<uint64_t, GroupData*> byCode_;  // per chunk: dictionary code tuple -> group
+};
+
+// ORDER BY: every row's sort keys are typed once, then an index sort permutes
+// the rows. Fails with the first ORDER BY column the schema lacks.
+bool SortRecords(std::vector<Record>& rows, const TableSchema& schema, const std::vector<std::pair<std::string, bool>>& orderBy,
+                 const std::map<std::string, std::string>& aliasMap, std::string& err) {
+  std::vector<int> cols;
+  std::vector<ColumnKind> kinds;
+  for (const auto& ob : orderBy) {
+    std::string field = ob.first;
+    auto it = aliasMap.find(Lower(field));
+    if (it != aliasMap.end()) field = it->second;
+    const int idx = FieldIndex(schema, field);
+    if (idx < 0) {
+      err = "ORDER BY field not found: " + ob.first;
+      return false;
+    }
+    uint32_t width = 0;
+    cols.push_back(idx);
+    kinds.push_back(ColumnKindOf(schema.fields[idx], width));
+  }
+
+  const size_t width = cols.size();
+  std::vector<Value> keys(rows.size() * width);
+  for (size_t r = 0; r < rows.size(); ++r) {
+    for (size_t k = 0; k < width; ++k) {
+      const auto& values = rows[r].values;
+      std::string_view v = static_cast<size_t>(cols[k]) < values.size() ? std::string_view(values[cols[k]]) : std::string_view();
+      keys[r * width + k] = Value::Of(v, kinds[k]);
+    }
+  }
+  std::vector<size_t> order(rows.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    for (size_t k = 0; k < width; ++k) {
+      const int c = CompareValues(keys[a * width + k], keys[b * width + k]);
+      if (c == 0) continue;
+      return orderBy[k].second ? c < 0 : c > 0;
+    }
+    return false;
+  });
+
+  std::vector<Record> sorted;
+  sorted.reserve(rows.size());
+  for (size_t i : order) sorted.push_back(std::move(rows[i]));
+  rows = std::move(sorted);
+  return true;
+}
+
+// ORDER BY names usable after aggregation: aliases and "FUNC(field)".
+std::map<std::string, std::string> AggregateAliases(const QueryPlan& plan) {
+  std::map<std::string, std::string> aliasMap;
+  for (const auto& sel : plan.selectExprs) {
+    std::string name = sel.alias.empty() ? (sel.isAggregate ? sel.agg.func + "(" + sel.agg.field + ")" : sel.field) : sel.alias;
+    if (!sel.alias.empty()) {
+      aliasMap[Lower(sel.field)] = name;
+      aliasMap[Lower(sel.alias)] = name;
+    }
+    if (sel.isAggregate) aliasMap[Lower(sel.agg.func + "(" + sel.agg.field + ")")] = name;
+  }
+  return aliasMap;
+}
+
+// Output schema of an aggregate SELECT, and the one HAVING resolves against.
+TableSchema AggregateSchema(const QueryPlan& plan, bool forHaving) {
+  TableSchema out;
+  for (const auto& sel : plan.selectExprs) {
+    Field f;
+    if (!forHaving && !sel.alias.empty()) f.name = sel.alias;
+    else if (sel.isAggregate) f.name = sel.agg.func + "(" + sel.agg.field + ")";
+    else f.name = sel.field;
+    out.fields.push_back(f);
+  }
+  return out;
+}
+
+// Fields a single-table SELECT reads, for columnar scans and out-of-line
+// values; all of them when some name does not resolve to one column or a
+// SELECT-list subquery may look at the whole row.
+std::vector<bool> ReadColumns(const TableSchema& schema, const QueryPlan& plan, bool hasAgg) {
+  std::vector<bool> cols(schema.fields.size(), false);
+  bool all = false;
+  auto use = [&](const std::string& name) {
+    const int i = FieldIndex(schema, name);
+    if (i < 0) all = true;
+    else cols[i] = true;
+  };
+  for (const auto& c : plan.conditions) {
+    if (!c.fieldName.empty() && c.op != "EXISTS" && c.op != "NOT EXISTS") use(c.fieldName);
+  }
+  if (hasAgg) {
+    for (const auto& g : plan.groupBy) use(g);
+    for (const auto& a : plan.aggregates) {
+      if (!a.field.empty() && a.field != "*") use(a.field);
+    }
+  } else {
+    if (plan.projection.empty()) all = true;
+    for (const auto& p : plan.projection) use(p);
+    for (const auto& o : plan.orderBy) {
+      if (FieldIndex(schema, o.first) >= 0) {
+        use(o.first);
+        continue;
+      }
+      bool aliased = false;
+      for (size_t i = 0; i < plan.projectionAliases.size() && i < plan.projection.size(); ++i) {
+        if (EqualsNoCase(plan.projectionAliases[i], o.first)) aliased = true;
+      }
+      if (!aliased) all = true;
+    }
+    for (const auto& e : plan.selectExprs) {
+      if (e.isSubQuery) all = true;
+    }
+  }
+  if (all) cols.assign(schema.fields.size(), true);
+  return cols;
+}
+}  // namespace
 
 bool QueryService::Select(const std::string& datPath, const std::string& dbfPath, const TableSchema& schema, const QueryPlan& plan,
                           std::vector<Record>& out, std::string& err, Txn* txn, LockManager* lock_manager) {
@@ -405,7 +825,7 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
   static thread_local std::vector<std::string> viewStack;
 
   std::vector<Record> r1;
-  std::vector<std::pair<long, Record>> r1o;
+  std::vector<std::pair<int64_t, Record>> r1o;
   
   // Try Index Optimization
   bool indexUsed = false;
@@ -423,29 +843,50 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
 
   if (!indexUsed) {
   for (const auto& c : plan.conditions) {
-      if (c.op == "=" && !c.fieldName.empty()) {
+      bool inList = c.op == "IN" && !c.isSubQuery;
+      if ((c.op == "=" || inList) && !c.fieldName.empty()) {
           // Check if field is indexed
            auto it = std::find_if(schema.indexes.begin(), schema.indexes.end(), [&](const IndexDef& d){ return d.fieldName == c.fieldName; });
-           if (it != schema.indexes.end()) {
+           // Index files keep one offset per key, so IN lists only trust unique indexes.
+           if (it != schema.indexes.end() && (!inList || it->isUnique)) {
                // Use index name for file path
                std::string idxPath = dbms_paths::IndexPathFromDat(datPath, schema.tableName, it->name);
-               std::map<std::string, long> idx;
+               std::map<std::string, int64_t> idx;
+               // VACUUM and DDL move rows: hold the table shared from reading
+               // the index until its rows are read (a transaction keeps it).
+               const TxnId tableOwner = txn ? txn->id : LockManager::TransientOwner();
+               struct TableRelease {
+                   LockManager* lm;
+                   TxnId owner;
+                   ~TableRelease() { if (lm) lm->ReleaseAll(owner); }
+               } tableRelease{txn ? nullptr : lock_manager, tableOwner};
+               if (lock_manager && (!lock_manager->LockTableShared(tableOwner, schema.tableName, err) ||
+                                    !engine_.SchemaStillCurrent(dbfPath, schema, err))) return false;
                // Load index. If fail (missing file), fall back to scan
                std::string ignErr;
                if (engine_.LoadIndex(idxPath, idx, ignErr)) {
-                   std::string key = NormalizeValue(c.value);
-                   std::vector<std::string> keys = {key, c.value, "'" + key + "'", "\"" + key + "\""};
-                   for (const auto& k : keys) {
-                       if (!idx.count(k)) continue;
-                       Record rec;
-                       if (engine_.ReadRecordAt(datPath, schema, idx[k], rec, ignErr)) {
-                           if (rec.valid) {
-                               r1.push_back(rec);
-                               RID rid{schema.tableName, static_cast<uint64_t>(idx[k])};
-                               if (!trackShared(rid, ignErr)) { err = ignErr; return false; }
-                           }
+                   std::vector<int64_t> offsets;
+                   for (const auto& value : inList ? c.values : std::vector<std::string>{c.value}) {
+                       std::string key = NormalizeValue(value);
+                       std::vector<std::string> keys = {key, value, "'" + key + "'", "\"" + key + "\""};
+                       for (const auto& k : keys) {
+                           auto hit = idx.find(k);
+                           if (hit == idx.end()) continue;
+                           offsets.push_back(hit->second);
+                           break;
+                       }
+                   }
+                   // File order, as a scan would return them; one batched read.
+                   std::sort(offsets.begin(), offsets.end());
+                   offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+                   std::vector<Record> recs;
+                   if (engine_.ReadRecordsAt(datPath, schema, offsets, recs, ignErr)) {
+                       for (size_t k = 0; k < recs.size(); ++k) {
+                           if (!recs[k].valid) continue;
+                           r1.push_back(std::move(recs[k]));
+                           RID rid{schema.tableName, static_cast<uint64_t>(offsets[k])};
+                           if (!trackShared(rid, ignErr)) { err = ignErr; return false; }
                        }
-                       break;
                    }
                    indexUsed = true;
                    break;
@@ -455,19 +896,24 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
   }
   }
 
+  bool isJoin = !plan.joinTable.empty();
+  // Single-table scans pull rows from a cursor, filter them straight off the
+  // mapping and copy only the survivors.
+  bool streamScan = false;
   if (!indexUsed) {
       if (plan.sourceSubQuery) {
           if (!ExecuteSubQuery(datPath, dbfPath, *plan.sourceSubQuery, r1, err)) return false;
           indexUsed = true;
+      } else if (!isJoin) {
+          streamScan = true;
       } else {
           if (!engine_.ReadRecordsWithOffsets(datPath, schema, r1o, err)) return false;
           for (const auto& p : r1o) r1.push_back(p.second);
       }
   }
 
-  bool isJoin = !plan.joinTable.empty();
   std::vector<Record> r2;
-  std::vector<std::pair<long, Record>> r2o;
+  std::vector<std::pair<int64_t, Record>> r2o;
   TableSchema schema2;
   
   // Combine Schemas (preserving alias info in field names)
@@ -480,7 +926,6 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
       combinedSchema.fields.push_back(nf);
   }
 
-  isJoin = isJoin && !plan.joinTable.empty();
   
   std::vector<std::pair<size_t, size_t>> naturalPairs;
   if (isJoin) {
@@ -518,6 +963,34 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
       }
   }
 
+  const std::vector<BoundCondition> where = Bind(combinedSchema, plan.conditions);
+
+  // Aggregate output: HAVING, then ORDER BY over the aggregate names.
+  auto finishAggregate = [&](const Aggregator& agg) -> bool {
+      std::vector<Record> aggOut = agg.Finish();
+      if (!plan.havingConditions.empty()) {
+          const std::vector<BoundCondition> having = Bind(AggregateSchema(plan, true), plan.havingConditions);
+          std::vector<Record> havingFiltered;
+          for (auto& rec : aggOut) {
+              if (MatchBound(rec, having, datPath, dbfPath)) havingFiltered.push_back(std::move(rec));
+          }
+          aggOut = std::move(havingFiltered);
+      }
+      if (!plan.orderBy.empty() && !SortRecords(aggOut, AggregateSchema(plan, false), plan.orderBy, AggregateAliases(plan), err)) return false;
+      out = std::move(aggOut);
+      return true;
+  };
+  // Plain ORDER BY; projection aliases name the columns they project.
+  auto sortRows = [&](std::vector<Record>& rows) -> bool {
+      std::map<std::string, std::string> aliasMap;
+      for (size_t i = 0; i < plan.projection.size(); ++i) {
+          if (i < plan.projectionAliases.size() && !plan.projectionAliases[i].empty()) {
+              aliasMap[Lower(plan.projectionAliases[i])] = plan.projection[i];
+          }
+      }
+      return SortRecords(rows, combinedSchema, plan.orderBy, aliasMap, err);
+  };
+
   std::vector<std::string> effectiveProjection = plan.projection;
   if (plan.isNaturalJoin) {
       bool isStar = effectiveProjection.empty() ||
@@ -538,28 +1011,11 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
   
   if (!isJoin) {
       std::vector<Record> matched;
-      if (!indexUsed) {
-          for (const auto& p : r1o) {
-              const auto& r = p.second;
-              if (!r.valid) continue;
-              if (!MatchConditions(combinedSchema, r, plan.conditions, datPath, dbfPath)) continue;
-              RID rid{schema.tableName, static_cast<uint64_t>(p.first)};
-              if (!trackShared(rid, err)) return false;
-              matched.push_back(r);
-          }
-      } else {
-          for (const auto& r : r1) {
-              if (!r.valid) continue;
-              if (!MatchConditions(combinedSchema, r, plan.conditions, datPath, dbfPath)) continue;
-              matched.push_back(r);
-          }
-      }
-
       bool hasAgg = !plan.aggregates.empty() || !plan.groupBy.empty();
-      if (hasAgg) {
-          std::map<std::string, bool> groupBySet;
-          for (const auto& g : plan.groupBy) groupBySet[Lower(g)] = true;
+      std::map<std::string, bool> groupBySet;
+      for (const auto& g : plan.groupBy) groupBySet[Lower(g)] = true;
 
+      if (hasAgg) {
           for (const auto& sel : plan.selectExprs) {
               if (!sel.isAggregate) {
                   if (!sel.field.empty() && sel.field != "*" && !groupBySet[Lower(sel.field)]) {
@@ -568,273 +1024,65 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
                   }
               }
           }
+      }
 
-          struct AggState {
-              std::string func;
-              std::string field;
-              long count = 0;
-              double sum = 0;
-              std::string minVal;
-              std::string maxVal;
-              bool hasVal = false;
-          };
-          struct GroupData {
-              std::map<std::string, std::string> groupVals; // lower(field)->value
-              std::vector<AggState> aggs;
-          };
-
-          auto asNumber = [](const std::string& s, double& out) {
-              try { size_t i = 0; out = std::stod(s, &i); return i == s.size(); } catch (...) { return false; }
-          };
-          auto lessValue = [&](const std::string& a, const std::string& b) {
-              double an = 0, bn = 0;
-              bool aNum = asNumber(a, an);
-              bool bNum = asNumber(b, bn);
-              if (aNum && bNum) return an < bn;
-              return a < b;
-          };
-
-          std::map<std::string, GroupData> groups;
-          for (const auto& r : matched) {
-              std::string key;
-              GroupData* gd = nullptr;
-              if (!plan.groupBy.empty()) {
-                  for (const auto& g : plan.groupBy) {
-                      std::string v;
-                      if (!GetFieldValue(combinedSchema, r, g, v)) {
-                          err = "GROUP BY field not found: " + g;
-                          return false;
-                      }
-                      key += v;
-                      key.push_back('\x1f');
-                  }
-              }
-
-              auto it = groups.find(key);
-              if (it == groups.end()) {
-                  GroupData init;
-                  for (const auto& g : plan.groupBy) {
-                      std::string v;
-                      GetFieldValue(combinedSchema, r, g, v);
-                      init.groupVals[Lower(g)] = v;
-                  }
-                  for (const auto& a : plan.aggregates) {
-                      AggState st;
-                      st.func = a.func;
-                      st.field = a.field;
-                      init.aggs.push_back(st);
-                  }
-                  it = groups.insert({key, init}).first;
-              }
-              gd = &it->second;
-
-              for (auto& st : gd->aggs) {
-                  if (st.func == "COUNT") {
-                      if (st.field == "*" || st.field.empty()) {
-                          st.count++;
-                      } else {
-                          std::string v;
-                          if (!GetFieldValue(combinedSchema, r, st.field, v)) {
-                              err = "COUNT field not found: " + st.field;
-                              return false;
-                          }
-                          if (!v.empty() && v != "NULL") st.count++;
-                      }
-                  } else if (st.func == "SUM" || st.func == "AVG") {
-                      std::string v;
-                      if (!GetFieldValue(combinedSchema, r, st.field, v)) {
-                          err = st.func + " field not found: " + st.field;
-                          return false;
-                      }
-                      double num = 0;
-                      if (!asNumber(v, num)) {
-                          err = st.func + " requires numeric field: " + st.field;
-                          return false;
-                      }
-                      st.sum += num;
-                      st.count++;
-                  } else if (st.func == "MIN" || st.func == "MAX") {
-                      std::string v;
-                      if (!GetFieldValue(combinedSchema, r, st.field, v)) {
-                          err = st.func + " field not found: " + st.field;
-                          return false;
-                      }
-                      if (!st.hasVal) {
-                          st.minVal = v;
-                          st.maxVal = v;
-                          st.hasVal = true;
-                      } else {
-                          if (lessValue(v, st.minVal)) st.minVal = v;
-                          if (lessValue(st.maxVal, v)) st.maxVal = v;
-                      }
-                  }
-              }
-          }
-
-          TableSchema outSchema;
-          for (const auto& sel : plan.selectExprs) {
-              Field f;
-              if (!sel.alias.empty()) f.name = sel.alias;
-              else if (sel.isAggregate) {
-                  f.name = sel.agg.func + "(" + sel.agg.field + ")";
-              } else {
-                  f.name = sel.field;
-              }
-              outSchema.fields.push_back(f);
-          }
+      Aggregator agg(combinedSchema, plan);
+      // Without ORDER BY or SELECT-list subqueries rows can be projected as they arrive.
+      bool projectEarly = !hasAgg && plan.orderBy.empty() &&
+                          std::none_of(plan.selectExprs.begin(), plan.selectExprs.end(),
+                                       [](const SelectExpr& e) { return e.isSubQuery; });
+      auto keep = [&](const auto& r) -> bool {
+          if (hasAgg) return agg.Add(r, err);
+          if (projectEarly) out.push_back(Project(combinedSchema, r, effectiveProjection));
+          else matched.push_back(ToRecord(r));
+          return true;
+      };
 
-          std::vector<Record> aggOut;
-          for (const auto& kv : groups) {
-              const GroupData& gd = kv.second;
-              Record rec;
-              rec.valid = true;
-              size_t aggIndex = 0;
-              for (const auto& sel : plan.selectExprs) {
-                  if (sel.isAggregate) {
-                      const AggState& st = gd.aggs[aggIndex++];
-                      if (st.func == "COUNT") rec.values.push_back(std::to_string(st.count));
-                      else if (st.func == "SUM") rec.values.push_back(std::to_string(st.sum));
-                      else if (st.func == "AVG") {
-                          if (st.count == 0) rec.values.push_back("NULL");
-                          else rec.values.push_back(std::to_string(st.sum / st.count));
-                      } else if (st.func == "MIN") rec.values.push_back(st.hasVal ? st.minVal : "NULL");
-                      else if (st.func == "MAX") rec.values.push_back(st.hasVal ? st.maxVal : "NULL");
-                      else rec.values.push_back("NULL");
-                  } else {
-                      auto itv = gd.groupVals.find(Lower(sel.field));
-                      if (itv != gd.groupVals.end()) rec.values.push_back(itv->second);
-                      else rec.values.push_back("NULL");
-                  }
-              }
-              aggOut.push_back(rec);
+      if (streamScan) {
+          TableScanCursor cursor;
+          if (!engine_.OpenScan(datPath, schema, cursor, err)) return false;
+          cursor.SetColumns(ReadColumns(combinedSchema, plan, hasAgg));
+          if (std::any_of(where.begin(), where.end(), UsesZones)) {
+              cursor.SetZoneFilter([&where](const std::vector<ColumnZone>& zone) { return ZoneMayMatch(where, zone); });
           }
-
-          // Apply HAVING filter
-          if (!plan.havingConditions.empty()) {
-              // Build a temporary schema that maps aggregate expressions to their field names
-              TableSchema havingSchema;
-              for (const auto& sel : plan.selectExprs) {
-                  Field f;
-                  if (sel.isAggregate) {
-                      // Add field with aggregate expression name like "COUNT(*)"
-                      f.name = sel.agg.func + "(" + sel.agg.field + ")";
-                      havingSchema.fields.push_back(f);
-                  } else {
-                      // Add field with actual name
-                      f.name = sel.field;
-                      havingSchema.fields.push_back(f);
+          int64_t offset = 0;
+          RecordView r;
+          if (cursor.columnar()) {
+              // Page-sized chunks: WHERE works on dictionary codes where it can,
+              // aggregates take whole columns.
+              ColumnChunk chunk;
+              std::vector<uint32_t> rows;
+              while (cursor.NextChunk(chunk)) {
+                  FilterChunk(chunk, where, datPath, dbfPath, rows);
+                  for (uint32_t k : rows) {
+                      RID rid{schema.tableName, static_cast<uint64_t>(chunk.rids[k])};
+                      if (!trackShared(rid, err)) return false;
+                      if (!hasAgg) {
+                          chunk.Row(k, r);
+                          if (!keep(r)) return false;
+                      }
                   }
+                  if (hasAgg && !agg.AddChunk(chunk, rows, err)) return false;
               }
-              
-              std::vector<Record> havingFiltered;
-              for (const auto& rec : aggOut) {
-                  if (MatchConditions(havingSchema, rec, plan.havingConditions, datPath, dbfPath)) {
-                      havingFiltered.push_back(rec);
-                  }
+          } else {
+              while (cursor.Next(offset, r)) {
+                  if (!MatchBound(r, where, datPath, dbfPath)) continue;
+                  RID rid{schema.tableName, static_cast<uint64_t>(offset)};
+                  if (!trackShared(rid, err) || !keep(r)) return false;
               }
-              aggOut = havingFiltered;
           }
-
-          if (!plan.orderBy.empty()) {
-      std::map<std::string, std::string> aliasMap;
-      for (const auto& sel : plan.selectExprs) {
-          std::string name = sel.alias.empty() ? (sel.isAggregate ? sel.agg.func + "(" + sel.agg.field + ")" : sel.field) : sel.alias;
-          if (!sel.alias.empty()) {
-              aliasMap[Lower(sel.field)] = name;
-              aliasMap[Lower(sel.alias)] = name;
-          }
-          // Map aggregate expressions like "COUNT(*)" to their field names
-          if (sel.isAggregate) {
-              std::string exprName = sel.agg.func + "(" + sel.agg.field + ")";
-              aliasMap[Lower(exprName)] = name;
-          }
-      }
-
-              for (const auto& ob : plan.orderBy) {
-                  std::string field = ob.first;
-                  auto it = aliasMap.find(Lower(field));
-                  if (it != aliasMap.end()) field = it->second;
-                  if (!FieldExists(outSchema, field)) {
-                      err = "ORDER BY field not found: " + ob.first;
-                      return false;
-                  }
-              }
-
-              auto asNumber = [](const std::string& s, double& out) {
-                  try { size_t i = 0; out = std::stod(s, &i); return i == s.size(); } catch (...) { return false; }
-              };
-
-              auto cmp = [&](const Record& a, const Record& b) {
-                  for (const auto& ob : plan.orderBy) {
-                      std::string av, bv;
-                      GetFieldValueForOrder(outSchema, a, ob.first, aliasMap, av);
-                      GetFieldValueForOrder(outSchema, b, ob.first, aliasMap, bv);
-
-                      double an = 0, bn = 0;
-                      bool aNum = asNumber(av, an);
-                      bool bNum = asNumber(bv, bn);
-
-                      if (aNum && bNum) {
-                          if (std::abs(an - bn) < 1e-9) continue;
-                          return ob.second ? (an < bn) : (an > bn);
-                      }
-                      if (av == bv) continue;
-                      return ob.second ? (av < bv) : (av > bv);
-                  }
-                  return false;
-              };
-
-              std::sort(aggOut.begin(), aggOut.end(), cmp);
+          if (!cursor.error().empty()) { err = cursor.error(); return false; }
+      } else {
+          for (const auto& r : r1) {
+              if (!r.valid) continue;
+              if (!MatchBound(r, where, datPath, dbfPath)) continue;
+              if (!keep(r)) return false;
           }
-
-          out = aggOut;
-          return true;
       }
 
-      if (!plan.orderBy.empty()) {
-          std::map<std::string, std::string> aliasMap;
-          for (size_t i = 0; i < plan.projection.size(); ++i) {
-              if (i < plan.projectionAliases.size() && !plan.projectionAliases[i].empty()) {
-                  aliasMap[Lower(plan.projectionAliases[i])] = plan.projection[i];
-              }
-          }
-
-          for (const auto& ob : plan.orderBy) {
-              std::string field = ob.first;
-              auto it = aliasMap.find(Lower(field));
-              if (it != aliasMap.end()) field = it->second;
-              if (!FieldExists(combinedSchema, field)) {
-                  err = "ORDER BY field not found: " + ob.first;
-                  return false;
-              }
-          }
-
-          auto asNumber = [](const std::string& s, double& out) {
-              try { size_t i = 0; out = std::stod(s, &i); return i == s.size(); } catch (...) { return false; }
-          };
-
-          auto cmp = [&](const Record& a, const Record& b) {
-              for (const auto& ob : plan.orderBy) {
-                  std::string av, bv;
-                  GetFieldValueForOrder(combinedSchema, a, ob.first, aliasMap, av);
-                  GetFieldValueForOrder(combinedSchema, b, ob.first, aliasMap, bv);
+      if (hasAgg) return finishAggregate(agg);
 
-                  double an = 0, bn = 0;
-                  bool aNum = asNumber(av, an);
-                  bool bNum = asNumber(bv, bn);
-
-                  if (aNum && bNum) {
-                      if (std::abs(an - bn) < 1e-9) continue;
-                      return ob.second ? (an < bn) : (an > bn);
-                  }
-                  if (av == bv) continue;
-                  return ob.second ? (av < bv) : (av > bv);
-              }
-              return false;
-          };
-
-          std::sort(matched.begin(), matched.end(), cmp);
-      }
+      if (!plan.orderBy.empty() && !sortRows(matched)) return false;
 
       // Handle SELECT list subqueries
       if (!plan.selectExprs.empty()) {
@@ -927,7 +1175,7 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
               if (!row2.valid) continue;
               Record cur = createCombined(row1, row2);
               if (matchesVar(row1, row2, cur)) {
-                  if (MatchConditions(combinedSchema, cur, plan.conditions, datPath, dbfPath)) {
+                  if (MatchBound(cur, where, datPath, dbfPath)) {
                        matched = true;
                        if (lock_manager && txn) {
                            if (!r1o.empty() && i < r1o.size()) {
@@ -945,7 +1193,7 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
           }
           if (plan.joinType == JoinType::kLeft && !matched) {
                Record cur = createCombined(row1, nullR2);
-               if (MatchConditions(combinedSchema, cur, plan.conditions, datPath, dbfPath)) {
+               if (MatchBound(cur, where, datPath, dbfPath)) {
                     if (lock_manager && txn) {
                         if (!r1o.empty() && i < r1o.size()) {
                             RID rid1{schema.tableName, static_cast<uint64_t>(r1o[i].first)};
@@ -967,7 +1215,7 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
               if (!row1.valid) continue;
               Record cur = createCombined(row1, row2);
               if (matchesVar(row1, row2, cur)) {
-                  if (MatchConditions(combinedSchema, cur, plan.conditions, datPath, dbfPath)) {
+                  if (MatchBound(cur, where, datPath, dbfPath)) {
                        matched = true;
                        if (lock_manager && txn) {
                            if (!r1o.empty() && i < r1o.size()) {
@@ -985,7 +1233,7 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
           }
           if (!matched) {
                Record cur = createCombined(nullR1, row2);
-               if (MatchConditions(combinedSchema, cur, plan.conditions, datPath, dbfPath)) {
+               if (MatchBound(cur, where, datPath, dbfPath)) {
                     if (lock_manager && txn) {
                         if (j < r2o.size()) {
                             RID rid2{schema2.tableName, static_cast<uint64_t>(r2o[j].first)};
@@ -1012,271 +1260,14 @@ bool QueryService::Select(const std::string& datPath, const std::string& dbfPath
           }
       }
 
-      struct AggState {
-          std::string func;
-          std::string field;
-          long count = 0;
-          double sum = 0;
-          std::string minVal;
-          std::string maxVal;
-          bool hasVal = false;
-      };
-      struct GroupData {
-          std::map<std::string, std::string> groupVals; // lower(field)->value
-          std::vector<AggState> aggs;
-      };
-
-      auto asNumber = [](const std::string& s, double& out) {
-          try { size_t i = 0; out = std::stod(s, &i); return i == s.size(); } catch (...) { return false; }
-      };
-      auto lessValue = [&](const std::string& a, const std::string& b) {
-          double an = 0, bn = 0;
-          bool aNum = asNumber(a, an);
-          bool bNum = asNumber(b, bn);
-          if (aNum && bNum) return an < bn;
-          return a < b;
-      };
-
-      std::map<std::string, GroupData> groups;
+      Aggregator agg(combinedSchema, plan);
       for (const auto& r : matchedRows) {
-          std::string key;
-          GroupData* gd = nullptr;
-          if (!plan.groupBy.empty()) {
-              for (const auto& g : plan.groupBy) {
-                  std::string v;
-                  if (!GetFieldValue(combinedSchema, r, g, v)) {
-                      err = "GROUP BY field not found: " + g;
-                      return false;
-                  }
-                  key += v;
-                  key.push_back('\x1f');
-              }
-          }
-
-          auto it = groups.find(key);
-          if (it == groups.end()) {
-              GroupData init;
-              for (const auto& g : plan.groupBy) {
-                  std::string v;
-                  GetFieldValue(combinedSchema, r, g, v);
-                  init.groupVals[Lower(g)] = v;
-              }
-              for (const auto& a : plan.aggregates) {
-                  AggState st;
-                  st.func = a.func;
-                  st.field = a.field;
-                  init.aggs.push_back(st);
-              }
-              it = groups.insert({key, init}).first;
-          }
-          gd = &it->second;
-
-          for (auto& st : gd->aggs) {
-              if (st.func == "COUNT") {
-                  if (st.field == "*" || st.field.empty()) {
-                      st.count++;
-                  } else {
-                      std::string v;
-                      if (!GetFieldValue(combinedSchema, r, st.field, v)) {
-                          err = "COUNT field not found: " + st.field;
-                          return false;
-                      }
-                      if (!v.empty() && v != "NULL") st.count++;
-                  }
-              } else if (st.func == "SUM" || st.func == "AVG") {
-                  std::string v;
-                  if (!GetFieldValue(combinedSchema, r, st.field, v)) {
-                      err = st.func + " field not found: " + st.field;
-                      return false;
-                  }
-                  double num = 0;
-                  if (!asNumber(v, num)) {
-                      err = st.func + " requires numeric field: " + st.field;
-                      return false;
-                  }
-                  st.sum += num;
-                  st.count++;
-              } else if (st.func == "MIN" || st.func == "MAX") {
-                  std::string v;
-                  if (!GetFieldValue(combinedSchema, r, st.field, v)) {
-                      err = st.func + " field not found: " + st.field;
-                      return false;
-                  }
-                  if (!st.hasVal) {
-                      st.minVal = v;
-                      st.maxVal = v;
-                      st.hasVal = true;
-                  } else {
-                      if (lessValue(v, st.minVal)) st.minVal = v;
-                      if (lessValue(st.maxVal, v)) st.maxVal = v;
-                  }
-              }
-          }
+          if (!agg.Add(r, err)) return false;
       }
-
-      TableSchema outSchema;
-      for (const auto& sel : plan.selectExprs) {
-          Field f;
-          if (!sel.alias.empty()) f.name = sel.alias;
-          else if (sel.isAggregate) {
-              f.name = sel.agg.func + "(" + sel.agg.field + ")";
-          } else {
-              f.name = sel.field;
-          }
-          outSchema.fields.push_back(f);
-      }
-
-      std::vector<Record> aggOut;
-      for (const auto& kv : groups) {
-          const GroupData& gd = kv.second;
-          Record rec;
-          rec.valid = true;
-          size_t aggIndex = 0;
-          for (const auto& sel : plan.selectExprs) {
-              if (sel.isAggregate) {
-                  const AggState& st = gd.aggs[aggIndex++];
-                  if (st.func == "COUNT") rec.values.push_back(std::to_string(st.count));
-                  else if (st.func == "SUM") rec.values.push_back(std::to_string(st.sum));
-                  else if (st.func == "AVG") {
-                      if (st.count == 0) rec.values.push_back("NULL");
-                      else rec.values.push_back(std::to_string(st.sum / st.count));
-                  } else if (st.func == "MIN") rec.values.push_back(st.hasVal ? st.minVal : "NULL");
-                  else if (st.func == "MAX") rec.values.push_back(st.hasVal ? st.maxVal : "NULL");
-                  else rec.values.push_back("NULL");
-              } else {
-                  auto itv = gd.groupVals.find(Lower(sel.field));
-                  if (itv != gd.groupVals.end()) rec.values.push_back(itv->second);
-                  else rec.values.push_back("NULL");
-              }
-          }
-          aggOut.push_back(rec);
-      }
-
-      // Apply HAVING filter
-      if (!plan.havingConditions.empty()) {
-          // Build a temporary schema that maps aggregate expressions to their field names
-          TableSchema havingSchema;
-          for (const auto& sel : plan.selectExprs) {
-              Field f;
-              if (sel.isAggregate) {
-                  // Add field with aggregate expression name like "COUNT(*)"
-                  f.name = sel.agg.func + "(" + sel.agg.field + ")";
-                  havingSchema.fields.push_back(f);
-              } else {
-                  // Add field with actual name
-                  f.name = sel.field;
-                  havingSchema.fields.push_back(f);
-              }
-          }
-          
-          std::vector<Record> havingFiltered;
-          for (const auto& rec : aggOut) {
-              if (MatchConditions(havingSchema, rec, plan.havingConditions, datPath, dbfPath)) {
-                  havingFiltered.push_back(rec);
-              }
-          }
-          aggOut = havingFiltered;
-      }
-
-      if (!plan.orderBy.empty()) {
-          std::map<std::string, std::string> aliasMap;
-          for (const auto& sel : plan.selectExprs) {
-              std::string name = sel.alias.empty() ? (sel.isAggregate ? sel.agg.func + "(" + sel.agg.field + ")" : sel.field) : sel.alias;
-              if (!sel.alias.empty()) {
-                  aliasMap[Lower(sel.field)] = name;
-                  aliasMap[Lower(sel.alias)] = name;
-              }
-              if (sel.isAggregate) {
-                  std::string exprName = sel.agg.func + "(" + sel.agg.field + ")";
-                  aliasMap[Lower(exprName)] = name;
-              }
-          }
-
-          for (const auto& ob : plan.orderBy) {
-              std::string field = ob.first;
-              auto it = aliasMap.find(Lower(field));
-              if (it != aliasMap.end()) field = it->second;
-              if (!FieldExists(outSchema, field)) {
-                  err = "ORDER BY field not found: " + ob.first;
-                  return false;
-              }
-          }
-
-          auto asNumber = [](const std::string& s, double& out) {
-              try { size_t i = 0; out = std::stod(s, &i); return i == s.size(); } catch (...) { return false; }
-          };
-
-          auto cmp = [&](const Record& a, const Record& b) {
-              for (const auto& ob : plan.orderBy) {
-                  std::string av, bv;
-                  GetFieldValueForOrder(outSchema, a, ob.first, aliasMap, av);
-                  GetFieldValueForOrder(outSchema, b, ob.first, aliasMap, bv);
-
-                  double an = 0, bn = 0;
-                  bool aNum = asNumber(av, an);
-                  bool bNum = asNumber(bv, bn);
-
-                  if (aNum && bNum) {
-                      if (std::abs(an - bn) < 1e-9) continue;
-                      return ob.second ? (an < bn) : (an > bn);
-                  }
-                  if (av == bv) continue;
-                  return ob.second ? (av < bv) : (av > bv);
-              }
-              return false;
-          };
-
-          std::sort(aggOut.begin(), aggOut.end(), cmp);
-      }
-
-      out = aggOut;
-      return true;
+      return finishAggregate(agg);
   }
 
-  if (!plan.orderBy.empty()) {
-      std::map<std::string, std::string> aliasMap;
-      for (size_t i = 0; i < plan.projection.size(); ++i) {
-          if (i < plan.projectionAliases.size() && !plan.projectionAliases[i].empty()) {
-              aliasMap[Lower(plan.projectionAliases[i])] = plan.projection[i];
-          }
-      }
-
-      for (const auto& ob : plan.orderBy) {
-          std::string field = ob.first;
-          auto it = aliasMap.find(Lower(field));
-          if (it != aliasMap.end()) field = it->second;
-          if (!FieldExists(combinedSchema, field)) {
-              err = "ORDER BY field not found: " + ob.first;
-              return false;
-          }
-      }
-
-      auto asNumber = [](const std::string& s, double& out) {
-          try { size_t i = 0; out = std::stod(s, &i); return i == s.size(); } catch (...) { return false; }
-      };
-
-      auto cmp = [&](const Record& a, const Record& b) {
-          for (const auto& ob : plan.orderBy) {
-              std::string av, bv;
-              GetFieldValueForOrder(combinedSchema, a, ob.first, aliasMap, av);
-              GetFieldValueForOrder(combinedSchema, b, ob.first, aliasMap, bv);
-
-              double an = 0, bn = 0;
-              bool aNum = asNumber(av, an);
-              bool bNum = asNumber(bv, bn);
-
-              if (aNum && bNum) {
-                  if (std::abs(an - bn) < 1e-9) continue;
-                  return ob.second ? (an < bn) : (an > bn);
-              }
-              if (av == bv) continue;
-              return ob.second ? (av < bv) : (av > bv);
-          }
-          return false;
-      };
-
-      std::sort(matchedRows.begin(), matchedRows.end(), cmp);
-  }
+  if (!plan.orderBy.empty() && !sortRows(matchedRows)) return false;
 
   for (const auto& r : matchedRows) out.push_back(Project(combinedSchema, r, effectiveProjection));
   return true;
@@ -1,9 +1,12 @@
 #pragma once
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "db_types.h"
 #include "storage_engine.h"
 #include "txn/txn_types.h"
+#include "value.h"
 
 class LockManager;
 
@@ -16,9 +19,34 @@ class QueryService {
 
  private:
   StorageEngine& engine_;
-  bool MatchConditions(const TableSchema& schema, const Record& rec, const std::vector<Condition>& conds, const std::string& datPath, const std::string& dbfPath);
-  bool MatchConditions(const TableSchema& schema, const Record& rec, const std::vector<Condition>& conds, const std::string& datPath, const std::string& dbfPath, const Record* outerRec, const TableSchema* outerSchema);
+
+  // A WHERE/HAVING condition resolved against one schema: field slot, column
+  // kind and literal operands are worked out once per statement, not per row.
+  struct BoundCondition {
+    const Condition* cond = nullptr;
+    int field = -1;
+    ColumnKind kind = ColumnKind::kText;
+    bool hasOp = false;
+    CompareOp op = CompareOp::kEq;
+    Value operand;            // normalized literal; views the plan's strings
+    std::vector<Value> list;  // IN values / BETWEEN bounds
+  };
+  std::vector<BoundCondition> Bind(const TableSchema& schema, const std::vector<Condition>& conds) const;
+  // Row is Record or RecordView.
+  template <typename Row>
+  bool MatchBound(const Row& rec, const std::vector<BoundCondition>& conds, const std::string& datPath, const std::string& dbfPath,
+                  const Record* outerRec = nullptr, const TableSchema* outerSchema = nullptr);
+  // Indices of the rows of a columnar chunk that pass conds. Conditions on
+  // dictionary columns run once per distinct value and rows test their code.
+  void FilterChunk(const ColumnChunk& chunk, const std::vector<BoundCondition>& conds, const std::string& datPath,
+                   const std::string& dbfPath, std::vector<uint32_t>& rows);
+  // Range conditions (=, <, <=, >, >=, BETWEEN, IN) against a zone's
+  // bounds and Bloom filters: false only when no row of the zone can pass
+  // them all.
+  static bool ZoneMayMatch(const std::vector<BoundCondition>& conds, const std::vector<ColumnZone>& zone);
+  static bool UsesZones(const BoundCondition& b);
   Record Project(const TableSchema& schema, const Record& rec, const std::vector<std::string>& projection) const;
+  Record Project(const TableSchema& schema, const RecordView& rec, const std::vector<std::string>& projection) const;
   
   // Helper to execute subquery
   bool ExecuteSubQuery(const std::string& datPath, const std::string& dbfPath, const QueryPlan& plan, std::vector<Record>& out, std::string& err);
@@ -0,0 +1,69 @@
+#include "append_writer.h"
+#include "block_directory.h"
+#include "file_handle_cache.h"
+
+#include <algorithm>
+#include <limits>
+
+bool AppendWriter::Prepare(uint64_t& at, std::string& err) {
+  // The handle cache keeps the descriptor open; a replaced or removed file
+  // comes back as a new handle, which starts its own reservation.
+  file_ = FileHandleCache::Instance().Open(path_, true, err);
+  if (!file_) {
+    err = "Cannot open dat file for append: " + path_;
+    return false;
+  }
+  if (reservedFor_.lock() != file_) {
+    reservedFor_ = file_;
+    reserved_ = 0;
+  }
+  if (!file_->Size(at_)) {
+    err = "Cannot stat dat file: " + path_;
+    return false;
+  }
+  const uint64_t end = at_ + buf_.size();
+  if (end > reserved_) {
+    // Grow with the file so large tables take few, large extents.
+    const uint64_t ahead = std::min(kMaxReserve, std::max(kMinReserve, at_ / 8));
+    const uint64_t from = std::max(at_, reserved_);
+    // Unsupported here: stop asking for this file.
+    reserved_ = file_->Reserve(from, end + ahead - from) ? end + ahead : std::numeric_limits<uint64_t>::max();
+  }
+  at = at_;
+  return true;
+}
+
+bool AppendWriter::Write(std::string& err) {
+  const bool ok = file_ && file_->WriteAt(at_, buf_.data(), buf_.size());
+  if (!ok) {
+    file_.reset();
+    err = "Append failed: " + path_;
+  }
+  return ok;
+}
+
+void AppendWriter::Register(const BlockEntry& entry) {
+  std::string ignore;
+  auto sidecar = FileHandleCache::Instance().Open(BlockDirectory::PathFor(path_), false, ignore);
+  // The remembered tail holds while the block lands right after it, on the
+  // same data file: anything else writing there would have moved the end.
+  if (sidecar && sidecar == sidecar_.lock() && file_ == tailFor_.lock() && entry.offset == covered_) {
+    const uint64_t end = BlockDirectory::AppendAt(*sidecar, sidecarEnd_, entry);
+    if (end != 0) {
+      sidecarEnd_ = end;
+      covered_ = entry.offset + entry.length;
+      file_.reset();
+      return;
+    }
+  }
+  sidecar_.reset();
+  if (BlockDirectory::Append(path_, entry)) {
+    sidecar = FileHandleCache::Instance().Open(BlockDirectory::PathFor(path_), false, ignore);
+    if (sidecar && sidecar->Size(sidecarEnd_)) {
+      sidecar_ = sidecar;
+      tailFor_ = file_;
+      covered_ = entry.offset + entry.length;
+    }
+  }
+  file_.reset();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FileHandle;
+struct BlockEntry;
+
+// Appends whole blocks to one data file. The block is built in a buffer
+// reused across appends and goes out in one positioned write at the end of
+// file; disk extents are reserved ahead of that end without changing the
+// file size, so readers never see the reservation.
+// The writer also remembers where the block directory ends, so registering
+// a block is one write while nothing else touches the file.
+// Hold mutex() from filling buffer() through Register().
+class AppendWriter {
+ public:
+  explicit AppendWriter(std::string path) : path_(std::move(path)) {}
+
+  std::mutex& mutex() { return mu_; }
+  std::vector<uint8_t>& buffer() { return buf_; }
+  // at = where buffer() will land (the end of file).
+  bool Prepare(uint64_t& at, std::string& err);
+  // Write buffer() at the offset Prepare returned.
+  bool Write(std::string& err);
+  // Add the written block to the data file's block directory.
+  void Register(const BlockEntry& entry);
+
+ private:
+  static constexpr uint64_t kMinReserve = 1 << 20;
+  static constexpr uint64_t kMaxReserve = 16 << 20;
+
+  std::string path_;
+  std::mutex mu_;
+  std::vector<uint8_t> buf_;
+  std::shared_ptr<FileHandle> file_;       // between Prepare and Register
+  uint64_t at_ = 0;
+  std::weak_ptr<FileHandle> reservedFor_;  // reserved_ is about this descriptor's file
+  uint64_t reserved_ = 0;                  // extents allocated up to here
+  std::weak_ptr<FileHandle> tailFor_;      // data descriptor the tail below is about
+  std::weak_ptr<FileHandle> sidecar_;
+  uint64_t sidecarEnd_ = 0;
+  uint64_t covered_ = 0;                   // end of the sidecar's last block
+};
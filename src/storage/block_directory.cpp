@@ -0,0 +1,333 @@
+#include "block_directory.h"
+#include "crc32c.h"
+#include "file_handle_cache.h"
+#include "record_codec.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <sstream>
+
+namespace {
+constexpr uint32_t kMagic = 0x4B424244;  // "DBBK"
+constexpr uint32_t kVersion = 2;  // 1: entries without crc
+constexpr uint64_t kHeaderSize = 8;
+constexpr uint64_t kEntrySize = 28;
+constexpr uint64_t kCrcAt = 24;  // within an entry
+constexpr char kTableSep = '~';
+
+template <typename T>
+void WritePod(std::ostream& os, T v) {
+  os.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+bool ReadPod(std::istream& is, T& v) {
+  is.read(reinterpret_cast<char*>(&v), sizeof(T));
+  return static_cast<bool>(is);
+}
+
+void WriteEntry(std::ostream& os, const BlockEntry& e) {
+  WritePod(os, e.table_id);
+  WritePod(os, e.record_count);
+  WritePod(os, e.offset);
+  WritePod(os, e.length);
+  WritePod(os, e.crc);
+}
+
+bool ReadEntry(std::istream& is, BlockEntry& e, uint32_t version = kVersion) {
+  e.crc = 0;
+  return ReadPod(is, e.table_id) && ReadPod(is, e.record_count) &&
+         ReadPod(is, e.offset) && ReadPod(is, e.length) &&
+         (version < 2 || ReadPod(is, e.crc));
+}
+
+uint64_t EntrySize(uint32_t version) { return version < 2 ? 24 : kEntrySize; }
+
+// Sidecar version, 0 when the header is missing or foreign.
+uint32_t ReadVersion(FileHandle& file) {
+  char buf[kHeaderSize];
+  size_t got = 0;
+  if (!file.ReadAt(0, buf, sizeof(buf), got) || got != sizeof(buf)) return 0;
+  std::istringstream is(std::string(buf, sizeof(buf)));
+  uint32_t magic = 0, version = 0;
+  if (!ReadPod(is, magic) || !ReadPod(is, version) || magic != kMagic) return 0;
+  return version == 1 || version == kVersion ? version : 0;
+}
+
+bool ReadEntryAt(FileHandle& file, uint64_t index, BlockEntry& e) {
+  std::string buf(kEntrySize, '\0');
+  size_t got = 0;
+  if (!file.ReadAt(kHeaderSize + index * kEntrySize, &buf[0], buf.size(), got) || got != buf.size()) return false;
+  std::istringstream is(buf);
+  return ReadEntry(is, e);
+}
+
+// Index of the current-version entry holding offset: entries are contiguous
+// and ordered, so a binary search over positioned reads.
+bool FindEntry(FileHandle& file, uint64_t offset, uint64_t& index, BlockEntry& out) {
+  uint64_t size = 0;
+  if (!file.Size(size) || size < kHeaderSize) return false;
+  uint64_t lo = 0, hi = (size - kHeaderSize) / kEntrySize;
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    BlockEntry e;
+    if (!ReadEntryAt(file, mid, e)) return false;
+    if (offset < e.offset) {
+      hi = mid;
+    } else if (offset >= e.offset + e.length) {
+      lo = mid + 1;
+    } else {
+      index = mid;
+      out = e;
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+uint32_t BlockDirectory::TableId(const std::string& table_name) {
+  // FNV-1a; collisions are resolved by the name stored in each block header.
+  uint32_t h = 2166136261u;
+  for (unsigned char c : table_name) {
+    h ^= c;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+std::string BlockDirectory::PathFor(const std::string& data_path) {
+  std::filesystem::path p = data_path;
+  p.replace_extension(".blk");
+  return p.string();
+}
+
+bool BlockDirectory::Load(const std::string& data_path, std::vector<BlockEntry>& out, std::string& err) {
+  out.clear();
+  std::error_code ec;
+  uint64_t data_size = std::filesystem::file_size(data_path, ec);
+  if (ec) return true;  // no data file yet
+
+  // Whole sidecar in one positioned read through the cached handle.
+  std::string ignore;
+  auto file = FileHandleCache::Instance().Open(PathFor(data_path), false, ignore);
+  uint64_t size = 0;
+  std::string bytes;
+  if (file && file->Size(size)) {
+    bytes.resize(static_cast<size_t>(size));
+    size_t got = 0;
+    if (!file->ReadAt(0, &bytes[0], bytes.size(), got)) got = 0;
+    bytes.resize(got);
+  }
+  std::istringstream ifs(bytes);
+  bool ok = false;
+  if (!bytes.empty()) {
+    uint32_t magic = 0, version = 0;
+    if (ReadPod(ifs, magic) && ReadPod(ifs, version) && magic == kMagic && (version == 1 || version == kVersion)) {
+      uint64_t covered = 0;
+      ok = true;
+      BlockEntry e;
+      while (ifs.peek() != EOF) {
+        if (!ReadEntry(ifs, e, version) || e.offset != covered) { ok = false; break; }
+        covered += e.length;
+        out.push_back(e);
+      }
+      ok = ok && covered == data_size;
+      if (ok && version != kVersion) Rewrite(data_path, out, ignore);
+    }
+  }
+  if (ok) return true;
+  return Rebuild(data_path, out, err);
+}
+
+bool BlockDirectory::Append(const std::string& data_path, const BlockEntry& entry) {
+  std::string ignore;
+  auto file = FileHandleCache::Instance().Open(PathFor(data_path), false, ignore);
+  if (!file) {
+    // First block of a new file starts the sidecar; otherwise Load rebuilds it.
+    return entry.offset == 0 && Rewrite(data_path, {entry}, ignore);
+  }
+
+  uint64_t size = 0;
+  const uint32_t version = ReadVersion(*file);
+  if (version == 1 && file->Size(size) && (size - kHeaderSize) % EntrySize(1) == 0) {
+    // Upgrade in place, keeping every entry.
+    std::string bytes(static_cast<size_t>(size), '\0');
+    size_t got = 0;
+    std::vector<BlockEntry> entries;
+    if (file->ReadAt(0, &bytes[0], bytes.size(), got) && got == bytes.size()) {
+      std::istringstream is(bytes.substr(kHeaderSize));
+      BlockEntry e;
+      while (is.peek() != EOF && ReadEntry(is, e, 1)) entries.push_back(e);
+    }
+    if (entries.size() != (size - kHeaderSize) / EntrySize(1) || !Rewrite(data_path, entries, ignore)) {
+      Remove(data_path);
+      return false;
+    }
+  } else if (version != kVersion) {
+    Remove(data_path);
+    return false;
+  }
+  if (!file->Size(size) || size < kHeaderSize || (size - kHeaderSize) % kEntrySize != 0) {
+    Remove(data_path);
+    return false;
+  }
+  uint64_t covered = 0;
+  if (size > kHeaderSize) {
+    std::string tail(kEntrySize, '\0');
+    size_t got = 0;
+    if (!file->ReadAt(size - kEntrySize, &tail[0], tail.size(), got) || got != tail.size()) {
+      Remove(data_path);
+      return false;
+    }
+    std::istringstream is(tail);
+    BlockEntry last;
+    if (!ReadEntry(is, last)) {
+      Remove(data_path);
+      return false;
+    }
+    covered = last.offset + last.length;
+  }
+  if (entry.offset == covered) {
+    if (AppendAt(*file, size, entry) != 0) return true;
+    Remove(data_path);
+    return false;
+  }
+  if (entry.offset + entry.length <= covered) return false;
+  Remove(data_path);
+  return false;
+}
+
+uint64_t BlockDirectory::AppendAt(FileHandle& sidecar, uint64_t at, const BlockEntry& entry) {
+  std::ostringstream os;
+  WriteEntry(os, entry);
+  const std::string bytes = os.str();
+  return sidecar.WriteAt(at, bytes.data(), bytes.size()) ? at + bytes.size() : 0;
+}
+
+bool BlockDirectory::Rewrite(const std::string& data_path, const std::vector<BlockEntry>& entries, std::string& err) {
+  const std::string path = PathFor(data_path);
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open()) {
+    err = "Cannot write block directory: " + path;
+    return false;
+  }
+  WritePod(ofs, kMagic);
+  WritePod(ofs, kVersion);
+  for (const auto& e : entries) WriteEntry(ofs, e);
+  return static_cast<bool>(ofs);
+}
+
+void BlockDirectory::Remove(const std::string& data_path) {
+  FileHandleCache::Instance().Invalidate(PathFor(data_path));
+  std::error_code ec;
+  std::filesystem::remove(PathFor(data_path), ec);
+}
+
+std::unique_lock<std::mutex> BlockDirectory::LockSeals(const std::string& data_path) {
+  static std::array<std::mutex, 64> stripes;
+  return std::unique_lock<std::mutex>(stripes[std::hash<std::string>()(data_path) % stripes.size()]);
+}
+
+void BlockDirectory::Unseal(const std::string& data_path, uint64_t offset, uint64_t length) {
+  std::string ignore;
+  auto file = FileHandleCache::Instance().Open(PathFor(data_path), false, ignore);
+  if (!file || ReadVersion(*file) != kVersion) return;  // nothing sealed
+  uint64_t index = 0;
+  BlockEntry e;
+  if (!FindEntry(*file, offset, index, e)) return;
+  const uint64_t end = offset + std::max<uint64_t>(length, 1);
+  const uint32_t zero = 0;
+  do {
+    if (e.crc != 0 && !file->WriteAt(kHeaderSize + index * kEntrySize + kCrcAt, &zero, sizeof(zero))) {
+      Remove(data_path);
+      return;
+    }
+    if (e.offset + e.length >= end) return;
+  } while (ReadEntryAt(*file, ++index, e));
+}
+
+void BlockDirectory::Reseal(const std::string& data_path, const std::vector<std::pair<uint64_t, uint64_t>>& ranges) {
+  std::string ignore;
+  auto file = FileHandleCache::Instance().Open(PathFor(data_path), false, ignore);
+  if (!file || ReadVersion(*file) != kVersion) return;
+  auto data = FileHandleCache::Instance().Open(data_path, false, ignore);
+  if (!data) return;
+  std::vector<char> buf(1 << 16);
+  uint64_t sealed_to = 0;  // ranges may share a block; checksum it once
+  for (const auto& r : ranges) {
+    uint64_t index = 0;
+    BlockEntry e;
+    if (!FindEntry(*file, r.first, index, e)) continue;
+    const uint64_t end = r.first + std::max<uint64_t>(r.second, 1);
+    do {
+      if (e.offset + e.length <= sealed_to) continue;
+      uint32_t crc = 0;
+      for (uint64_t pos = e.offset; pos < e.offset + e.length;) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(buf.size(), e.offset + e.length - pos));
+        size_t got = 0;
+        if (!data->ReadAt(pos, buf.data(), n, got) || got != n) return;  // left unsealed
+        crc = Crc32c(buf.data(), n, crc);
+        pos += n;
+      }
+      if (!file->WriteAt(kHeaderSize + index * kEntrySize + kCrcAt, &crc, sizeof(crc))) {
+        Remove(data_path);
+        return;
+      }
+      sealed_to = e.offset + e.length;
+    } while (e.offset + e.length < end && ReadEntryAt(*file, ++index, e));
+  }
+}
+
+bool BlockDirectory::Lookup(const std::string& data_path, uint64_t offset, BlockEntry& out) {
+  std::string ignore;
+  auto file = FileHandleCache::Instance().Open(PathFor(data_path), false, ignore);
+  uint64_t index = 0;
+  return file && ReadVersion(*file) == kVersion && FindEntry(*file, offset, index, out) && out.offset == offset;
+}
+
+bool BlockDirectory::Rebuild(const std::string& data_path, std::vector<BlockEntry>& out, std::string& err) {
+  out.clear();
+  std::ifstream ifs(data_path, std::ios::binary);
+  if (!ifs.is_open()) {
+    err = "Cannot open dat file: " + data_path;
+    return false;
+  }
+  while (ifs.peek() != EOF) {
+    BlockEntry e;
+    e.offset = static_cast<uint64_t>(ifs.tellg());
+    char sep = 0;
+    ifs.read(&sep, 1);
+    if (!ifs || sep != kTableSep) {
+      err = "Invalid separator in dat";
+      return false;
+    }
+    uint32_t name_len = 0, field_count = 0;
+    std::string name;
+    bool ok = ReadPod(ifs, name_len);
+    if (ok) {
+      name.resize(name_len);
+      if (name_len > 0) ifs.read(&name[0], name_len);
+      ok = ReadPod(ifs, e.record_count) && ReadPod(ifs, field_count);
+    }
+    for (uint32_t i = 0; ok && i < e.record_count; ++i) {
+      ifs.ignore(1);
+      for (uint32_t j = 0; ifs.good() && j < field_count; ++j) {
+        uint32_t len = 0;
+        if (ReadPod(ifs, len) && (len &= ~RecordCodec::kOverflowBit) > 0) ifs.ignore(len);
+      }
+      ok = !ifs.fail() && !ifs.eof();  // ignore() past EOF sets only eofbit
+    }
+    if (!ok) {
+      err = "Truncated block in dat: " + data_path;
+      return false;
+    }
+    e.table_id = TableId(name);
+    e.length = static_cast<uint64_t>(ifs.tellg()) - e.offset;
+    out.push_back(e);
+  }
+  return Rewrite(data_path, out, err);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class FileHandle;
+
+// One entry per block of a data file ('~' header + records).
+struct BlockEntry {
+  uint32_t table_id = 0;      // BlockDirectory::TableId(table name)
+  uint32_t record_count = 0;
+  uint64_t offset = 0;        // position of the block header
+  uint64_t length = 0;        // header + record bytes
+  uint32_t crc = 0;           // CRC32C of the block as written; 0 = unsealed
+};
+
+// Sidecar "<data>.blk" listing the blocks of a data file, so scans can seek
+// from one relevant block to the next without parsing foreign ones.
+// A missing or stale sidecar is rebuilt from the data file on Load.
+// A block written whole is sealed with its checksum; a write into it
+// unseals it first and reseals it from the file once the bytes are down.
+// Rebuilt entries and those of version 1 sidecars, upgraded on first touch,
+// are unsealed.
+class BlockDirectory {
+ public:
+  static uint32_t TableId(const std::string& table_name);
+  static std::string PathFor(const std::string& data_path);
+
+  static bool Load(const std::string& data_path, std::vector<BlockEntry>& out, std::string& err);
+  // Register a block just written to the data file. Blocks that are already
+  // covered (WAL redo) are ignored; anything else invalidates the sidecar.
+  // True when the sidecar now ends with entry.
+  static bool Append(const std::string& data_path, const BlockEntry& entry);
+  // Append for a caller that already knows the sidecar ends at `at` with a
+  // block ending at entry.offset; returns the new end, 0 on failure.
+  static uint64_t AppendAt(FileHandle& sidecar, uint64_t at, const BlockEntry& entry);
+  static bool Rewrite(const std::string& data_path, const std::vector<BlockEntry>& entries, std::string& err);
+  static void Remove(const std::string& data_path);
+  // Held across Unseal, the writes and Reseal, so that a block is never
+  // sealed over bytes another writer is still changing.
+  static std::unique_lock<std::mutex> LockSeals(const std::string& data_path);
+  // Clear the checksum of every block overlapping [offset, offset + length).
+  // Call before the bytes change in the data file.
+  static void Unseal(const std::string& data_path, uint64_t offset, uint64_t length);
+  // Checksum again, from the data file, every block overlapping one of the
+  // (offset, length) ranges, given in file order. Call after the bytes are written.
+  static void Reseal(const std::string& data_path, const std::vector<std::pair<uint64_t, uint64_t>>& ranges);
+  // Current entry of the block starting at offset; false if there is none.
+  static bool Lookup(const std::string& data_path, uint64_t offset, BlockEntry& out);
+
+ private:
+  static bool Rebuild(const std::string& data_path, std::vector<BlockEntry>& out, std::string& err);
+};
@@ -0,0 +1,377 @@
+#include "buffer_pool.h"
+#include "block_directory.h"
+#include "file_handle_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+BufferPool::PageRef& BufferPool::PageRef::operator=(PageRef&& o) noexcept {
+  if (this != &o) {
+    Release();
+    pool_ = o.pool_;
+    frame_ = o.frame_;
+    o.pool_ = nullptr;
+    o.frame_ = nullptr;
+  }
+  return *this;
+}
+
+void BufferPool::PageRef::MarkDirty(uint64_t lsn) {
+  std::lock_guard<std::mutex> lock(pool_->mu_);
+  if (frame_->path.empty()) return;  // invalidated while pinned
+  frame_->dirty = true;
+  frame_->lsn = std::max(frame_->lsn, lsn);
+}
+
+void BufferPool::PageRef::Release() {
+  if (pool_ && frame_) pool_->Unpin(frame_);
+  pool_ = nullptr;
+  frame_ = nullptr;
+}
+
+BufferPool::BufferPool(size_t capacity_bytes)
+    : capacity_(std::max<size_t>(16, capacity_bytes / kPageSize)) {}
+
+void BufferPool::SetWalFlusher(WalFlusher flusher) {
+  std::lock_guard<std::mutex> lock(mu_);
+  wal_flusher_ = std::move(flusher);
+}
+
+bool BufferPool::Fetch(const std::string& path, uint64_t page, const std::string& wal_key, PageRef& out, std::string& err,
+                       bool checksummed) {
+  std::unique_lock<std::mutex> lock(mu_);
+  const Key key(path, page);
+  while (true) {
+    auto it = table_.find(key);
+    if (it != table_.end()) {
+      Frame* f = it->second;
+      if (f->loading) {
+        ++f->pins;
+        f->io_done.wait(lock, [f] { return !f->loading; });
+        --f->pins;
+        continue;  // the read may have failed and dropped the frame
+      }
+      ++hits_;
+      f->checksummed = f->checksummed || checksummed;
+      ++f->pins;
+      f->ref = true;
+      out = PageRef(this, f);
+      return true;
+    }
+
+    Frame* f = Victim(lock, err);
+    if (!f) return false;
+    if (table_.count(key)) continue;  // read in by another thread while lock was released
+    ++misses_;
+    f->path = path;
+    f->page = page;
+    f->wal_key = wal_key;
+    f->checksummed = checksummed;
+    f->dirty = false;
+    f->lsn = 0;
+    f->pins = 1;
+    f->ref = true;
+    f->loading = true;
+    table_[key] = f;
+    lock.unlock();
+    const bool ok = LoadFrame(*f, err);
+    lock.lock();
+    f->loading = false;
+    f->io_done.notify_all();
+    if (!ok) {
+      --f->pins;
+      Drop(f);
+      return false;
+    }
+    out = PageRef(this, f);
+    return true;
+  }
+}
+
+void BufferPool::Prefetch(const std::string& path, std::vector<uint64_t> pages, const std::string& wal_key,
+                          bool checksummed) {
+  std::sort(pages.begin(), pages.end());
+  pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+  std::unique_lock<std::mutex> lock(mu_);
+  std::vector<Frame*> claimed;
+  std::string err;
+  for (uint64_t page : pages) {
+    if (claimed.size() >= capacity_ / 2) break;  // leave frames for what the caller pins
+    if (table_.count(Key(path, page))) continue;
+    Frame* f = Victim(lock, err);
+    if (!f) break;
+    if (table_.count(Key(path, page))) continue;
+    f->path = path;
+    f->page = page;
+    f->wal_key = wal_key;
+    f->checksummed = checksummed;
+    f->dirty = false;
+    f->lsn = 0;
+    f->pins = 1;  // no victim while the batch is read
+    f->loading = true;
+    table_[Key(path, page)] = f;
+    claimed.push_back(f);
+  }
+  if (claimed.empty()) return;
+  misses_ += claimed.size();
+  lock.unlock();
+
+  std::vector<IoRead> reads(claimed.size());
+  for (size_t i = 0; i < claimed.size(); ++i) {
+    claimed[i]->data.assign(kPageSize, 0);
+    reads[i].offset = claimed[i]->page * kPageSize;
+    reads[i].dst = claimed[i]->data.data();
+    reads[i].len = kPageSize;
+  }
+  auto file = FileHandleCache::Instance().Open(path, false, err);
+  const bool ok = file && file->ReadBatch(reads);
+  std::vector<bool> loaded(claimed.size());
+  for (size_t i = 0; i < claimed.size(); ++i) loaded[i] = ok && Loaded(*claimed[i], reads[i].got, err);
+
+  lock.lock();
+  for (size_t i = 0; i < claimed.size(); ++i) {
+    Frame* f = claimed[i];
+    f->pins = 0;
+    f->loading = false;
+    f->io_done.notify_all();
+    if (!loaded[i]) {
+      Drop(f);
+      continue;
+    }
+    f->ref = true;
+  }
+}
+
+bool BufferPool::FlushFile(const std::string& path, std::string& err) {
+  std::unique_lock<std::mutex> lock(mu_);
+  std::vector<Frame*> dirty = Settled(lock, [&](std::vector<Frame*>& out) {
+    for (auto it = table_.lower_bound(Key(path, 0)); it != table_.end() && it->first.first == path; ++it) {
+      if (it->second->dirty || it->second->writing) out.push_back(it->second);
+    }
+  });
+  dirty.erase(std::remove_if(dirty.begin(), dirty.end(), [](const Frame* f) { return !f->dirty; }), dirty.end());
+  return WriteBack(lock, dirty, err);
+}
+
+bool BufferPool::FlushAll(std::string& err) {
+  std::unique_lock<std::mutex> lock(mu_);
+  std::vector<Frame*> dirty = Settled(lock, [&](std::vector<Frame*>& out) {
+    for (auto& kv : table_) {
+      if (kv.second->dirty || kv.second->writing) out.push_back(kv.second);
+    }
+  });
+  dirty.erase(std::remove_if(dirty.begin(), dirty.end(), [](const Frame* f) { return !f->dirty; }), dirty.end());
+  return WriteBack(lock, dirty, err);
+}
+
+bool BufferPool::Invalidate(const std::string& path, uint64_t first_page, std::string& err) {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    std::vector<Frame*> victims = Settled(lock, [&](std::vector<Frame*>& out) {
+      for (auto it = table_.lower_bound(Key(path, first_page)); it != table_.end() && it->first.first == path; ++it) {
+        out.push_back(it->second);
+      }
+    });
+    std::vector<Frame*> dirty;
+    for (Frame* f : victims) if (f->dirty) dirty.push_back(f);
+    // Dropped only once clean with the lock held throughout.
+    if (dirty.empty()) {
+      for (Frame* f : victims) Drop(f);
+      return true;
+    }
+    if (!WriteBack(lock, dirty, err)) return false;
+  }
+}
+
+bool BufferPool::InvalidatePrefix(const std::string& dir, std::string& err) {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    std::vector<Frame*> victims = Settled(lock, [&](std::vector<Frame*>& out) {
+      for (auto& kv : table_) {
+        if (kv.first.first.compare(0, dir.size(), dir) == 0) out.push_back(kv.second);
+      }
+    });
+    std::vector<Frame*> dirty;
+    for (Frame* f : victims) if (f->dirty) dirty.push_back(f);
+    if (dirty.empty()) {
+      for (Frame* f : victims) Drop(f);
+      return true;
+    }
+    if (!WriteBack(lock, dirty, err)) return false;
+  }
+}
+
+std::vector<BufferPool::Frame*> BufferPool::Settled(std::unique_lock<std::mutex>& lock,
+                                                    const std::function<void(std::vector<Frame*>&)>& collect) {
+  while (true) {
+    std::vector<Frame*> frames;
+    collect(frames);
+    auto busy = std::find_if(frames.begin(), frames.end(), [](const Frame* f) { return f->loading || f->writing; });
+    if (busy == frames.end()) return frames;
+    Frame* f = *busy;
+    f->io_done.wait(lock, [f] { return !f->loading && !f->writing; });
+  }
+}
+
+bool BufferPool::LoadFrame(Frame& f, std::string& err) {
+  f.data.assign(kPageSize, 0);
+  std::string openErr;
+  auto file = FileHandleCache::Instance().Open(f.path, false, openErr);
+  if (!file) {
+    err = "Cannot open dat file: " + f.path;
+    return false;
+  }
+  size_t got = 0;
+  if (!file->ReadAt(f.page * kPageSize, f.data.data(), kPageSize, got)) {
+    err = "Page read failed: " + f.path;
+    return false;
+  }
+  return Loaded(f, got, err);
+}
+
+bool BufferPool::Loaded(Frame& f, size_t got, std::string& err) {
+  f.valid_len = static_cast<uint32_t>(got);
+  if (f.valid_len == 0) {
+    err = "Page beyond end of file: " + f.path;
+    return false;
+  }
+  if (f.checksummed && f.valid_len == kPageSize && !PageChecksumOk(f.data.data())) {
+    err = "Checksum mismatch in page " + std::to_string(f.page) + " of " + f.path;
+    return false;
+  }
+  return true;
+}
+
+bool BufferPool::WriteBack(std::unique_lock<std::mutex>& lock, const std::vector<Frame*>& frames, std::string& err) {
+  if (frames.empty()) return true;
+  struct Out {
+    Frame* frame;
+    std::string path;
+    std::string wal_key;
+    uint64_t offset;
+    bool checksummed;
+    uint64_t lsn = 0;
+    std::vector<uint8_t> bytes;
+  };
+  std::vector<Out> outs;
+  outs.reserve(frames.size());
+  for (Frame* f : frames) {
+    outs.push_back({f, f->path, f->wal_key, f->page * kPageSize, f->checksummed});
+    f->writing = true;
+    ++f->pins;
+  }
+  const WalFlusher flusher = wal_flusher_;
+  lock.unlock();
+
+  // Copy each frame under its latch and take its LSN with it: a writer marks
+  // the frame dirty before releasing the latch, so the copy holds exactly the
+  // changes that LSN covers, and later ones dirty the frame again.
+  for (Out& o : outs) {
+    Frame* f = o.frame;
+    std::lock_guard<std::mutex> latch(f->latch);
+    o.bytes.assign(f->data.begin(), f->data.begin() + f->valid_len);
+    if (f->checksummed && f->valid_len == kPageSize) StampPageChecksum(o.bytes.data());
+    std::lock_guard<std::mutex> state(mu_);
+    o.lsn = f->lsn;
+    f->dirty = false;
+    f->lsn = 0;
+  }
+
+  // WAL rule: log records up to the frame LSN reach disk before the frame does.
+  std::map<std::string, uint64_t> horizon;
+  for (const Out& o : outs) {
+    if (o.lsn > 0) horizon[o.wal_key] = std::max(horizon[o.wal_key], o.lsn);
+  }
+  bool ok = true;
+  for (const auto& kv : horizon) {
+    if (ok && flusher) ok = flusher(kv.first, kv.second, err);
+  }
+
+  std::sort(outs.begin(), outs.end(), [](const Out& a, const Out& b) {
+    return a.path != b.path ? a.path < b.path : a.offset < b.offset;
+  });
+  size_t written = 0;
+  while (ok && written < outs.size()) {
+    const std::string& path = outs[written].path;
+    size_t end = written;
+    while (end < outs.size() && outs[end].path == path) ++end;
+    std::string openErr;
+    auto file = FileHandleCache::Instance().Open(path, false, openErr);
+    if (!file) {
+      err = "Cannot open dat file for write: " + path;
+      ok = false;
+      break;
+    }
+    // Row-format files: the blocks written into are sealed again afterwards.
+    const bool blocks = !outs[written].checksummed;
+    std::unique_lock<std::mutex> seals;
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    if (blocks) seals = BlockDirectory::LockSeals(path);
+    for (; written < end; ++written) {
+      const Out& o = outs[written];
+      if (blocks) {
+        BlockDirectory::Unseal(path, o.offset, o.bytes.size());
+        ranges.emplace_back(o.offset, o.bytes.size());
+      }
+      if (!file->WriteAt(o.offset, o.bytes.data(), o.bytes.size())) {
+        err = "Page write-back failed: " + path;
+        ok = false;
+        break;
+      }
+    }
+    if (blocks) BlockDirectory::Reseal(path, ranges);
+  }
+
+  lock.lock();
+  for (size_t i = 0; i < outs.size(); ++i) {
+    Frame* f = outs[i].frame;
+    if (i >= written) {
+      f->dirty = true;
+      f->lsn = std::max(f->lsn, outs[i].lsn);
+    }
+    f->writing = false;
+    --f->pins;
+    f->io_done.notify_all();
+  }
+  return ok;
+}
+
+BufferPool::Frame* BufferPool::Victim(std::unique_lock<std::mutex>& lock, std::string& err) {
+  if (frames_.size() < capacity_) {
+    frames_.push_back(std::make_unique<Frame>());
+    return frames_.back().get();
+  }
+  // CLOCK: clear reference bits until an unpinned, unreferenced frame turns up.
+  // A dirty one is written back and the sweep goes on: it may be wanted again by then.
+  for (size_t scanned = 0; scanned < 2 * frames_.size(); ++scanned) {
+    Frame* f = frames_[hand_].get();
+    hand_ = (hand_ + 1) % frames_.size();
+    if (f->pins > 0) continue;
+    if (f->path.empty()) return f;
+    if (f->ref) {
+      f->ref = false;
+      continue;
+    }
+    if (f->dirty) {
+      if (!WriteBack(lock, {f}, err)) return nullptr;
+      if (f->pins > 0 || f->dirty || f->ref) continue;
+    }
+    Drop(f);
+    return f;
+  }
+  err = "Buffer pool exhausted: all frames pinned";
+  return nullptr;
+}
+
+void BufferPool::Drop(Frame* f) {
+  table_.erase(Key(f->path, f->page));
+  f->path.clear();
+  f->dirty = false;
+  f->ref = false;
+  f->lsn = 0;
+}
+
+void BufferPool::Unpin(Frame* f) {
+  std::lock_guard<std::mutex> lock(mu_);
+  if (f->pins > 0) --f->pins;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "slotted_page.h"
+
+// Shared cache of kPageSize frames over data files (both row-format segments
+// and slotted-page files). CLOCK eviction, pin counts, dirty tracking.
+// A dirty frame remembers the highest WAL LSN that touched it; before it is
+// written back the WAL flusher must have made that LSN durable.
+// Frames of page files are checksummed: verified when read from disk,
+// stamped on the copy that is written back. Cached hits are not re-verified.
+// A miss reads its page, and write-back (eviction and flushes) runs the WAL
+// flush and the writes, with mu_ released: the frame is marked
+// loading/writing meanwhile, and only threads that need that frame wait for
+// it. Writers change a pinned frame under its latch and mark it dirty before
+// letting go; write-back copies the frame under the same latch.
+class BufferPool {
+ public:
+  // (wal key, lsn) -> make the WAL durable up to lsn
+  using WalFlusher = std::function<bool(const std::string& wal_key, uint64_t lsn, std::string& err)>;
+
+  struct Frame {
+    std::string path;           // empty = free
+    uint64_t page = 0;
+    std::string wal_key;
+    std::vector<uint8_t> data;  // kPageSize bytes
+    uint32_t valid_len = 0;     // bytes backed by the file (short for the tail page)
+    int pins = 0;
+    bool dirty = false;
+    bool ref = false;
+    uint64_t lsn = 0;
+    bool checksummed = false;   // whole pages carrying a page checksum
+    bool loading = false;       // being read in; data not valid yet
+    bool writing = false;       // being written back from a copy of data
+    std::condition_variable io_done;
+    std::mutex latch;           // taken before mu_, never while holding it
+  };
+
+  // Pinned frame; unpinned on destruction.
+  class PageRef {
+   public:
+    PageRef() = default;
+    PageRef(BufferPool* pool, Frame* frame) : pool_(pool), frame_(frame) {}
+    PageRef(PageRef&& o) noexcept { *this = std::move(o); }
+    PageRef& operator=(PageRef&& o) noexcept;
+    PageRef(const PageRef&) = delete;
+    PageRef& operator=(const PageRef&) = delete;
+    ~PageRef() { Release(); }
+
+    uint8_t* data() const { return frame_->data.data(); }
+    uint32_t valid_len() const { return frame_->valid_len; }
+    // Hold across changing data() and the MarkDirty that follows.
+    std::unique_lock<std::mutex> Latch() const { return std::unique_lock<std::mutex>(frame_->latch); }
+    void MarkDirty(uint64_t lsn);
+    void Release();
+
+   private:
+    BufferPool* pool_ = nullptr;
+    Frame* frame_ = nullptr;
+  };
+
+  explicit BufferPool(size_t capacity_bytes);
+
+  void SetWalFlusher(WalFlusher flusher);
+
+  bool Fetch(const std::string& path, uint64_t page, const std::string& wal_key, PageRef& out, std::string& err,
+             bool checksummed = false);
+
+  // Load the pages not cached yet in one batch (FileHandle::ReadBatch), so
+  // the Fetch calls that follow hit. Best effort: a page that fails to load
+  // is left for Fetch to report.
+  void Prefetch(const std::string& path, std::vector<uint64_t> pages, const std::string& wal_key,
+                bool checksummed = false);
+
+  // Write back dirty frames (WAL first).
+  bool FlushFile(const std::string& path, std::string& err);
+  bool FlushAll(std::string& err);
+  // Write back and forget frames of `path` from `first_page` on; call before
+  // the file is modified outside the pool (append, rewrite, remove).
+  bool Invalidate(const std::string& path, uint64_t first_page, std::string& err);
+  // Same for every file under a directory.
+  bool InvalidatePrefix(const std::string& dir, std::string& err);
+
+  size_t capacity() const { return capacity_; }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  using Key = std::pair<std::string, uint64_t>;
+
+  // Called without mu_ on a frame marked loading.
+  bool LoadFrame(Frame& f, std::string& err);
+  // Checks a frame after got bytes were read into it.
+  bool Loaded(Frame& f, size_t got, std::string& err);
+  // Writes settled dirty frames back with lock released; a frame changed
+  // meanwhile stays dirty.
+  bool WriteBack(std::unique_lock<std::mutex>& lock, const std::vector<Frame*>& frames, std::string& err);
+  // A free frame; lock may be released meanwhile to write a dirty one back.
+  Frame* Victim(std::unique_lock<std::mutex>& lock, std::string& err);
+  // The frames collect picks, once none of them has IO in flight.
+  std::vector<Frame*> Settled(std::unique_lock<std::mutex>& lock,
+                              const std::function<void(std::vector<Frame*>&)>& collect);
+  void Drop(Frame* f);
+  void Unpin(Frame* f);
+
+  size_t capacity_;
+  std::vector<std::unique_ptr<Frame>> frames_;
+  std::map<Key, Frame*> table_;
+  size_t hand_ = 0;
+  WalFlusher wal_flusher_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  std::mutex mu_;
+};
@@ -0,0 +1,59 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define DBMS_CRC32C_SSE42 1
+#endif
+
+namespace {
+constexpr uint32_t kPoly = 0x82F63B78;  // reflected Castagnoli polynomial
+
+struct Table {
+  uint32_t t[256];
+  Table() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ kPoly : c >> 1;
+      t[i] = c;
+    }
+  }
+};
+
+uint32_t Portable(const uint8_t* p, size_t len, uint32_t state) {
+  static const Table table;
+  while (len--) state = table.t[(state ^ *p++) & 0xFF] ^ (state >> 8);
+  return state;
+}
+
+#ifdef DBMS_CRC32C_SSE42
+__attribute__((target("sse4.2"))) uint32_t Hardware(const uint8_t* p, size_t len, uint32_t state) {
+  uint64_t s = state;
+  while (len >= 8) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    s = _mm_crc32_u64(s, v);
+    p += 8;
+    len -= 8;
+  }
+  uint32_t s32 = static_cast<uint32_t>(s);
+  while (len--) s32 = _mm_crc32_u8(s32, *p++);
+  return s32;
+}
+
+bool HasSse42() {
+  static const bool has = __builtin_cpu_supports("sse4.2");
+  return has;
+}
+#endif
+}  // namespace
+
+uint32_t Crc32c(const void* data, size_t len, uint32_t crc) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  const uint32_t state = ~crc;
+#ifdef DBMS_CRC32C_SSE42
+  if (HasSse42()) return ~Hardware(p, len, state);
+#endif
+  return ~Portable(p, len, state);
+}
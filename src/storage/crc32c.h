@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C (Castagnoli), the checksum of data pages and row blocks. Uses the
+// SSE4.2 crc32 instruction when the CPU has it, a table otherwise.
+// crc continues a previous result, so Crc32c(b, n, Crc32c(a, m)) is the
+// checksum of a followed by b.
+uint32_t Crc32c(const void* data, size_t len, uint32_t crc = 0);
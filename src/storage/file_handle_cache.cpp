@@ -0,0 +1,192 @@
+#include "file_handle_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+  #include <io.h>
+  #include <share.h>
+#else
+  #include <unistd.h>
+#endif
+
+namespace {
+#if defined(_WIN32)
+int OpenFd(const std::string& path, bool create) {
+  int fd = -1;
+  int flags = _O_RDWR | _O_BINARY | (create ? _O_CREAT : 0);
+  _sopen_s(&fd, path.c_str(), flags, _SH_DENYNO, _S_IREAD | _S_IWRITE);
+  return fd;
+}
+#else
+int OpenFd(const std::string& path, bool create) {
+  return ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+}
+#endif
+}  // namespace
+
+FileHandle::~FileHandle() {
+#if defined(_WIN32)
+  if (fd_ >= 0) _close(fd_);
+#else
+  if (fd_ >= 0) ::close(fd_);
+#endif
+}
+
+bool FileHandle::ReadAt(uint64_t offset, void* dst, size_t len, size_t& got) {
+  got = 0;
+  auto* out = static_cast<char*>(dst);
+#if defined(_WIN32)
+  std::lock_guard<std::mutex> lock(mu_);
+  if (_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+  while (got < len) {
+    int n = _read(fd_, out + got, static_cast<unsigned>(len - got));
+    if (n < 0) return false;
+    if (n == 0) break;
+    got += static_cast<size_t>(n);
+  }
+#else
+  while (got < len) {
+    ssize_t n = ::pread(fd_, out + got, len - got, static_cast<off_t>(offset + got));
+    if (n < 0) return false;
+    if (n == 0) break;
+    got += static_cast<size_t>(n);
+  }
+#endif
+  return true;
+}
+
+bool FileHandle::ReadBatch(std::vector<IoRead>& reads) {
+  if (reads.empty()) return true;
+  if (reads.size() > 1 && IoRing::Read(fd_, reads.data(), reads.size())) return true;
+  for (auto& r : reads) {
+    if (!ReadAt(r.offset, r.dst, r.len, r.got)) return false;
+  }
+  return true;
+}
+
+bool FileHandle::Readahead(uint64_t offset, uint64_t len) { return IoRing::Readahead(fd_, offset, len); }
+
+bool FileHandle::WriteAt(uint64_t offset, const void* src, size_t len) {
+  const auto* in = static_cast<const char*>(src);
+  size_t done = 0;
+#if defined(_WIN32)
+  std::lock_guard<std::mutex> lock(mu_);
+  if (_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+  while (done < len) {
+    int n = _write(fd_, in + done, static_cast<unsigned>(len - done));
+    if (n <= 0) return false;
+    done += static_cast<size_t>(n);
+  }
+#else
+  while (done < len) {
+    ssize_t n = ::pwrite(fd_, in + done, len - done, static_cast<off_t>(offset + done));
+    if (n <= 0) return false;
+    done += static_cast<size_t>(n);
+  }
+#endif
+  return true;
+}
+
+bool FileHandle::Append(const void* src, size_t len, uint64_t& outOffset) {
+#if defined(_WIN32)
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    __int64 end = _lseeki64(fd_, 0, SEEK_END);
+    if (end < 0) return false;
+    outOffset = static_cast<uint64_t>(end);
+  }
+  return WriteAt(outOffset, src, len);
+#else
+  std::lock_guard<std::mutex> lock(mu_);
+  if (!Size(outOffset)) return false;
+  return WriteAt(outOffset, src, len);
+#endif
+}
+
+bool FileHandle::Size(uint64_t& out) {
+#if defined(_WIN32)
+  struct _stat64 st;
+  if (_fstat64(fd_, &st) != 0) return false;
+#else
+  struct stat st;
+  if (::fstat(fd_, &st) != 0) return false;
+#endif
+  out = static_cast<uint64_t>(st.st_size);
+  return true;
+}
+
+bool FileHandle::Reserve(uint64_t offset, uint64_t len) {
+#if defined(__linux__)
+  return ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset), static_cast<off_t>(len)) == 0;
+#else
+  (void)offset;
+  (void)len;
+  return false;
+#endif
+}
+
+bool FileHandle::Sync() {
+#if defined(_WIN32)
+  return _commit(fd_) == 0;
+#else
+  return ::fsync(fd_) == 0;
+#endif
+}
+
+bool FileHandle::SyncDirectory(const std::string& path) {
+#if defined(_WIN32)
+  (void)path;
+  return true;
+#else
+  int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return false;
+  const bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+#endif
+}
+
+FileHandleCache& FileHandleCache::Instance() {
+  static FileHandleCache cache;
+  return cache;
+}
+
+std::shared_ptr<FileHandle> FileHandleCache::Open(const std::string& path, bool create, std::string& err) {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = open_.find(path);
+  if (it != open_.end()) {
+    it->second.lastUse = ++tick_;
+    return it->second.handle;
+  }
+
+  int fd = OpenFd(path, create);
+  if (fd < 0) {
+    err = "Cannot open file: " + path;
+    return nullptr;
+  }
+  if (open_.size() >= kMaxOpen) {
+    // Drop the least recently used entry; holders keep their descriptor.
+    auto lru = open_.begin();
+    for (auto e = open_.begin(); e != open_.end(); ++e) {
+      if (e->second.lastUse < lru->second.lastUse) lru = e;
+    }
+    open_.erase(lru);
+  }
+  Entry& e = open_[path];
+  e.handle.reset(new FileHandle(fd));
+  e.lastUse = ++tick_;
+  return e.handle;
+}
+
+void FileHandleCache::Invalidate(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mu_);
+  open_.erase(path);
+}
+
+void FileHandleCache::InvalidatePrefix(const std::string& prefix) {
+  std::lock_guard<std::mutex> lock(mu_);
+  for (auto it = open_.lower_bound(prefix); it != open_.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+    it = open_.erase(it);
+  }
+}
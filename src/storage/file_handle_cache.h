@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "io_ring.h"
+
+// Open read/write descriptor with positioned IO. Shared through
+// FileHandleCache; the descriptor closes when the last reference goes.
+class FileHandle {
+ public:
+  ~FileHandle();
+  FileHandle(const FileHandle&) = delete;
+  FileHandle& operator=(const FileHandle&) = delete;
+
+  // Short reads happen only at end of file; got = bytes read.
+  bool ReadAt(uint64_t offset, void* dst, size_t len, size_t& got);
+  // Several reads, kept in flight together where io_uring is available
+  // (see IoRing), else one ReadAt after another.
+  bool ReadBatch(std::vector<IoRead>& reads);
+  // Start reading [offset, offset + len) into the page cache without
+  // waiting for it. False when not queued (always, without io_uring).
+  bool Readahead(uint64_t offset, uint64_t len);
+  bool WriteAt(uint64_t offset, const void* src, size_t len);
+  // Write at the current end of file; outOffset = where it landed.
+  bool Append(const void* src, size_t len, uint64_t& outOffset);
+  bool Size(uint64_t& out);
+  bool Sync();
+  // fsync a directory, so renames and creations in it survive a crash.
+  // Always true on Windows, which has no such call.
+  static bool SyncDirectory(const std::string& path);
+  // Allocate disk extents for [offset, offset + len) without changing the
+  // file size. Best effort: false where the platform or file system can't.
+  bool Reserve(uint64_t offset, uint64_t len);
+
+ private:
+  friend class FileHandleCache;
+  explicit FileHandle(int fd) : fd_(fd) {}
+
+  int fd_;
+  // Serializes appends; on Windows (no pread/pwrite) every seek + read/write.
+  std::mutex mu_;
+};
+
+// Process-wide handle cache keyed by path (data, sidecar and WAL files).
+// Anything that removes, renames over or replaces a file must Invalidate it;
+// callers still holding the old handle keep it until they release it.
+class FileHandleCache {
+ public:
+  static FileHandleCache& Instance();
+
+  // nullptr + err when the file is missing and create is false.
+  std::shared_ptr<FileHandle> Open(const std::string& path, bool create, std::string& err);
+  void Invalidate(const std::string& path);
+  void InvalidatePrefix(const std::string& prefix);
+
+ private:
+  FileHandleCache() = default;
+
+  struct Entry {
+    std::shared_ptr<FileHandle> handle;
+    uint64_t lastUse = 0;
+  };
+  static constexpr size_t kMaxOpen = 256;
+
+  std::mutex mu_;
+  std::map<std::string, Entry> open_;
+  uint64_t tick_ = 0;
+};
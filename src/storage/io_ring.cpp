@@ -0,0 +1,281 @@
+#include "io_ring.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+  #define DBMS_HAVE_IO_URING 1
+#endif
+
+#if DBMS_HAVE_IO_URING
+  #include <fcntl.h>
+  #include <linux/io_uring.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+
+  #include <algorithm>
+  #include <cerrno>
+  #include <cstdlib>
+  #include <cstring>
+  #include <memory>
+  #include <mutex>
+  #include <vector>
+#endif
+
+#if DBMS_HAVE_IO_URING
+namespace {
+constexpr uint64_t kReadaheadTag = ~uint64_t{0};
+
+bool Disabled() {
+  const char* env = std::getenv("DBMS_IO_URING");
+  return env && std::strcmp(env, "0") == 0;
+}
+
+// A raw io_uring (no liburing): SQ and CQ rings mapped from the kernel.
+class Ring {
+ public:
+  ~Ring() {
+    if (sqes_) ::munmap(sqes_, sqesLen_);
+    if (cqMap_ && cqMap_ != sqMap_) ::munmap(cqMap_, cqMapLen_);
+    if (sqMap_) ::munmap(sqMap_, sqMapLen_);
+    if (fd_ >= 0) ::close(fd_);
+  }
+
+  bool Setup() {
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, IoRing::kDepth, &p));
+    if (fd_ < 0) return false;
+    sqMapLen_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqMapLen_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) sqMapLen_ = cqMapLen_ = std::max(sqMapLen_, cqMapLen_);
+    sqMap_ = Map(sqMapLen_, IORING_OFF_SQ_RING);
+    if (!sqMap_) return false;
+    cqMap_ = single ? sqMap_ : Map(cqMapLen_, IORING_OFF_CQ_RING);
+    if (!cqMap_) return false;
+    sqesLen_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(Map(sqesLen_, IORING_OFF_SQES));
+    if (!sqes_) return false;
+
+    auto* sq = static_cast<uint8_t*>(sqMap_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    auto* cq = static_cast<uint8_t*>(cqMap_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    entries_ = p.sq_entries;
+    return Supports(IORING_OP_READ, fadvise_);
+  }
+
+  bool broken() const { return broken_; }
+
+  bool Read(int fd, IoRead* reads, size_t count) {
+    for (size_t i = 0; i < count; ++i) reads[i].got = 0;
+    std::vector<size_t> queue;  // reads with bytes still to fetch
+    queue.reserve(count);
+    for (size_t i = count; i > 0; --i) queue.push_back(i - 1);
+    size_t inflight = 0;
+    bool ok = true;
+    while (ok && (!queue.empty() || inflight > 0)) {
+      while (!queue.empty() && inflight + pending_ < entries_) {
+        const size_t i = queue.back();
+        queue.pop_back();
+        IoRead& r = reads[i];
+        io_uring_sqe* sqe = Next();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->off = r.offset + r.got;
+        sqe->addr = reinterpret_cast<uint64_t>(static_cast<char*>(r.dst) + r.got);
+        sqe->len = static_cast<uint32_t>(std::min<size_t>(r.len - r.got, 1u << 30));
+        sqe->user_data = i;
+        ++inflight;
+      }
+      if (!Enter(1)) return false;
+      Reap([&](uint64_t tag, int res) {
+        IoRead& r = reads[tag];
+        --inflight;
+        if (res == -EAGAIN || res == -EINTR) {
+          queue.push_back(static_cast<size_t>(tag));
+        } else if (res < 0) {
+          ok = false;
+        } else if (res > 0) {
+          r.got += static_cast<size_t>(res);
+          if (r.got < r.len) queue.push_back(static_cast<size_t>(tag));
+        }  // 0 = end of file
+      });
+    }
+    // A failed batch still drains, so no completion outlives its buffer.
+    while (inflight > 0) {
+      if (!Enter(1)) return false;
+      Reap([&](uint64_t, int) { --inflight; });
+    }
+    return ok;
+  }
+
+  bool Readahead(int fd, uint64_t offset, uint64_t len) {
+    if (!fadvise_) return false;
+    Reap([](uint64_t, int) {});
+    if (pending_ >= entries_ / 2) return false;  // plenty queued already
+    io_uring_sqe* sqe = Next();
+    sqe->opcode = IORING_OP_FADVISE;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->len = static_cast<uint32_t>(std::min<uint64_t>(len, 1u << 30));
+    sqe->fadvise_advice = POSIX_FADV_WILLNEED;
+    sqe->user_data = kReadaheadTag;
+    ++pending_;
+    return Enter(0);
+  }
+
+ private:
+  void* Map(size_t len, off_t what) {
+    void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, what);
+    return p == MAP_FAILED ? nullptr : p;
+  }
+
+  bool Supports(uint8_t op, bool& fadvise) {
+    const size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[size]());
+    auto* probe = reinterpret_cast<io_uring_probe*>(buf.get());
+    if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+    auto has = [&](uint8_t o) { return o <= probe->last_op && (probe->ops[o].flags & IO_URING_OP_SUPPORTED); };
+    fadvise = has(IORING_OP_FADVISE);
+    return has(op);
+  }
+
+  io_uring_sqe* Next() {
+    const unsigned tail = *sqTail_;
+    const unsigned idx = tail & sqMask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+  }
+
+  // Submits every queued entry, then waits for `wait` completions.
+  bool Enter(unsigned wait) {
+    while (true) {
+      const unsigned submit = *sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+      const long n = ::syscall(__NR_io_uring_enter, fd_, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+      if (n >= 0 && static_cast<unsigned>(n) == submit) return true;
+      if (n < 0 && errno != EINTR && errno != EAGAIN) {
+        broken_ = true;
+        return false;
+      }
+    }
+  }
+
+  // Passes each completed read to done; readahead completions are counted off.
+  template <typename Done>
+  void Reap(Done done) {
+    unsigned head = *cqHead_;
+    const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const io_uring_cqe& cqe = cqes_[head & cqMask_];
+      if (cqe.user_data == kReadaheadTag) {
+        --pending_;
+        if (cqe.res == -EINVAL) fadvise_ = false;
+        continue;
+      }
+      done(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  }
+
+  int fd_ = -1;
+  void* sqMap_ = nullptr;
+  void* cqMap_ = nullptr;
+  size_t sqMapLen_ = 0;
+  size_t cqMapLen_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqesLen_ = 0;
+  unsigned* sqHead_ = nullptr;
+  unsigned* sqTail_ = nullptr;
+  unsigned* sqArray_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned* cqHead_ = nullptr;
+  unsigned* cqTail_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned cqMask_ = 0;
+  unsigned entries_ = 0;
+  unsigned pending_ = 0;  // readahead submitted, not yet reaped
+  bool fadvise_ = false;
+  bool broken_ = false;  // enter failed: entries may still be queued
+};
+
+// Rings are leased for one call and kept for reuse: the server runs a
+// thread per connection, too short-lived for a ring of its own.
+class RingPool {
+ public:
+  static constexpr size_t kMaxIdle = 16;
+
+  std::unique_ptr<Ring> Take() {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      if (!idle_.empty()) {
+        auto ring = std::move(idle_.back());
+        idle_.pop_back();
+        return ring;
+      }
+    }
+    auto ring = std::make_unique<Ring>();
+    if (!ring->Setup()) ring.reset();
+    return ring;
+  }
+
+  void Give(std::unique_ptr<Ring> ring) {
+    if (!ring || ring->broken()) return;
+    std::lock_guard<std::mutex> lock(mu_);
+    if (idle_.size() < kMaxIdle) idle_.push_back(std::move(ring));
+  }
+
+ private:
+  std::mutex mu_;
+  std::vector<std::unique_ptr<Ring>> idle_;
+};
+
+RingPool& Pool() {
+  static RingPool pool;
+  return pool;
+}
+
+}  // namespace
+
+bool IoRing::Available() {
+  static const bool available = [] {
+    if (Disabled()) return false;
+    Ring probe;
+    return probe.Setup();
+  }();
+  return available;
+}
+
+bool IoRing::Read(int fd, IoRead* reads, size_t count) {
+  if (!Available()) return false;
+  auto ring = Pool().Take();
+  const bool ok = ring && ring->Read(fd, reads, count);
+  Pool().Give(std::move(ring));
+  return ok;
+}
+
+bool IoRing::Readahead(int fd, uint64_t offset, uint64_t len) {
+  if (!Available()) return false;
+  auto ring = Pool().Take();
+  const bool ok = ring && ring->Readahead(fd, offset, len);
+  Pool().Give(std::move(ring));
+  return ok;
+}
+
+#else
+
+bool IoRing::Available() { return false; }
+
+bool IoRing::Read(int, IoRead*, size_t) { return false; }
+
+bool IoRing::Readahead(int, uint64_t, uint64_t) { return false; }
+
+#endif
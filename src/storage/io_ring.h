@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// One positioned read of a batch.
+struct IoRead {
+  uint64_t offset = 0;
+  void* dst = nullptr;
+  size_t len = 0;
+  size_t got = 0;  // bytes read; short only at end of file
+};
+
+// io_uring on Linux: a batch of reads is kept in flight together (up to
+// kDepth) instead of one pread at a time, and readahead
+// (POSIX_FADV_WILLNEED) is queued without waiting for it.
+// Available() is false on other platforms, on kernels without
+// IORING_OP_READ, or with DBMS_IO_URING=0; callers then stay on pread.
+class IoRing {
+ public:
+  static constexpr unsigned kDepth = 64;
+
+  static bool Available();
+  // False when the ring could not serve every read; the caller redoes them
+  // with pread, which reports real errors.
+  static bool Read(int fd, IoRead* reads, size_t count);
+  // Best effort; false when it was not queued.
+  static bool Readahead(int fd, uint64_t offset, uint64_t len);
+};
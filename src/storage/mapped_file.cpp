@@ -0,0 +1,85 @@
+#include "mapped_file.h"
+
+#include <filesystem>
+#include <fstream>
+
+#if !defined(_WIN32)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace {
+// (size, inode) of the file, or false if it does not exist.
+bool StatFile(const std::string& path, size_t& size, uint64_t& ino) {
+#if defined(_WIN32)
+  std::error_code ec;
+  auto sz = std::filesystem::file_size(path, ec);
+  if (ec) return false;
+  size = static_cast<size_t>(sz);
+  ino = 0;
+  return true;
+#else
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) return false;
+  size = static_cast<size_t>(st.st_size);
+  ino = static_cast<uint64_t>(st.st_ino);
+  return true;
+#endif
+}
+}  // namespace
+
+FileMapping::~FileMapping() {
+#if !defined(_WIN32)
+  if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+}
+
+std::shared_ptr<const FileMapping> MappedFile::Acquire(std::string& err) {
+  std::lock_guard<std::mutex> lock(mu_);
+  size_t size = 0;
+  uint64_t ino = 0;
+  const bool exists = StatFile(path_, size, ino);
+  if (!exists) size = 0;
+  if (current_ && size == size_ && ino == ino_) return current_;
+
+  std::shared_ptr<FileMapping> m(new FileMapping());
+  if (size > 0) {
+#if defined(_WIN32)
+    std::ifstream ifs(path_, std::ios::binary);
+    m->copy_.resize(size);
+    if (!ifs.read(reinterpret_cast<char*>(m->copy_.data()), static_cast<std::streamsize>(size))) {
+      err = "Cannot read dat file: " + path_;
+      return nullptr;
+    }
+    m->data_ = m->copy_.data();
+#else
+    int fd = ::open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+      err = "Cannot open dat file: " + path_;
+      return nullptr;
+    }
+    void* p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the file referenced
+    if (p == MAP_FAILED) {
+      err = "mmap failed: " + path_;
+      return nullptr;
+    }
+    ::madvise(p, size, MADV_SEQUENTIAL);
+    m->data_ = static_cast<const uint8_t*>(p);
+#endif
+    m->size_ = size;
+  }
+  current_ = std::move(m);
+  size_ = size;
+  ino_ = ino;
+  return current_;
+}
+
+void MappedFile::Release() {
+  std::lock_guard<std::mutex> lock(mu_);
+  current_.reset();
+  size_ = 0;
+  ino_ = 0;
+}
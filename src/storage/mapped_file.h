@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Read-only mapping of one version of a data file (MADV_SEQUENTIAL).
+// Data files are only ever appended to, overwritten in place, or replaced by
+// rename, so a mapping stays valid for as long as someone holds it.
+class FileMapping {
+ public:
+  ~FileMapping();
+  FileMapping(const FileMapping&) = delete;
+  FileMapping& operator=(const FileMapping&) = delete;
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  friend class MappedFile;
+  FileMapping() = default;
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  std::vector<uint8_t> copy_;  // no mmap: whole-file read
+#endif
+};
+
+// Per-path cache of the current FileMapping; remaps when the file grew,
+// shrank or was replaced.
+class MappedFile {
+ public:
+  explicit MappedFile(std::string path) : path_(std::move(path)) {}
+
+  // A missing file maps as empty.
+  std::shared_ptr<const FileMapping> Acquire(std::string& err);
+  // Forget the cached mapping (file dropped); holders keep theirs.
+  void Release();
+
+ private:
+  std::string path_;
+  std::mutex mu_;
+  std::shared_ptr<const FileMapping> current_;
+  size_t size_ = 0;
+  uint64_t ino_ = 0;
+};
@@ -0,0 +1,145 @@
+#include "overflow.h"
+#include "crc32c.h"
+#include "file_handle_cache.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <filesystem>
+
+namespace {
+constexpr uint32_t kMagic = 0x564F4244;  // "DBOV"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kEntryHeader = 8;  // u32 length + u32 crc32c
+constexpr char kMarker[4] = {'\0', 'O', 'V', 'F'};
+
+template <typename T>
+void Put(std::string& out, T v) {
+  out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// marker | u64 entry offset | u32 crc32c of the 12 bytes before it
+std::string MakePointer(uint64_t at) {
+  std::string p(kMarker, sizeof(kMarker));
+  Put(p, at);
+  Put(p, Crc32c(p.data(), p.size()));
+  return p;
+}
+}  // namespace
+
+std::string Overflow::PathFor(const std::string& data_path) {
+  std::filesystem::path p = data_path;
+  p.replace_extension(".ovf");
+  return p.string();
+}
+
+bool Overflow::Moves(const RecordCodec& codec, size_t field, std::string_view v) {
+  if (v.size() <= kInlineLimit) return false;
+  const bool slot = codec.typed() && field < codec.fieldCount() && codec.kind(field) == ColumnKind::kChar &&
+                    v.size() <= codec.width(field) && v.back() != '\0';
+  return !slot;
+}
+
+bool Overflow::Resolve(const FileMapping& file, std::string_view pointer, std::string_view& out) {
+  if (pointer.size() != kPointerSize || std::memcmp(pointer.data(), kMarker, sizeof(kMarker)) != 0) return false;
+  uint32_t check = 0;
+  std::memcpy(&check, pointer.data() + 12, sizeof(check));
+  if (Crc32c(pointer.data(), 12) != check) return false;
+  uint64_t at = 0;
+  std::memcpy(&at, pointer.data() + sizeof(kMarker), sizeof(at));
+  const size_t size = file.size();
+  if (at < kHeaderSize || at > size || size - at < kEntryHeader) return false;
+  uint32_t len = 0, crc = 0;
+  std::memcpy(&len, file.data() + at, sizeof(len));
+  std::memcpy(&crc, file.data() + at + 4, sizeof(crc));
+  if (size - at - kEntryHeader < len) return false;
+  const uint8_t* p = file.data() + at + kEntryHeader;
+  if (Crc32c(p, len) != crc) return false;
+  out = std::string_view(reinterpret_cast<const char*>(p), len);
+  return true;
+}
+
+uint64_t Overflow::Shrink(const RecordCodec& codec, Record& record) {
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < record.values.size(); ++i) {
+    if (!Moves(codec, i, record.values[i])) continue;
+    bytes += kEntryHeader + record.values[i].size();
+    record.values[i] = MakePointer(0);
+    record.SetOverflowed(i);
+  }
+  return bytes;
+}
+
+void Overflow::Remove(const std::string& data_path) {
+  FileHandleCache::Instance().Invalidate(PathFor(data_path));
+  std::error_code ec;
+  std::filesystem::remove(PathFor(data_path), ec);
+}
+
+OverflowWriter::OverflowWriter(std::string data_path, const TableSchema& schema)
+    : path_(Overflow::PathFor(data_path)), codec_(schema) {}
+
+void OverflowWriter::Add(Record& record) {
+  for (size_t i = 0; i < record.values.size(); ++i) {
+    const std::string& v = record.values[i];
+    if (!Overflow::Moves(codec_, i, v)) continue;
+    pending_.push_back({&record, i, buf_.size()});
+    Put(buf_, static_cast<uint32_t>(v.size()));
+    Put(buf_, Crc32c(v.data(), v.size()));
+    buf_.append(v);
+  }
+}
+
+const std::vector<Record>& OverflowWriter::Add(const std::vector<Record>& records, std::vector<Record>& copy) {
+  bool any = false;
+  for (const auto& r : records) {
+    for (size_t i = 0; i < r.values.size() && !any; ++i) any = Overflow::Moves(codec_, i, r.values[i]);
+    if (any) break;
+  }
+  if (!any) return records;
+  copy = records;
+  for (auto& r : copy) Add(r);
+  return copy;
+}
+
+bool OverflowWriter::Flush(std::string& err) {
+  if (pending_.empty()) return true;
+  auto file = FileHandleCache::Instance().Open(path_, true, err);
+  uint64_t size = 0;
+  if (!file || !file->Size(size)) {
+    err = "Cannot open overflow file: " + path_;
+    return false;
+  }
+  std::string header;
+  if (size == 0) {
+    Put(header, kMagic);
+    Put(header, kVersion);
+    buf_.insert(0, header);
+  }
+  uint64_t at = 0;
+  if (!file->Append(buf_.data(), buf_.size(), at)) {
+    err = "Write failed: " + path_;
+    return false;
+  }
+  const uint64_t base = at + header.size();
+  for (const auto& p : pending_) {
+    p.record->values[p.field] = MakePointer(base + p.at);
+    p.record->SetOverflowed(p.field);
+  }
+  bytes_ += buf_.size();
+  buf_.clear();
+  pending_.clear();
+  written_ = true;
+  return true;
+}
+
+bool OverflowWriter::Sync(std::string& err) {
+  if (!Flush(err)) return false;
+  if (!written_) return true;
+  auto file = FileHandleCache::Instance().Open(path_, true, err);
+  if (!file || !file->Sync()) {
+    err = "Sync failed: " + path_;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../db_types.h"
+#include "record_codec.h"
+
+class FileMapping;
+
+// Sidecar "<data>.ovf": values too long to keep in their row. The row holds
+// a kPointerSize-byte pointer in the value's place (marker, entry offset,
+// checksum of both), flagged out of band (Record::overflow, kOverflowBit in
+// the stored length) so no stored value is ever taken for one, and the
+// value is appended here as u32 length | u32 crc32c | bytes. Entries are never rewritten, so a pointer stays valid
+// until the data file itself is rewritten (SaveRecords, VACUUM), which
+// stages a sidecar holding only the live values, installed with the data
+// file (StorageEngine::InstallStaged). Only
+// per-table segment files get one.
+class Overflow {
+ public:
+  // Longer values leave the row, unless they sit in a fixed-width char[n]
+  // slot that takes the same room either way.
+  static constexpr size_t kInlineLimit = 512;
+  static constexpr size_t kPointerSize = 16;
+
+  static std::string PathFor(const std::string& data_path);
+  static bool Moves(const RecordCodec& codec, size_t field, std::string_view v);
+  // The value pointer refers to inside file, a mapping of the sidecar; false
+  // when pointer is malformed or the entry lies past the mapping or fails
+  // its checksum.
+  static bool Resolve(const FileMapping& file, std::string_view pointer, std::string_view& out);
+  // record as it would be stored, for sizing only: its long values become
+  // (flagged) pointers to nothing. Returns the sidecar bytes they would take.
+  static uint64_t Shrink(const RecordCodec& codec, Record& record);
+  static void Remove(const std::string& data_path);
+};
+
+// Moves the long values of records bound for one data file to its sidecar.
+class OverflowWriter {
+ public:
+  OverflowWriter(std::string data_path, const TableSchema& schema);
+
+  // Queues record's long values; Flush puts their pointers in, so record
+  // must stay where it is until then.
+  void Add(Record& record);
+  // records itself when none has a long value, else copy holding them with
+  // their long values queued.
+  const std::vector<Record>& Add(const std::vector<Record>& records, std::vector<Record>& copy);
+  // Appends everything queued with one write.
+  bool Flush(std::string& err);
+  // Flush, then make the sidecar durable (before rows pointing into it are).
+  bool Sync(std::string& err);
+  uint64_t bytes() const { return bytes_; }  // appended so far
+
+ private:
+  struct Pending {
+    Record* record;
+    size_t field;
+    uint64_t at;  // entry offset in buf_
+  };
+
+  std::string path_;
+  RecordCodec codec_;
+  std::string buf_;
+  std::vector<Pending> pending_;
+  uint64_t bytes_ = 0;
+  bool written_ = false;
+};
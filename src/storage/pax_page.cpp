@@ -0,0 +1,379 @@
+#include "pax_page.h"
+
+#include <cstring>
+
+namespace {
+constexpr size_t kLsnOff = 0;
+constexpr size_t kCrcOff = 8;
+constexpr size_t kRowsOff = 12;
+constexpr size_t kColumnsOff = 14;
+constexpr uint16_t kDictionaryBit = 0x8000;
+constexpr uint16_t kSpilledBit = 0x8000;
+constexpr uint16_t kLengthMask = 0x7FFF;
+
+template <typename T>
+T Load(const uint8_t* p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+template <typename T>
+void Store(uint8_t* p, T v) {
+  std::memcpy(p, &v, sizeof(T));
+}
+
+size_t DataStart(size_t columns) { return PaxPage::kHeaderSize + 2 * (columns + 1); }
+
+// Entry length word of column c's cell; field c - 1 is spilled when the
+// codec sizes it by a length prefix.
+uint16_t EntryTag(const RecordCodec& codec, const uint8_t* rec, size_t c, uint16_t len) {
+  const bool spilled = codec.FieldWidth(rec, c - 1) == RecordCodec::kLengthPrefixed;
+  return static_cast<uint16_t>(len | (spilled ? kSpilledBit : 0));
+}
+
+std::string EntryKey(uint16_t tag, const uint8_t* bytes, uint16_t len) {
+  std::string key(reinterpret_cast<const char*>(&tag), sizeof(tag));
+  key.append(reinterpret_cast<const char*>(bytes), len);
+  return key;
+}
+}  // namespace
+
+bool PaxPage::Split(const RecordCodec& codec, const uint8_t* rec, size_t len, std::vector<uint16_t>& cells) {
+  cells.clear();
+  size_t pos = codec.HeaderSize();
+  if (len < pos || len > kPageSize) return false;
+  cells.push_back(static_cast<uint16_t>(pos));
+  for (size_t i = 0; i < codec.fieldCount(); ++i) {
+    size_t width = codec.FieldWidth(rec, i);
+    if (width == RecordCodec::kLengthPrefixed) {
+      uint32_t n = 0;
+      if (len - pos < sizeof(n)) return false;
+      std::memcpy(&n, rec + pos, sizeof(n));
+      n &= ~RecordCodec::kOverflowBit;
+      if (n > len - pos - sizeof(n)) return false;
+      width = sizeof(n) + n;
+    }
+    if (width > len - pos) return false;
+    cells.push_back(static_cast<uint16_t>(width));
+    pos += width;
+  }
+  return pos == len;
+}
+
+bool PaxPage::IsDictionaryField(const RecordCodec& codec, size_t field) {
+  return codec.typed() && codec.kind(field) == ColumnKind::kChar;
+}
+
+bool PaxPage::IsInitialized() const { return ColumnCount() != 0; }
+
+uint64_t PaxPage::Lsn() const { return Load<uint64_t>(data_ + kLsnOff); }
+void PaxPage::SetLsn(uint64_t lsn) { Store(data_ + kLsnOff, lsn); }
+uint32_t PaxPage::Checksum() const { return Load<uint32_t>(data_ + kCrcOff); }
+void PaxPage::SetChecksum(uint32_t crc) { Store(data_ + kCrcOff, crc); }
+uint16_t PaxPage::RowCount() const { return Load<uint16_t>(data_ + kRowsOff); }
+uint16_t PaxPage::ColumnCount() const { return Load<uint16_t>(data_ + kColumnsOff); }
+void PaxPage::SetRowCount(uint16_t n) { Store(data_ + kRowsOff, n); }
+
+bool PaxPage::IsDictionary(uint16_t column) const {
+  return (Load<uint16_t>(data_ + kHeaderSize + 2 * column) & kDictionaryBit) != 0;
+}
+uint16_t PaxPage::RegionStart(uint16_t column) const {
+  return Load<uint16_t>(data_ + kHeaderSize + 2 * column) & static_cast<uint16_t>(~kDictionaryBit);
+}
+uint16_t PaxPage::RowsBase(uint16_t column) const {
+  return static_cast<uint16_t>(RegionStart(column) + (IsDictionary(column) ? 2 : 0));
+}
+
+uint16_t PaxPage::Floor(uint16_t column) const {
+  if (IsDictionary(column)) return Load<uint16_t>(data_ + RegionStart(column));
+  const uint16_t rows = RowCount();
+  if (rows == 0) return RegionStart(static_cast<uint16_t>(column + 1));
+  return Load<uint16_t>(data_ + RowsBase(column) + 2 * (rows - 1));
+}
+
+uint16_t PaxPage::FreeIn(uint16_t column) const {
+  const size_t used = RowsBase(column) + 2u * RowCount();
+  const uint16_t floor = Floor(column);
+  return floor > used ? static_cast<uint16_t>(floor - used) : 0;
+}
+
+uint16_t PaxPage::FindEntry(uint16_t column, uint16_t tag, const uint8_t* bytes) const {
+  const uint16_t end = RegionStart(static_cast<uint16_t>(column + 1));
+  const uint16_t len = tag & kLengthMask;
+  for (uint32_t at = Floor(column); at + 2 <= end;) {
+    const uint16_t t = Load<uint16_t>(data_ + at);
+    const uint32_t n = t & kLengthMask;
+    if (at + 2 + n > end) break;
+    if (t == tag && std::memcmp(data_ + at + 2, bytes, len) == 0) return static_cast<uint16_t>(at);
+    at += 2 + n;
+  }
+  return 0;
+}
+
+bool PaxPage::Cell(uint16_t row, uint16_t column, const uint8_t*& out, uint16_t& len) const {
+  const uint16_t columns = ColumnCount();
+  if (column >= columns || DataStart(columns) > kPageSize) return false;
+  if (IsDictionary(column)) {
+    uint16_t entry = 0;
+    bool spilled = false;
+    return EntryOf(row, column, entry) && EntryCell(column, entry, out, len, spilled);
+  }
+  const uint16_t base = RowsBase(column);
+  const uint16_t end = RegionStart(static_cast<uint16_t>(column + 1));
+  if (base < DataStart(columns) || end > kPageSize || base + 2u * (row + 1u) > end) return false;
+  const uint16_t off = Load<uint16_t>(data_ + base + 2 * row);
+  const uint16_t top = row == 0 ? end : Load<uint16_t>(data_ + base + 2 * (row - 1));
+  if (off < base + 2u * (row + 1u) || off > top || top > end) return false;
+  out = data_ + off;
+  len = static_cast<uint16_t>(top - off);
+  return true;
+}
+
+bool PaxPage::EntryOf(uint16_t row, uint16_t column, uint16_t& entry) const {
+  const uint16_t columns = ColumnCount();
+  if (column >= columns || !IsDictionary(column)) return false;
+  const uint16_t base = RowsBase(column);
+  const uint16_t end = RegionStart(static_cast<uint16_t>(column + 1));
+  if (base < DataStart(columns) || end > kPageSize || base + 2u * (row + 1u) > end) return false;
+  entry = Load<uint16_t>(data_ + base + 2 * row);
+  return entry >= base + 2u * (row + 1u);
+}
+
+bool PaxPage::EntryCell(uint16_t column, uint16_t entry, const uint8_t*& out, uint16_t& len, bool& spilled) const {
+  const uint16_t end = RegionStart(static_cast<uint16_t>(column + 1));
+  if (entry < RowsBase(column) || entry + 2u > end) return false;
+  const uint16_t tag = Load<uint16_t>(data_ + entry);
+  len = tag & kLengthMask;
+  spilled = (tag & kSpilledBit) != 0;
+  if (entry + 2u + len > end) return false;
+  out = data_ + entry + 2;
+  return true;
+}
+
+bool PaxPage::Get(uint16_t row, std::vector<uint8_t>& out) const {
+  if (row >= RowCount()) return false;
+  out.clear();
+  for (uint16_t c = 0; c < ColumnCount(); ++c) {
+    const uint8_t* cell = nullptr;
+    uint16_t len = 0;
+    if (!Cell(row, c, cell, len)) return false;
+    out.insert(out.end(), cell, cell + len);
+  }
+  return true;
+}
+
+bool PaxPage::MakePlan(const RecordCodec& codec, const uint8_t* rec, size_t len, int row, Plan& plan) const {
+  if (!IsInitialized() || ColumnCount() != codec.fieldCount() + 1) return false;
+  if (!Split(codec, rec, len, plan.cells)) return false;
+  plan.reuse.assign(plan.cells.size(), 0);
+  plan.need.assign(plan.cells.size(), 0);
+  size_t at = 0;
+  for (uint16_t c = 0; c < ColumnCount(); ++c) {
+    const uint8_t* bytes = rec + at;
+    const uint16_t n = plan.cells[c];
+    at += n;
+    if (IsDictionary(c)) {
+      const uint16_t tag = EntryTag(codec, rec, c, n);
+      uint16_t cur = 0;
+      if (row >= 0 && !EntryOf(static_cast<uint16_t>(row), c, cur)) return false;
+      if (row >= 0 && Load<uint16_t>(data_ + cur) == tag && std::memcmp(data_ + cur + 2, bytes, n) == 0) {
+        plan.reuse[c] = cur;
+      } else {
+        plan.reuse[c] = FindEntry(c, tag, bytes);
+      }
+      plan.need[c] = static_cast<uint16_t>((row < 0 ? 2 : 0) + (plan.reuse[c] ? 0 : 2 + n));
+    } else if (row >= 0) {
+      const uint8_t* cur = nullptr;
+      uint16_t curLen = 0;
+      if (!Cell(static_cast<uint16_t>(row), c, cur, curLen) || curLen != n) return false;
+    } else {
+      plan.need[c] = static_cast<uint16_t>(2 + n);
+    }
+    if (plan.need[c] > FreeIn(c)) return false;
+  }
+  return true;
+}
+
+bool PaxPage::CanInsert(const RecordCodec& codec, const uint8_t* rec, size_t len) const {
+  Plan plan;
+  return RowCount() < 0xFFFF && MakePlan(codec, rec, len, -1, plan);
+}
+
+bool PaxPage::Insert(const RecordCodec& codec, const uint8_t* rec, size_t len, uint16_t& out_row) {
+  Plan plan;
+  if (RowCount() == 0xFFFF || !MakePlan(codec, rec, len, -1, plan)) return false;
+  const uint16_t rows = RowCount();
+  size_t at = 0;
+  for (uint16_t c = 0; c < ColumnCount(); ++c) {
+    const uint16_t n = plan.cells[c];
+    uint16_t off = plan.reuse[c];
+    if (IsDictionary(c)) {
+      if (!off) {
+        off = static_cast<uint16_t>(Floor(c) - 2 - n);
+        Store(data_ + off, EntryTag(codec, rec, c, n));
+        std::memcpy(data_ + off + 2, rec + at, n);
+        Store(data_ + RegionStart(c), off);
+      }
+    } else {
+      off = static_cast<uint16_t>(Floor(c) - n);
+      std::memcpy(data_ + off, rec + at, n);
+    }
+    Store(data_ + RowsBase(c) + 2 * rows, off);
+    at += n;
+  }
+  // Published last: a scan bounded by the old count never sees a half row.
+  SetRowCount(static_cast<uint16_t>(rows + 1));
+  out_row = rows;
+  return true;
+}
+
+bool PaxPage::CanOverwrite(const RecordCodec& codec, uint16_t row, const uint8_t* rec, size_t len) const {
+  Plan plan;
+  return row < RowCount() && MakePlan(codec, rec, len, row, plan);
+}
+
+bool PaxPage::Overwrite(const RecordCodec& codec, uint16_t row, const uint8_t* rec, size_t len) {
+  Plan plan;
+  if (row >= RowCount() || !MakePlan(codec, rec, len, row, plan)) return false;
+  size_t at = 0;
+  for (uint16_t c = 0; c < ColumnCount(); ++c) {
+    const uint16_t n = plan.cells[c];
+    if (IsDictionary(c)) {
+      uint16_t off = plan.reuse[c];
+      if (!off) {
+        off = static_cast<uint16_t>(Floor(c) - 2 - n);
+        Store(data_ + off, EntryTag(codec, rec, c, n));
+        std::memcpy(data_ + off + 2, rec + at, n);
+        Store(data_ + RegionStart(c), off);
+      }
+      Store(data_ + RowsBase(c) + 2 * row, off);
+    } else {
+      const uint8_t* cell = nullptr;
+      uint16_t curLen = 0;
+      Cell(row, c, cell, curLen);
+      std::memcpy(const_cast<uint8_t*>(cell), rec + at, n);
+    }
+    at += n;
+  }
+  return true;
+}
+
+bool PaxPage::PutAt(const RecordCodec& codec, uint16_t row, const uint8_t* rec, size_t len) {
+  if (!IsInitialized()) {
+    if (row != 0) return false;
+    PaxRowGroup group(codec);
+    const uint64_t lsn = Lsn();
+    if (!group.Add(std::vector<uint8_t>(rec, rec + len)) || !group.Build(data_)) return false;
+    SetLsn(lsn);
+    return true;
+  }
+  if (row < RowCount()) return Overwrite(codec, row, rec, len);
+  if (row != RowCount()) return false;
+  uint16_t got = 0;
+  return Insert(codec, rec, len, got);
+}
+
+PaxRowGroup::PaxRowGroup(const RecordCodec& codec) : codec_(codec) {
+  const size_t columns = codec_.fieldCount() + 1;
+  dictionary_.assign(columns, false);
+  for (size_t c = 1; c < columns; ++c) dictionary_[c] = PaxPage::IsDictionaryField(codec_, c - 1);
+  entries_.resize(columns);
+  Clear();
+}
+
+void PaxRowGroup::Clear() {
+  rows_.clear();
+  cells_.clear();
+  need_.assign(dictionary_.size(), 0);
+  total_ = 0;
+  for (size_t c = 0; c < dictionary_.size(); ++c) {
+    entries_[c].clear();
+    if (dictionary_[c]) {
+      need_[c] = 2;  // floor word
+      total_ += 2;
+    }
+  }
+}
+
+bool PaxRowGroup::Add(const std::vector<uint8_t>& rec) {
+  std::vector<uint16_t> cells;
+  if (rows_.size() == 0xFFFF || !PaxPage::Split(codec_, rec.data(), rec.size(), cells)) return false;
+  std::vector<size_t> added(cells.size(), 0);
+  std::vector<std::string> fresh(cells.size());
+  size_t grow = 0;
+  size_t at = 0;
+  for (size_t c = 0; c < cells.size(); ++c) {
+    added[c] = 2;
+    if (dictionary_[c]) {
+      std::string key = EntryKey(EntryTag(codec_, rec.data(), c, cells[c]), rec.data() + at, cells[c]);
+      if (!entries_[c].count(key)) {
+        added[c] += 2 + cells[c];
+        fresh[c] = std::move(key);
+      }
+    } else {
+      added[c] += cells[c];
+    }
+    grow += added[c];
+    at += cells[c];
+  }
+  if (DataStart(cells.size()) + total_ + grow > kPageSize) return false;
+  for (size_t c = 0; c < cells.size(); ++c) {
+    need_[c] += added[c];
+    if (!fresh[c].empty()) entries_[c].emplace(std::move(fresh[c]), 0);
+  }
+  total_ += grow;
+  rows_.push_back(rec);
+  cells_.push_back(std::move(cells));
+  return true;
+}
+
+bool PaxRowGroup::Build(uint8_t* page) const {
+  const size_t columns = dictionary_.size();
+  if (rows_.empty()) return false;
+  std::memset(page, 0, kPageSize);
+  const size_t spare = kPageSize - DataStart(columns) - total_;
+  std::vector<size_t> starts(columns + 1);
+  size_t start = DataStart(columns);
+  for (size_t c = 0; c < columns; ++c) {
+    starts[c] = start;
+    Store(page + PaxPage::kHeaderSize + 2 * c, static_cast<uint16_t>(start | (dictionary_[c] ? kDictionaryBit : 0)));
+    start += need_[c] + spare * need_[c] / total_;
+  }
+  starts[columns] = kPageSize;
+  Store(page + PaxPage::kHeaderSize + 2 * columns, static_cast<uint16_t>(kPageSize));
+  Store(page + kColumnsOff, static_cast<uint16_t>(columns));
+
+  std::vector<size_t> floors(starts.begin() + 1, starts.end());
+  std::vector<std::unordered_map<std::string, uint16_t>> placed(columns);
+  for (size_t r = 0; r < rows_.size(); ++r) {
+    const uint8_t* rec = rows_[r].data();
+    size_t at = 0;
+    for (size_t c = 0; c < columns; ++c) {
+      const uint16_t n = cells_[r][c];
+      uint16_t off = 0;
+      if (dictionary_[c]) {
+        const uint16_t tag = EntryTag(codec_, rec, c, n);
+        auto it = placed[c].try_emplace(EntryKey(tag, rec + at, n), 0).first;
+        if (!it->second) {
+          floors[c] -= 2 + n;
+          Store(page + floors[c], tag);
+          std::memcpy(page + floors[c] + 2, rec + at, n);
+          it->second = static_cast<uint16_t>(floors[c]);
+        }
+        off = it->second;
+      } else {
+        floors[c] -= n;
+        std::memcpy(page + floors[c], rec + at, n);
+        off = static_cast<uint16_t>(floors[c]);
+      }
+      Store(page + starts[c] + (dictionary_[c] ? 2 : 0) + 2 * r, off);
+      at += n;
+    }
+  }
+  for (size_t c = 0; c < columns; ++c) {
+    if (dictionary_[c]) Store(page + starts[c], static_cast<uint16_t>(floors[c]));
+  }
+  Store(page + kRowsOff, static_cast<uint16_t>(rows_.size()));
+  return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "record_codec.h"
+#include "slotted_page.h"
+
+// Fixed-size PAX page used by STORAGE=COLUMNAR tables: one row group whose
+// cells are stored column by column, so a scan reads only its columns.
+//
+//   [header 16B][u16 region start x (columns + 1)][region 0][region 1]...
+//
+// header: u64 page LSN | u32 checksum (0 = unset) | u16 row count | u16 column count
+// region start: offset, bit 15 set for a dictionary region
+// plain region:      u16 cell offset per row ->   free   <- cells, newest first
+// dictionary region: u16 floor | u16 entry offset per row ->  free  <- entries
+// entry:             u16 length (bit 15 = spilled value) | cell bytes
+// Column 0 holds each row's record header (valid byte, null and spill
+// bitmaps); column i + 1 holds field i as RecordCodec encodes it. char[n]
+// columns of typed tables are dictionary regions: each distinct cell is
+// stored once and rows point at it, so the entry offset doubles as the
+// value's code within the page. A record is the concatenation of its
+// cells, so RIDs (page, row), WAL images and tombstones work on the same
+// bytes as STORAGE=PAGED. Region sizes are fixed when the page is built
+// and cells never move, so a scan that stops at the row count it saw stays
+// consistent while rows are appended.
+class PaxPage {
+ public:
+  static constexpr uint32_t kHeaderSize = 16;
+
+  explicit PaxPage(uint8_t* data) : data_(data) {}
+
+  bool IsInitialized() const;
+
+  uint64_t Lsn() const;
+  void SetLsn(uint64_t lsn);
+  uint32_t Checksum() const;
+  void SetChecksum(uint32_t crc);
+  uint16_t RowCount() const;
+  uint16_t ColumnCount() const;
+  bool IsDictionary(uint16_t column) const;
+
+  bool Cell(uint16_t row, uint16_t column, const uint8_t*& out, uint16_t& len) const;
+  // Dictionary regions: the entry a row points at, and an entry's cell.
+  bool EntryOf(uint16_t row, uint16_t column, uint16_t& entry) const;
+  bool EntryCell(uint16_t column, uint16_t entry, const uint8_t*& out, uint16_t& len, bool& spilled) const;
+  // The whole record of a row.
+  bool Get(uint16_t row, std::vector<uint8_t>& out) const;
+
+  bool CanInsert(const RecordCodec& codec, const uint8_t* rec, size_t len) const;
+  // Append a row; false when a region is full.
+  bool Insert(const RecordCodec& codec, const uint8_t* rec, size_t len, uint16_t& out_row);
+  // In-place overwrite. Plain cells must keep their length; a changed
+  // dictionary cell points at an equal entry or a new one.
+  bool CanOverwrite(const RecordCodec& codec, uint16_t row, const uint8_t* rec, size_t len) const;
+  bool Overwrite(const RecordCodec& codec, uint16_t row, const uint8_t* rec, size_t len);
+  // Redo helper: overwrite an existing row or insert it as the next row
+  // (building the page around it when it is still blank).
+  bool PutAt(const RecordCodec& codec, uint16_t row, const uint8_t* rec, size_t len);
+
+  // Cell lengths of an encoded record: the header, then one per field.
+  static bool Split(const RecordCodec& codec, const uint8_t* rec, size_t len, std::vector<uint16_t>& cells);
+  static bool IsDictionaryField(const RecordCodec& codec, size_t field);
+  // Bytes one row can take in an empty page, with every dictionary cell new.
+  static size_t MaxRecordSize(size_t columns) { return kPageSize - kHeaderSize - 8 * columns - 2; }
+
+ private:
+  // What writing a record's cells takes: per column, an existing entry to
+  // reuse (dictionary regions) and the bytes needed.
+  struct Plan {
+    std::vector<uint16_t> cells;
+    std::vector<uint16_t> reuse;  // 0 = store the cell
+    std::vector<uint16_t> need;
+  };
+  bool MakePlan(const RecordCodec& codec, const uint8_t* rec, size_t len, int row, Plan& plan) const;
+  uint16_t RegionStart(uint16_t column) const;
+  uint16_t RowsBase(uint16_t column) const;
+  uint16_t Floor(uint16_t column) const;
+  uint16_t FreeIn(uint16_t column) const;
+  uint16_t FindEntry(uint16_t column, uint16_t tag, const uint8_t* bytes) const;
+  void SetRowCount(uint16_t n);
+
+  uint8_t* data_;
+};
+
+// Rows collected for one fresh page by bulk writers (multi-row appends,
+// rewrites, compaction); the page is laid out for exactly these rows, each
+// region getting a share of the spare space in proportion.
+class PaxRowGroup {
+ public:
+  explicit PaxRowGroup(const RecordCodec& codec);
+
+  // False when the row would not fit in the page (or is not a record).
+  bool Add(const std::vector<uint8_t>& rec);
+  bool empty() const { return rows_.empty(); }
+  size_t size() const { return rows_.size(); }
+  void Clear();
+  bool Build(uint8_t* page) const;
+
+ private:
+  RecordCodec codec_;
+  std::vector<std::vector<uint8_t>> rows_;
+  std::vector<std::vector<uint16_t>> cells_;
+  std::vector<size_t> need_;
+  std::vector<bool> dictionary_;
+  std::vector<std::unordered_map<std::string, uint16_t>> entries_;  // distinct cells of dictionary columns
+  size_t total_ = 0;
+};
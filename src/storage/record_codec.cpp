@@ -0,0 +1,275 @@
+#include "record_codec.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+namespace {
+constexpr uint32_t kMaxFixedChar = 1024;  // wider char[n] columns stay length-prefixed
+const std::string_view kNull = "NULL";
+
+void PutUInt32(std::vector<uint8_t>& out, uint32_t v) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+  out.insert(out.end(), p, p + sizeof(v));
+}
+
+void PutText(std::vector<uint8_t>& out, std::string_view s, bool pointer = false) {
+  PutUInt32(out, static_cast<uint32_t>(s.size()) | (pointer ? RecordCodec::kOverflowBit : 0));
+  out.insert(out.end(), s.begin(), s.end());
+}
+
+template <typename T>
+void PutPod(std::vector<uint8_t>& out, T v) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+bool Bit(const uint8_t* bitmap, size_t i) { return (bitmap[i / 8] >> (i % 8)) & 1; }
+void SetBit(uint8_t* bitmap, size_t i) { bitmap[i / 8] |= static_cast<uint8_t>(1u << (i % 8)); }
+
+// Exact text of an integer / double as the decoder will render it.
+std::string_view Render(int64_t v, char* buf, size_t cap) {
+  auto r = std::to_chars(buf, buf + cap, v);
+  return std::string_view(buf, static_cast<size_t>(r.ptr - buf));
+}
+std::string_view Render(double v, char* buf, size_t cap) {
+  auto r = std::to_chars(buf, buf + cap, v);
+  return std::string_view(buf, static_cast<size_t>(r.ptr - buf));
+}
+
+bool ParseInt(std::string_view s, int64_t& out) {
+  auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+  if (r.ec != std::errc() || r.ptr != s.data() + s.size()) return false;
+  char buf[24];
+  return Render(out, buf, sizeof(buf)) == s;
+}
+
+bool ParseDouble(std::string_view s, double& out) {
+  auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+  if (r.ec != std::errc() || r.ptr != s.data() + s.size()) return false;
+  char buf[32];
+  return Render(out, buf, sizeof(buf)) == s;
+}
+
+bool TakeText(const uint8_t* p, size_t len, size_t& pos, std::string_view& out) {
+  uint32_t n = 0;
+  if (pos + sizeof(uint32_t) > len) return false;
+  std::memcpy(&n, p + pos, sizeof(uint32_t));
+  n &= ~RecordCodec::kOverflowBit;
+  pos += sizeof(uint32_t);
+  if (n > len - pos) return false;
+  out = std::string_view(reinterpret_cast<const char*>(p + pos), n);
+  pos += n;
+  return true;
+}
+}  // namespace
+
+ColumnKind ColumnKindOf(const Field& field, uint32_t& width) {
+  std::string t;
+  for (char c : field.type) {
+    if (!std::isspace(static_cast<unsigned char>(c))) t.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+  }
+  width = 0;
+  if (t == "int" || t == "integer" || t == "smallint" || t == "short" || t == "tinyint") {
+    width = 4;
+    return ColumnKind::kInt32;
+  }
+  if (t == "bigint" || t == "long") {
+    width = 8;
+    return ColumnKind::kInt64;
+  }
+  if (t == "double" || t == "float" || t == "real" || t == "decimal" || t == "numeric") {
+    width = 8;
+    return ColumnKind::kDouble;
+  }
+  if (t.size() > 5 && t.compare(0, 4, "char") == 0 && (t[4] == '[' || t[4] == '(')) {
+    uint32_t n = 0;
+    auto r = std::from_chars(t.data() + 5, t.data() + t.size(), n);
+    if (r.ec != std::errc() || n == 0) n = field.size > 0 ? static_cast<uint32_t>(field.size) : 0;
+    if (n > 0 && n <= kMaxFixedChar) {
+      width = n;
+      return ColumnKind::kChar;
+    }
+  }
+  return ColumnKind::kText;
+}
+
+RecordCodec::RecordCodec(const TableSchema& schema) {
+  typed_ = schema.encoding == RecordEncoding::kTyped;
+  kinds_.resize(schema.fields.size(), ColumnKind::kText);
+  widths_.resize(schema.fields.size(), 0);
+  if (!typed_) return;
+  bitmapBytes_ = (schema.fields.size() + 7) / 8;
+  for (size_t i = 0; i < schema.fields.size(); ++i) kinds_[i] = ColumnKindOf(schema.fields[i], widths_[i]);
+}
+
+RecordCodec RecordCodec::Text(size_t fieldCount) {
+  RecordCodec c;
+  c.kinds_.resize(fieldCount, ColumnKind::kText);
+  c.widths_.resize(fieldCount, 0);
+  return c;
+}
+
+void RecordCodec::Encode(const Record& record, std::vector<uint8_t>& out) const {
+  out.clear();
+  EncodeAppend(record, out);
+}
+
+void RecordCodec::EncodeAppend(const Record& record, std::vector<uint8_t>& out) const {
+  static const std::string kEmpty;
+  const size_t base = out.size();
+  out.push_back(record.valid ? 1 : 0);
+  if (!typed_) {
+    for (size_t i = 0; i < kinds_.size(); ++i) {
+      PutText(out, i < record.values.size() ? record.values[i] : kEmpty, record.Overflowed(i));
+    }
+    return;
+  }
+  out.resize(base + HeaderSize(), 0);
+  for (size_t i = 0; i < kinds_.size(); ++i) {
+    const std::string& v = i < record.values.size() ? record.values[i] : kEmpty;
+    if (record.Overflowed(i)) {
+      if (kinds_[i] != ColumnKind::kText) SetBit(out.data() + base + 1 + bitmapBytes_, i);
+      PutText(out, v, true);
+      continue;
+    }
+    if (v == kNull) {
+      SetBit(out.data() + base + 1, i);
+      continue;
+    }
+    int64_t iv = 0;
+    double dv = 0;
+    switch (kinds_[i]) {
+      case ColumnKind::kInt32:
+        if (ParseInt(v, iv) && iv >= INT32_MIN && iv <= INT32_MAX) {
+          PutPod(out, static_cast<int32_t>(iv));
+          continue;
+        }
+        break;
+      case ColumnKind::kInt64:
+        if (ParseInt(v, iv)) {
+          PutPod(out, iv);
+          continue;
+        }
+        break;
+      case ColumnKind::kDouble:
+        if (ParseDouble(v, dv)) {
+          PutPod(out, dv);
+          continue;
+        }
+        break;
+      case ColumnKind::kChar:
+        if (v.size() <= widths_[i] && (v.empty() || v.back() != '\0')) {
+          out.insert(out.end(), v.begin(), v.end());
+          out.resize(out.size() + (widths_[i] - v.size()), 0);
+          continue;
+        }
+        break;
+      case ColumnKind::kText:
+        PutText(out, v);
+        continue;
+    }
+    SetBit(out.data() + base + 1 + bitmapBytes_, i);
+    PutText(out, v);
+  }
+}
+
+bool RecordCodec::OverflowCell(const uint8_t* cell, size_t len) {
+  uint32_t n = 0;
+  if (len < sizeof(n)) return false;
+  std::memcpy(&n, cell, sizeof(n));
+  return (n & kOverflowBit) != 0;
+}
+
+size_t RecordCodec::FieldWidth(const uint8_t* header, size_t i) const {
+  if (!typed_) return kLengthPrefixed;
+  if (Bit(header + 1, i)) return 0;
+  if (kinds_[i] == ColumnKind::kText || Bit(header + 1 + bitmapBytes_, i)) return kLengthPrefixed;
+  return widths_[i];
+}
+
+bool RecordCodec::DecodeField(const uint8_t* header, size_t i, const uint8_t* p, size_t len, std::string_view& out, std::string& scratch,
+                              StoredNumber* number) const {
+  return DecodeCell(i, FieldWidth(header, i), p, len, out, scratch, number);
+}
+
+bool RecordCodec::DecodeCell(size_t i, size_t width, const uint8_t* p, size_t len, std::string_view& out, std::string& scratch,
+                             StoredNumber* number) const {
+  StoredNumber unused;
+  StoredNumber& n = number ? *number : unused;
+  n.type = StoredNumber::Type::kNone;
+  if (width == kLengthPrefixed) {
+    size_t pos = 0;
+    return TakeText(p, len, pos, out) && pos == len;
+  }
+  if (width != len) return false;
+  if (width == 0) {
+    out = kNull;
+    return true;
+  }
+  if (kinds_[i] == ColumnKind::kChar) {
+    size_t n = width;
+    while (n > 0 && p[n - 1] == 0) --n;
+    out = std::string_view(reinterpret_cast<const char*>(p), n);
+    return true;
+  }
+  char buf[32];
+  if (kinds_[i] == ColumnKind::kInt32) {
+    int32_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    n.type = StoredNumber::Type::kInt;
+    n.i = v;
+    scratch.assign(Render(n.i, buf, sizeof(buf)));
+  } else if (kinds_[i] == ColumnKind::kInt64) {
+    std::memcpy(&n.i, p, sizeof(n.i));
+    n.type = StoredNumber::Type::kInt;
+    scratch.assign(Render(n.i, buf, sizeof(buf)));
+  } else {
+    std::memcpy(&n.d, p, sizeof(n.d));
+    n.type = StoredNumber::Type::kDouble;
+    scratch.assign(Render(n.d, buf, sizeof(buf)));
+  }
+  out = scratch;
+  return true;
+}
+
+bool RecordCodec::Decode(const uint8_t* p, size_t len, RecordView& out, std::vector<std::string>& scratch, size_t* used) const {
+  if (len < HeaderSize()) return false;
+  out.valid = p[0] != 0;
+  out.values.resize(kinds_.size());
+  out.overflow.clear();
+  out.numbers.resize(typed_ ? kinds_.size() : 0);
+  if (typed_ && scratch.size() < kinds_.size()) scratch.resize(kinds_.size());
+  std::string unused;  // text records render nothing
+  size_t pos = HeaderSize();
+  for (size_t i = 0; i < kinds_.size(); ++i) {
+    size_t width = FieldWidth(p, i);
+    if (width == kLengthPrefixed) {
+      uint32_t n = 0;
+      if (len - pos < sizeof(n)) return false;
+      std::memcpy(&n, p + pos, sizeof(n));
+      if (n & kOverflowBit) {
+        if (out.overflow.empty()) out.overflow.resize(kinds_.size());
+        out.overflow[i] = true;
+        n &= ~kOverflowBit;
+      }
+      if (n > len - pos - sizeof(n)) return false;
+      width = sizeof(n) + n;
+    }
+    StoredNumber* number = typed_ ? &out.numbers[i] : nullptr;
+    if (width > len - pos || !DecodeField(p, i, p + pos, width, out.values[i], typed_ ? scratch[i] : unused, number)) return false;
+    pos += width;
+  }
+  if (used) *used = pos;
+  return true;
+}
+
+bool RecordCodec::Decode(const uint8_t* p, size_t len, Record& out) const {
+  RecordView view;
+  std::vector<std::string> scratch;
+  if (!Decode(p, len, view, scratch)) return false;
+  out = view.Materialize();
+  return true;
+}
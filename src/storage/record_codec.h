@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../db_types.h"
+
+// Physical type of a column under ENCODING=TYPED, derived from Field::type.
+enum class ColumnKind : uint8_t {
+  kText,    // u32 length + bytes
+  kInt32,   // int, smallint, tinyint: 4-byte little-endian
+  kInt64,   // bigint, long: 8-byte little-endian
+  kDouble,  // double, float, real, decimal, numeric: 8-byte IEEE-754
+  kChar     // char[n]: n bytes, NUL padded
+};
+
+ColumnKind ColumnKindOf(const Field& field, uint32_t& width);
+
+// Record layout of one table.
+//   text:  valid byte | per field: u32 length + bytes
+//   typed: valid byte | null bitmap | spill bitmap | non-null columns
+// A typed value that does not round-trip exactly through its column kind
+// (e.g. "007" in an int column, 40 chars in a char[32]) is spilled: stored
+// as u32 length + bytes with its spill bit set. NULL is the "NULL" literal.
+// A field holding an Overflow pointer (Record::overflow) is always stored
+// length-prefixed, with kOverflowBit set in the length.
+class RecordCodec {
+ public:
+  explicit RecordCodec(const TableSchema& schema);
+  static RecordCodec Text(size_t fieldCount);
+
+  bool typed() const { return typed_; }
+  size_t fieldCount() const { return kinds_.size(); }
+  ColumnKind kind(size_t i) const { return kinds_[i]; }
+  uint32_t width(size_t i) const { return widths_[i]; }  // kChar: n
+
+  void Encode(const Record& record, std::vector<uint8_t>& out) const;
+  // Same, appended to out (building a block in place).
+  void EncodeAppend(const Record& record, std::vector<uint8_t>& out) const;
+
+  // Decode the record at p (at most len bytes); used = its encoded length.
+  // Views point into p, or into scratch for values rendered from binary;
+  // out.numbers keeps those values' binary form.
+  bool Decode(const uint8_t* p, size_t len, RecordView& out, std::vector<std::string>& scratch, size_t* used = nullptr) const;
+  bool Decode(const uint8_t* p, size_t len, Record& out) const;
+
+  // Incremental sizing for readers that fetch a record piecewise:
+  // HeaderSize() bytes first, then per field FieldWidth() bytes, or a u32
+  // length and that many bytes when it returns kLengthPrefixed.
+  static constexpr size_t kLengthPrefixed = static_cast<size_t>(-1);
+  static constexpr uint32_t kOverflowBit = 0x80000000u;
+  // A length-prefixed cell (prefix included) that holds an Overflow pointer;
+  // DecodeCell / DecodeField give the pointer itself as the value.
+  static bool OverflowCell(const uint8_t* cell, size_t len);
+  size_t HeaderSize() const { return typed_ ? 1 + 2 * bitmapBytes_ : 1; }
+  size_t FieldWidth(const uint8_t* header, size_t i) const;
+  // Decode field i from just its bytes (len as sized above, length prefix
+  // included), given the record's header; rendered values go to scratch,
+  // and to number (if given) as stored.
+  bool DecodeField(const uint8_t* header, size_t i, const uint8_t* p, size_t len, std::string_view& out, std::string& scratch,
+                   StoredNumber* number = nullptr) const;
+  // The same with the width already known (dictionary entries carry no header).
+  bool DecodeCell(size_t i, size_t width, const uint8_t* p, size_t len, std::string_view& out, std::string& scratch,
+                  StoredNumber* number = nullptr) const;
+
+ private:
+  RecordCodec() = default;
+
+  bool typed_ = false;
+  size_t bitmapBytes_ = 0;
+  std::vector<ColumnKind> kinds_;
+  std::vector<uint32_t> widths_;
+};
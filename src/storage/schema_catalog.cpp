@@ -0,0 +1,76 @@
+#include "schema_catalog.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+namespace {
+std::string Lower(const std::string& s) {
+  std::string out = s;
+  std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return out;
+}
+}  // namespace
+
+const TableSchema* SchemaSnapshot::Find(const std::string& name) const {
+  auto it = byName_.find(name);
+  return it == byName_.end() ? nullptr : &tables[it->second];
+}
+
+const TableSchema* SchemaSnapshot::FindNoCase(const std::string& name) const {
+  auto it = byLowerName_.find(Lower(name));
+  return it == byLowerName_.end() ? nullptr : &tables[it->second];
+}
+
+std::string SchemaCatalog::Key(const std::string& path) {
+  return std::filesystem::path(path).lexically_normal().string();
+}
+
+std::shared_ptr<const SchemaSnapshot> SchemaCatalog::Get(const std::string& dbfPath, const Loader& load, std::string& err) {
+  const std::string key = Key(dbfPath);
+  uint64_t version = 0;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = snapshots_.find(key);
+    if (it != snapshots_.end()) return it->second;
+    version = versions_[key];
+  }
+
+  // Parse outside the lock; a write that lands meanwhile bumps the version.
+  auto snap = std::make_shared<SchemaSnapshot>();
+  if (!load(snap->tables, err)) return nullptr;
+  snap->version = version;
+  for (size_t i = 0; i < snap->tables.size(); ++i) {
+    snap->byName_.emplace(snap->tables[i].tableName, i);  // first wins, as the linear lookups did
+    snap->byLowerName_.emplace(Lower(snap->tables[i].tableName), i);
+  }
+
+  std::lock_guard<std::mutex> lock(mu_);
+  if (versions_[key] == version) snapshots_[key] = snap;
+  return snap;
+}
+
+void SchemaCatalog::Invalidate(const std::string& dbfPath) {
+  const std::string key = Key(dbfPath);
+  std::lock_guard<std::mutex> lock(mu_);
+  snapshots_.erase(key);
+  ++versions_[key];
+}
+
+void SchemaCatalog::InvalidateDir(const std::string& dir) {
+  const std::string p = (std::filesystem::path(dir) / "").lexically_normal().string();
+  std::lock_guard<std::mutex> lock(mu_);
+  for (auto& kv : versions_) {
+    if (kv.first.compare(0, p.size(), p) == 0) ++kv.second;
+  }
+  for (auto it = snapshots_.begin(); it != snapshots_.end();) {
+    if (it->first.compare(0, p.size(), p) == 0) it = snapshots_.erase(it);
+    else ++it;
+  }
+}
+
+uint64_t SchemaCatalog::Version(const std::string& dbfPath) const {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = versions_.find(Key(dbfPath));
+  return it == versions_.end() ? 0 : it->second;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../db_types.h"
+
+// One database's parsed .dbf. Immutable once published, so readers share it
+// without locking.
+struct SchemaSnapshot {
+  uint64_t version = 0;  // SchemaCatalog::Version when it was parsed
+  std::vector<TableSchema> tables;  // .dbf order
+
+  // nullptr when absent. FindNoCase returns the first match in file order.
+  const TableSchema* Find(const std::string& name) const;
+  const TableSchema* FindNoCase(const std::string& name) const;
+
+ private:
+  friend class SchemaCatalog;
+  std::unordered_map<std::string, size_t> byName_;
+  std::unordered_map<std::string, size_t> byLowerName_;
+};
+
+// Parsed .dbf files keyed by path. Each database has a version that only
+// grows: every schema write bumps it and drops the cached snapshot, and a
+// snapshot parsed while the version moved is returned but not cached.
+// Anything that writes, replaces or removes a .dbf must Invalidate it.
+class SchemaCatalog {
+ public:
+  using Loader = std::function<bool(std::vector<TableSchema>&, std::string&)>;
+
+  // Cached snapshot, or one parsed by load; nullptr + err when load fails.
+  std::shared_ptr<const SchemaSnapshot> Get(const std::string& dbfPath, const Loader& load, std::string& err);
+  void Invalidate(const std::string& dbfPath);
+  // Every .dbf under dir (a dropped or overwritten database directory).
+  void InvalidateDir(const std::string& dir);
+  uint64_t Version(const std::string& dbfPath) const;
+
+ private:
+  static std::string Key(const std::string& path);
+
+  mutable std::mutex mu_;
+  std::unordered_map<std::string, std::shared_ptr<const SchemaSnapshot>> snapshots_;
+  std::unordered_map<std::string, uint64_t> versions_;
+};
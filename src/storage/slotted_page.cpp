@@ -0,0 +1,104 @@
+#include "slotted_page.h"
+
+#include <cstring>
+
+#include "crc32c.h"
+
+namespace {
+constexpr size_t kLsnOff = 0;
+constexpr size_t kCrcOff = 8;
+constexpr size_t kCountOff = 12;
+constexpr size_t kFreeOff = 14;
+
+template <typename T>
+T Load(const uint8_t* p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+template <typename T>
+void Store(uint8_t* p, T v) {
+  std::memcpy(p, &v, sizeof(T));
+}
+}  // namespace
+
+uint32_t PageChecksum(const uint8_t* page) {
+  static const uint8_t kZero[4] = {};
+  uint32_t crc = Crc32c(page, kCrcOff);
+  crc = Crc32c(kZero, sizeof(kZero), crc);
+  crc = Crc32c(page + kCrcOff + 4, kPageSize - kCrcOff - 4, crc);
+  return crc ? crc : 1;
+}
+
+void StampPageChecksum(uint8_t* page) { Store(page + kCrcOff, PageChecksum(page)); }
+
+bool PageChecksumOk(const uint8_t* page) {
+  const uint32_t stored = Load<uint32_t>(page + kCrcOff);
+  return stored == 0 ? PageBlank(page) : stored == PageChecksum(page);
+}
+
+bool PageBlank(const uint8_t* page) {
+  return page[0] == 0 && std::memcmp(page, page + 1, kPageSize - 1) == 0;
+}
+
+void SlottedPage::Init() {
+  std::memset(data_, 0, kPageSize);
+  SetFreePtr(static_cast<uint16_t>(kPageSize));
+}
+
+bool SlottedPage::IsInitialized() const { return FreePtr() != 0; }
+
+uint64_t SlottedPage::Lsn() const { return Load<uint64_t>(data_ + kLsnOff); }
+void SlottedPage::SetLsn(uint64_t lsn) { Store(data_ + kLsnOff, lsn); }
+uint32_t SlottedPage::Checksum() const { return Load<uint32_t>(data_ + kCrcOff); }
+void SlottedPage::SetChecksum(uint32_t crc) { Store(data_ + kCrcOff, crc); }
+uint16_t SlottedPage::SlotCount() const { return Load<uint16_t>(data_ + kCountOff); }
+uint16_t SlottedPage::FreePtr() const { return Load<uint16_t>(data_ + kFreeOff); }
+void SlottedPage::SetSlotCount(uint16_t n) { Store(data_ + kCountOff, n); }
+void SlottedPage::SetFreePtr(uint16_t p) { Store(data_ + kFreeOff, p); }
+
+uint32_t SlottedPage::FreeSpace() const {
+  uint32_t used = kHeaderSize + kSlotSize * SlotCount();
+  uint32_t free_ptr = FreePtr();
+  return free_ptr > used ? free_ptr - used : 0;
+}
+
+bool SlottedPage::Get(uint16_t slot, const uint8_t*& out, uint16_t& len) const {
+  if (slot >= SlotCount()) return false;
+  const uint8_t* s = data_ + kHeaderSize + kSlotSize * slot;
+  uint16_t off = Load<uint16_t>(s);
+  len = Load<uint16_t>(s + 2);
+  if (off < kHeaderSize || static_cast<uint32_t>(off) + len > kPageSize) return false;
+  out = data_ + off;
+  return true;
+}
+
+bool SlottedPage::Insert(const uint8_t* rec, uint16_t len, uint16_t& out_slot) {
+  if (FreeSpace() < static_cast<uint32_t>(len) + kSlotSize) return false;
+  uint16_t slot = SlotCount();
+  uint16_t off = static_cast<uint16_t>(FreePtr() - len);
+  std::memcpy(data_ + off, rec, len);
+  uint8_t* s = data_ + kHeaderSize + kSlotSize * slot;
+  Store(s, off);
+  Store(s + 2, len);
+  SetSlotCount(static_cast<uint16_t>(slot + 1));
+  SetFreePtr(off);
+  out_slot = slot;
+  return true;
+}
+
+bool SlottedPage::Overwrite(uint16_t slot, const uint8_t* rec, uint16_t len) {
+  const uint8_t* cur = nullptr;
+  uint16_t cur_len = 0;
+  if (!Get(slot, cur, cur_len) || cur_len != len) return false;
+  std::memcpy(const_cast<uint8_t*>(cur), rec, len);
+  return true;
+}
+
+bool SlottedPage::PutAt(uint16_t slot, const uint8_t* rec, uint16_t len) {
+  if (slot < SlotCount()) return Overwrite(slot, rec, len);
+  if (slot != SlotCount()) return false;
+  uint16_t got = 0;
+  return Insert(rec, len, got);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size slotted page used by STORAGE=PAGED tables.
+//
+//   [header 16B][slot 0][slot 1]...  free space  ...[record 1][record 0]
+//
+// header: u64 page LSN | u32 checksum (0 = unset) | u16 slot count | u16 free pointer
+// slot:   u16 record offset | u16 record length
+// Records are the SerializeRecord bytes (valid flag + fields); a tombstone
+// keeps its slot so RIDs stay stable.
+constexpr uint32_t kPageSize = 8192;
+
+// RID of a paged record, stored wherever a file offset used to go.
+inline int64_t MakePageRid(uint64_t page, uint16_t slot) {
+  return static_cast<int64_t>((page << 16) | slot);
+}
+inline uint64_t RidPage(int64_t rid) { return static_cast<uint64_t>(rid) >> 16; }
+inline uint16_t RidSlot(int64_t rid) { return static_cast<uint16_t>(rid & 0xFFFF); }
+
+// Page checksums, shared by both page layouts (the u32 at offset 8): CRC32C
+// of the page with that field taken as zero, never 0 itself. Stamped when a
+// page is written to its file, so a field of 0 passes only on an all-zero
+// page (a hole nothing was written to); anywhere else it is damage.
+uint32_t PageChecksum(const uint8_t* page);
+void StampPageChecksum(uint8_t* page);
+bool PageChecksumOk(const uint8_t* page);
+bool PageBlank(const uint8_t* page);
+
+class SlottedPage {
+ public:
+  static constexpr uint32_t kHeaderSize = 16;
+  static constexpr uint32_t kSlotSize = 4;
+
+  explicit SlottedPage(uint8_t* data) : data_(data) {}
+
+  void Init();
+  bool IsInitialized() const;
+
+  uint64_t Lsn() const;
+  void SetLsn(uint64_t lsn);
+  uint32_t Checksum() const;
+  void SetChecksum(uint32_t crc);
+  uint16_t SlotCount() const;
+  uint32_t FreeSpace() const;
+
+  bool Get(uint16_t slot, const uint8_t*& out, uint16_t& len) const;
+  // Append a new slot; false when the page is full.
+  bool Insert(const uint8_t* rec, uint16_t len, uint16_t& out_slot);
+  // Same-length in-place overwrite (updates, tombstones).
+  bool Overwrite(uint16_t slot, const uint8_t* rec, uint16_t len);
+  // Redo helper: overwrite an existing slot or insert it as the next slot.
+  bool PutAt(uint16_t slot, const uint8_t* rec, uint16_t len);
+
+  static size_t MaxRecordSize() { return kPageSize - kHeaderSize - kSlotSize; }
+
+ private:
+  uint16_t FreePtr() const;
+  void SetSlotCount(uint16_t n);
+  void SetFreePtr(uint16_t p);
+
+  uint8_t* data_;
+};
@@ -0,0 +1,356 @@
+#include "zone_map.h"
+#include "crc32c.h"
+#include "file_handle_cache.h"
+#include "pax_page.h"
+#include "slotted_page.h"
+#include "../value.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+constexpr uint32_t kMagic = 0x4D5A4244;  // "DBZM"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kMaxBound = 64;  // longer text bounds are cut
+constexpr size_t kBloomBitsPerKey = 10;
+constexpr uint64_t kBloomProbes = 7;  // about 1% false positives
+// Numbers Satisfies calls equal (ints exactly, doubles within 1e-9) fall in
+// the same or adjacent buckets 2^-29 wide. From 2^33 on doubles are more
+// than 1e-9 apart, so there only identical values are equal.
+constexpr double kBucketScale = 536870912.0;   // 2^29
+constexpr double kBucketLimit = 8589934592.0;  // 2^33
+
+template <typename T>
+void Put(std::string& out, T v) {
+  out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+void PutStr(std::string& out, const std::string& s) {
+  Put(out, static_cast<uint32_t>(s.size()));
+  out.append(s);
+}
+
+template <typename T>
+bool Get(const std::string& in, size_t& pos, T& v) {
+  if (in.size() - pos < sizeof(T)) return false;
+  std::memcpy(&v, in.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+bool GetStr(const std::string& in, size_t& pos, std::string& s) {
+  uint32_t len = 0;
+  if (!Get(in, pos, len) || in.size() - pos < len) return false;
+  s.assign(in, pos, len);
+  pos += len;
+  return true;
+}
+
+// What MatchBound compares: the value with one pair of quotes stripped.
+std::string_view Unquote(std::string_view s) {
+  if (s.size() >= 2 && ((s.front() == '\'' && s.back() == '\'') || (s.front() == '"' && s.back() == '"'))) {
+    return s.substr(1, s.size() - 2);
+  }
+  return s;
+}
+
+// Numbers ordered as Satisfies orders them against each other.
+bool Less(const Value& a, const Value& b) {
+  if (a.type == Value::Type::kInt && b.type == Value::Type::kInt) return a.i < b.i;
+  return a.AsDouble() < b.AsDouble();
+}
+
+uint64_t Hash(char tag, const void* data, size_t len) {
+  uint64_t h = 1469598103934665603ULL ^ static_cast<unsigned char>(tag);
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < len; ++i) h = (h ^ p[i]) * 1099511628211ULL;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+uint64_t TextKey(std::string_view text) { return Hash('t', text.data(), text.size()); }
+
+uint64_t BucketKey(int64_t bucket) { return Hash('n', &bucket, sizeof(bucket)); }
+
+uint64_t ExactKey(double d) {
+  if (d == 0) d = 0;  // -0.0
+  uint64_t bits = 0;
+  std::memcpy(&bits, &d, sizeof(bits));
+  return Hash('x', &bits, sizeof(bits));
+}
+
+uint64_t NumberKey(double d) {
+  if (std::abs(d) >= kBucketLimit) return ExactKey(d);
+  return BucketKey(static_cast<int64_t>(std::floor(d * kBucketScale)));
+}
+
+uint64_t BloomBit(uint64_t h, uint64_t probe, size_t bytes) {
+  return (h + probe * ((h >> 32) | 1)) % (bytes * 8);
+}
+
+bool BloomTest(const std::string& bits, uint64_t h) {
+  for (uint64_t k = 0; k < kBloomProbes; ++k) {
+    const uint64_t bit = BloomBit(h, k, bits.size());
+    if (!(static_cast<unsigned char>(bits[bit / 8]) & (1u << (bit % 8)))) return false;
+  }
+  return true;
+}
+
+std::string BuildBloom(std::vector<uint64_t>& keys) {
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  const size_t bytes = std::max<size_t>(8, (keys.size() * kBloomBitsPerKey + 63) / 64 * 8);
+  std::string bits(bytes, '\0');
+  for (uint64_t h : keys) {
+    for (uint64_t k = 0; k < kBloomProbes; ++k) {
+      const uint64_t bit = BloomBit(h, k, bytes);
+      bits[bit / 8] = static_cast<char>(bits[bit / 8] | (1u << (bit % 8)));
+    }
+  }
+  keys.clear();
+  return bits;
+}
+
+void EncodeZone(const Zone& z, std::string& out) {
+  std::string body;
+  Put(body, z.unit);
+  Put(body, z.begin);
+  Put(body, z.end);
+  Put(body, z.rows);
+  Put(body, z.stamp);
+  Put(body, static_cast<uint32_t>(z.columns.size()));
+  for (const auto& c : z.columns) {
+    Put(body, c.flags);
+    PutStr(body, c.numMin);
+    PutStr(body, c.numMax);
+    PutStr(body, c.textMin);
+    PutStr(body, c.textMax);
+    if (c.flags & ColumnZone::kBloom) PutStr(body, c.bloom);
+  }
+  Put(out, static_cast<uint32_t>(body.size()));
+  Put(out, Crc32c(body.data(), body.size()));
+  out.append(body);
+}
+
+bool DecodeZone(const std::string& body, Zone& z) {
+  size_t pos = 0;
+  uint32_t count = 0;
+  if (!Get(body, pos, z.unit) || !Get(body, pos, z.begin) || !Get(body, pos, z.end) || !Get(body, pos, z.rows) ||
+      !Get(body, pos, z.stamp) || !Get(body, pos, count)) {
+    return false;
+  }
+  z.columns.clear();
+  z.columns.resize(count);
+  for (auto& c : z.columns) {
+    if (!Get(body, pos, c.flags) || !GetStr(body, pos, c.numMin) || !GetStr(body, pos, c.numMax) ||
+        !GetStr(body, pos, c.textMin) || !GetStr(body, pos, c.textMax) ||
+        ((c.flags & ColumnZone::kBloom) && (!GetStr(body, pos, c.bloom) || c.bloom.empty()))) {
+      return false;
+    }
+  }
+  return pos == body.size();
+}
+}  // namespace
+
+bool ColumnZone::MayEqual(const Value& v) const {
+  if (!(flags & kBloom)) return true;
+  if (BloomTest(bloom, TextKey(v.text))) return true;  // text comparisons
+  if (!v.numeric()) return false;
+  const double d = v.AsDouble();
+  if (std::isnan(d)) return false;
+  if (std::abs(d) >= kBucketLimit) return BloomTest(bloom, ExactKey(d));
+  const int64_t bucket = static_cast<int64_t>(std::floor(d * kBucketScale));
+  return BloomTest(bloom, BucketKey(bucket - 1)) || BloomTest(bloom, BucketKey(bucket)) ||
+         BloomTest(bloom, BucketKey(bucket + 1));
+}
+
+ZoneBuilder::ZoneBuilder(const TableSchema& schema) {
+  kinds_.resize(schema.fields.size());
+  bloom_.resize(kinds_.size());
+  keys_.resize(kinds_.size());
+  for (size_t i = 0; i < kinds_.size(); ++i) {
+    uint32_t width = 0;
+    kinds_[i] = ColumnKindOf(schema.fields[i], width);
+    bloom_[i] = schema.fields[i].bloom;
+  }
+  columns_.resize(kinds_.size());
+  numMin_.resize(kinds_.size());
+  numMax_.resize(kinds_.size());
+  seen_.assign(kinds_.size(), false);
+  opaque_.assign(kinds_.size(), false);
+}
+
+void ZoneBuilder::Add(const Record& row) {
+  for (size_t i = 0; i < row.values.size() && i < columns_.size(); ++i) AddValue(i, row.values[i], nullptr, row.Overflowed(i));
+  ++rows_;
+}
+
+void ZoneBuilder::Add(const RecordView& row) {
+  for (size_t i = 0; i < row.values.size() && i < columns_.size(); ++i) {
+    AddValue(i, row.values[i], i < row.numbers.size() ? &row.numbers[i] : nullptr, row.Overflowed(i));
+  }
+  ++rows_;
+}
+
+void ZoneBuilder::AddValue(size_t field, std::string_view raw, const StoredNumber* stored, bool pointer) {
+  ColumnZone& c = columns_[field];
+  if (pointer) {  // the value itself is not at hand
+    c.flags |= ColumnZone::kUnordered;
+    opaque_[field] = true;
+    return;
+  }
+  const std::string_view text = Unquote(raw);
+  const std::string_view cut = text.substr(0, kMaxBound);
+  if (!seen_[field]) {
+    seen_[field] = true;
+    c.textMin.assign(cut);
+    c.textMax.assign(cut);
+    if (cut.size() < text.size()) c.flags |= ColumnZone::kTextMaxOpen;
+  } else {
+    if (cut < std::string_view(c.textMin)) c.textMin.assign(cut);
+    if (!(c.flags & ColumnZone::kTextMaxOpen) && text > std::string_view(c.textMax)) {
+      c.textMax.assign(cut);
+      if (cut.size() < text.size()) c.flags |= ColumnZone::kTextMaxOpen;
+    }
+  }
+
+  const Value v = Value::Of(text, kinds_[field], stored);
+  const bool nan = v.type == Value::Type::kDouble && std::isnan(v.d);
+  if (bloom_[field]) {
+    keys_[field].push_back(TextKey(text));
+    if (v.numeric() && !nan) keys_[field].push_back(NumberKey(v.AsDouble()));
+  }
+  if (!v.numeric()) {
+    c.flags |= ColumnZone::kTexts;
+    return;
+  }
+  if (nan) {
+    c.flags |= ColumnZone::kUnordered;
+    return;
+  }
+  if (!(c.flags & ColumnZone::kNumbers)) {
+    c.flags |= ColumnZone::kNumbers;
+    c.numMin.assign(text);
+    c.numMax.assign(text);
+    numMin_[field] = numMax_[field] = v;
+    return;
+  }
+  if (Less(v, numMin_[field])) {
+    c.numMin.assign(text);
+    numMin_[field] = v;
+  }
+  if (Less(numMax_[field], v)) {
+    c.numMax.assign(text);
+    numMax_[field] = v;
+  }
+}
+
+bool ZoneBuilder::AddPage(const RecordCodec& codec, const uint8_t* page, bool columnar) {
+  uint8_t* data = const_cast<uint8_t*>(page);  // read-only use
+  RecordView row;
+  std::vector<std::string> scratch;
+  if (columnar) {
+    PaxPage pg(data);
+    if (!pg.IsInitialized()) return true;
+    std::vector<uint8_t> bytes;
+    for (uint16_t r = 0; r < pg.RowCount(); ++r) {
+      if (!pg.Get(r, bytes) || !codec.Decode(bytes.data(), bytes.size(), row, scratch)) return false;
+      Add(row);
+    }
+    return true;
+  }
+  SlottedPage pg(data);
+  if (!pg.IsInitialized()) return true;
+  for (uint16_t s = 0; s < pg.SlotCount(); ++s) {
+    const uint8_t* rec = nullptr;
+    uint16_t len = 0;
+    if (!pg.Get(s, rec, len) || len == 0) continue;
+    if (!codec.Decode(rec, len, row, scratch)) return false;
+    Add(row);
+  }
+  return true;
+}
+
+Zone ZoneBuilder::Take(uint64_t unit, uint64_t begin, uint64_t end, uint32_t stamp) {
+  Zone z;
+  z.unit = unit;
+  z.begin = begin;
+  z.end = end;
+  z.rows = rows_;
+  z.stamp = stamp;
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    if (!bloom_[i]) continue;
+    if (opaque_[i]) {
+      keys_[i].clear();
+      continue;
+    }
+    columns_[i].bloom = BuildBloom(keys_[i]);
+    columns_[i].flags |= ColumnZone::kBloom;
+  }
+  z.columns.swap(columns_);
+  columns_.assign(kinds_.size(), ColumnZone());
+  seen_.assign(kinds_.size(), false);
+  opaque_.assign(kinds_.size(), false);
+  rows_ = 0;
+  return z;
+}
+
+std::string ZoneMap::PathFor(const std::string& data_path) {
+  std::filesystem::path p = data_path;
+  p.replace_extension(".zm");
+  return p.string();
+}
+
+void ZoneMap::Load(const std::string& data_path, std::vector<Zone>& out) {
+  out.clear();
+  std::string ignore;
+  auto file = FileHandleCache::Instance().Open(PathFor(data_path), false, ignore);
+  uint64_t size = 0;
+  if (!file || !file->Size(size) || size < kHeaderSize) return;
+  std::string bytes(static_cast<size_t>(size), '\0');
+  size_t got = 0;
+  if (!file->ReadAt(0, &bytes[0], bytes.size(), got)) return;
+  bytes.resize(got);
+  size_t pos = 0;
+  uint32_t magic = 0, version = 0;
+  if (!Get(bytes, pos, magic) || !Get(bytes, pos, version) || magic != kMagic || version != kVersion) return;
+  std::string body;
+  while (pos < bytes.size()) {
+    uint32_t len = 0, crc = 0;
+    if (!Get(bytes, pos, len) || !Get(bytes, pos, crc) || bytes.size() - pos < len) return;  // torn tail
+    body.assign(bytes, pos, len);
+    pos += len;
+    Zone z;
+    if (Crc32c(body.data(), body.size()) != crc || !DecodeZone(body, z)) return;
+    out.push_back(std::move(z));
+  }
+}
+
+bool ZoneMap::Append(const std::string& data_path, const std::vector<Zone>& zones) {
+  if (zones.empty()) return true;
+  std::string ignore;
+  auto file = FileHandleCache::Instance().Open(PathFor(data_path), true, ignore);
+  uint64_t size = 0;
+  if (!file || !file->Size(size)) return false;
+  std::string bytes;
+  if (size == 0) {
+    Put(bytes, kMagic);
+    Put(bytes, kVersion);
+  }
+  for (const auto& z : zones) EncodeZone(z, bytes);
+  uint64_t at = 0;
+  return file->Append(bytes.data(), bytes.size(), at);
+}
+
+void ZoneMap::Remove(const std::string& data_path) {
+  FileHandleCache::Instance().Invalidate(PathFor(data_path));
+  std::error_code ec;
+  std::filesystem::remove(PathFor(data_path), ec);
+}
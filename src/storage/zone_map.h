@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../db_types.h"
+#include "../value.h"
+#include "record_codec.h"
+
+// Bounds of one column over a zone's rows, as WHERE sees the values: numbers
+// compare numerically against numbers, everything else (NULL included) by
+// text, so both orders are kept.
+struct ColumnZone {
+  enum : uint8_t {
+    kNumbers = 1,      // numMin/numMax hold
+    kTexts = 2,        // some value is not a number
+    kTextMaxOpen = 4,  // textMax was too long to keep: no upper text bound
+    kUnordered = 8,    // a NaN or an out-of-line value: nothing can be ruled out
+    kBloom = 16        // bloom holds a filter (Field::bloom columns)
+  };
+  uint8_t flags = 0;
+  std::string numMin, numMax;    // over the numbers
+  std::string textMin, textMax;  // byte order over every value
+  std::string bloom;             // bit array
+
+  // False only when no value of the zone can equal v under Satisfies or by
+  // text; always true without a filter.
+  bool MayEqual(const Value& v) const;
+};
+
+// A run of rows with per-column bounds: one page of a paged or columnar
+// file, or a stripe of consecutive rows of a row block. stamp is the
+// checksum of the page / block the bounds were taken from, so a zone only
+// applies while that page or sealed block is unchanged.
+struct Zone {
+  uint64_t unit = 0;   // page number; row files: offset of the block
+  uint64_t begin = 0;  // row files: bytes [begin, end) holding the rows
+  uint64_t end = 0;
+  uint32_t rows = 0;
+  uint32_t stamp = 0;
+  std::vector<ColumnZone> columns;  // by schema field
+};
+
+// Accumulates the bounds of the rows added since the last Take.
+class ZoneBuilder {
+ public:
+  explicit ZoneBuilder(const TableSchema& schema);
+
+  void Add(const Record& row);
+  void Add(const RecordView& row);
+  // Every row of a page of either layout, deleted ones included.
+  bool AddPage(const RecordCodec& codec, const uint8_t* page, bool columnar);
+  uint32_t rows() const { return rows_; }
+  Zone Take(uint64_t unit, uint64_t begin, uint64_t end, uint32_t stamp);
+
+ private:
+  // pointer: text is an Overflow pointer, not the value.
+  void AddValue(size_t field, std::string_view text, const StoredNumber* stored, bool pointer);
+
+  std::vector<ColumnKind> kinds_;
+  std::vector<ColumnZone> columns_;
+  std::vector<Value> numMin_, numMax_;  // per column: numMin / numMax as numbers (text unused)
+  std::vector<bool> seen_;  // per column: any value yet
+  std::vector<bool> bloom_;
+  std::vector<bool> opaque_;  // per column: an overflow pointer, no filter
+  std::vector<std::vector<uint64_t>> keys_;  // per bloom column: key hashes
+  uint32_t rows_ = 0;
+};
+
+// Sidecar "<data>.zm": zones appended as pages fill and row blocks are
+// written, so scans can skip what a range predicate rules out. Entries are
+// only hints; a zone whose stamp no longer matches is ignored, and a torn
+// or damaged tail hides the entries after it. Rewrites of the data file
+// stage a fresh sidecar next to the staged file, installed with it
+// (StorageEngine::InstallStaged).
+class ZoneMap {
+ public:
+  // Row blocks get one zone per stripe of this many rows; blocks with fewer
+  // than kMinBlockRows rows (single-row inserts) get none.
+  static constexpr uint32_t kStripeRows = 1024;
+  static constexpr uint32_t kMinBlockRows = 64;
+
+  static std::string PathFor(const std::string& data_path);
+  // Missing or unreadable sidecar = no zones.
+  static void Load(const std::string& data_path, std::vector<Zone>& out);
+  static bool Append(const std::string& data_path, const std::vector<Zone>& zones);
+  static void Remove(const std::string& data_path);
+};
@@ -6,12 +6,249 @@
 #include <map>          // �ṩ std::map
 #include <vector>       // �ṩ std::vector����Ȼ storage_engine.h �Ѱ�������������ʽ��������ȫ��
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <set>
 #include <filesystem>
 #include "path_utils.h"
+#include "storage/block_directory.h"
+#include "storage/crc32c.h"
+#include "storage/file_handle_cache.h"
+#include <cstdlib>
+#include <cstring>
 namespace fs = std::filesystem;       // �ṩ std::string��ͬ�ϣ�
 
+namespace {
+// fsync through the shared descriptor; a missing file has nothing to sync.
+bool SyncFile(const std::string& path, std::string& err) {
+    std::error_code ec;
+    if (!fs::exists(path, ec)) return true;
+    auto file = FileHandleCache::Instance().Open(path, false, err);
+    if (!file || !file->Sync()) {
+        err = "Sync failed: " + path;
+        return false;
+    }
+    return true;
+}
+
+bool SyncParentDir(const std::string& path, std::string& err) {
+    const std::string dir = fs::path(path).parent_path().string();
+    if (!FileHandle::SyncDirectory(dir.empty() ? "." : dir)) {
+        err = "Sync failed: " + dir;
+        return false;
+    }
+    return true;
+}
+
+// An install is a list of renames (from over to) and removals (from empty),
+// written to "<data>.install" before the first of them: a crash part way is
+// finished on the next start (StorageEngine::FinishInstalls).
+struct InstallStep {
+    std::string from;
+    std::string to;
+};
+constexpr char kInstallSuffix[] = ".install";
+constexpr char kInstallEnd[] = ".";  // last line; a torn manifest is ignored
+
+bool WriteInstallManifest(const std::string& manifest, const std::vector<InstallStep>& steps, std::string& err) {
+    {
+        std::ofstream ofs(manifest, std::ios::binary | std::ios::trunc);
+        for (const auto& s : steps) ofs << s.from << '\t' << s.to << '\n';
+        ofs << kInstallEnd << '\n';
+        if (!ofs) {
+            err = "Cannot write install manifest: " + manifest;
+            return false;
+        }
+    }
+    const bool ok = SyncFile(manifest, err);
+    FileHandleCache::Instance().Invalidate(manifest);
+    return ok && SyncParentDir(manifest, err);
+}
+
+// Renames whose source is gone already happened before a crash.
+bool ApplyInstall(const std::vector<InstallStep>& steps, std::string& err) {
+    std::set<std::string> dirs;
+    for (const auto& s : steps) {
+        // Cached descriptors of either name would now point at the wrong inode.
+        FileHandleCache::Instance().Invalidate(s.to);
+        std::error_code ec;
+        if (s.from.empty()) {
+            fs::remove(s.to, ec);
+        } else {
+            FileHandleCache::Instance().Invalidate(s.from);
+            if (!fs::exists(s.from, ec)) continue;
+            fs::rename(s.from, s.to, ec);
+            if (ec) {
+                err = "Failed to install " + s.to + ": " + ec.message();
+                return false;
+            }
+        }
+        dirs.insert(s.to);
+    }
+    for (const auto& d : dirs) {
+        if (!SyncParentDir(d, err)) return false;
+    }
+    return true;
+}
+
+bool FinishInstall(const std::string& manifest, std::string& err) {
+    std::ifstream ifs(manifest, std::ios::binary);
+    std::vector<InstallStep> steps;
+    std::string line;
+    bool complete = false;
+    while (std::getline(ifs, line)) {
+        if (line == kInstallEnd) {
+            complete = true;
+            break;
+        }
+        const size_t tab = line.find('\t');
+        if (tab == std::string::npos) break;
+        steps.push_back({line.substr(0, tab), line.substr(tab + 1)});
+    }
+    ifs.close();
+    if (complete && !ApplyInstall(steps, err)) return false;
+    std::error_code ec;
+    fs::remove(manifest, ec);
+    return SyncParentDir(manifest, err);
+}
+}  // namespace
+
+StorageEngine::StorageEngine() {
+    size_t mb = 64;
+    if (const char* env = std::getenv("DBMS_BUFFER_POOL_MB")) {
+        long v = std::atol(env);
+        if (v > 0) mb = static_cast<size_t>(v);
+    }
+    pool_ = std::make_unique<BufferPool>(mb * 1024 * 1024);
+}
+
+void StorageEngine::SetWalFlusher(BufferPool::WalFlusher flusher) {
+    pool_->SetWalFlusher(std::move(flusher));
+}
+
+bool StorageEngine::FlushBufferPool(std::string& err) {
+    return pool_->FlushAll(err);
+}
+
+bool StorageEngine::FlushTable(const std::string& datPath, const TableSchema& schema, std::string& err) {
+    std::string path = TableDataPath(datPath, schema.tableName);
+    if (schema.storage != StorageFormat::kRow && !PagedPath(datPath, schema, path, err)) return false;
+    return pool_->FlushFile(path, err);
+}
+
+bool StorageEngine::SyncTable(const std::string& datPath, const TableSchema& schema, std::string& err) {
+    std::string path = TableDataPath(datPath, schema.tableName);
+    if (schema.storage != StorageFormat::kRow && !PagedPath(datPath, schema, path, err)) return false;
+    return pool_->FlushFile(path, err) && SyncFile(path, err) &&
+           SyncFile(Overflow::PathFor(path), err) && SyncFile(BlockDirectory::PathFor(path), err) &&
+           SyncFile(ZoneMap::PathFor(path), err);
+}
+
+bool StorageEngine::SyncForRawRead(const std::string& path, std::string& err) {
+    return pool_->FlushFile(path, err);
+}
+
+bool StorageEngine::SyncForRawWrite(const std::string& path, uint64_t fromOffset, std::string& err) {
+    return pool_->Invalidate(path, fromOffset / kPageSize, err);
+}
+
+MappedFile& StorageEngine::MappedFor(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mappedMu_);
+    auto& slot = mapped_[path];
+    if (!slot) slot = std::make_unique<MappedFile>(path);
+    return *slot;
+}
+
+AppendWriter& StorageEngine::WriterFor(const std::string& path) {
+    std::lock_guard<std::mutex> lock(writersMu_);
+    auto& slot = writers_[path];
+    if (!slot) slot = std::make_unique<AppendWriter>(path);
+    return *slot;
+}
+
+std::string StorageEngine::StagingPath(const std::string& path) {
+    return path + ".tmp";
+}
+
+void StorageEngine::SetReclaimable(const std::string& path, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(reclaimableMu_);
+    reclaimable_[path] = bytes;
+}
+
+void StorageEngine::AddReclaimable(const std::string& path, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(reclaimableMu_);
+    auto it = reclaimable_.find(path);
+    if (it != reclaimable_.end()) it->second += bytes;
+}
+
+void StorageEngine::ForgetReclaimable(const std::string& path) {
+    std::lock_guard<std::mutex> lock(reclaimableMu_);
+    reclaimable_.erase(path);
+}
+
+bool StorageEngine::InstallStaged(const std::string& path, std::string& err, const std::vector<std::string>& companions) {
+    if (!SyncForRawWrite(path, 0, err)) return false;
+    // The staged files must be on disk before a rename can expose them.
+    const std::string staged = StagingPath(path);
+    if (!SyncFile(staged, err) || !SyncFile(BlockDirectory::PathFor(staged), err) ||
+        !SyncFile(ZoneMap::PathFor(staged), err) || !SyncFile(Overflow::PathFor(staged), err)) return false;
+    for (const auto& c : companions) {
+        if (!SyncFile(StagingPath(c), err)) return false;
+    }
+    // Data file, sidecars and index files go in as one unit.
+    std::vector<InstallStep> steps;
+    steps.push_back({staged, path});
+    auto sidecar = [&](const std::string& from, const std::string& to) {
+        std::error_code ec;
+        steps.push_back({fs::exists(from, ec) ? from : std::string(), to});
+    };
+    sidecar(BlockDirectory::PathFor(staged), BlockDirectory::PathFor(path));
+    sidecar(ZoneMap::PathFor(staged), ZoneMap::PathFor(path));
+    sidecar(Overflow::PathFor(staged), Overflow::PathFor(path));
+    for (const auto& c : companions) steps.push_back({StagingPath(c), c});
+    const std::string manifest = path + kInstallSuffix;
+    ForgetReclaimable(path);
+    if (!WriteInstallManifest(manifest, steps, err) || !ApplyInstall(steps, err)) return false;
+    std::error_code ec;
+    fs::remove(manifest, ec);
+    return SyncParentDir(manifest, err);
+}
+
+bool StorageEngine::FinishInstalls(const std::string& dbName, std::string& err) {
+    std::vector<std::string> manifests;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dbms_paths::DbDirPath(dbName), ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string p = it->path().string();
+        if (it->is_regular_file(ec) && p.size() > sizeof(kInstallSuffix) - 1 &&
+            p.compare(p.size() - (sizeof(kInstallSuffix) - 1), std::string::npos, kInstallSuffix) == 0) {
+            manifests.push_back(p);
+        }
+    }
+    for (const auto& m : manifests) {
+        if (!FinishInstall(m, err)) return false;
+    }
+    return true;
+}
+
+bool StorageEngine::LoadOverflow(const std::string& path, Record& record, std::string& err) {
+    std::shared_ptr<const FileMapping> overflow;
+    for (size_t i = 0; i < record.values.size(); ++i) {
+        if (!record.Overflowed(i)) continue;
+        if (!overflow) overflow = MappedFor(Overflow::PathFor(path)).Acquire(err);
+        std::string_view value;
+        if (!overflow || !Overflow::Resolve(*overflow, record.values[i], value)) {
+            err = "Bad overflow pointer in " + path;
+            return false;
+        }
+        record.values[i].assign(value);
+    }
+    record.overflow.clear();
+    return true;
+}
+
 bool StorageEngine::BackupDatabase(const std::string& dbName, const std::string& destPath, std::string& err) {
     namespace fs = std::filesystem;
+    if (!FlushBufferPool(err)) return false;
     try {
         if (!fs::exists(destPath)) {
             if (!fs::create_directories(destPath)) {
@@ -32,7 +269,10 @@ bool StorageEngine::BackupDatabase(const std::string& dbName, const std::string&
         }
         fs::path destDir = fs::path(destPath) / dbDir.filename();
         fs::create_directories(destDir);
+        // The copy may overwrite files we hold open (backup into a data dir).
+        FileHandleCache::Instance().InvalidatePrefix(destDir.string());
         fs::copy(dbDir, destDir, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+        catalog_.InvalidateDir(destDir.string());
     } catch (const std::exception& e) {
         err = "Backup failed: " + std::string(e.what());
         return false;
@@ -43,6 +283,7 @@ bool StorageEngine::BackupDatabase(const std::string& dbName, const std::string&
 
 namespace {
     constexpr char kTableSep = '~';
+    constexpr char kOptionsTag = 0x02;  // table options section in .dbf
 
     bool WriteUInt32(std::ofstream& ofs, uint32_t v) {
         ofs.write(reinterpret_cast<const char*>(&v), sizeof(uint32_t));
@@ -53,6 +294,124 @@ namespace {
         ifs.read(reinterpret_cast<char*>(&v), sizeof(uint32_t));
         return static_cast<bool>(ifs);
     }
+
+    bool WriteUInt64(std::ofstream& ofs, uint64_t v) {
+        ofs.write(reinterpret_cast<const char*>(&v), sizeof(uint64_t));
+        return static_cast<bool>(ofs);
+    }
+
+    bool ReadUInt64(std::ifstream& ifs, uint64_t& v) {
+        ifs.read(reinterpret_cast<char*>(&v), sizeof(uint64_t));
+        return static_cast<bool>(ifs);
+    }
+
+    // Index file: u32 magic | u32 version, then key | u64 offset entries.
+    // Files from before the header hold key | u32 offset entries; they are
+    // read as such and rewritten in the current format on their next save.
+    // A legacy file cannot start with the magic: that would be a key of
+    // over a GiB.
+    constexpr uint32_t kIndexMagic = 0x58444944;  // "DIDX"
+    constexpr uint32_t kIndexVersion = 2;
+
+    void PutUInt32(std::vector<uint8_t>& out, uint32_t v) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+        out.insert(out.end(), p, p + sizeof(uint32_t));
+    }
+
+    // Zones of a row block's stripes; starts[s] = offset of stripe s's first row.
+    std::vector<Zone> StripeZones(const TableSchema& schema, const std::vector<Record>& records,
+                                  const std::vector<uint64_t>& starts, const BlockEntry& block) {
+        std::vector<Zone> zones;
+        ZoneBuilder builder(schema);
+        for (size_t s = 0; s < starts.size(); ++s) {
+            const size_t from = s * ZoneMap::kStripeRows;
+            const size_t to = std::min<size_t>(records.size(), from + ZoneMap::kStripeRows);
+            for (size_t i = from; i < to; ++i) builder.Add(records[i]);
+            const uint64_t end = s + 1 < starts.size() ? starts[s + 1] : block.offset + block.length;
+            zones.push_back(builder.Take(block.offset, starts[s], end, block.crc));
+        }
+        return zones;
+    }
+
+    // Statistics section in .dbf: tag, then a length-prefixed payload that
+    // starts with its version, so other versions can be skipped.
+    constexpr char kStatsTag = 0x03;
+    constexpr uint32_t kStatsVersion = 1;
+
+    template <typename T>
+    void PutPod(std::string& out, T v) {
+        out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    void PutStr(std::string& out, const std::string& s) {
+        PutPod(out, static_cast<uint32_t>(s.size()));
+        out += s;
+    }
+
+    template <typename T>
+    bool GetPod(const std::string& in, size_t& pos, T& v) {
+        if (in.size() - pos < sizeof(T)) return false;
+        std::memcpy(&v, in.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool GetStr(const std::string& in, size_t& pos, std::string& s) {
+        uint32_t len = 0;
+        if (!GetPod(in, pos, len) || in.size() - pos < len) return false;
+        s.assign(in, pos, len);
+        pos += len;
+        return true;
+    }
+
+    std::string EncodeStats(const TableStats& st) {
+        std::string out;
+        PutPod(out, kStatsVersion);
+        PutPod(out, st.analyzedAt);
+        PutPod(out, st.rowCount);
+        PutPod(out, st.deadRows);
+        PutPod(out, st.sampleRows);
+        PutPod(out, static_cast<uint32_t>(st.columns.size()));
+        for (const auto& c : st.columns) {
+            PutStr(out, c.name);
+            PutPod(out, c.distinct);
+            PutPod(out, c.nullFraction);
+            PutPod(out, static_cast<uint8_t>(c.hasRange));
+            PutStr(out, c.min);
+            PutStr(out, c.max);
+            PutPod(out, static_cast<uint32_t>(c.bucketRows.size()));
+            for (const auto& b : c.bounds) PutStr(out, b);
+            for (uint64_t rows : c.bucketRows) PutPod(out, rows);
+        }
+        return out;
+    }
+
+    bool DecodeStats(const std::string& in, TableStats& st) {
+        size_t pos = 0;
+        uint32_t version = 0, columns = 0;
+        if (!GetPod(in, pos, version) || version != kStatsVersion) return false;
+        if (!GetPod(in, pos, st.analyzedAt) || !GetPod(in, pos, st.rowCount) || !GetPod(in, pos, st.deadRows) ||
+            !GetPod(in, pos, st.sampleRows) || !GetPod(in, pos, columns)) return false;
+        for (uint32_t i = 0; i < columns; ++i) {
+            ColumnStats c;
+            uint8_t hasRange = 0;
+            uint32_t buckets = 0;
+            if (!GetStr(in, pos, c.name) || !GetPod(in, pos, c.distinct) || !GetPod(in, pos, c.nullFraction) ||
+                !GetPod(in, pos, hasRange) || !GetStr(in, pos, c.min) || !GetStr(in, pos, c.max) ||
+                !GetPod(in, pos, buckets) || buckets > in.size()) return false;
+            c.hasRange = hasRange != 0;
+            c.bounds.resize(buckets > 0 ? buckets + 1 : 0);
+            c.bucketRows.resize(buckets);
+            for (auto& b : c.bounds) {
+                if (!GetStr(in, pos, b)) return false;
+            }
+            for (auto& rows : c.bucketRows) {
+                if (!GetPod(in, pos, rows)) return false;
+            }
+            st.columns.push_back(std::move(c));
+        }
+        return pos == in.size();
+    }
 }
 
 bool StorageEngine::CreateDatabase(const std::string& dbName, std::string& err) {
@@ -77,6 +436,7 @@ bool StorageEngine::CreateDatabase(const std::string& dbName, std::string& err)
             err = "Failed to create dbf file";
             return false;
         }
+        catalog_.Invalidate(dbf);
         // Ŀǰ��д�κ����ݣ�����������������
     }
 
@@ -89,19 +449,27 @@ bool StorageEngine::CreateDatabase(const std::string& dbName, std::string& err)
         }
     }
 
-    return true;
+    return dbms_paths::EnsureSegmentDirFromDat(dat, err);
 }
 
 bool StorageEngine::DropDatabase(const std::string& dbName, std::string& err) {
-    (void)err;
     try {
         fs::path dbDir = dbms_paths::DbDirPath(dbName);
+        if (!pool_->InvalidatePrefix(dbDir.string(), err)) return false;
+        {
+            std::lock_guard<std::mutex> lock(mappedMu_);
+            for (auto& kv : mapped_) {
+                if (kv.first.compare(0, dbDir.string().size(), dbDir.string()) == 0) kv.second->Release();
+            }
+        }
+        FileHandleCache::Instance().InvalidatePrefix(dbDir.string());
         if (fs::exists(dbDir)) {
             fs::remove_all(dbDir);
         }
     } catch (const fs::filesystem_error&) {
         // Ignore delete errors for now.
     }
+    catalog_.InvalidateDir(dbms_paths::DbDirPath(dbName).string());
     return true;
 }
 
@@ -121,19 +489,49 @@ bool StorageEngine::ReadString(std::ifstream& ifs, std::string& s) {
 }
 
 bool StorageEngine::LoadSchema(const std::string& dbfPath, const std::string& tableName, TableSchema& outSchema, std::string& err) {
-    std::vector<TableSchema> schemas;
-    if (!LoadSchemas(dbfPath, schemas, err)) return false;
-    for (const auto& s : schemas) {
-        if (s.tableName == tableName) {
-            outSchema = s;
-            return true;
-        }
+    auto catalog = LoadCatalog(dbfPath, err);
+    if (!catalog) return false;
+    const TableSchema* s = catalog->Find(tableName);
+    if (!s) {
+        err = "Table not found: " + tableName;
+        return false;
+    }
+    outSchema = *s;
+    return true;
+}
+
+bool StorageEngine::SchemaStillCurrent(const std::string& dbfPath, const TableSchema& schema, std::string& err) {
+    auto catalog = LoadCatalog(dbfPath, err);
+    if (!catalog) return false;
+    const TableSchema* s = catalog->Find(schema.tableName);
+    auto sameField = [](const Field& a, const Field& b) {
+        return a.name == b.name && a.type == b.type && a.size == b.size && a.isKey == b.isKey &&
+               a.nullable == b.nullable && a.valid == b.valid;
+    };
+    auto sameIndex = [](const IndexDef& a, const IndexDef& b) {
+        return a.name == b.name && a.fieldName == b.fieldName && a.isUnique == b.isUnique;
+    };
+    if (s && s->storage == schema.storage && s->encoding == schema.encoding &&
+        std::equal(s->fields.begin(), s->fields.end(), schema.fields.begin(), schema.fields.end(), sameField) &&
+        std::equal(s->indexes.begin(), s->indexes.end(), schema.indexes.begin(), schema.indexes.end(), sameIndex)) {
+        return true;
     }
-    err = "Table not found: " + tableName;
+    err = "Table " + schema.tableName + " was altered concurrently, retry the statement";
     return false;
 }
 
-bool StorageEngine::LoadSchemas(const std::string& dbfPath,
+bool StorageEngine::LoadSchemas(const std::string& dbfPath, std::vector<TableSchema>& schemas, std::string& err) {
+    auto catalog = LoadCatalog(dbfPath, err);
+    if (!catalog) return false;
+    schemas = catalog->tables;
+    return true;
+}
+
+std::shared_ptr<const SchemaSnapshot> StorageEngine::LoadCatalog(const std::string& dbfPath, std::string& err) {
+    return catalog_.Get(dbfPath, [&](std::vector<TableSchema>& out, std::string& e) { return ParseSchemas(dbfPath, out, e); }, err);
+}
+
+bool StorageEngine::ParseSchemas(const std::string& dbfPath,
     std::vector<TableSchema>& schemas,
     std::string& err) {
     schemas.clear();
@@ -285,6 +683,39 @@ bool StorageEngine::LoadSchemas(const std::string& dbfPath,
             }
         }
 
+        // Table options (optional): tag, u32 count, (key, value) strings
+        if (ifs.peek() == kOptionsTag) {
+            ifs.ignore(1);
+            uint32_t optCount = 0;
+            if (!ReadUInt32(ifs, optCount)) return false;
+            for (uint32_t k = 0; k < optCount; ++k) {
+                std::string key, value;
+                if (!ReadString(ifs, key) || !ReadString(ifs, value)) return false;
+                if (key == "storage" && value == "paged") schema.storage = StorageFormat::kPaged;
+                if (key == "storage" && value == "columnar") schema.storage = StorageFormat::kColumnar;
+                if (key == "encoding" && value == "typed") schema.encoding = RecordEncoding::kTyped;
+                if (key == "bloom") {  // comma-separated column names
+                    for (size_t from = 0; from <= value.size();) {
+                        size_t to = value.find(',', from);
+                        if (to == std::string::npos) to = value.size();
+                        for (auto& f : schema.fields) {
+                            if (f.name.compare(0, std::string::npos, value, from, to - from) == 0) f.bloom = true;
+                        }
+                        from = to + 1;
+                    }
+                }
+            }
+        }
+
+        // Statistics (optional); a payload of another version is dropped
+        if (ifs.peek() == kStatsTag) {
+            ifs.ignore(1);
+            std::string payload;
+            if (!ReadString(ifs, payload)) return false;
+            auto stats = std::make_shared<TableStats>();
+            if (DecodeStats(payload, *stats)) schema.stats = std::move(stats);
+        }
+
         schemas.push_back(schema);
     }
 
@@ -294,6 +725,13 @@ bool StorageEngine::LoadSchemas(const std::string& dbfPath,
 
 
 bool StorageEngine::SaveSchemas(const std::string& dbfPath, const std::vector<TableSchema>& schemas, std::string& err) {
+    // Invalidate even on failure: the file may be half written.
+    const bool ok = WriteSchemas(dbfPath, schemas, err);
+    catalog_.Invalidate(dbfPath);
+    return ok;
+}
+
+bool StorageEngine::WriteSchemas(const std::string& dbfPath, const std::vector<TableSchema>& schemas, std::string& err) {
     std::ofstream ofs(dbfPath, std::ios::binary | std::ios::trunc);
     if (!ofs.is_open()) {
         err = "Cannot open dbf file for writing: " + dbfPath;
@@ -345,6 +783,32 @@ bool StorageEngine::SaveSchemas(const std::string& dbfPath, const std::vector<Ta
         if (schema.isView) {
             if (!WriteString(ofs, schema.viewSql)) return false;
         }
+
+        // Table options; omitted entirely for default tables
+        std::vector<std::pair<std::string, std::string>> options;
+        if (schema.storage == StorageFormat::kPaged) options.push_back({"storage", "paged"});
+        if (schema.storage == StorageFormat::kColumnar) options.push_back({"storage", "columnar"});
+        if (schema.encoding == RecordEncoding::kTyped) options.push_back({"encoding", "typed"});
+        std::string bloom;
+        for (const auto& f : schema.fields) {
+            if (!f.bloom) continue;
+            if (!bloom.empty()) bloom += ',';
+            bloom += f.name;
+        }
+        if (!bloom.empty()) options.push_back({"bloom", bloom});
+        if (!options.empty()) {
+            ofs.write(&kOptionsTag, 1);
+            if (!WriteUInt32(ofs, static_cast<uint32_t>(options.size()))) return false;
+            for (const auto& opt : options) {
+                if (!WriteString(ofs, opt.first)) return false;
+                if (!WriteString(ofs, opt.second)) return false;
+            }
+        }
+
+        if (schema.stats) {
+            ofs.write(&kStatsTag, 1);
+            if (!WriteString(ofs, EncodeStats(*schema.stats))) return false;
+        }
     }
     return static_cast<bool>(ofs);
 }
@@ -359,252 +823,273 @@ bool StorageEngine::AppendSchema(const std::string& dbfPath, const TableSchema&
     return SaveSchemas(dbfPath, schemas, err);
 }
 
-// Helper to read fields
-static bool ReadFields(std::ifstream& ifs, const TableSchema& schema, Record& rec) {
-    // Valid flag
-    char valid;
-    ifs.read(&valid, 1);
-    if (!ifs) return false;
-    rec.valid = (valid != 0);
-
-    for (const auto& f : schema.fields) {
-        std::string s;
-        // Re-use StorageEngine::ReadString logic (but we are outside class or need helper)
-        uint32_t len = 0;
-        ifs.read(reinterpret_cast<char*>(&len), sizeof(uint32_t));
-        if (!ifs) return false;
-        s.resize(len);
-        if (len > 0) ifs.read(&s[0], len);
-        if (!ifs) return false;
-        rec.values.push_back(s);
-    }
-    return true;
-}
-
-bool StorageEngine::AppendRecord(const std::string& datPath, const TableSchema& schema, const Record& record, long& outOffset, std::string& err) {
+bool StorageEngine::AppendRecord(const std::string& datPath, const TableSchema& schema, const Record& record, int64_t& outOffset, std::string& err) {
     if (record.values.size() != schema.fields.size()) {
         err = "Record field count mismatch";
         return false;
     }
-
-    std::ofstream ofs(datPath, std::ios::binary | std::ios::app);
-    if (!ofs.is_open()) {
-        err = "Cannot open dat file for append: " + datPath;
-        return false;
-    }
-
-    // Write Block Header
-    ofs.write(&kTableSep, 1);
-    if (!WriteString(ofs, schema.tableName)) return false;
-    if (!WriteUInt32(ofs, 1)) return false; // 1 Record
-    if (!WriteUInt32(ofs, static_cast<uint32_t>(schema.fields.size()))) return false;
-
-    // Save Offset
-    outOffset = static_cast<long>(ofs.tellp());
-
-    // Write Record
-    char valid = record.valid ? 1 : 0;
-    ofs.write(&valid, 1);
-    for (const auto& val : record.values) {
-        if (!WriteString(ofs, val)) return false;
+    if (schema.storage != StorageFormat::kRow) {
+        std::string path;
+        return PagedPath(datPath, schema, path, err) && PagedAppend(path, schema, {record}, &outOffset, err);
     }
 
-    return true;
+    return AppendRowBlock(datPath, schema, {record}, &outOffset, err);
 }
 
 // Rewriting AppendRecords to use Append-Only mode (writing one block with multiple records)
 // NOTE: This does NOT return offsets. Use AppendRecord loop if you need offsets.
 bool StorageEngine::AppendRecords(const std::string& datPath, const TableSchema& schema, const std::vector<Record>& newRecords, std::string& err) {
     if (newRecords.empty()) return true;
-
-    std::ofstream ofs(datPath, std::ios::binary | std::ios::app);
-    if (!ofs.is_open()) {
-        err = "Cannot open dat file for append: " + datPath;
-        return false;
+    for (const auto& r : newRecords) {
+        if (r.values.size() != schema.fields.size()) {
+            err = "Record field count mismatch";
+            return false;
+        }
+    }
+    if (schema.storage != StorageFormat::kRow) {
+        std::string path;
+        return PagedPath(datPath, schema, path, err) && PagedAppend(path, schema, newRecords, nullptr, err);
     }
 
-    // Write Block Header
-    ofs.write(&kTableSep, 1);
-    if (!WriteString(ofs, schema.tableName)) return false;
-    if (!WriteUInt32(ofs, static_cast<uint32_t>(newRecords.size()))) return false;
-    if (!WriteUInt32(ofs, static_cast<uint32_t>(schema.fields.size()))) return false;
+    return AppendRowBlock(datPath, schema, newRecords, nullptr, err);
+}
 
-    for (const auto& r : newRecords) {
+// One block holding all records, built in the file's append buffer and
+// written with a single positioned write.
+bool StorageEngine::AppendRowBlock(const std::string& datPath, const TableSchema& schema, const std::vector<Record>& records, int64_t* outFirstOffset, std::string& err) {
+    const std::string path = TableDataPath(datPath, schema.tableName);
+    if (path != datPath && !dbms_paths::EnsureSegmentDirFromDat(datPath, err)) return false;
+    for (const auto& r : records) {
         if (r.values.size() != schema.fields.size()) {
             err = "Record field count mismatch";
             return false;
         }
-        char valid = r.valid ? 1 : 0;
-        ofs.write(&valid, 1);
-        for (const auto& val : r.values) {
-            if (!WriteString(ofs, val)) return false;
-        }
     }
-    return true;
-}
 
-bool StorageEngine::ReadRecordAt(const std::string& datPath, const TableSchema& schema, long offset, Record& outRecord, std::string& err) {
-    std::ifstream ifs(datPath, std::ios::binary);
-    if (!ifs.is_open()) {
-        err = "Cannot open dat file: " + datPath;
-        return false;
+    // Long values go to the sidecar first, so no row points at a value that may be lost.
+    std::vector<Record> moved;
+    const std::vector<Record>* rows = &records;
+    if (path != datPath) {
+        OverflowWriter overflow(path, schema);
+        rows = &overflow.Add(records, moved);
+        if (!overflow.Sync(err)) return false;
     }
-    
-    ifs.seekg(offset);
-    if (!ifs) {
-        err = "Seek failed";
-        return false;
+
+    AppendWriter& writer = WriterFor(path);
+    std::lock_guard<std::mutex> lock(writer.mutex());
+    std::vector<uint8_t>& block = writer.buffer();
+    block.clear();
+    block.push_back(static_cast<uint8_t>(kTableSep));
+    PutUInt32(block, static_cast<uint32_t>(schema.tableName.size()));
+    block.insert(block.end(), schema.tableName.begin(), schema.tableName.end());
+    PutUInt32(block, static_cast<uint32_t>(records.size()));
+    PutUInt32(block, static_cast<uint32_t>(schema.fields.size()));
+    const size_t headerSize = block.size();
+
+    const RecordCodec codec(schema);
+    const bool zoned = records.size() >= ZoneMap::kMinBlockRows;
+    std::vector<uint64_t> starts;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (zoned && i % ZoneMap::kStripeRows == 0) starts.push_back(block.size());
+        codec.EncodeAppend((*rows)[i], block);
     }
 
-    outRecord.values.clear();
-    if (!ReadFields(ifs, schema, outRecord)) {
+    uint64_t blockStart = 0;
+    if (!writer.Prepare(blockStart, err)) return false;
+    if (!SyncForRawWrite(path, blockStart, err)) return false;
+    if (!writer.Write(err)) return false;
+    if (outFirstOffset) *outFirstOffset = static_cast<int64_t>(blockStart + headerSize);
+
+    BlockEntry entry;
+    entry.table_id = BlockDirectory::TableId(schema.tableName);
+    entry.record_count = static_cast<uint32_t>(records.size());
+    entry.offset = blockStart;
+    entry.length = block.size();
+    entry.crc = Crc32c(block.data(), block.size());
+    writer.Register(entry);
+    for (auto& s : starts) s += blockStart;
+    ZoneMap::Append(path, StripeZones(schema, records, starts, entry));
+    return true;
+}
+
+bool StorageEngine::ReadRecordAt(const std::string& datPath, const TableSchema& schema, int64_t offset, Record& outRecord, std::string& err) {
+    if (schema.storage != StorageFormat::kRow) {
+        std::string path;
+        return PagedPath(datPath, schema, path, err) &&
+               PagedReadRecord(path, dbms_paths::DbNameFromDat(datPath), schema, offset, outRecord, err);
+    }
+    std::vector<uint8_t> bytes;
+    if (!ReadRecordBytesAt(datPath, schema, offset, bytes, err)) return false;
+    if (!RecordCodec(schema).Decode(bytes.data(), bytes.size(), outRecord)) {
         err = "Read fields failed";
         return false;
     }
-    return true;
+    return LoadOverflow(TableDataPath(datPath, schema.tableName), outRecord, err);
 }
 
 // Index IO
-bool StorageEngine::LoadIndex(const std::string& indexPath, std::map<std::string, long>& outIndex, std::string& err) {
+bool StorageEngine::LoadIndex(const std::string& indexPath, std::map<std::string, int64_t>& outIndex, std::string& err) {
     outIndex.clear();
     std::ifstream ifs(indexPath, std::ios::binary);
     if (!ifs.is_open()) return true; // No index (new), not error
 
+    uint32_t magic = 0, version = 0;
+    const bool legacy = !ReadUInt32(ifs, magic) || magic != kIndexMagic;
+    if (legacy) {
+        ifs.clear();
+        ifs.seekg(0);
+    } else if (!ReadUInt32(ifs, version) || version != kIndexVersion) {
+        err = "Unsupported index file version: " + indexPath;
+        return false;
+    }
     while (ifs.peek() != EOF) {
         std::string key;
         // Read key
         if (!ReadString(ifs, key)) break;
         // Read offset
-        uint32_t off = 0; 
-        if (!ReadUInt32(ifs, off)) break;
-        outIndex[key] = static_cast<long>(off);
+        uint64_t off = 0;
+        if (legacy) {
+            uint32_t off32 = 0;
+            if (!ReadUInt32(ifs, off32)) break;
+            off = off32;
+        } else if (!ReadUInt64(ifs, off)) {
+            break;
+        }
+        outIndex[key] = static_cast<int64_t>(off);
     }
     return true;
 }
 
-bool StorageEngine::SaveIndex(const std::string& indexPath, const std::map<std::string, long>& index, std::string& err) {
-    std::ofstream ofs(indexPath, std::ios::binary | std::ios::trunc);
-    if (!ofs.is_open()) {
+bool StorageEngine::SaveIndex(const std::string& indexPath, const std::map<std::string, int64_t>& index, std::string& err) {
+    // Readers load index files under a shared table lock, as do the commits
+    // that save them: write a private copy and rename it into place.
+    static std::atomic<uint64_t> seq{0};
+    const std::string tmp = indexPath + ".tmp" + std::to_string(++seq);
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open()) {
+            err = "Cannot write index file";
+            return false;
+        }
+        bool ok = WriteUInt32(ofs, kIndexMagic) && WriteUInt32(ofs, kIndexVersion);
+        for (auto it = index.begin(); ok && it != index.end(); ++it) {
+            ok = WriteString(ofs, it->first) && WriteUInt64(ofs, static_cast<uint64_t>(it->second));
+        }
+        if (!ok) {
+            ofs.close();
+            std::remove(tmp.c_str());
+            err = "Cannot write index file";
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, indexPath, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
         err = "Cannot write index file";
         return false;
     }
-    for (const auto& kv : index) {
-        if (!WriteString(ofs, kv.first)) return false;
-        if (!WriteUInt32(ofs, static_cast<uint32_t>(kv.second))) return false;
-    }
     return true;
 }
 
-
-bool StorageEngine::ReadRecordsWithOffsets(const std::string& datPath, const TableSchema& schema, std::vector<std::pair<long, Record>>& outRecords, std::string& err) {
-    std::ifstream ifs(datPath, std::ios::binary);
-    if (!ifs.is_open()) {
-        err = "Cannot open dat file: " + datPath;
-        return false;
+namespace {
+// Write one block holding all of `records` at the current stream position.
+// zones (optional) gets the block's stripe zones; overflow (optional) takes
+// the long values.
+bool WriteTableBlock(std::ofstream& ofs, const TableSchema& schema, const std::vector<Record>& records, BlockEntry& outBlock,
+                     std::vector<Zone>* zones = nullptr, OverflowWriter* overflow = nullptr) {
+    const std::string& tableName = schema.tableName;
+    const RecordCodec codec(schema);
+    const std::streamoff start = ofs.tellp();
+    std::vector<uint8_t> bytes;
+    bytes.push_back(static_cast<uint8_t>(kTableSep));
+    PutUInt32(bytes, static_cast<uint32_t>(tableName.size()));
+    bytes.insert(bytes.end(), tableName.begin(), tableName.end());
+    PutUInt32(bytes, static_cast<uint32_t>(records.size()));
+    PutUInt32(bytes, static_cast<uint32_t>(codec.fieldCount()));
+    uint32_t crc = 0;
+    auto put = [&]() {
+        ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        crc = Crc32c(bytes.data(), bytes.size(), crc);
+    };
+    put();
+    const bool zoned = zones && records.size() >= ZoneMap::kMinBlockRows;
+    std::vector<uint64_t> starts;
+    std::vector<Record> moved;
+    const std::vector<Record>& rows = overflow ? overflow->Add(records, moved) : records;
+    std::string err;
+    if (overflow && !overflow->Flush(err)) return false;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (zoned && i % ZoneMap::kStripeRows == 0) starts.push_back(static_cast<uint64_t>(ofs.tellp()));
+        codec.Encode(rows[i], bytes);
+        put();
     }
-
-    outRecords.clear();
-    while (ifs.peek() != EOF) {
-        char sep;
-        ifs.read(&sep, 1);
-        if (!ifs) break;
-        if (sep != kTableSep) {
-            err = "Invalid separator in dat";
-            return false;
-        }
-        std::string tableName;
-        if (!ReadString(ifs, tableName)) return false;
-        uint32_t recordCount = 0;
-        uint32_t fieldCount = 0;
-        if (!ReadUInt32(ifs, recordCount)) return false;
-        if (!ReadUInt32(ifs, fieldCount)) return false;
-
-        // Skip logic for unrelated tables
-        if (tableName != schema.tableName) {
-            for (uint32_t i = 0; i < recordCount; ++i) {
-                 // Skip valid byte
-                 ifs.ignore(1);
-                 for (uint32_t j = 0; j < fieldCount; ++j) {
-                     // Read and discard string
-                     uint32_t len = 0;
-                     ifs.read(reinterpret_cast<char*>(&len), sizeof(uint32_t));
-                     if (len > 0) ifs.ignore(len); 
-                 }
-            }
-            continue;
-        }
-
-        // Read records
-        for (uint32_t i = 0; i < recordCount; ++i) {
-            long offset = static_cast<long>(ifs.tellg());
-            Record rec;
-            if (!ReadFields(ifs, schema, rec)) {
-                err = "Failed reading record in Loop";
-                return false;
-            }
-            if (rec.valid) {
-                outRecords.push_back({offset, rec});
-            }
-        }
+    if (!ofs) return false;
+    outBlock.crc = crc;
+    outBlock.table_id = BlockDirectory::TableId(tableName);
+    outBlock.record_count = static_cast<uint32_t>(records.size());
+    outBlock.offset = static_cast<uint64_t>(start);
+    outBlock.length = static_cast<uint64_t>(ofs.tellp() - start);
+    if (zoned) {
+        std::vector<Zone> stripes = StripeZones(schema, records, starts, outBlock);
+        zones->insert(zones->end(), std::make_move_iterator(stripes.begin()), std::make_move_iterator(stripes.end()));
     }
     return true;
 }
 
-bool StorageEngine::ReadRecords(const std::string& datPath, const TableSchema& schema, std::vector<Record>& outRecords, std::string& err) {
-    std::ifstream ifs(datPath, std::ios::binary);
-    if (!ifs.is_open()) {
-        err = "Cannot open dat file: " + datPath;
-        return false;
-    }
+}  // namespace
 
+bool StorageEngine::ReadRecordsWithOffsets(const std::string& datPath, const TableSchema& schema, std::vector<std::pair<int64_t, Record>>& outRecords, std::string& err) {
     outRecords.clear();
-    while (ifs.peek() != EOF) {
-        char sep;
-        ifs.read(&sep, 1);
-        if (!ifs) break;
-        if (sep != kTableSep) {
-            err = "Invalid separator in dat";
-            return false;
-        }
-        std::string tableName;
-        if (!ReadString(ifs, tableName)) return false;
-        uint32_t recordCount = 0;
-        uint32_t fieldCount = 0;
-        if (!ReadUInt32(ifs, recordCount)) return false;
-        if (!ReadUInt32(ifs, fieldCount)) return false;
-
-        if (tableName != schema.tableName) {
-            // skip unrelated table
-            for (uint32_t i = 0; i < recordCount; ++i) {
-                char validFlag;
-                ifs.read(&validFlag, 1);
-                for (uint32_t j = 0; j < fieldCount; ++j) {
-                    std::string dummy;
-                    if (!ReadString(ifs, dummy)) return false;
-                }
-            }
-            continue;
-        }
-
-        for (uint32_t i = 0; i < recordCount; ++i) {
-            Record rec;
-            char validFlag;
-            ifs.read(&validFlag, 1);
-            rec.valid = validFlag;
-            for (uint32_t j = 0; j < fieldCount; ++j) {
-                std::string val;
-                if (!ReadString(ifs, val)) return false;
-                rec.values.push_back(val);
-            }
-            outRecords.push_back(rec);
-        }
-    }
-    return true;
+    TableScanCursor cursor;
+    if (!OpenScan(datPath, schema, cursor, err)) return false;
+    int64_t offset = 0;
+    Record row;
+    while (cursor.Next(offset, row)) outRecords.push_back({offset, std::move(row)});
+    err = cursor.error();
+    return err.empty();
+}
+
+bool StorageEngine::ReadRecords(const std::string& datPath, const TableSchema& schema, std::vector<Record>& outRecords, std::string& err) {
+    outRecords.clear();
+    TableScanCursor cursor;
+    if (!OpenScan(datPath, schema, cursor, err, false)) return false;
+    int64_t offset = 0;
+    Record row;
+    while (cursor.Next(offset, row)) outRecords.push_back(std::move(row));
+    err = cursor.error();
+    return err.empty();
 }
 
 // ******* ���ǹؼ����޸ĺ��� *******
 bool StorageEngine::SaveRecords(const std::string& datPath, const TableSchema& schema,
     const std::vector<Record>& records, std::string& err) {
+    if (schema.storage != StorageFormat::kRow) {
+        std::string path;
+        return PagedPath(datPath, schema, path, err) && PagedSave(path, schema, records, err);
+    }
+    if (UsesSegments(datPath)) {
+        // Segment layout: only this table's file is rewritten.
+        if (!dbms_paths::EnsureSegmentDirFromDat(datPath, err)) return false;
+        const std::string path = TableDataPath(datPath, schema.tableName);
+        std::ofstream ofs(StagingPath(path), std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open()) {
+            err = "Cannot open dat file for writing: " + path;
+            return false;
+        }
+        BlockEntry block;
+        std::vector<Zone> zones;
+        OverflowWriter overflow(StagingPath(path), schema);
+        if (!WriteTableBlock(ofs, schema, records, block, &zones, &overflow)) {
+            err = "Failed to write dat file: " + path;
+            return false;
+        }
+        ofs.close();
+        if (!overflow.Sync(err)) return false;
+        ZoneMap::Append(StagingPath(path), zones);
+        return ofs && BlockDirectory::Rewrite(StagingPath(path), {block}, err) && InstallStaged(path, err);
+    }
+
     // 1. �Ƶ���Ӧ�� .dbf ·��
     std::string dbfPath = datPath.substr(0, datPath.find_last_of('.')) + ".dbf";
 
@@ -632,30 +1117,147 @@ bool StorageEngine::SaveRecords(const std::string& datPath, const TableSchema& s
     allData[schema.tableName] = records;
 
     // 5. д�����б����ݣ�����д�����������б���
-    std::ofstream ofs(datPath, std::ios::binary | std::ios::trunc);
+    std::ofstream ofs(StagingPath(datPath), std::ios::binary | std::ios::trunc);
     if (!ofs.is_open()) {
         err = "Cannot open dat file for writing: " + datPath;
         return false;
     }
 
+    std::vector<BlockEntry> blocks;
+    std::vector<Zone> zones;
     for (const auto& tableSchema : allSchemas) {
         const std::string& tableName = tableSchema.tableName;
-        const auto& tableRecords = allData[tableName];
+        BlockEntry block;
+        if (!WriteTableBlock(ofs, tableSchema, allData[tableName], block, &zones)) return false;
+        blocks.push_back(block);
+    }
+    ofs.close();
+    ZoneMap::Append(StagingPath(datPath), zones);
+    return ofs && BlockDirectory::Rewrite(StagingPath(datPath), blocks, err) && InstallStaged(datPath, err);
+}
 
-        ofs.write(&kTableSep, 1);
-        if (!WriteString(ofs, tableName)) return false;
-        if (!WriteUInt32(ofs, static_cast<uint32_t>(tableRecords.size()))) return false;
-        if (!WriteUInt32(ofs, static_cast<uint32_t>(tableSchema.fields.size()))) return false;
-
-        for (const auto& rec : tableRecords) {
-            char validFlag = rec.valid ? 1 : 0;
-            ofs.write(&validFlag, 1);
-            for (size_t i = 0; i < tableSchema.fields.size(); ++i) {
-                const std::string& val = (i < rec.values.size()) ? rec.values[i] : "";
-                if (!WriteString(ofs, val)) return false;
-            }
+
+bool StorageEngine::UsesSegments(const std::string& datPath) const {
+    std::error_code ec;
+    if (fs::is_directory(dbms_paths::SegmentDirFromDat(datPath), ec)) return true;
+    // No segment dir yet: legacy layout only if the shared .dat holds data.
+    auto sz = fs::file_size(datPath, ec);
+    return ec || sz == 0;
+}
+
+std::string StorageEngine::TableDataPath(const std::string& datPath, const std::string& tableName) const {
+    if (!UsesSegments(datPath)) return datPath;
+    return dbms_paths::SegmentPathFromDat(datPath, tableName);
+}
+
+bool StorageEngine::NeedsSegmentMigration(const std::string& dbName) const {
+    return !UsesSegments(dbms_paths::DatPath(dbName));
+}
+
+bool StorageEngine::MigrateToSegments(const std::string& dbName, std::string& err) {
+    const std::string dat = dbms_paths::DatPath(dbName);
+    if (UsesSegments(dat)) return true;
+
+    std::vector<TableSchema> schemas;
+    if (!LoadSchemas(dbms_paths::DbfPath(dbName), schemas, err)) return false;
+
+    // Write every table into a staging dir, then swap it in with one rename.
+    fs::path segDir = dbms_paths::SegmentDirFromDat(dat);
+    fs::path stageDir = segDir;
+    stageDir += ".tmp";
+    try {
+        fs::remove_all(stageDir);
+        fs::create_directories(stageDir);
+    } catch (const fs::filesystem_error& e) {
+        err = "Filesystem error: " + std::string(e.what());
+        return false;
+    }
+
+    for (const auto& schema : schemas) {
+        if (schema.isView) continue;
+        std::vector<std::pair<int64_t, Record>> rows;
+        if (!ReadRecordsWithOffsets(dat, schema, rows, err)) return false;
+        std::vector<Record> records;
+        records.reserve(rows.size());
+        for (auto& row : rows) records.push_back(std::move(row.second));
+
+        const std::string segPath = (stageDir / (schema.tableName + ".dat")).string();
+        std::ofstream ofs(segPath, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open()) {
+            err = "Cannot create segment for table: " + schema.tableName;
+            return false;
+        }
+        BlockEntry block;
+        std::vector<Zone> zones;
+        if (!WriteTableBlock(ofs, schema, records, block, &zones)) {
+            err = "Failed writing segment for table: " + schema.tableName;
+            return false;
         }
+        ofs.close();
+        if (!BlockDirectory::Rewrite(segPath, {block}, err)) return false;
+        ZoneMap::Append(segPath, zones);
+        if (!SyncFile(segPath, err) || !SyncFile(BlockDirectory::PathFor(segPath), err) ||
+            !SyncFile(ZoneMap::PathFor(segPath), err)) return false;
+        FileHandleCache::Instance().InvalidatePrefix(stageDir.string());
+    }
+    if (!FileHandle::SyncDirectory(stageDir.string())) {
+        err = "Sync failed: " + stageDir.string();
+        return false;
     }
 
-    return static_cast<bool>(ofs);
+    try {
+        fs::rename(stageDir, segDir);
+    } catch (const fs::filesystem_error& e) {
+        err = "Filesystem error: " + std::string(e.what());
+        return false;
+    }
+    if (!SyncParentDir(segDir.string(), err)) return false;
+    // Segments are authoritative from here; drop the legacy payload.
+    std::ofstream(StagingPath(dat), std::ios::binary | std::ios::trunc);
+    return InstallStaged(dat, err);
+}
+
+bool StorageEngine::DropTableData(const std::string& datPath, const std::string& tableName, std::string& err) {
+    if (UsesSegments(datPath)) {
+        const std::string segPath = dbms_paths::SegmentPathFromDat(datPath, tableName);
+        if (!SyncForRawWrite(segPath, 0, err)) return false;
+        MappedFor(segPath).Release();
+        FileHandleCache::Instance().Invalidate(segPath);
+        ForgetReclaimable(segPath);
+        std::error_code ec;
+        fs::remove(segPath, ec);
+        BlockDirectory::Remove(segPath);
+        ZoneMap::Remove(segPath);
+        MappedFor(Overflow::PathFor(segPath)).Release();
+        Overflow::Remove(segPath);
+        if (ec) {
+            err = "Failed to remove segment: " + ec.message();
+            return false;
+        }
+        return true;
+    }
+
+    // Legacy layout: rewrite the shared file with the remaining tables.
+    std::string dbfPath = datPath.substr(0, datPath.find_last_of('.')) + ".dbf";
+    std::vector<TableSchema> schemas;
+    if (!LoadSchemas(dbfPath, schemas, err)) return false;
+    if (schemas.empty()) {
+        std::ofstream ofs(StagingPath(datPath), std::ios::binary | std::ios::trunc);
+        ofs.close();
+        return ofs && InstallStaged(datPath, err);
+    }
+    std::vector<Record> records;
+    if (!ReadRecords(datPath, schemas[0], records, err)) return false;
+    return SaveRecords(datPath, schemas[0], records, err);
+}
+
+bool StorageEngine::RenameTableData(const std::string& datPath, const std::string& oldName, const TableSchema& newSchema, std::string& err) {
+    // Block headers carry the table name, so the data is rewritten rather than renamed.
+    TableSchema oldSchema = newSchema;
+    oldSchema.tableName = oldName;
+    std::vector<Record> records;
+    if (!ReadRecords(datPath, oldSchema, records, err)) return false;
+    if (!SaveRecords(datPath, newSchema, records, err)) return false;
+    if (!UsesSegments(datPath)) return true;
+    return DropTableData(datPath, oldName, err);
 }
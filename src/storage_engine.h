@@ -1,13 +1,166 @@
 #pragma once
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <map>
 #include "db_types.h"
+#include "storage/append_writer.h"
+#include "storage/block_directory.h"
+#include "storage/buffer_pool.h"
+#include "storage/file_handle_cache.h"
+#include "storage/mapped_file.h"
+#include "storage/overflow.h"
+#include "storage/record_codec.h"
+#include "storage/schema_catalog.h"
+#include "storage/zone_map.h"
+
+// One row group of a columnar scan: the page's rows (live ones only unless
+// the scan was opened with validOnly = false), column by column. Columns
+// outside the cursor's mask are left empty. Views point into the snapshot
+// or into `rendered` and stay valid until the next NextChunk call.
+struct ColumnChunk {
+  std::vector<int64_t> rids;
+  std::vector<uint8_t> valid;
+  std::vector<std::vector<std::string_view>> columns;  // [field][row]
+  std::vector<std::vector<std::string>> rendered;      // typed values decoded to text
+  std::vector<std::vector<StoredNumber>> numbers;      // [field][row]; typed INT/DOUBLE columns only
+  // Dictionary (char[n]) columns: each row's code and each code's value,
+  // codes numbered per chunk in first-seen order; empty for other columns.
+  std::vector<std::vector<uint16_t>> codes;              // [field][row]
+  std::vector<std::vector<std::string_view>> dictionary;  // [field][code]
+
+  size_t size() const { return rids.size(); }
+  // Row k as a view; unread columns are empty.
+  void Row(size_t k, RecordView& out) const {
+    out.valid = valid[k] != 0;
+    out.values.resize(columns.size());
+    out.numbers.resize(numbers.size());
+    for (size_t i = 0; i < columns.size(); ++i) out.values[i] = columns[i].empty() ? std::string_view() : columns[i][k];
+    for (size_t i = 0; i < numbers.size(); ++i) out.numbers[i] = numbers[i].empty() ? StoredNumber() : numbers[i][k];
+  }
+};
+
+// Pull-based scan over one table, opened by StorageEngine::OpenScan.
+// It reads a snapshot of the data file: rows appended after opening are not
+// returned, and the caller may write to the table between calls.
+class TableScanCursor {
+ public:
+  // Next record; false at end of table or on error (see error()).
+  // A view points into the snapshot or the cursor's decode buffers and stays
+  // valid until the next call.
+  bool Next(int64_t& offset, RecordView& row);
+  bool Next(int64_t& offset, Record& row);
+  const std::string& error() const { return err_; }
+
+  // Fields the caller reads (by schema index); the others may come back
+  // empty. Out-of-line values (see Overflow) are only fetched for these, and
+  // STORAGE=COLUMNAR tables skip reading the others. Set before the first call.
+  void SetColumns(std::vector<bool> columns) { columns_ = std::move(columns); }
+  bool columnar() const { return columnar_; }
+  // Columnar tables only: the next page's rows; false at the end or on error.
+  bool NextChunk(ColumnChunk& chunk);
+  // For a caller that drops rows failing its WHERE: may gets the bounds of a
+  // page or row stripe (by schema field) and says whether any row there can
+  // pass; the ones it rules out are passed over unread. Set before the
+  // first call.
+  void SetZoneFilter(std::function<bool(const std::vector<ColumnZone>&)> may) { zoneFilter_ = std::move(may); }
+
+ private:
+  friend class StorageEngine;
+  bool NextInBlocks(int64_t& offset, RecordView& row);
+  bool NextInPages(int64_t& offset, RecordView& row);
+  bool NextInChunks(int64_t& offset, RecordView& row);
+  bool ReadChunk(uint64_t page, ColumnChunk& chunk);
+  // The page, checksum verified; nullptr (err_ set) when it stays bad.
+  const uint8_t* VerifiedPage(uint64_t page);
+  bool VerifyBlock(const BlockEntry& block);
+  void LoadZones();
+  bool PageSkipped(uint64_t page);
+  // Row format: collects the stripes of block that can be skipped; true
+  // when that is all of it.
+  bool BlockSkipped(const BlockEntry& block);
+  void Readahead(uint64_t at);
+  bool Wanted(size_t field) const { return field >= columns_.size() || columns_[field]; }
+  // An out-of-line value: v becomes the value (or empty, if not wanted).
+  bool Resolve(size_t field, std::string_view& v);
+  bool ResolveRow(RecordView& row);
+
+  std::shared_ptr<const FileMapping> map_;
+  // Overflow sidecar as of opening; remapped (older mappings kept, views
+  // may point into them) when a row rewritten since points past its end
+  MappedFile* overflowFile_ = nullptr;
+  std::vector<std::shared_ptr<const FileMapping>> overflow_;
+  std::string path_;
+  std::string tableName_;
+  RecordCodec codec_ = RecordCodec::Text(0);
+  std::vector<std::string> rendered_;  // typed values decoded to text
+  std::vector<int32_t> codeAt_;        // dictionary entry offset -> chunk code, -1 = unseen
+  bool paged_ = false;
+  bool columnar_ = false;
+  bool validOnly_ = true;
+  std::vector<bool> columns_;  // empty = all
+  // Row format: this table's blocks and the position inside the current one
+  std::vector<BlockEntry> blocks_;
+  size_t block_ = 0;
+  size_t pos_ = 0;
+  size_t end_ = 0;
+  uint32_t left_ = 0;
+  uint32_t blockFields_ = 0;
+  // Page formats: slot (row) count of the last page when the scan was opened
+  uint64_t page_ = 0;
+  uint64_t pageCount_ = 0;
+  uint32_t slot_ = 0;
+  uint16_t lastPageSlots_ = 0;
+  const uint8_t* current_ = nullptr;  // page_ as verified (mapping or pageCopy_)
+  // Columnar format: the page Next is serving rows from
+  ColumnChunk chunk_;
+  size_t chunkRow_ = 0;
+  std::vector<const uint8_t*> headers_;
+  std::vector<uint16_t> rows_;
+  std::vector<uint8_t> pageCopy_;  // a page re-read after a checksum mismatch
+  // Zone map, loaded on first use when a filter is set
+  std::function<bool(const std::vector<ColumnZone>&)> zoneFilter_;
+  bool zonesLoaded_ = false;
+  std::vector<Zone> zones_;
+  std::unordered_map<uint64_t, std::vector<const Zone*>> zonesAt_;  // by Zone::unit
+  std::vector<const Zone*> skips_;  // stripes of the current block to pass over
+  size_t skip_ = 0;
+  // io_uring only: file bytes from the scan position up to readahead_ are
+  // queued for reading ahead of the mapping's page faults
+  std::shared_ptr<FileHandle> file_;
+  uint64_t readahead_ = 0;
+  RecordView scratch_;
+  std::string err_;
+};
+
+// Outcome of StorageEngine::CheckTable. bad lists (page number, or byte
+// offset of a row block; problem).
+struct CheckReport {
+  uint64_t checked = 0;     // pages / blocks whose checksum matched
+  uint64_t unverified = 0;  // written without a checksum (or unsealed since)
+  std::vector<std::pair<uint64_t, std::string>> bad;
+};
+
+// Outcome of StorageEngine::CompactTable (bytesAfter is the dense size;
+// both sizes include the overflow sidecar).
+struct CompactStats {
+  uint64_t liveRows = 0;
+  uint64_t deadRows = 0;
+  uint64_t bytesBefore = 0;
+  uint64_t bytesAfter = 0;
+
+  uint64_t Reclaimed() const { return bytesBefore > bytesAfter ? bytesBefore - bytesAfter : 0; }
+};
 
 // Binary IO for .dbf (schema) and .dat (data)
 class StorageEngine {
  public:
-  
+  // Buffer pool budget: DBMS_BUFFER_POOL_MB (default 64)
+  StorageEngine();
+
   // Create empty database files: xxx.dbf / xxx.dat
   bool CreateDatabase(const std::string& dbName, std::string& err);
 
@@ -19,6 +172,14 @@ class StorageEngine {
 
   // Helper to load single schema
   bool LoadSchema(const std::string& dbfPath, const std::string& tableName, TableSchema& outSchema, std::string& err);
+  // False + err when the table's fields, indexes or layout no longer match
+  // schema: a DDL ran between loading it and locking the table.
+  bool SchemaStillCurrent(const std::string& dbfPath, const TableSchema& schema, std::string& err);
+
+  // The cached parse of dbf shared with other readers (parsed again only
+  // after a schema write); nullptr + err when it cannot be read.
+  std::shared_ptr<const SchemaSnapshot> LoadCatalog(const std::string& dbfPath, std::string& err);
+  uint64_t SchemaVersion(const std::string& dbfPath) const { return catalog_.Version(dbfPath); }
 
   // Overwrite dbf with all schemas
   bool SaveSchemas(const std::string& dbfPath, const std::vector<TableSchema>& schemas, std::string& err);
@@ -27,7 +188,7 @@ class StorageEngine {
   bool AppendSchema(const std::string& dbfPath, const TableSchema& schema, std::string& err);
 
   // Append one record for a table, returns offset in file
-  bool AppendRecord(const std::string& datPath, const TableSchema& schema, const Record& record, long& outOffset, std::string& err);
+  bool AppendRecord(const std::string& datPath, const TableSchema& schema, const Record& record, int64_t& outOffset, std::string& err);
   
   // Append multiple records for a table
   bool AppendRecords(const std::string& datPath, const TableSchema& schema, const std::vector<Record>& records, std::string& err);
@@ -36,38 +197,142 @@ class StorageEngine {
   bool ReadRecords(const std::string& datPath, const TableSchema& schema, std::vector<Record>& outRecords, std::string& err);
 
   // Read all records with their offsets (for Index Building)
-  bool ReadRecordsWithOffsets(const std::string& datPath, const TableSchema& schema, std::vector<std::pair<long, Record>>& outRecords, std::string& err);
+  bool ReadRecordsWithOffsets(const std::string& datPath, const TableSchema& schema, std::vector<std::pair<int64_t, Record>>& outRecords, std::string& err);
+
+  // Stream a table's records in file order (valid ones only unless validOnly is false)
+  bool OpenScan(const std::string& datPath, const TableSchema& schema, TableScanCursor& cursor, std::string& err, bool validOnly = true);
 
   // Read single record at specific offset (Random Access)
-  bool ReadRecordAt(const std::string& datPath, const TableSchema& schema, long offset, Record& outRecord, std::string& err);
+  bool ReadRecordAt(const std::string& datPath, const TableSchema& schema, int64_t offset, Record& outRecord, std::string& err);
+
+  // Read records at many offsets in one pass; outRecords[i] is the row at offsets[i]
+  bool ReadRecordsAt(const std::string& datPath, const TableSchema& schema, const std::vector<int64_t>& offsets, std::vector<Record>& outRecords, std::string& err);
 
   // Read raw record bytes at offset (valid flag + fields)
-  bool ReadRecordBytesAt(const std::string& datPath, const TableSchema& schema, long offset, std::vector<uint8_t>& outBytes, std::string& err);
+  bool ReadRecordBytesAt(const std::string& datPath, const TableSchema& schema, int64_t offset, std::vector<uint8_t>& outBytes, std::string& err);
 
-  // Write raw record bytes at offset
-  bool WriteRecordBytesAt(const std::string& datPath, long offset, const std::vector<uint8_t>& bytes, std::string& err);
+  // Write raw record bytes at offset (buffered; lsn = WAL record covering the write, 0 if none)
+  bool WriteRecordBytesAt(const std::string& datPath, const TableSchema& schema, int64_t offset, const std::vector<uint8_t>& bytes, std::string& err, uint64_t lsn = 0);
 
-  // Compute offset for next append record (single-record block)
-  bool ComputeAppendRecordOffset(const std::string& datPath, const TableSchema& schema, long& outOffset, std::string& err);
+  // Compute offset (RID for paged tables) the next AppendRecord of these record bytes will return
+  bool ComputeAppendRecordOffset(const std::string& datPath, const TableSchema& schema, const std::vector<uint8_t>& recordBytes, int64_t& outOffset, std::string& err);
+
+  // Whether after can be written over before at the same offset (same size;
+  // on a columnar page every plain cell keeps its size and a changed
+  // dictionary cell must find an equal entry or room for a new one)
+  bool CanOverwrite(const std::string& datPath, const TableSchema& schema, int64_t offset, const std::vector<uint8_t>& before, const std::vector<uint8_t>& after) const;
 
   // Write insert block header + record at offset
-  bool WriteInsertBlockAt(const std::string& datPath, const TableSchema& schema, long recordOffset, const std::vector<uint8_t>& recordBytes, std::string& err);
+  bool WriteInsertBlockAt(const std::string& datPath, const TableSchema& schema, int64_t recordOffset, const std::vector<uint8_t>& recordBytes, std::string& err, uint64_t lsn = 0);
+
+  // Write buffered changes of one table to its data file (non-transactional writes)
+  bool FlushTable(const std::string& datPath, const TableSchema& schema, std::string& err);
+  // FlushTable, then fsync the data file and its sidecars (before a WAL
+  // rewrite marker, which lets recovery drop the table's earlier records)
+  bool SyncTable(const std::string& datPath, const TableSchema& schema, std::string& err);
 
-  // Serialize record to bytes (valid flag + fields)
-  bool SerializeRecord(const TableSchema& schema, const Record& record, std::vector<uint8_t>& outBytes, std::string& err) const;
+  // Serialize record to bytes (valid flag + fields) as datPath stores it:
+  // long values move to the table's overflow sidecar (made durable first)
+  // and record gets the pointers, so appending it moves nothing again.
+  bool SerializeRecord(const std::string& datPath, const TableSchema& schema, Record& record, std::vector<uint8_t>& outBytes, std::string& err);
 
   // Overwrite all records of a table
   bool SaveRecords(const std::string& datPath, const TableSchema& schema, const std::vector<Record>& records, std::string& err);
 
+  // Rewrite a table's live records densely (one row block, or packed pages)
+  // and remap its index files. The caller must keep writers out of the table
+  // and retire its WAL records first. dryRun only measures.
+  bool CompactTable(const std::string& datPath, const TableSchema& schema, CompactStats& stats, std::string& err, bool dryRun = false);
+  // What CompactTable last measured as reclaimable (dry run or not) plus the
+  // bytes of rows deleted since; no IO. False when the table has not been
+  // measured since startup or its data file was replaced since.
+  bool EstimateReclaimable(const std::string& datPath, const TableSchema& schema, uint64_t& outBytes);
+
+  // Verify every page / row block checksum of a table and decode its rows.
+  // false only when the table cannot be read at all.
+  bool CheckTable(const std::string& datPath, const TableSchema& schema, CheckReport& report, std::string& err);
+
+  // Per-table segment files: data/<db>/segments/<table>.dat
+  // A database uses segments once its segment dir exists or it has no legacy data.
+  bool UsesSegments(const std::string& datPath) const;
+  std::string TableDataPath(const std::string& datPath, const std::string& tableName) const;
+  bool NeedsSegmentMigration(const std::string& dbName) const;
+  // Split the shared legacy .dat into segments; record offsets change, so the
+  // caller must rebuild indexes and discard the WAL.
+  bool MigrateToSegments(const std::string& dbName, std::string& err);
+  // Complete the table rewrites a crash interrupted mid-install; run at
+  // startup, before recovery.
+  bool FinishInstalls(const std::string& dbName, std::string& err);
+  // Remove/rename one table's data (call after the schema change is saved)
+  bool DropTableData(const std::string& datPath, const std::string& tableName, std::string& err);
+  bool RenameTableData(const std::string& datPath, const std::string& oldName, const TableSchema& newSchema, std::string& err);
+
   // Index IO
-  bool LoadIndex(const std::string& indexPath, std::map<std::string, long>& outIndex, std::string& err);
-  bool SaveIndex(const std::string& indexPath, const std::map<std::string, long>& index, std::string& err);
+  bool LoadIndex(const std::string& indexPath, std::map<std::string, int64_t>& outIndex, std::string& err);
+  bool SaveIndex(const std::string& indexPath, const std::map<std::string, int64_t>& index, std::string& err);
 
   // Backup
   bool BackupDatabase(const std::string& dbName, const std::string& destPath, std::string& err);
 
+  // Buffer pool: dirty pages are written back only after the WAL is durable
+  // up to their LSN; the flusher receives the database name.
+  void SetWalFlusher(BufferPool::WalFlusher flusher);
+  bool FlushBufferPool(std::string& err);
+  const BufferPool& Pool() const { return *pool_; }
+
  private:
   // basic read/write helpers
   bool WriteString(std::ofstream& ofs, const std::string& s);
   bool ReadString(std::ifstream& ifs, std::string& s);
+  friend class TableScanCursor;
+
+  // .dbf parsing and writing behind the catalog cache
+  bool ParseSchemas(const std::string& dbfPath, std::vector<TableSchema>& outSchemas, std::string& err);
+  bool WriteSchemas(const std::string& dbfPath, const std::vector<TableSchema>& schemas, std::string& err);
+
+  // Append one row-format block; outFirstOffset = offset of its first record
+  bool AppendRowBlock(const std::string& datPath, const TableSchema& schema, const std::vector<Record>& records, int64_t* outFirstOffset, std::string& err);
+
+  // Byte-range access through the buffer pool (row-format files)
+  bool PoolWrite(const std::string& path, const std::string& walKey, uint64_t offset, const std::vector<uint8_t>& bytes, uint64_t lsn, std::string& err);
+  // Before the file is read / modified outside the pool
+  bool SyncForRawRead(const std::string& path, std::string& err);
+  bool SyncForRawWrite(const std::string& path, uint64_t fromOffset, std::string& err);
+  // Cached read-only mapping used by full scans
+  MappedFile& MappedFor(const std::string& path);
+  // Row-block appender of a data file
+  AppendWriter& WriterFor(const std::string& path);
+  // Rewrites go to StagingPath(path) and are renamed over the data file, so
+  // open scan snapshots never see a truncated file.
+  static std::string StagingPath(const std::string& path);
+  // Rename the staged data file and sidecars, then each of companions (index
+  // files, also staged at StagingPath), over the live ones; durable on return.
+  bool InstallStaged(const std::string& path, std::string& err, const std::vector<std::string>& companions = {});
+  // Tallies behind EstimateReclaimable, by data file; Add only counts on
+  // top of a measurement.
+  void SetReclaimable(const std::string& path, uint64_t bytes);
+  void AddReclaimable(const std::string& path, uint64_t bytes);
+  void ForgetReclaimable(const std::string& path);
+  // Replace the overflow pointers of a record read from the data file at path.
+  bool LoadOverflow(const std::string& path, Record& record, std::string& err);
+
+  // STORAGE=PAGED and STORAGE=COLUMNAR tables (storage_engine_paged.cpp);
+  // offsets are packed RIDs
+  bool PagedPath(const std::string& datPath, const TableSchema& schema, std::string& outPath, std::string& err) const;
+  bool PagedAppend(const std::string& path, const TableSchema& schema, const std::vector<Record>& records, int64_t* outLastRid, std::string& err);
+  bool ColumnarAppend(const std::string& path, const TableSchema& schema, const std::vector<std::vector<uint8_t>>& encoded, int64_t* outLastRid, std::string& err);
+  bool PagedComputeAppendRid(const std::string& path, const std::string& walKey, const TableSchema& schema, const std::vector<uint8_t>& bytes, int64_t& outRid, std::string& err);
+  bool PagedReadBytes(const std::string& path, const std::string& walKey, const TableSchema& schema, int64_t rid, std::vector<uint8_t>& outBytes, std::string& err);
+  bool PagedReadRecord(const std::string& path, const std::string& walKey, const TableSchema& schema, int64_t rid, Record& outRecord, std::string& err);
+  bool PagedWriteBytes(const std::string& path, const std::string& walKey, const TableSchema& schema, int64_t rid, const std::vector<uint8_t>& bytes, bool allowInsert, uint64_t lsn, std::string& err);
+  bool PagedSave(const std::string& path, const TableSchema& schema, const std::vector<Record>& records, std::string& err);
+
+  std::unique_ptr<BufferPool> pool_;
+  SchemaCatalog catalog_;
+  std::map<std::string, std::unique_ptr<MappedFile>> mapped_;
+  std::mutex mappedMu_;
+  std::map<std::string, std::unique_ptr<AppendWriter>> writers_;
+  std::mutex writersMu_;
+  std::map<std::string, uint64_t> reclaimable_;
+  std::mutex reclaimableMu_;
 };
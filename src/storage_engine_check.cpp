@@ -0,0 +1,158 @@
+#include "storage_engine.h"
+#include "storage/crc32c.h"
+#include "storage/pax_page.h"
+#include "storage/slotted_page.h"
+
+#include <cstring>
+#include <filesystem>
+
+namespace {
+constexpr char kTableSep = '~';
+
+bool Take(const uint8_t* base, size_t end, size_t& pos, void* dst, size_t n) {
+  if (pos > end || n > end - pos) return false;
+  if (n > 0) std::memcpy(dst, base + pos, n);
+  pos += n;
+  return true;
+}
+
+// Checksum of one mapped page (the verified bytes end up in copy); a torn
+// read of a page being written back gets a few re-reads, as in scans.
+bool CheckPage(const uint8_t* p, std::vector<uint8_t>& copy, CheckReport& report) {
+  if (PageBlank(p)) {
+    ++report.unverified;
+    return true;
+  }
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    copy.assign(p, p + kPageSize);
+    if (PageChecksumOk(copy.data())) {
+      ++report.checked;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Some value is an overflow pointer that leads to no intact entry.
+template <typename Row>
+bool BadPointer(const Row& row, const FileMapping& overflow) {
+  std::string_view v;
+  for (size_t i = 0; i < row.values.size(); ++i) {
+    if (row.Overflowed(i) && !Overflow::Resolve(overflow, row.values[i], v)) return true;
+  }
+  return false;
+}
+
+std::string DecodePage(const uint8_t* p, bool columnar, const RecordCodec& codec, const FileMapping& overflow) {
+  Record rec;
+  if (columnar) {
+    PaxPage pg(const_cast<uint8_t*>(p));
+    if (!pg.IsInitialized()) return "";
+    if (pg.ColumnCount() != codec.fieldCount() + 1) return "column count mismatch";
+    std::vector<uint8_t> bytes;
+    for (uint16_t r = 0; r < pg.RowCount(); ++r) {
+      if (!pg.Get(r, bytes) || !codec.Decode(bytes.data(), bytes.size(), rec)) return "corrupt row " + std::to_string(r);
+      if (BadPointer(rec, overflow)) return "bad overflow pointer in row " + std::to_string(r);
+    }
+    return "";
+  }
+  SlottedPage pg(const_cast<uint8_t*>(p));
+  if (!pg.IsInitialized()) return "";
+  for (uint16_t s = 0; s < pg.SlotCount(); ++s) {
+    const uint8_t* bytes = nullptr;
+    uint16_t len = 0;
+    if (!pg.Get(s, bytes, len)) return "corrupt slot " + std::to_string(s);
+    if (len == 0) continue;
+    if (!codec.Decode(bytes, len, rec)) return "corrupt record in slot " + std::to_string(s);
+    if (BadPointer(rec, overflow)) return "bad overflow pointer in slot " + std::to_string(s);
+  }
+  return "";
+}
+
+std::string DecodeBlock(const uint8_t* base, const BlockEntry& b, const std::string& table, const RecordCodec& codec,
+                        const FileMapping& overflow) {
+  size_t pos = static_cast<size_t>(b.offset);
+  const size_t end = static_cast<size_t>(b.offset + b.length);
+  char sep = 0;
+  uint32_t nameLen = 0, count = 0, fields = 0;
+  if (!Take(base, end, pos, &sep, 1) || sep != kTableSep) return "invalid separator";
+  if (!Take(base, end, pos, &nameLen, sizeof(nameLen)) || nameLen > end - pos) return "truncated header";
+  const std::string name(reinterpret_cast<const char*>(base + pos), nameLen);
+  pos += nameLen;
+  if (!Take(base, end, pos, &count, sizeof(count)) || !Take(base, end, pos, &fields, sizeof(fields))) return "truncated header";
+  if (name != table) return "";  // table id collision
+  if (count != b.record_count) return "record count differs from the block directory";
+  if (fields != codec.fieldCount() && codec.typed()) return "field count mismatch";
+  const RecordCodec blockCodec = fields != codec.fieldCount() ? RecordCodec::Text(fields) : codec;
+  RecordView row;
+  std::vector<std::string> scratch;
+  for (uint32_t i = 0; i < count; ++i) {
+    size_t used = 0;
+    if (!blockCodec.Decode(base + pos, end - pos, row, scratch, &used)) return "corrupt record " + std::to_string(i);
+    if (BadPointer(row, overflow)) return "bad overflow pointer in record " + std::to_string(i);
+    pos += used;
+  }
+  return pos == end ? "" : "trailing bytes after the last record";
+}
+}  // namespace
+
+bool StorageEngine::CheckTable(const std::string& datPath, const TableSchema& schema, CheckReport& report, std::string& err) {
+  report = CheckReport();
+  const std::string path = TableDataPath(datPath, schema.tableName);
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) return true;  // nothing written yet
+  if (!SyncForRawRead(path, err)) return false;
+  const RecordCodec codec(schema);
+
+  std::vector<BlockEntry> blocks;
+  if (schema.storage == StorageFormat::kRow && !BlockDirectory::Load(path, blocks, err)) return false;
+  auto map = MappedFor(path).Acquire(err);
+  if (!map) return false;
+  const uint8_t* base = map->data();
+  auto overflow = MappedFor(Overflow::PathFor(path)).Acquire(err);  // no older than the rows
+  if (!overflow) return false;
+
+  if (schema.storage != StorageFormat::kRow) {
+    const bool columnar = schema.storage == StorageFormat::kColumnar;
+    const uint64_t pages = map->size() / kPageSize;
+    std::vector<uint8_t> copy;
+    for (uint64_t p = 0; p < pages; ++p) {
+      const uint8_t* page = base + p * kPageSize;
+      if (!CheckPage(page, copy, report)) {
+        report.bad.push_back({p, "checksum mismatch"});
+        continue;
+      }
+      const std::string problem = DecodePage(copy.empty() ? page : copy.data(), columnar, codec, *overflow);
+      if (!problem.empty()) report.bad.push_back({p, problem});
+      copy.clear();
+    }
+    if (map->size() % kPageSize != 0) report.bad.push_back({pages, "partial page at end of file"});
+    return true;
+  }
+
+  const uint32_t tableId = BlockDirectory::TableId(schema.tableName);
+  for (const auto& b : blocks) {
+    if (b.table_id != tableId) continue;
+    if (b.offset + b.length > map->size()) {
+      report.bad.push_back({b.offset, "block beyond end of file"});
+      continue;
+    }
+    if (b.crc == 0) {
+      ++report.unverified;
+    } else {
+      const uint32_t crc = Crc32c(base + b.offset, static_cast<size_t>(b.length));
+      BlockEntry now;
+      if (crc == b.crc) {
+        ++report.checked;
+      } else if (BlockDirectory::Lookup(path, b.offset, now) && (now.crc == 0 || now.crc == crc)) {
+        ++report.unverified;  // written since the directory was read
+      } else {
+        report.bad.push_back({b.offset, "checksum mismatch"});
+        continue;
+      }
+    }
+    const std::string problem = DecodeBlock(base, b, schema.tableName, codec, *overflow);
+    if (!problem.empty()) report.bad.push_back({b.offset, problem});
+  }
+  return true;
+}
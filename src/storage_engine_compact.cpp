@@ -0,0 +1,276 @@
+#include "storage_engine.h"
+#include "path_utils.h"
+#include "storage/crc32c.h"
+#include "storage/pax_page.h"
+#include "storage/slotted_page.h"
+
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kTableSep = '~';
+
+void PutUInt32(std::vector<uint8_t>& out, uint32_t v) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+  out.insert(out.end(), p, p + sizeof(v));
+}
+
+uint64_t FileSize(const std::string& path) {
+  std::error_code ec;
+  auto sz = fs::file_size(path, ec);
+  return ec ? 0 : static_cast<uint64_t>(sz);
+}
+
+// CRC32C of a whole file (the compacted row block, whose header is patched
+// after its records are written).
+bool FileCrc(const std::string& path, uint32_t& crc) {
+  std::ifstream ifs(path, std::ios::binary);
+  std::vector<char> buf(1 << 16);
+  crc = 0;
+  while (ifs) {
+    ifs.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+    crc = Crc32c(buf.data(), static_cast<size_t>(ifs.gcount()), crc);
+  }
+  return ifs.eof();
+}
+
+// Destination of a compaction: one dense row block, or packed pages (PAX
+// pages laid out for exactly the rows they hold), with their zones. With no
+// stream attached it only measures.
+class DenseWriter {
+ public:
+  DenseWriter(std::ofstream* out, const TableSchema& schema)
+      : out_(out),
+        paged_(schema.storage != StorageFormat::kRow),
+        columnar_(schema.storage == StorageFormat::kColumnar),
+        codec_(schema),
+        page_(kPageSize),
+        pg_(page_.data()),
+        group_(codec_),
+        zone_(schema) {
+    if (paged_) {
+      pg_.Init();
+      return;
+    }
+    std::vector<uint8_t> header;
+    header.push_back(static_cast<uint8_t>(kTableSep));
+    PutUInt32(header, static_cast<uint32_t>(schema.tableName.size()));
+    header.insert(header.end(), schema.tableName.begin(), schema.tableName.end());
+    countAt_ = header.size();
+    PutUInt32(header, 0);  // record count, patched in Finish
+    PutUInt32(header, static_cast<uint32_t>(schema.fields.size()));
+    Write(header);
+  }
+
+  // Place one record; outOffset = its new offset / RID.
+  bool Add(const std::vector<uint8_t>& bytes, int64_t& outOffset) {
+    ++count_;
+    if (!paged_) {
+      outOffset = static_cast<int64_t>(size_);
+      if (out_) {
+        if (zone_.rows() == 0) stripeAt_ = size_;
+        if (codec_.Decode(bytes.data(), bytes.size(), row_, scratch_)) zone_.Add(row_);
+        else zoneless_ = true;
+      }
+      Write(bytes);
+      if (zone_.rows() == ZoneMap::kStripeRows) zones_.push_back(zone_.Take(0, stripeAt_, size_, 0));
+      return true;
+    }
+    if (columnar_) {
+      if (bytes.size() > PaxPage::MaxRecordSize(codec_.fieldCount() + 1)) return false;
+      if (!group_.Add(bytes) && (group_.empty() || !WriteGroup() || !group_.Add(bytes))) return false;
+      outOffset = MakePageRid(pageNo_, static_cast<uint16_t>(group_.size() - 1));
+      return true;
+    }
+    if (bytes.size() > SlottedPage::MaxRecordSize()) return false;
+    uint16_t slot = 0;
+    if (!pg_.Insert(bytes.data(), static_cast<uint16_t>(bytes.size()), slot)) {
+      WritePage();
+      ++pageNo_;
+      pg_.Init();
+      pg_.Insert(bytes.data(), static_cast<uint16_t>(bytes.size()), slot);
+    }
+    outOffset = MakePageRid(pageNo_, slot);
+    return true;
+  }
+
+  bool Finish(BlockEntry& block) {
+    if (columnar_) {
+      if (!group_.empty() && !WriteGroup()) return false;
+    } else if (paged_) {
+      if (count_ > 0) WritePage();
+    } else {
+      if (zone_.rows() > 0) zones_.push_back(zone_.Take(0, stripeAt_, size_, 0));
+      if (zoneless_ || count_ < ZoneMap::kMinBlockRows) zones_.clear();
+      block.record_count = count_;
+      block.offset = 0;
+      block.length = size_;
+      if (out_) {
+        out_->seekp(static_cast<std::streamoff>(countAt_));
+        out_->write(reinterpret_cast<const char*>(&count_), sizeof(count_));
+      }
+    }
+    return !out_ || static_cast<bool>(*out_);
+  }
+
+  uint64_t size() const { return size_; }
+  // Row blocks: stamp with the block checksum once it is known.
+  std::vector<Zone>& zones() { return zones_; }
+
+ private:
+  void Write(const std::vector<uint8_t>& bytes) {
+    if (out_) out_->write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    size_ += bytes.size();
+  }
+
+  void WritePage() {
+    if (out_) {
+      StampPageChecksum(page_.data());
+      const bool ok = zone_.AddPage(codec_, page_.data(), columnar_);
+      Zone zone = zone_.Take(pageNo_, 0, 0, SlottedPage(page_.data()).Checksum());
+      if (ok) zones_.push_back(std::move(zone));
+    }
+    Write(page_);
+  }
+
+  bool WriteGroup() {
+    if (!group_.Build(page_.data())) return false;
+    WritePage();
+    ++pageNo_;
+    group_.Clear();
+    return true;
+  }
+
+  std::ofstream* out_;
+  bool paged_;
+  bool columnar_;
+  RecordCodec codec_;
+  std::vector<uint8_t> page_;
+  SlottedPage pg_;
+  PaxRowGroup group_;  // columnar: rows of the page being filled
+  uint64_t pageNo_ = 0;
+  size_t countAt_ = 0;
+  uint32_t count_ = 0;
+  uint64_t size_ = 0;
+  ZoneBuilder zone_;
+  std::vector<Zone> zones_;
+  uint64_t stripeAt_ = 0;
+  bool zoneless_ = false;  // a row did not decode: no row block zones
+  RecordView row_;
+  std::vector<std::string> scratch_;
+};
+}  // namespace
+
+bool StorageEngine::CompactTable(const std::string& datPath, const TableSchema& schema, CompactStats& stats, std::string& err, bool dryRun) {
+  stats = CompactStats();
+  const bool paged = schema.storage != StorageFormat::kRow;
+  const std::string path = TableDataPath(datPath, schema.tableName);
+  if (path == datPath) {
+    err = "VACUUM requires per-table segments: " + schema.tableName;
+    return false;
+  }
+
+  TableScanCursor cursor;
+  if (!OpenScan(datPath, schema, cursor, err, false)) return false;
+  stats.bytesBefore = FileSize(path) + FileSize(Overflow::PathFor(path));
+
+  std::ofstream ofs;
+  if (!dryRun) {
+    ofs.open(StagingPath(path), std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+      err = "Cannot open dat file for writing: " + path;
+      return false;
+    }
+  }
+  DenseWriter writer(dryRun ? nullptr : &ofs, schema);
+  // Live rows' long values are copied to a fresh sidecar; dead ones stay behind.
+  OverflowWriter overflow(StagingPath(path), schema);
+  uint64_t overflowBytes = 0;
+  std::unordered_map<int64_t, int64_t> moved;
+  const RecordCodec codec(schema);  // pads/truncates rows of older text blocks
+  std::vector<uint8_t> bytes;
+  int64_t offset = 0;
+  RecordView row;
+  Record rec;
+  while (cursor.Next(offset, row)) {
+    if (!row.valid) {
+      ++stats.deadRows;
+      continue;
+    }
+    ++stats.liveRows;
+    rec = row.Materialize();
+    if (dryRun) {
+      overflowBytes += Overflow::Shrink(codec, rec);
+    } else {
+      overflow.Add(rec);
+      if (!overflow.Flush(err)) return false;
+    }
+    codec.Encode(rec, bytes);
+    int64_t newOffset = 0;
+    if (!writer.Add(bytes, newOffset)) {
+      err = "Record too large for a page";
+      return false;
+    }
+    if (!dryRun) moved[offset] = newOffset;
+  }
+  if (!cursor.error().empty()) {
+    err = cursor.error();
+    return false;
+  }
+  BlockEntry block;
+  if (!writer.Finish(block)) {
+    err = "Failed to write compacted dat file: " + path;
+    return false;
+  }
+  block.table_id = BlockDirectory::TableId(schema.tableName);
+  stats.bytesAfter = writer.size() + (dryRun ? overflowBytes : overflow.bytes());
+  if (dryRun) {
+    SetReclaimable(path, stats.Reclaimed());
+    return true;
+  }
+  ofs.close();
+  if (!overflow.Sync(err)) return false;
+  if (!ofs || (!paged && !FileCrc(StagingPath(path), block.crc))) {
+    err = "Failed to write compacted dat file: " + path;
+    return false;
+  }
+  if (!paged) {
+    for (auto& zone : writer.zones()) zone.stamp = block.crc;
+  }
+  ZoneMap::Append(StagingPath(path), writer.zones());
+
+  // Index files are remapped next to the new data file and installed with it.
+  std::vector<std::string> indexPaths;
+  for (const auto& def : schema.indexes) {
+    const std::string idxPath = dbms_paths::IndexPathFromDat(datPath, schema.tableName, def.name);
+    std::map<std::string, int64_t> index;
+    if (!fs::exists(idxPath) || !LoadIndex(idxPath, index, err)) continue;
+    for (auto it = index.begin(); it != index.end();) {
+      auto m = moved.find(it->second);
+      if (m == moved.end()) {
+        it = index.erase(it);
+      } else {
+        it->second = m->second;
+        ++it;
+      }
+    }
+    if (!SaveIndex(StagingPath(idxPath), index, err)) return false;
+    indexPaths.push_back(idxPath);
+  }
+
+  if (!paged && !BlockDirectory::Rewrite(StagingPath(path), {block}, err)) return false;
+  if (!InstallStaged(path, err, indexPaths)) return false;
+  SetReclaimable(path, 0);
+  return true;
+}
+
+bool StorageEngine::EstimateReclaimable(const std::string& datPath, const TableSchema& schema, uint64_t& outBytes) {
+  std::lock_guard<std::mutex> lock(reclaimableMu_);
+  auto it = reclaimable_.find(TableDataPath(datPath, schema.tableName));
+  if (it == reclaimable_.end()) return false;
+  outBytes = it->second;
+  return true;
+}
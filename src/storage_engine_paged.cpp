@@ -0,0 +1,271 @@
+#include "storage_engine.h"
+#include "path_utils.h"
+#include "storage/file_handle_cache.h"
+#include "storage/pax_page.h"
+#include "storage/slotted_page.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+uint64_t PageCount(const std::string& path) {
+  std::error_code ec;
+  auto sz = std::filesystem::file_size(path, ec);
+  return ec ? 0 : static_cast<uint64_t>(sz) / kPageSize;
+}
+
+bool ReadPage(FileHandle& file, uint64_t page, std::vector<uint8_t>& buf, std::string& err) {
+  buf.resize(kPageSize);
+  size_t got = 0;
+  if (!file.ReadAt(page * kPageSize, buf.data(), kPageSize, got) || got != kPageSize) {
+    err = "Read page failed";
+    return false;
+  }
+  if (!PageChecksumOk(buf.data())) {
+    err = "Checksum mismatch in page " + std::to_string(page);
+    return false;
+  }
+  return true;
+}
+
+// Stamps the page checksum into buf before writing it.
+bool WritePage(FileHandle& file, uint64_t page, std::vector<uint8_t>& buf) {
+  StampPageChecksum(buf.data());
+  return file.WriteAt(page * kPageSize, buf.data(), kPageSize);
+}
+
+// Zone of a page appends have filled, as written (buf is stamped). The last
+// page still takes rows, so it is zoned only once appends move past it.
+void ZonePage(ZoneBuilder& builder, const RecordCodec& codec, uint64_t page, std::vector<uint8_t>& buf,
+              bool columnar, std::vector<Zone>& zones) {
+  const bool ok = builder.AddPage(codec, buf.data(), columnar);
+  const uint32_t stamp = columnar ? PaxPage(buf.data()).Checksum() : SlottedPage(buf.data()).Checksum();
+  Zone zone = builder.Take(page, 0, 0, stamp);
+  if (ok) zones.push_back(std::move(zone));
+}
+
+}  // namespace
+
+bool StorageEngine::PagedPath(const std::string& datPath, const TableSchema& schema, std::string& outPath, std::string& err) const {
+  outPath = TableDataPath(datPath, schema.tableName);
+  if (outPath == datPath) {
+    err = "Paged storage requires per-table segments: " + schema.tableName;
+    return false;
+  }
+  return dbms_paths::EnsureSegmentDirFromDat(datPath, err);
+}
+
+bool StorageEngine::PagedAppend(const std::string& path, const TableSchema& schema, const std::vector<Record>& records, int64_t* outLastRid, std::string& err) {
+  const RecordCodec codec(schema);
+  const bool columnar = schema.storage == StorageFormat::kColumnar;
+  const size_t maxSize = columnar ? PaxPage::MaxRecordSize(schema.fields.size() + 1) : SlottedPage::MaxRecordSize();
+  for (const auto& r : records) {
+    if (r.values.size() != schema.fields.size()) { err = "Record field count mismatch"; return false; }
+  }
+  // Long values go to the sidecar first, so no row points at a value that may be lost.
+  OverflowWriter overflow(path, schema);
+  std::vector<Record> moved;
+  const std::vector<Record>& rows = overflow.Add(records, moved);
+  if (!overflow.Sync(err)) return false;
+  std::vector<std::vector<uint8_t>> encoded(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    codec.Encode(rows[i], encoded[i]);
+    if (encoded[i].size() > maxSize) { err = "Record too large for a page"; return false; }
+  }
+  if (columnar) return ColumnarAppend(path, schema, encoded, outLastRid, err);
+
+  uint64_t pageCount = PageCount(path);
+  if (!SyncForRawWrite(path, pageCount > 0 ? (pageCount - 1) * kPageSize : 0, err)) return false;
+  auto file = FileHandleCache::Instance().Open(path, true, err);
+  if (!file) { err = "Cannot open dat file for append: " + path; return false; }
+  std::vector<uint8_t> buf(kPageSize);
+  uint64_t page = 0;
+  if (pageCount > 0) {
+    page = pageCount - 1;
+    if (!ReadPage(*file, page, buf, err)) return false;
+  }
+  SlottedPage pg(buf.data());
+  if (!pg.IsInitialized()) pg.Init();
+
+  ZoneBuilder builder(schema);
+  std::vector<Zone> zones;
+  for (const auto& bytes : encoded) {
+    uint16_t slot = 0;
+    if (!pg.Insert(bytes.data(), static_cast<uint16_t>(bytes.size()), slot)) {
+      if (!WritePage(*file, page, buf)) { err = "Write page failed"; return false; }
+      ZonePage(builder, codec, page, buf, false, zones);
+      ++page;
+      pg.Init();
+      pg.Insert(bytes.data(), static_cast<uint16_t>(bytes.size()), slot);
+    }
+    if (outLastRid) *outLastRid = MakePageRid(page, slot);
+  }
+  if (!WritePage(*file, page, buf)) { err = "Write page failed"; return false; }
+  ZoneMap::Append(path, zones);
+  return true;
+}
+
+// Rows first fill the last page's column regions in place; the rest go to
+// fresh pages, each laid out for the rows it holds.
+bool StorageEngine::ColumnarAppend(const std::string& path, const TableSchema& schema, const std::vector<std::vector<uint8_t>>& encoded, int64_t* outLastRid, std::string& err) {
+  const RecordCodec codec(schema);
+  uint64_t pageCount = PageCount(path);
+  if (!SyncForRawWrite(path, pageCount > 0 ? (pageCount - 1) * kPageSize : 0, err)) return false;
+  auto file = FileHandleCache::Instance().Open(path, true, err);
+  if (!file) { err = "Cannot open dat file for append: " + path; return false; }
+  std::vector<uint8_t> buf(kPageSize);
+  uint64_t page = pageCount;
+  size_t next = 0;
+  ZoneBuilder builder(schema);
+  std::vector<Zone> zones;
+  if (pageCount > 0) {
+    if (!ReadPage(*file, pageCount - 1, buf, err)) return false;
+    PaxPage last(buf.data());
+    if (!last.IsInitialized()) page = pageCount - 1;
+    uint16_t row = 0;
+    while (next < encoded.size() && last.IsInitialized() &&
+           last.Insert(codec, encoded[next].data(), encoded[next].size(), row)) {
+      if (outLastRid) *outLastRid = MakePageRid(pageCount - 1, row);
+      ++next;
+    }
+    if (next > 0 && !WritePage(*file, pageCount - 1, buf)) { err = "Write page failed"; return false; }
+    if (next < encoded.size() && last.IsInitialized()) ZonePage(builder, codec, pageCount - 1, buf, true, zones);
+  }
+
+  PaxRowGroup group(codec);
+  // full: the group took rows until one did not fit, so the page is done.
+  auto writeGroup = [&](bool full) -> bool {
+    if (!group.Build(buf.data())) { err = "Corrupt record for a columnar page"; return false; }
+    if (!WritePage(*file, page, buf)) { err = "Write page failed"; return false; }
+    if (full) ZonePage(builder, codec, page, buf, true, zones);
+    if (outLastRid) *outLastRid = MakePageRid(page, static_cast<uint16_t>(group.size() - 1));
+    ++page;
+    group.Clear();
+    return true;
+  };
+  for (; next < encoded.size(); ++next) {
+    if (group.Add(encoded[next])) continue;
+    if (group.empty() || !writeGroup(true)) {
+      if (err.empty()) err = "Corrupt record for a columnar page";
+      return false;
+    }
+    if (!group.Add(encoded[next])) { err = "Corrupt record for a columnar page"; return false; }
+  }
+  if (!group.empty() && !writeGroup(false)) return false;
+  ZoneMap::Append(path, zones);
+  return true;
+}
+
+bool StorageEngine::PagedComputeAppendRid(const std::string& path, const std::string& walKey, const TableSchema& schema, const std::vector<uint8_t>& bytes, int64_t& outRid, std::string& err) {
+  // Must mirror the placement decision in PagedAppend / ColumnarAppend.
+  const bool columnar = schema.storage == StorageFormat::kColumnar;
+  const size_t maxSize = columnar ? PaxPage::MaxRecordSize(schema.fields.size() + 1) : SlottedPage::MaxRecordSize();
+  if (bytes.size() > maxSize) { err = "Record too large for a page"; return false; }
+  uint64_t pageCount = PageCount(path);
+  if (pageCount == 0) { outRid = MakePageRid(0, 0); return true; }
+
+  BufferPool::PageRef ref;
+  if (!pool_->Fetch(path, pageCount - 1, walKey, ref, err, true)) return false;
+  if (columnar) {
+    PaxPage pg(ref.data());
+    if (!pg.IsInitialized()) {
+      outRid = MakePageRid(pageCount - 1, 0);
+    } else if (pg.CanInsert(RecordCodec(schema), bytes.data(), bytes.size())) {
+      outRid = MakePageRid(pageCount - 1, pg.RowCount());
+    } else {
+      outRid = MakePageRid(pageCount, 0);
+    }
+    return true;
+  }
+  SlottedPage pg(ref.data());
+  if (!pg.IsInitialized()) {
+    outRid = MakePageRid(pageCount - 1, 0);
+  } else if (pg.FreeSpace() >= bytes.size() + SlottedPage::kSlotSize) {
+    outRid = MakePageRid(pageCount - 1, pg.SlotCount());
+  } else {
+    outRid = MakePageRid(pageCount, 0);
+  }
+  return true;
+}
+
+bool StorageEngine::PagedReadBytes(const std::string& path, const std::string& walKey, const TableSchema& schema, int64_t rid, std::vector<uint8_t>& outBytes, std::string& err) {
+  BufferPool::PageRef ref;
+  if (!pool_->Fetch(path, RidPage(rid), walKey, ref, err, true)) { err = "Invalid page in RID: " + err; return false; }
+  if (schema.storage == StorageFormat::kColumnar) {
+    if (!PaxPage(ref.data()).Get(RidSlot(rid), outBytes)) { err = "Invalid row in RID"; return false; }
+    return true;
+  }
+  SlottedPage pg(ref.data());
+  const uint8_t* rec = nullptr;
+  uint16_t len = 0;
+  if (!pg.Get(RidSlot(rid), rec, len)) { err = "Invalid slot in RID"; return false; }
+  outBytes.assign(rec, rec + len);
+  return true;
+}
+
+bool StorageEngine::PagedReadRecord(const std::string& path, const std::string& walKey, const TableSchema& schema, int64_t rid, Record& outRecord, std::string& err) {
+  std::vector<uint8_t> bytes;
+  if (!PagedReadBytes(path, walKey, schema, rid, bytes, err)) return false;
+  if (!RecordCodec(schema).Decode(bytes.data(), bytes.size(), outRecord)) { err = "Corrupt record in page"; return false; }
+  return LoadOverflow(path, outRecord, err);
+}
+
+bool StorageEngine::PagedWriteBytes(const std::string& path, const std::string& walKey, const TableSchema& schema, int64_t rid, const std::vector<uint8_t>& bytes, bool allowInsert, uint64_t lsn, std::string& err) {
+  const bool columnar = schema.storage == StorageFormat::kColumnar;
+  const size_t maxSize = columnar ? PaxPage::MaxRecordSize(schema.fields.size() + 1) : SlottedPage::MaxRecordSize();
+  if (bytes.size() > maxSize) { err = "Record too large for a page"; return false; }
+  const uint64_t page = RidPage(rid);
+  const uint64_t pageCount = PageCount(path);
+  if (page >= pageCount) {
+    if (!allowInsert) { err = "Invalid page in RID"; return false; }
+    // Redo past the end: materialize the missing pages empty, then buffer the target.
+    if (!SyncForRawWrite(path, pageCount * kPageSize, err)) return false;
+    auto file = FileHandleCache::Instance().Open(path, true, err);
+    if (!file) { err = "Cannot open dat file for write: " + path; return false; }
+    std::vector<uint8_t> blank(kPageSize);
+    if (!columnar) SlottedPage(blank.data()).Init();  // a blank PAX page is built by its first row
+    for (uint64_t p = pageCount; p <= page; ++p) {
+      if (!WritePage(*file, p, blank)) { err = "Write page failed"; return false; }
+    }
+  }
+
+  BufferPool::PageRef ref;
+  if (!pool_->Fetch(path, page, walKey, ref, err, true)) return false;
+  auto latch = ref.Latch();
+  if (columnar) {
+    const RecordCodec codec(schema);
+    PaxPage pg(ref.data());
+    bool ok = allowInsert ? pg.PutAt(codec, RidSlot(rid), bytes.data(), bytes.size())
+                          : pg.Overwrite(codec, RidSlot(rid), bytes.data(), bytes.size());
+    if (!ok) { err = "Row write failed for RID"; return false; }
+    if (lsn > pg.Lsn()) pg.SetLsn(lsn);
+    ref.MarkDirty(lsn);
+    return true;
+  }
+  SlottedPage pg(ref.data());
+  if (!pg.IsInitialized()) pg.Init();
+  const uint16_t len = static_cast<uint16_t>(bytes.size());
+  bool ok = allowInsert ? pg.PutAt(RidSlot(rid), bytes.data(), len)
+                        : pg.Overwrite(RidSlot(rid), bytes.data(), len);
+  if (!ok) { err = "Slot write failed for RID"; return false; }
+  if (lsn > pg.Lsn()) pg.SetLsn(lsn);
+  ref.MarkDirty(lsn);
+  return true;
+}
+
+bool StorageEngine::PagedSave(const std::string& path, const TableSchema& schema, const std::vector<Record>& records, std::string& err) {
+  const std::string staging = StagingPath(path);
+  {
+    std::ofstream ofs(staging, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) { err = "Cannot open dat file for writing: " + path; return false; }
+  }
+  if (!records.empty()) {
+    std::vector<Record> rows = records;
+    for (auto& r : rows) r.values.resize(schema.fields.size());
+    if (!PagedAppend(staging, schema, rows, nullptr, err)) return false;
+  }
+  return InstallStaged(path, err);
+}
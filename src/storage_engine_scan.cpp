@@ -0,0 +1,438 @@
+#include "storage_engine.h"
+#include "storage/crc32c.h"
+#include "storage/file_handle_cache.h"
+#include "storage/io_ring.h"
+#include "storage/pax_page.h"
+#include "storage/slotted_page.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+constexpr char kTableSep = '~';
+
+// Bounds-checked reads from a mapped data file.
+bool Take(const uint8_t* base, size_t end, size_t& pos, void* dst, size_t n) {
+  if (pos > end || n > end - pos) return false;
+  if (n > 0) std::memcpy(dst, base + pos, n);
+  pos += n;
+  return true;
+}
+
+bool TakeView(const uint8_t* base, size_t end, size_t& pos, std::string_view& s) {
+  uint32_t len = 0;
+  if (!Take(base, end, pos, &len, sizeof(uint32_t)) || len > end - pos) return false;
+  s = std::string_view(reinterpret_cast<const char*>(base + pos), len);
+  pos += len;
+  return true;
+}
+}  // namespace
+
+bool StorageEngine::OpenScan(const std::string& datPath, const TableSchema& schema, TableScanCursor& cursor, std::string& err, bool validOnly) {
+  cursor = TableScanCursor();
+  cursor.tableName_ = schema.tableName;
+  cursor.codec_ = RecordCodec(schema);
+  cursor.paged_ = schema.storage != StorageFormat::kRow;
+  cursor.columnar_ = schema.storage == StorageFormat::kColumnar;
+  cursor.validOnly_ = validOnly;
+
+  const std::string path = TableDataPath(datPath, schema.tableName);
+  cursor.path_ = path;
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) {
+    if (path != datPath) return true;  // segment not written yet = empty table
+    err = "Cannot open dat file: " + path;
+    return false;
+  }
+  // Scans read the file directly so they don't flush the pool's hot pages.
+  if (!SyncForRawRead(path, err)) return false;
+
+  if (!cursor.paged_) {
+    // The directory lets the scan seek straight to the table's blocks; load it
+    // before mapping so every listed block lies inside the snapshot.
+    std::vector<BlockEntry> blocks;
+    if (!BlockDirectory::Load(path, blocks, err)) return false;
+    const uint32_t tableId = BlockDirectory::TableId(schema.tableName);
+    for (const auto& b : blocks) {
+      if (b.table_id == tableId && b.record_count > 0) cursor.blocks_.push_back(b);
+    }
+    if (cursor.blocks_.empty()) return true;
+  }
+
+  cursor.map_ = MappedFor(path).Acquire(err);
+  if (!cursor.map_) return false;
+  cursor.overflowFile_ = &MappedFor(Overflow::PathFor(path));
+  auto overflow = cursor.overflowFile_->Acquire(err);
+  if (!overflow) return false;
+  cursor.overflow_.push_back(std::move(overflow));
+  if (IoRing::Available()) {
+    std::string ignore;
+    cursor.file_ = FileHandleCache::Instance().Open(path, false, ignore);
+  }
+  if (cursor.paged_) {
+    cursor.pageCount_ = cursor.map_->size() / kPageSize;
+    if (cursor.pageCount_ > 0) {
+      uint8_t* last = const_cast<uint8_t*>(cursor.map_->data()) + (cursor.pageCount_ - 1) * kPageSize;
+      if (cursor.columnar_) {
+        PaxPage pg(last);
+        cursor.lastPageSlots_ = pg.IsInitialized() ? pg.RowCount() : 0;
+      } else {
+        SlottedPage pg(last);
+        cursor.lastPageSlots_ = pg.IsInitialized() ? pg.SlotCount() : 0;
+      }
+    }
+  } else {
+    for (const auto& b : cursor.blocks_) {
+      if (b.offset + b.length > cursor.map_->size()) {
+        err = "Block beyond end of dat file: " + path;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+const uint8_t* TableScanCursor::VerifiedPage(uint64_t page) {
+  const uint8_t* p = map_->data() + page * kPageSize;
+  if (PageChecksumOk(p)) return p;
+  // The mapping shares the file with in-place writers: a page written back
+  // while it is read may look torn, so re-read it a few times before failing.
+  pageCopy_.resize(kPageSize);
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    std::memcpy(pageCopy_.data(), p, kPageSize);
+    if (PageChecksumOk(pageCopy_.data())) return pageCopy_.data();
+  }
+  err_ = "Checksum mismatch in page " + std::to_string(page);
+  return nullptr;
+}
+
+bool TableScanCursor::VerifyBlock(const BlockEntry& block) {
+  if (block.crc == 0) return true;
+  const uint32_t crc = Crc32c(map_->data() + block.offset, static_cast<size_t>(block.length));
+  if (crc == block.crc) return true;
+  // Unsealed by a write since the scan opened?
+  BlockEntry now;
+  if (BlockDirectory::Lookup(path_, block.offset, now) && (now.crc == 0 || now.crc == crc)) return true;
+  err_ = "Checksum mismatch in block at offset " + std::to_string(block.offset);
+  return false;
+}
+
+void TableScanCursor::LoadZones() {
+  if (zonesLoaded_) return;
+  zonesLoaded_ = true;
+  ZoneMap::Load(path_, zones_);
+  for (const auto& z : zones_) zonesAt_[z.unit].push_back(&z);
+}
+
+bool TableScanCursor::PageSkipped(uint64_t page) {
+  if (!zoneFilter_) return false;
+  LoadZones();
+  auto it = zonesAt_.find(page);
+  if (it == zonesAt_.end()) return false;
+  // The page as mapped now, which is what would be read.
+  const uint32_t stamp = SlottedPage(const_cast<uint8_t*>(map_->data() + page * kPageSize)).Checksum();
+  if (stamp == 0) return false;
+  for (const Zone* z : it->second) {
+    if (z->stamp == stamp) return !zoneFilter_(z->columns);
+  }
+  return false;
+}
+
+bool TableScanCursor::BlockSkipped(const BlockEntry& block) {
+  skips_.clear();
+  skip_ = 0;
+  if (!zoneFilter_ || block.crc == 0) return false;  // unsealed: changed since its zones were taken
+  LoadZones();
+  auto it = zonesAt_.find(block.offset);
+  if (it == zonesAt_.end()) return false;
+  for (const Zone* z : it->second) {
+    if (z->stamp != block.crc || z->begin <= block.offset || z->begin >= z->end ||
+        z->end > block.offset + block.length) {
+      continue;
+    }
+    if (!zoneFilter_(z->columns)) skips_.push_back(z);
+  }
+  std::sort(skips_.begin(), skips_.end(), [](const Zone* a, const Zone* b) { return a->begin < b->begin; });
+  skips_.erase(std::unique(skips_.begin(), skips_.end(), [](const Zone* a, const Zone* b) { return a->begin == b->begin; }),
+               skips_.end());
+  uint64_t rows = 0;
+  for (const Zone* z : skips_) rows += z->rows;
+  return rows == block.record_count;
+}
+
+bool TableScanCursor::Resolve(size_t field, std::string_view& v) {
+  if (!Wanted(field)) {
+    v = std::string_view();
+    return true;
+  }
+  if (Overflow::Resolve(*overflow_.back(), v, v)) return true;
+  std::string ignore;
+  auto now = overflowFile_->Acquire(ignore);
+  if (now && now != overflow_.back()) {
+    overflow_.push_back(std::move(now));
+    if (Overflow::Resolve(*overflow_.back(), v, v)) return true;
+  }
+  err_ = "Bad overflow pointer in " + path_;
+  return false;
+}
+
+bool TableScanCursor::ResolveRow(RecordView& row) {
+  for (size_t i = 0; i < row.values.size(); ++i) {
+    if (row.Overflowed(i) && !Resolve(i, row.values[i])) return false;
+  }
+  row.overflow.clear();
+  return true;
+}
+
+// Keeps the next kReadaheadBytes past `at` queued, kReadaheadChunk at a time.
+// A zone filter passes pages over unread, so it turns readahead off.
+void TableScanCursor::Readahead(uint64_t at) {
+  constexpr uint64_t kReadaheadChunk = 256 * 1024;
+  constexpr uint64_t kReadaheadBytes = 8 * kReadaheadChunk;
+  if (!file_ || zoneFilter_ || at + kReadaheadBytes / 2 < readahead_) return;
+  readahead_ = std::max(readahead_, at);
+  const uint64_t end = std::min<uint64_t>(map_->size(), at + kReadaheadBytes);
+  while (readahead_ < end) {
+    const uint64_t len = std::min(kReadaheadChunk, end - readahead_);
+    if (!file_->Readahead(readahead_, len)) return;
+    readahead_ += len;
+  }
+}
+
+bool TableScanCursor::Next(int64_t& offset, RecordView& row) {
+  if (!err_.empty() || !map_) return false;
+  if (columnar_) return NextInChunks(offset, row);
+  return paged_ ? NextInPages(offset, row) : NextInBlocks(offset, row);
+}
+
+bool TableScanCursor::NextChunk(ColumnChunk& chunk) {
+  if (!err_.empty() || !map_ || !columnar_) return false;
+  while (page_ < pageCount_) {
+    if (PageSkipped(page_)) {
+      ++page_;
+      continue;
+    }
+    Readahead(page_ * kPageSize);
+    if (!ReadChunk(page_++, chunk)) return false;
+    if (chunk.size() > 0) return true;
+  }
+  return false;
+}
+
+bool TableScanCursor::Next(int64_t& offset, Record& row) {
+  if (!Next(offset, scratch_)) return false;
+  row = scratch_.Materialize();
+  return true;
+}
+
+bool TableScanCursor::NextInBlocks(int64_t& offset, RecordView& row) {
+  const uint8_t* base = map_->data();
+  while (true) {
+    while (left_ == 0) {
+      if (block_ >= blocks_.size()) return false;
+      const BlockEntry& b = blocks_[block_++];
+      if (BlockSkipped(b)) continue;
+      if (!VerifyBlock(b)) return false;
+      pos_ = static_cast<size_t>(b.offset);
+      end_ = static_cast<size_t>(b.offset + b.length);
+      char sep = 0;
+      if (!Take(base, end_, pos_, &sep, 1) || sep != kTableSep) {
+        err_ = "Invalid separator in dat";
+        return false;
+      }
+      std::string_view name;
+      uint32_t recordCount = 0;
+      if (!TakeView(base, end_, pos_, name) || !Take(base, end_, pos_, &recordCount, sizeof(uint32_t)) ||
+          !Take(base, end_, pos_, &blockFields_, sizeof(uint32_t))) {
+        err_ = "Truncated block header in dat";
+        return false;
+      }
+      if (name != tableName_) continue;  // table id collision
+      if (blockFields_ != codec_.fieldCount()) {
+        // Text blocks written before ADD/DROP COLUMN keep their own width;
+        // typed tables are rewritten by every column change.
+        if (codec_.typed()) {
+          err_ = "Block field count mismatch in dat";
+          return false;
+        }
+        codec_ = RecordCodec::Text(blockFields_);
+      }
+      left_ = recordCount;
+    }
+
+    while (skip_ < skips_.size() && skips_[skip_]->begin < pos_) ++skip_;
+    if (skip_ < skips_.size() && skips_[skip_]->begin == pos_ && skips_[skip_]->rows <= left_) {
+      const Zone* z = skips_[skip_++];
+      pos_ = static_cast<size_t>(z->end);
+      left_ -= z->rows;
+      continue;
+    }
+    Readahead(pos_);
+    --left_;
+    offset = static_cast<int64_t>(pos_);
+    size_t used = 0;
+    if (!codec_.Decode(base + pos_, end_ - pos_, row, rendered_, &used)) {
+      err_ = "Failed reading record in Loop";
+      return false;
+    }
+    pos_ += used;
+    if (validOnly_ && !row.valid) continue;
+    return ResolveRow(row);
+  }
+}
+
+bool TableScanCursor::NextInPages(int64_t& offset, RecordView& row) {
+  for (; page_ < pageCount_; ++page_, slot_ = 0) {
+    if (slot_ == 0 && PageSkipped(page_)) continue;
+    if (slot_ == 0) Readahead(page_ * kPageSize);
+    const uint8_t* data = slot_ == 0 ? VerifiedPage(page_) : current_;
+    if (!data) return false;
+    current_ = data;
+    // Read-only view; SlottedPage never writes through Get/SlotCount.
+    SlottedPage pg(const_cast<uint8_t*>(data));
+    if (!pg.IsInitialized()) continue;
+    // Appends fill the last page in place; stop at the slots present at open.
+    const uint16_t slots = page_ + 1 == pageCount_ ? lastPageSlots_ : pg.SlotCount();
+    while (slot_ < slots) {
+      const uint16_t slot = static_cast<uint16_t>(slot_++);
+      const uint8_t* rec = nullptr;
+      uint16_t len = 0;
+      if (!pg.Get(slot, rec, len) || len == 0) continue;
+      if (validOnly_ && rec[0] == 0) continue;
+      if (!codec_.Decode(rec, len, row, rendered_)) {
+        err_ = "Corrupt record in page";
+        return false;
+      }
+      offset = MakePageRid(page_, slot);
+      return ResolveRow(row);
+    }
+  }
+  return false;
+}
+
+bool TableScanCursor::NextInChunks(int64_t& offset, RecordView& row) {
+  while (chunkRow_ >= chunk_.size()) {
+    if (page_ >= pageCount_) return false;
+    if (PageSkipped(page_)) {
+      ++page_;
+      continue;
+    }
+    Readahead(page_ * kPageSize);
+    if (!ReadChunk(page_++, chunk_)) return false;
+    chunkRow_ = 0;
+  }
+  const size_t k = chunkRow_++;
+  chunk_.Row(k, row);
+  offset = chunk_.rids[k];
+  return true;
+}
+
+// Decodes one PAX page column by column; only wanted columns are touched.
+bool TableScanCursor::ReadChunk(uint64_t page, ColumnChunk& chunk) {
+  chunk.rids.clear();
+  chunk.valid.clear();
+  headers_.clear();
+  rows_.clear();
+  const size_t fields = codec_.fieldCount();
+  chunk.columns.resize(fields);
+  chunk.rendered.resize(fields);
+  chunk.numbers.resize(codec_.typed() ? fields : 0);
+  chunk.codes.resize(fields);
+  chunk.dictionary.resize(fields);
+  for (size_t i = 0; i < fields; ++i) {
+    chunk.codes[i].clear();
+    chunk.dictionary[i].clear();
+  }
+  for (auto& numbers : chunk.numbers) numbers.clear();
+  const uint8_t* data = VerifiedPage(page);
+  if (!data) return false;
+  PaxPage pg(const_cast<uint8_t*>(data));
+  if (!pg.IsInitialized()) {
+    for (auto& col : chunk.columns) col.clear();
+    return true;
+  }
+  if (pg.ColumnCount() != fields + 1) {
+    err_ = "Column count mismatch in page";
+    return false;
+  }
+  const uint16_t rows = page + 1 == pageCount_ ? lastPageSlots_ : pg.RowCount();
+  for (uint16_t r = 0; r < rows; ++r) {
+    const uint8_t* header = nullptr;
+    uint16_t len = 0;
+    if (!pg.Cell(r, 0, header, len) || len != codec_.HeaderSize()) {
+      err_ = "Corrupt row in page";
+      return false;
+    }
+    if (validOnly_ && header[0] == 0) continue;
+    headers_.push_back(header);
+    rows_.push_back(r);
+    chunk.rids.push_back(MakePageRid(page, r));
+    chunk.valid.push_back(header[0]);
+  }
+
+  const size_t n = rows_.size();
+  for (size_t i = 0; i < fields; ++i) {
+    auto& col = chunk.columns[i];
+    if (!Wanted(i)) {
+      col.clear();
+      continue;
+    }
+    col.resize(n);
+    const uint16_t column = static_cast<uint16_t>(i + 1);
+    if (pg.IsDictionary(column)) {
+      // Each distinct entry is decoded once; rows take its code.
+      if (codeAt_.empty()) codeAt_.assign(kPageSize, -1);
+      auto& codes = chunk.codes[i];
+      auto& dict = chunk.dictionary[i];
+      codes.resize(n);
+      std::vector<uint16_t> seen;
+      bool ok = true;
+      for (size_t k = 0; k < n && ok; ++k) {
+        uint16_t entry = 0;
+        ok = pg.EntryOf(rows_[k], column, entry);
+        if (!ok) break;
+        if (codeAt_[entry] < 0) {
+          const uint8_t* cell = nullptr;
+          uint16_t len = 0;
+          bool spilled = false;
+          std::string_view v;
+          std::string unused;  // char values are views into the page
+          ok = pg.EntryCell(column, entry, cell, len, spilled) &&
+               codec_.DecodeCell(i, len == 0 ? 0 : (spilled ? RecordCodec::kLengthPrefixed : len), cell, len, v, unused);
+          ok = ok && (!spilled || !RecordCodec::OverflowCell(cell, len) || Resolve(i, v));
+          if (!ok) break;
+          codeAt_[entry] = static_cast<int32_t>(dict.size());
+          dict.push_back(v);
+          seen.push_back(entry);
+        }
+        codes[k] = static_cast<uint16_t>(codeAt_[entry]);
+        col[k] = dict[codes[k]];
+      }
+      for (uint16_t entry : seen) codeAt_[entry] = -1;
+      if (!ok) {
+        if (err_.empty()) err_ = "Corrupt row in page";
+        return false;
+      }
+      continue;
+    }
+    if (chunk.rendered[i].size() < n) chunk.rendered[i].resize(n);
+    const ColumnKind kind = codec_.kind(i);
+    const bool numeric = kind == ColumnKind::kInt32 || kind == ColumnKind::kInt64 || kind == ColumnKind::kDouble;
+    if (numeric) chunk.numbers[i].resize(n);
+    for (size_t k = 0; k < n; ++k) {
+      const uint8_t* cell = nullptr;
+      uint16_t len = 0;
+      if (!pg.Cell(rows_[k], column, cell, len) ||
+          !codec_.DecodeField(headers_[k], i, cell, len, col[k], chunk.rendered[i][k], numeric ? &chunk.numbers[i][k] : nullptr)) {
+        err_ = "Corrupt row in page";
+        return false;
+      }
+      if (codec_.FieldWidth(headers_[k], i) == RecordCodec::kLengthPrefixed && RecordCodec::OverflowCell(cell, len) &&
+          !Resolve(i, col[k])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
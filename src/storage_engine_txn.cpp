@@ -1,5 +1,13 @@
 #include "storage_engine.h"
-#include <fstream>
+#include "path_utils.h"
+#include "storage/block_directory.h"
+#include "storage/crc32c.h"
+#include "storage/file_handle_cache.h"
+#include "storage/pax_page.h"
+#include "storage/slotted_page.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
 #include <vector>
 
 namespace {
@@ -14,101 +22,295 @@ void AppendString(std::vector<uint8_t>& out, const std::string& s) {
   AppendUInt32(out, static_cast<uint32_t>(s.size()));
   out.insert(out.end(), s.begin(), s.end());
 }
+
+// Byte reads through the buffer pool that keep the current page pinned, so
+// consecutive reads on one page cost a single fetch.
+class PoolReader {
+ public:
+  PoolReader(BufferPool& pool, const std::string& path, const std::string& walKey, bool paged = false)
+      : pool_(pool), path_(path), walKey_(walKey), paged_(paged) {}
+
+  bool Page(uint64_t page, std::string& err) {
+    if (pinned_ && page == page_) return true;
+    ref_ = BufferPool::PageRef();  // unpin before fetching the next one
+    pinned_ = pool_.Fetch(path_, page, walKey_, ref_, err, paged_);
+    page_ = page;
+    return pinned_;
+  }
+  const BufferPool::PageRef& Ref() const { return ref_; }
+
+  bool Read(uint64_t offset, size_t len, uint8_t* dst, std::string& err) {
+    while (len > 0) {
+      if (!Page(offset / kPageSize, err)) return false;
+      const uint32_t inPage = static_cast<uint32_t>(offset % kPageSize);
+      if (inPage >= ref_.valid_len()) { err = "Read past end of dat file"; return false; }
+      const size_t n = std::min<size_t>(len, ref_.valid_len() - inPage);
+      std::memcpy(dst, ref_.data() + inPage, n);
+      dst += n;
+      offset += n;
+      len -= n;
+    }
+    return true;
+  }
+
+ private:
+  BufferPool& pool_;
+  std::string path_;
+  std::string walKey_;
+  bool paged_;
+  BufferPool::PageRef ref_;
+  uint64_t page_ = 0;
+  bool pinned_ = false;
+};
+
+// Row-format record bytes at offset, sized field by field through the codec.
+bool ReadRowBytes(PoolReader& reader, uint64_t pos, const RecordCodec& codec, std::vector<uint8_t>& outBytes, std::string& err) {
+  outBytes.assign(codec.HeaderSize(), 0);
+  if (!reader.Read(pos, outBytes.size(), outBytes.data(), err)) return false;
+  pos += outBytes.size();
+  for (size_t i = 0; i < codec.fieldCount(); ++i) {
+    size_t width = codec.FieldWidth(outBytes.data(), i);
+    if (width == RecordCodec::kLengthPrefixed) {
+      uint32_t len = 0;
+      if (!reader.Read(pos, sizeof(uint32_t), reinterpret_cast<uint8_t*>(&len), err)) return false;
+      pos += sizeof(uint32_t);
+      const size_t at = outBytes.size();
+      outBytes.resize(at + sizeof(uint32_t));
+      std::memcpy(outBytes.data() + at, &len, sizeof(uint32_t));
+      width = len & ~RecordCodec::kOverflowBit;
+    }
+    const size_t at = outBytes.size();
+    outBytes.resize(at + width);
+    if (width > 0 && !reader.Read(pos, width, outBytes.data() + at, err)) return false;
+    pos += width;
+  }
+  return true;
+}
 }
 
-bool StorageEngine::SerializeRecord(const TableSchema& schema, const Record& record, std::vector<uint8_t>& outBytes, std::string& err) const {
+bool StorageEngine::SerializeRecord(const std::string& datPath, const TableSchema& schema, Record& record, std::vector<uint8_t>& outBytes, std::string& err) {
   if (record.values.size() != schema.fields.size()) {
     err = "Record field count mismatch";
     return false;
   }
-  outBytes.clear();
-  outBytes.push_back(record.valid ? 1 : 0);
-  for (const auto& v : record.values) AppendString(outBytes, v);
+  std::string path = TableDataPath(datPath, schema.tableName);
+  if (schema.storage != StorageFormat::kRow && !PagedPath(datPath, schema, path, err)) return false;
+  if (path != datPath) {
+    OverflowWriter overflow(path, schema);
+    overflow.Add(record);
+    if (!overflow.Sync(err)) return false;
+  }
+  RecordCodec(schema).Encode(record, outBytes);
+  return true;
+}
+
+bool StorageEngine::PoolWrite(const std::string& path, const std::string& walKey, uint64_t offset, const std::vector<uint8_t>& bytes, uint64_t lsn, std::string& err) {
+  // Pin every page first so a write past the cached end falls back cleanly.
+  std::vector<BufferPool::PageRef> refs;
+  bool covered = true;
+  for (uint64_t page = offset / kPageSize; covered && page * kPageSize < offset + bytes.size(); ++page) {
+    BufferPool::PageRef ref;
+    std::string fetchErr;
+    if (!pool_->Fetch(path, page, walKey, ref, fetchErr)) { covered = false; break; }
+    const uint64_t pageEnd = page * kPageSize + ref.valid_len();
+    covered = pageEnd >= std::min<uint64_t>(offset + bytes.size(), (page + 1) * kPageSize);
+    refs.push_back(std::move(ref));
+  }
+  if (!covered) {
+    refs.clear();
+    if (!SyncForRawWrite(path, offset, err)) return false;
+    auto file = FileHandleCache::Instance().Open(path, false, err);
+    if (!file) { err = "Cannot open dat file for write: " + path; return false; }
+    auto seals = BlockDirectory::LockSeals(path);
+    BlockDirectory::Unseal(path, offset, bytes.size());
+    const bool ok = file->WriteAt(offset, bytes.data(), bytes.size());
+    BlockDirectory::Reseal(path, {{offset, bytes.size()}});
+    if (!ok) { err = "Write failed: " + path; return false; }
+    return true;
+  }
+
+  size_t done = 0;
+  for (auto& ref : refs) {
+    const uint64_t pos = offset + done;
+    const uint32_t inPage = static_cast<uint32_t>(pos % kPageSize);
+    const size_t n = std::min<size_t>(bytes.size() - done, kPageSize - inPage);
+    auto latch = ref.Latch();
+    std::memcpy(ref.data() + inPage, bytes.data() + done, n);
+    ref.MarkDirty(lsn);
+    done += n;
+  }
   return true;
 }
 
-bool StorageEngine::ReadRecordBytesAt(const std::string& datPath, const TableSchema& schema, long offset, std::vector<uint8_t>& outBytes, std::string& err) {
-  std::ifstream ifs(datPath, std::ios::binary);
-  if (!ifs.is_open()) { err = "Cannot open dat file: " + datPath; return false; }
-  ifs.seekg(offset);
-  if (!ifs) { err = "Seek failed"; return false; }
-
-  outBytes.clear();
-  char valid = 0;
-  ifs.read(&valid, 1);
-  if (!ifs) { err = "Read valid flag failed"; return false; }
-  outBytes.push_back(static_cast<uint8_t>(valid));
-
-  for (const auto& f : schema.fields) {
-    (void)f;
-    uint32_t len = 0;
-    ifs.read(reinterpret_cast<char*>(&len), sizeof(uint32_t));
-    if (!ifs) { err = "Read length failed"; return false; }
-    AppendUInt32(outBytes, len);
-    if (len > 0) {
-      std::vector<char> buf(len);
-      ifs.read(buf.data(), len);
-      if (!ifs) { err = "Read field bytes failed"; return false; }
-      outBytes.insert(outBytes.end(), buf.begin(), buf.end());
+bool StorageEngine::ReadRecordBytesAt(const std::string& datPath, const TableSchema& schema, int64_t offset, std::vector<uint8_t>& outBytes, std::string& err) {
+  const std::string walKey = dbms_paths::DbNameFromDat(datPath);
+  if (schema.storage != StorageFormat::kRow) {
+    std::string path;
+    return PagedPath(datPath, schema, path, err) && PagedReadBytes(path, walKey, schema, offset, outBytes, err);
+  }
+  const std::string path = TableDataPath(datPath, schema.tableName);
+  if (offset < 0) { err = "Seek failed"; return false; }
+  PoolReader reader(*pool_, path, walKey);
+  return ReadRowBytes(reader, static_cast<uint64_t>(offset), RecordCodec(schema), outBytes, err);
+}
+
+bool StorageEngine::ReadRecordsAt(const std::string& datPath, const TableSchema& schema, const std::vector<int64_t>& offsets, std::vector<Record>& outRecords, std::string& err) {
+  outRecords.assign(offsets.size(), Record());
+  if (offsets.empty()) return true;
+  const bool paged = schema.storage != StorageFormat::kRow;
+  const bool columnar = schema.storage == StorageFormat::kColumnar;
+  std::string path;
+  if (paged) {
+    if (!PagedPath(datPath, schema, path, err)) return false;
+  } else {
+    path = TableDataPath(datPath, schema.tableName);
+  }
+
+  // Visit offsets in file order so each page is fetched once; duplicates are decoded once.
+  std::vector<size_t> order(offsets.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+  // Read the pages the offsets land on as one batch; the loop below then hits the pool.
+  const std::string walKey = dbms_paths::DbNameFromDat(datPath);
+  if (offsets.size() > 1) {
+    std::vector<uint64_t> pages;
+    pages.reserve(offsets.size());
+    for (int64_t offset : offsets) {
+      if (offset >= 0) pages.push_back(paged ? RidPage(offset) : static_cast<uint64_t>(offset) / kPageSize);
     }
+    pool_->Prefetch(path, std::move(pages), walKey, paged);
+  }
+
+  PoolReader reader(*pool_, path, walKey, paged);
+  const RecordCodec codec(schema);
+  std::vector<uint8_t> bytes;
+  for (size_t k = 0; k < order.size(); ++k) {
+    const size_t i = order[k];
+    const int64_t offset = offsets[i];
+    if (k > 0 && offsets[order[k - 1]] == offset) {
+      outRecords[i] = outRecords[order[k - 1]];
+      continue;
+    }
+    if (offset < 0) { err = "Seek failed"; return false; }
+    const uint8_t* rec = nullptr;
+    size_t len = 0;
+    if (paged) {
+      if (!reader.Page(RidPage(offset), err)) { err = "Invalid page in RID: " + err; return false; }
+      if (columnar) {
+        if (!PaxPage(reader.Ref().data()).Get(RidSlot(offset), bytes)) { err = "Invalid row in RID"; return false; }
+        rec = bytes.data();
+        len = bytes.size();
+      } else {
+        uint16_t slotLen = 0;
+        if (!SlottedPage(reader.Ref().data()).Get(RidSlot(offset), rec, slotLen)) { err = "Invalid slot in RID"; return false; }
+        len = slotLen;
+      }
+    } else {
+      if (!ReadRowBytes(reader, static_cast<uint64_t>(offset), codec, bytes, err)) return false;
+      rec = bytes.data();
+      len = bytes.size();
+    }
+    if (!codec.Decode(rec, len, outRecords[i])) { err = "Read fields failed"; return false; }
+    if (!LoadOverflow(path, outRecords[i], err)) return false;
+  }
+  return true;
+}
+
+bool StorageEngine::WriteRecordBytesAt(const std::string& datPath, const TableSchema& schema, int64_t offset, const std::vector<uint8_t>& bytes, std::string& err, uint64_t lsn) {
+  const std::string walKey = dbms_paths::DbNameFromDat(datPath);
+  std::string path;
+  if (schema.storage != StorageFormat::kRow) {
+    if (!PagedPath(datPath, schema, path, err) || !PagedWriteBytes(path, walKey, schema, offset, bytes, false, lsn, err)) return false;
+  } else {
+    if (offset < 0) { err = "Seek failed"; return false; }
+    path = TableDataPath(datPath, schema.tableName);
+    if (!PoolWrite(path, walKey, static_cast<uint64_t>(offset), bytes, lsn, err)) return false;
   }
+  // A tombstone: the row's bytes are garbage until the next compaction.
+  if (!bytes.empty() && bytes[0] == 0) AddReclaimable(path, bytes.size());
   return true;
 }
 
-bool StorageEngine::WriteRecordBytesAt(const std::string& datPath, long offset, const std::vector<uint8_t>& bytes, std::string& err) {
-  std::fstream fs(datPath, std::ios::binary | std::ios::in | std::ios::out);
-  if (!fs.is_open()) { err = "Cannot open dat file for write: " + datPath; return false; }
-  fs.seekp(offset);
-  if (!fs) { err = "Seek failed"; return false; }
-  if (!bytes.empty()) fs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
-  return static_cast<bool>(fs);
+bool StorageEngine::CanOverwrite(const std::string& datPath, const TableSchema& schema, int64_t offset, const std::vector<uint8_t>& before, const std::vector<uint8_t>& after) const {
+  if (before.size() != after.size()) return false;
+  if (schema.storage != StorageFormat::kColumnar) return true;
+  std::string path, err;
+  BufferPool::PageRef ref;
+  if (!PagedPath(datPath, schema, path, err) ||
+      !pool_->Fetch(path, RidPage(offset), dbms_paths::DbNameFromDat(datPath), ref, err, true)) {
+    return false;
+  }
+  return PaxPage(ref.data()).CanOverwrite(RecordCodec(schema), RidSlot(offset), after.data(), after.size());
 }
 
-bool StorageEngine::ComputeAppendRecordOffset(const std::string& datPath, const TableSchema& schema, long& outOffset, std::string& err) {
-  std::ifstream ifs(datPath, std::ios::binary | std::ios::ate);
-  std::streamsize sz = 0;
-  if (ifs.is_open()) {
-    sz = ifs.tellg();
-    ifs.close();
+bool StorageEngine::ComputeAppendRecordOffset(const std::string& datPath, const TableSchema& schema, const std::vector<uint8_t>& recordBytes, int64_t& outOffset, std::string& err) {
+  if (schema.storage != StorageFormat::kRow) {
+    std::string path;
+    return PagedPath(datPath, schema, path, err) &&
+           PagedComputeAppendRid(path, dbms_paths::DbNameFromDat(datPath), schema, recordBytes, outOffset, err);
   }
+  uint64_t sz = 0;
+  std::string ignore;
+  auto file = FileHandleCache::Instance().Open(TableDataPath(datPath, schema.tableName), false, ignore);
+  if (file && !file->Size(sz)) { err = "Cannot stat dat file"; return false; }
 
   std::vector<uint8_t> header;
   header.push_back(kTableSep);
   AppendString(header, schema.tableName);
   AppendUInt32(header, 1);
   AppendUInt32(header, static_cast<uint32_t>(schema.fields.size()));
-  outOffset = static_cast<long>(sz + header.size());
+  outOffset = static_cast<int64_t>(sz + header.size());
   return true;
 }
 
-bool StorageEngine::WriteInsertBlockAt(const std::string& datPath, const TableSchema& schema, long recordOffset, const std::vector<uint8_t>& recordBytes, std::string& err) {
+bool StorageEngine::WriteInsertBlockAt(const std::string& datPath, const TableSchema& schema, int64_t recordOffset, const std::vector<uint8_t>& recordBytes, std::string& err, uint64_t lsn) {
+  if (schema.storage != StorageFormat::kRow) {
+    std::string path;
+    return PagedPath(datPath, schema, path, err) &&
+           PagedWriteBytes(path, dbms_paths::DbNameFromDat(datPath), schema, recordOffset, recordBytes, true, lsn, err);
+  }
   std::vector<uint8_t> header;
   header.push_back(kTableSep);
   AppendString(header, schema.tableName);
   AppendUInt32(header, 1);
   AppendUInt32(header, static_cast<uint32_t>(schema.fields.size()));
-  long headerOffset = recordOffset - static_cast<long>(header.size());
+  int64_t headerOffset = recordOffset - static_cast<int64_t>(header.size());
   if (headerOffset < 0) { err = "Invalid record offset for insert"; return false; }
 
-  std::fstream fs(datPath, std::ios::binary | std::ios::in | std::ios::out);
-  if (!fs.is_open()) {
-    fs.open(datPath, std::ios::binary | std::ios::out);
-    fs.close();
-    fs.open(datPath, std::ios::binary | std::ios::in | std::ios::out);
-  }
-  if (!fs.is_open()) { err = "Cannot open dat file for insert"; return false; }
+  const std::string path = TableDataPath(datPath, schema.tableName);
+  if (path != datPath && !dbms_paths::EnsureSegmentDirFromDat(datPath, err)) return false;
+  auto file = FileHandleCache::Instance().Open(path, true, err);
+  if (!file) { err = "Cannot open dat file for insert"; return false; }
 
-  fs.seekp(0, std::ios::end);
-  std::streamoff endPos = fs.tellp();
-  if (endPos < headerOffset) {
-    fs.seekp(0, std::ios::end);
-    std::vector<char> pad(static_cast<size_t>(headerOffset - endPos), 0);
-    if (!pad.empty()) fs.write(pad.data(), static_cast<std::streamsize>(pad.size()));
+  uint64_t endPos = 0;
+  if (!file->Size(endPos)) { err = "Cannot stat dat file"; return false; }
+  (void)lsn;  // row blocks carry no LSN; the write bypasses the pool
+  if (!SyncForRawWrite(path, std::min<uint64_t>(endPos, static_cast<uint64_t>(headerOffset)), err)) return false;
+  // Header and record are contiguous; a gap before them (redo past the end) reads as zeros.
+  std::vector<uint8_t> bytes = header;
+  bytes.insert(bytes.end(), recordBytes.begin(), recordBytes.end());
+  if (static_cast<uint64_t>(headerOffset) < endPos) {
+    // Redo over blocks already in the file.
+    auto seals = BlockDirectory::LockSeals(path);
+    BlockDirectory::Unseal(path, static_cast<uint64_t>(headerOffset), bytes.size());
+    const bool ok = file->WriteAt(static_cast<uint64_t>(headerOffset), bytes.data(), bytes.size());
+    BlockDirectory::Reseal(path, {{static_cast<uint64_t>(headerOffset), bytes.size()}});
+    if (!ok) {
+      err = "Write failed: " + path;
+      return false;
+    }
+  } else if (!file->WriteAt(static_cast<uint64_t>(headerOffset), bytes.data(), bytes.size())) {
+    err = "Write failed: " + path;
+    return false;
   }
 
-  fs.seekp(headerOffset);
-  fs.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
-  fs.seekp(recordOffset);
-  if (!recordBytes.empty()) fs.write(reinterpret_cast<const char*>(recordBytes.data()), static_cast<std::streamsize>(recordBytes.size()));
-  return static_cast<bool>(fs);
+  BlockEntry block;
+  block.table_id = BlockDirectory::TableId(schema.tableName);
+  block.record_count = 1;
+  block.offset = static_cast<uint64_t>(headerOffset);
+  block.length = bytes.size();
+  block.crc = Crc32c(bytes.data(), bytes.size());
+  BlockDirectory::Append(path, block);
+  return true;
 }
@@ -1,4 +1,5 @@
 #include "lock_manager.h"
+#include <atomic>
 #include <chrono>
 #include <thread>
 
@@ -10,6 +11,10 @@ std::string LockManager::Key(const RID& rid) const {
   return rid.table_name + "#" + std::to_string(rid.file_offset);
 }
 
+std::string LockManager::TableKey(const std::string& table_name) const {
+  return table_name + "#*";
+}
+
 bool LockManager::TryLockShared(TxnId txn_id, const std::string& key) {
   LockState& st = locks_[key];
   if (st.exclusive_owner != 0 && st.exclusive_owner != txn_id) return false;
@@ -42,7 +47,7 @@ bool LockManager::LockShared(TxnId txn_id, const RID& rid, std::string& err) {
   std::unique_lock<std::mutex> lock(mu_);
   auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kTimeoutMs);
   while (true) {
-    if (TryLockShared(txn_id, key)) return true;
+    if (TryLockShared(txn_id, TableKey(rid.table_name)) && TryLockShared(txn_id, key)) return true;
     if (cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
       err = "Lock timeout (shared)";
       return false;
@@ -55,7 +60,7 @@ bool LockManager::LockExclusive(TxnId txn_id, const RID& rid, std::string& err)
   std::unique_lock<std::mutex> lock(mu_);
   auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kTimeoutMs);
   while (true) {
-    if (TryLockExclusive(txn_id, key)) return true;
+    if (TryLockShared(txn_id, TableKey(rid.table_name)) && TryLockExclusive(txn_id, key)) return true;
     if (cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
       err = "Lock timeout (exclusive)";
       return false;
@@ -63,6 +68,37 @@ bool LockManager::LockExclusive(TxnId txn_id, const RID& rid, std::string& err)
   }
 }
 
+bool LockManager::LockTableExclusive(TxnId txn_id, const std::string& table_name, std::string& err) {
+  std::string key = TableKey(table_name);
+  std::unique_lock<std::mutex> lock(mu_);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kTimeoutMs);
+  while (true) {
+    if (TryLockExclusive(txn_id, key)) return true;
+    if (cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
+      err = "Lock timeout (table)";
+      return false;
+    }
+  }
+}
+
+bool LockManager::LockTableShared(TxnId txn_id, const std::string& table_name, std::string& err) {
+  std::string key = TableKey(table_name);
+  std::unique_lock<std::mutex> lock(mu_);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kTimeoutMs);
+  while (true) {
+    if (TryLockShared(txn_id, key)) return true;
+    if (cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
+      err = "Lock timeout (table)";
+      return false;
+    }
+  }
+}
+
+TxnId LockManager::TransientOwner() {
+  static std::atomic<TxnId> next{TxnId{1} << 62};
+  return next.fetch_add(1);
+}
+
 void LockManager::ReleaseShared(TxnId txn_id, const RID& rid) {
   std::string key = Key(rid);
   std::lock_guard<std::mutex> lock(mu_);
@@ -11,8 +11,17 @@ class LockManager {
   bool LockShared(TxnId txn_id, const RID& rid, std::string& err);
   bool LockExclusive(TxnId txn_id, const RID& rid, std::string& err);
   void ReleaseShared(TxnId txn_id, const RID& rid);
+  // Row locks also hold their table's lock shared until ReleaseAll, so an
+  // exclusive table lock (compaction) waits for every transaction on the table.
+  bool LockTableExclusive(TxnId txn_id, const std::string& table_name, std::string& err);
+  // Table lock alone, for writers that do not lock rows.
+  bool LockTableShared(TxnId txn_id, const std::string& table_name, std::string& err);
   void ReleaseAll(TxnId txn_id);
 
+  // Owner for locks taken outside a transaction (autocommit writes without
+  // a Txn, COPY): unique per call, from a range transaction ids never reach.
+  static TxnId TransientOwner();
+
  private:
   struct LockState {
     TxnId exclusive_owner = 0;
@@ -20,6 +29,7 @@ class LockManager {
   };
 
   std::string Key(const RID& rid) const;
+  std::string TableKey(const std::string& table_name) const;
   bool TryLockShared(TxnId txn_id, const std::string& key);
   bool TryLockExclusive(TxnId txn_id, const std::string& key);
 
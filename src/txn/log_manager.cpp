@@ -6,11 +6,7 @@
 #include <filesystem>
 
 #include "../path_utils.h"
-#if defined(_WIN32)
-  #include <io.h>       // _fileno, _commit
-#else
-  #include <unistd.h>   // fileno, fsync
-#endif
+#include "../storage/file_handle_cache.h"
 
 namespace {
 
@@ -26,14 +22,23 @@ static int FopenCompat(FILE** out, const char* path, const char* mode) {
 #endif
 }
 
-bool WriteUInt32(FILE* f, uint32_t v) { return std::fwrite(&v, sizeof(uint32_t), 1, f) == 1; }
-bool WriteUInt64(FILE* f, uint64_t v) { return std::fwrite(&v, sizeof(uint64_t), 1, f) == 1; }
 bool ReadUInt32(FILE* f, uint32_t& v) { return std::fread(&v, sizeof(uint32_t), 1, f) == 1; }
 bool ReadUInt64(FILE* f, uint64_t& v) { return std::fread(&v, sizeof(uint64_t), 1, f) == 1; }
 
-bool WriteString(FILE* f, const std::string& s) {
-  if (!WriteUInt32(f, static_cast<uint32_t>(s.size()))) return false;
-  return s.empty() || std::fwrite(s.data(), 1, s.size(), f) == s.size();
+void PutUInt32(std::vector<uint8_t>& out, uint32_t v) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+  out.insert(out.end(), p, p + sizeof(v));
+}
+
+void PutUInt64(std::vector<uint8_t>& out, uint64_t v) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+  out.insert(out.end(), p, p + sizeof(v));
+}
+
+void PutBytes(std::vector<uint8_t>& out, const void* data, size_t n) {
+  PutUInt32(out, static_cast<uint32_t>(n));
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  out.insert(out.end(), p, p + n);
 }
 
 bool ReadString(FILE* f, std::string& s) {
@@ -50,6 +55,7 @@ LogManager::LogManager(const std::string& db_name) {
 }
 
 void LogManager::SetDbName(const std::string& db_name) {
+  std::lock_guard<std::mutex> lock(mu_);
   if (db_name.empty()) {
     wal_path_.clear();
     return;
@@ -59,41 +65,46 @@ void LogManager::SetDbName(const std::string& db_name) {
   wal_path_ = dbms_paths::WalPath(db_name);
 }
 
+LSN LogManager::NextLsn() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return next_lsn_;
+}
+
+void LogManager::SetNextLsn(LSN next) {
+  std::lock_guard<std::mutex> lock(mu_);
+  next_lsn_ = next;
+}
+
 LSN LogManager::Append(LogRecord& rec, std::string& err) {
-  if (wal_path_.empty()) {
+  std::lock_guard<std::mutex> lock(mu_);
+  return AppendTo(wal_path_, rec, err);
+}
+
+LSN LogManager::AppendTo(const std::string& wal_path, LogRecord& rec, std::string& err) {
+  if (wal_path.empty()) {
     err = "WAL path not set";
     return 0;
   }
 
-  FILE* f = nullptr;
-  if (FopenCompat(&f, wal_path_.c_str(), "ab") != 0 || !f) {
-    err = "Cannot open WAL file for append: " + wal_path_;
+  auto file = FileHandleCache::Instance().Open(wal_path, true, err);
+  if (!file) {
+    err = "Cannot open WAL file for append: " + wal_path;
     return 0;
   }
 
+  // The whole record goes out in one write through the cached handle.
   rec.lsn = next_lsn_++;
-  uint32_t type = static_cast<uint32_t>(rec.type);
-
-  bool ok = true;
-  ok = ok && WriteUInt64(f, rec.lsn);
-  ok = ok && WriteUInt64(f, rec.txn_id);
-  ok = ok && WriteUInt32(f, type);
-  ok = ok && WriteString(f, rec.rid.table_name);
-  ok = ok && WriteUInt64(f, rec.rid.file_offset);
-
-  ok = ok && WriteUInt32(f, static_cast<uint32_t>(rec.before.size()));
-  if (ok && !rec.before.empty()) {
-    ok = (std::fwrite(rec.before.data(), 1, rec.before.size(), f) == rec.before.size());
-  }
-
-  ok = ok && WriteUInt32(f, static_cast<uint32_t>(rec.after.size()));
-  if (ok && !rec.after.empty()) {
-    ok = (std::fwrite(rec.after.data(), 1, rec.after.size(), f) == rec.after.size());
-  }
-
-  std::fclose(f);
-
-  if (!ok) {
+  std::vector<uint8_t> buf;
+  PutUInt64(buf, rec.lsn);
+  PutUInt64(buf, rec.txn_id);
+  PutUInt32(buf, static_cast<uint32_t>(rec.type));
+  PutBytes(buf, rec.rid.table_name.data(), rec.rid.table_name.size());
+  PutUInt64(buf, rec.rid.file_offset);
+  PutBytes(buf, rec.before.data(), rec.before.size());
+  PutBytes(buf, rec.after.data(), rec.after.size());
+
+  uint64_t at = 0;
+  if (!file->Append(buf.data(), buf.size(), at)) {
     err = "Failed to write WAL record";
     return 0;
   }
@@ -102,35 +113,42 @@ LSN LogManager::Append(LogRecord& rec, std::string& err) {
   return rec.lsn;
 }
 
+bool LogManager::MarkRewritten(const std::string& db_name, const std::string& table_name, std::string& err) {
+  if (!dbms_paths::EnsureDbDir(db_name, err)) return false;
+  const std::string wal_path = dbms_paths::WalPath(db_name);
+  LogRecord rec;
+  rec.type = LogType::VACUUM;
+  rec.rid.table_name = table_name;
+  std::lock_guard<std::mutex> lock(mu_);
+  return AppendTo(wal_path, rec, err) != 0 && SyncTo(wal_path, err);
+}
+
 bool LogManager::Flush(LSN, std::string& err) {
-  if (wal_path_.empty()) {
+  std::lock_guard<std::mutex> lock(mu_);
+  return SyncTo(wal_path_, err);
+}
+
+bool LogManager::SyncTo(const std::string& wal_path, std::string& err) {
+  if (wal_path.empty()) {
     err = "WAL path not set";
     return false;
   }
 
-  FILE* f = nullptr;
-  if (FopenCompat(&f, wal_path_.c_str(), "ab") != 0 || !f) {
-    err = "Cannot open WAL file for flush: " + wal_path_;
+  // Appends went through the same cached descriptor, so fsync covers them.
+  auto file = FileHandleCache::Instance().Open(wal_path, true, err);
+  if (!file) {
+    err = "Cannot open WAL file for flush: " + wal_path;
     return false;
   }
-
-  std::fflush(f);
-
-#if defined(_WIN32)
-  _commit(_fileno(f));
-#else
-  // Best-effort durable flush on POSIX
-  int fd = fileno(f);
-  if (fd >= 0) {
-    (void)fsync(fd);
+  if (!file->Sync()) {
+    err = "WAL fsync failed: " + wal_path;
+    return false;
   }
-#endif
-
-  std::fclose(f);
   return true;
 }
 
 bool LogManager::TruncateWithBackup(std::string& err) {
+  std::lock_guard<std::mutex> lock(mu_);
   if (wal_path_.empty()) {
     err = "WAL path not set";
     return false;
@@ -161,6 +179,7 @@ bool LogManager::TruncateWithBackup(std::string& err) {
 }
 
 bool LogManager::GetRecord(LSN lsn, LogRecord& out) const {
+  std::lock_guard<std::mutex> lock(mu_);
   auto it = cache_.find(lsn);
   if (it == cache_.end()) return false;
   out = it->second;
@@ -169,11 +188,16 @@ bool LogManager::GetRecord(LSN lsn, LogRecord& out) const {
 
 bool LogManager::ReadAll(std::vector<LogRecord>& out, std::string& err) const {
   out.clear();
-  if (wal_path_.empty()) return true;
+  std::string wal_path;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    wal_path = wal_path_;
+  }
+  if (wal_path.empty()) return true;
 
   FILE* f = nullptr;
   // no wal yet -> ok
-  if (FopenCompat(&f, wal_path_.c_str(), "rb") != 0 || !f) return true;
+  if (FopenCompat(&f, wal_path.c_str(), "rb") != 0 || !f) return true;
 
   while (true) {
     LogRecord rec;
@@ -2,8 +2,11 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 #include "txn_types.h"
 
+// One per server, shared by the request threads and VACUUM; LSNs come from
+// one counter across all databases' logs.
 class LogManager {
  public:
   explicit LogManager(const std::string& db_name = "");
@@ -16,10 +19,19 @@ class LogManager {
   bool GetRecord(LSN lsn, LogRecord& out) const;
   bool ReadAll(std::vector<LogRecord>& out, std::string& err) const;
   bool TruncateWithBackup(std::string& err);
-  LSN NextLsn() const { return next_lsn_; }
-  void SetNextLsn(LSN next) { next_lsn_ = next; }
+  // Durably logs to db_name's WAL that table_name's data file was rewritten
+  // (VACUUM, DDL): recovery then drops its earlier data records, whose
+  // offsets point into the old file. That file must hold all of them before
+  // this is called.
+  bool MarkRewritten(const std::string& db_name, const std::string& table_name, std::string& err);
+  LSN NextLsn() const;
+  void SetNextLsn(LSN next);
 
  private:
+  LSN AppendTo(const std::string& wal_path, LogRecord& rec, std::string& err);
+  bool SyncTo(const std::string& wal_path, std::string& err);
+
+  mutable std::mutex mu_;
   std::string wal_path_;
   LSN next_lsn_ = 1;
   std::map<LSN, LogRecord> cache_;
@@ -5,40 +5,49 @@
 #include <map>
 
 namespace {
+bool IsDataRecord(const LogRecord& rec) {
+  return rec.type == LogType::INSERT || rec.type == LogType::UPDATE || rec.type == LogType::DELETE;
+}
+
 bool ApplyRedo(StorageEngine& engine, const std::string& db_name, const LogRecord& rec, std::string& err) {
+  if (!IsDataRecord(rec)) return true;
   std::string dat = dbms_paths::DatPath(db_name);
   std::string dbf = dbms_paths::DbfPath(db_name);
   TableSchema schema;
   if (!engine.LoadSchema(dbf, rec.rid.table_name, schema, err)) return false;
 
   if (rec.type == LogType::INSERT) {
-    return engine.WriteInsertBlockAt(dat, schema, static_cast<long>(rec.rid.file_offset), rec.after, err);
+    return engine.WriteInsertBlockAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), rec.after, err, rec.lsn);
   }
   if (rec.type == LogType::UPDATE) {
-    return engine.WriteRecordBytesAt(dat, static_cast<long>(rec.rid.file_offset), rec.after, err);
+    return engine.WriteRecordBytesAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), rec.after, err, rec.lsn);
   }
   if (rec.type == LogType::DELETE) {
     if (rec.before.empty()) return true;
     std::vector<uint8_t> bytes = rec.before;
     if (!bytes.empty()) bytes[0] = 0;
-    return engine.WriteRecordBytesAt(dat, static_cast<long>(rec.rid.file_offset), bytes, err);
+    return engine.WriteRecordBytesAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), bytes, err, rec.lsn);
   }
   return true;
 }
 
 bool ApplyUndo(StorageEngine& engine, const std::string& db_name, const LogRecord& rec, std::string& err) {
+  if (!IsDataRecord(rec)) return true;
   std::string dat = dbms_paths::DatPath(db_name);
+  std::string dbf = dbms_paths::DbfPath(db_name);
+  TableSchema schema;
+  if (!engine.LoadSchema(dbf, rec.rid.table_name, schema, err)) return false;
   if (rec.type == LogType::INSERT) {
     if (rec.after.empty()) return true;
     std::vector<uint8_t> bytes = rec.after;
     if (!bytes.empty()) bytes[0] = 0;
-    return engine.WriteRecordBytesAt(dat, static_cast<long>(rec.rid.file_offset), bytes, err);
+    return engine.WriteRecordBytesAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), bytes, err);
   }
   if (rec.type == LogType::UPDATE) {
-    return engine.WriteRecordBytesAt(dat, static_cast<long>(rec.rid.file_offset), rec.before, err);
+    return engine.WriteRecordBytesAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), rec.before, err);
   }
   if (rec.type == LogType::DELETE) {
-    return engine.WriteRecordBytesAt(dat, static_cast<long>(rec.rid.file_offset), rec.before, err);
+    return engine.WriteRecordBytesAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), rec.before, err);
   }
   return true;
 }
@@ -55,6 +64,22 @@ TxnId Recovery::Run(StorageEngine& engine, const std::string& db_name, std::stri
   std::map<TxnId, bool> active;
   std::map<TxnId, std::vector<LogRecord>> per_txn;
 
+  // Offsets logged before a table's last VACUUM point into the old file, which
+  // was fully flushed before the compaction; drop them.
+  std::map<std::string, size_t> vacuumed_at;
+  for (size_t i = 0; i < records.size(); ++i) {
+    if (records[i].type == LogType::VACUUM) vacuumed_at[records[i].rid.table_name] = i;
+  }
+  if (!vacuumed_at.empty()) {
+    std::vector<LogRecord> kept;
+    for (size_t i = 0; i < records.size(); ++i) {
+      auto it = vacuumed_at.find(records[i].rid.table_name);
+      if (IsDataRecord(records[i]) && it != vacuumed_at.end() && i < it->second) continue;
+      kept.push_back(std::move(records[i]));
+    }
+    records.swap(kept);
+  }
+
   for (const auto& rec : records) {
     if (rec.txn_id > max_txn) max_txn = rec.txn_id;
     if (rec.lsn > max_lsn) max_lsn = rec.lsn;
@@ -79,6 +104,17 @@ TxnId Recovery::Run(StorageEngine& engine, const std::string& db_name, std::stri
     }
   }
 
+  // Recovered pages must be on disk before the caller may truncate the WAL.
+  if (!engine.FlushBufferPool(err)) return max_txn;
+  // Close out the losers so a later restart does not undo them over newer writes.
+  for (const auto& kv : active) {
+    LogRecord ab;
+    ab.txn_id = kv.first;
+    ab.type = LogType::ABORT;
+    log.SetNextLsn(++max_lsn);
+    if (log.Append(ab, err) == 0) return max_txn;
+  }
+  if (!active.empty() && !log.Flush(max_lsn, err)) return max_txn;
   if (max_lsn_out) *max_lsn_out = max_lsn;
   return max_txn;
 }
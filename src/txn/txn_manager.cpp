@@ -58,6 +58,8 @@ bool TxnManager::Rollback(Txn* txn, std::string& err) {
     if (!log_.GetRecord(*it, rec)) continue;
     if (!UndoRecord(rec, txn->db_name, err)) return false;
   }
+  // ABORT stops recovery from undoing again, so the undone pages go first.
+  if (!engine_.FlushBufferPool(err)) return false;
 
   LogRecord ab;
   ab.txn_id = txn->id;
@@ -131,15 +133,15 @@ bool TxnManager::UndoRecord(const LogRecord& rec, const std::string& db_name, st
     if (!rec.after.empty()) {
       std::vector<uint8_t> bytes = rec.after;
       if (!bytes.empty()) bytes[0] = 0;
-    return engine_.WriteRecordBytesAt(dat, static_cast<long>(rec.rid.file_offset), bytes, err);
+    return engine_.WriteRecordBytesAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), bytes, err);
     }
     return true;
   }
   if (rec.type == LogType::UPDATE) {
-    return engine_.WriteRecordBytesAt(dat, static_cast<long>(rec.rid.file_offset), rec.before, err);
+    return engine_.WriteRecordBytesAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), rec.before, err);
   }
   if (rec.type == LogType::DELETE) {
-    return engine_.WriteRecordBytesAt(dat, static_cast<long>(rec.rid.file_offset), rec.before, err);
+    return engine_.WriteRecordBytesAt(dat, schema, static_cast<int64_t>(rec.rid.file_offset), rec.before, err);
   }
   return true;
 }
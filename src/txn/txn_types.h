@@ -8,7 +8,7 @@ using LSN = uint64_t;
 
 struct RID {
   std::string table_name;
-  uint64_t file_offset = 0;
+  uint64_t file_offset = 0;  // byte offset, or packed (page << 16 | slot) for paged tables
 };
 
 enum class TxnState {
@@ -28,7 +28,8 @@ enum class LogType {
   DELETE,
   COMMIT,
   ABORT,
-  CHECKPOINT
+  CHECKPOINT,
+  VACUUM  // rid.table_name was compacted; its earlier records are void
 };
 
 struct LogRecord {
@@ -0,0 +1,124 @@
+#include "vacuum.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+#include "path_utils.h"
+#include "storage/overflow.h"
+#include "storage/slotted_page.h"
+#include "txn/lock_manager.h"
+#include "txn/log_manager.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+// Lock owner for compactions; never handed out to a transaction.
+constexpr TxnId kVacuumTxnId = std::numeric_limits<TxnId>::max();
+
+uint64_t FileSize(const std::string& path) {
+  std::error_code ec;
+  auto sz = fs::file_size(path, ec);
+  return ec ? 0 : static_cast<uint64_t>(sz);
+}
+
+// At least a page and a fifth of the table's files.
+bool WorthCompacting(uint64_t reclaimable, uint64_t bytes) {
+  return reclaimable >= kPageSize && reclaimable * 5 >= bytes;
+}
+}  // namespace
+
+VacuumService::~VacuumService() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+bool VacuumService::CompactOne(const std::string& dbName, const TableSchema& schema, CompactStats& stats, std::string& err) {
+  std::lock_guard<std::mutex> run(runMu_);
+  if (!locks_.LockTableExclusive(kVacuumTxnId, schema.tableName, err)) return false;
+  const std::string dat = dbms_paths::DatPath(dbName);
+  // schema was read before the lock; a DDL may have rewritten the table since.
+  TableSchema current;
+  bool ok = engine_.LoadSchema(dbms_paths::DbfPath(dbName), schema.tableName, current, err) &&
+            engine_.SyncTable(dat, current, err);
+  if (ok) {
+    // Everything logged for the table so far is now durably in its data file; the
+    // marker tells recovery not to replay those offsets into the new file.
+    ok = log_.MarkRewritten(dbName, current.tableName, err) && engine_.CompactTable(dat, current, stats, err);
+  }
+  locks_.ReleaseAll(kVacuumTxnId);
+  return ok;
+}
+
+bool VacuumService::Vacuum(const std::string& dbName, const std::string& tableName,
+                           std::vector<std::pair<std::string, CompactStats>>& out, std::string& err) {
+  out.clear();
+  std::vector<TableSchema> schemas;
+  if (!engine_.LoadSchemas(dbms_paths::DbfPath(dbName), schemas, err)) return false;
+  bool found = false;
+  for (const auto& schema : schemas) {
+    if (schema.isView) continue;
+    if (!tableName.empty() && schema.tableName != tableName) continue;
+    found = true;
+    CompactStats stats;
+    if (!CompactOne(dbName, schema, stats, err)) return false;
+    out.emplace_back(schema.tableName, stats);
+  }
+  if (!tableName.empty() && !found) {
+    err = "Table not found: " + tableName;
+    return false;
+  }
+  return true;
+}
+
+void VacuumService::Start() {
+  int intervalSec = 300;
+  if (const char* env = std::getenv("DBMS_VACUUM_INTERVAL_SEC")) intervalSec = std::atoi(env);
+  if (intervalSec <= 0 || thread_.joinable()) return;
+  thread_ = std::thread(&VacuumService::Loop, this, intervalSec);
+}
+
+void VacuumService::Loop(int intervalSec) {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (!cv_.wait_for(lock, std::chrono::seconds(intervalSec), [this] { return stop_; })) {
+    lock.unlock();
+    Pass();
+    lock.lock();
+  }
+}
+
+void VacuumService::Pass() {
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator(dbms_paths::DataDirPath(), ec)) {
+    if (!entry.is_directory()) continue;
+    const std::string dbName = entry.path().filename().string();
+    const std::string dbf = dbms_paths::DbfPath(dbName);
+    const std::string dat = dbms_paths::DatPath(dbName);
+    std::string err;
+    std::vector<TableSchema> schemas;
+    if (!fs::exists(dbf) || !engine_.LoadSchemas(dbf, schemas, err)) continue;
+    for (const auto& schema : schemas) {
+      const std::string path = engine_.TableDataPath(dat, schema.tableName);
+      if (schema.isView || path == dat) continue;
+      // Only tables the tallies point at (or never measured) are scanned.
+      uint64_t estimate = 0;
+      if (engine_.EstimateReclaimable(dat, schema, estimate) &&
+          !WorthCompacting(estimate, FileSize(path) + FileSize(Overflow::PathFor(path)))) continue;
+      CompactStats stats;
+      if (!engine_.CompactTable(dat, schema, stats, err, true)) continue;
+      if (!WorthCompacting(stats.Reclaimed(), stats.bytesBefore)) continue;
+      if (!CompactOne(dbName, schema, stats, err)) {
+        std::cerr << "[Vacuum] db=" << dbName << " table=" << schema.tableName << " skipped: " << err << "\n";
+        continue;
+      }
+      std::cerr << "[Vacuum] db=" << dbName << " table=" << schema.tableName << " reclaimed "
+                << stats.Reclaimed() << " bytes\n";
+    }
+  }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "db_types.h"
+#include "storage_engine.h"
+
+class LockManager;
+class LogManager;
+
+// VACUUM and the background compactor: rewrite a table's live rows densely,
+// dropping tombstones and per-insert block headers. Only the table being
+// compacted is locked; transactions on it must finish first.
+class VacuumService {
+ public:
+  VacuumService(StorageEngine& engine, LockManager& lock_manager, LogManager& log)
+      : engine_(engine), locks_(lock_manager), log_(log) {}
+  ~VacuumService();
+
+  // Compact one table, or every table of the database when tableName is empty.
+  bool Vacuum(const std::string& dbName, const std::string& tableName,
+              std::vector<std::pair<std::string, CompactStats>>& out, std::string& err);
+
+  // Background pass every DBMS_VACUUM_INTERVAL_SEC seconds (default 300, 0 = off)
+  // over tables where at least a fifth of the file is reclaimable.
+  void Start();
+
+ private:
+  bool CompactOne(const std::string& dbName, const TableSchema& schema, CompactStats& stats, std::string& err);
+  void Loop(int intervalSec);
+  void Pass();
+
+  StorageEngine& engine_;
+  LockManager& locks_;
+  LogManager& log_;
+  std::mutex runMu_;  // one compaction at a time; they share a lock owner id
+  std::thread thread_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
@@ -0,0 +1,150 @@
+#include "value.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr double kEpsilon = 1e-9;
+
+// Full-length std::strtod, the acceptance the old stod-based checks had
+// (leading blanks, '+', hex, inf/nan), without allocating.
+bool ParseDouble(std::string_view s, double& out) {
+  char buf[64];
+  std::string heap;
+  const char* p = buf;
+  if (s.size() < sizeof(buf)) {
+    std::memcpy(buf, s.data(), s.size());
+    buf[s.size()] = '\0';
+  } else {
+    heap.assign(s);
+    p = heap.c_str();
+  }
+  char* end = nullptr;
+  errno = 0;
+  out = std::strtod(p, &end);
+  return end != p && errno != ERANGE && end == p + s.size();
+}
+
+// Only these can start something strtod accepts.
+bool MayBeNumber(char c) {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == ' ' || (c >= '\t' && c <= '\r') ||
+         c == 'i' || c == 'I' || c == 'n' || c == 'N';
+}
+
+template <typename T>
+int Order(T a, T b) { return a < b ? -1 : (b < a ? 1 : 0); }
+
+void PutBigEndian(uint64_t v, std::string& out) {
+  for (int shift = 56; shift >= 0; shift -= 8) out.push_back(static_cast<char>((v >> shift) & 0xff));
+}
+}  // namespace
+
+Value Value::Of(std::string_view text, ColumnKind kind) {
+  Value v;
+  v.text = text;
+  if (text == "NULL") {
+    v.type = Type::kNull;
+    return v;
+  }
+  if (text.empty() || !MayBeNumber(text.front())) return v;
+  if (kind != ColumnKind::kDouble) {
+    auto r = std::from_chars(text.data(), text.data() + text.size(), v.i);
+    if (r.ec == std::errc() && r.ptr == text.data() + text.size()) {
+      v.type = Type::kInt;
+      return v;
+    }
+  }
+  if (ParseDouble(text, v.d)) v.type = Type::kDouble;
+  return v;
+}
+
+Value Value::Of(std::string_view text, ColumnKind kind, const StoredNumber* stored) {
+  if (!stored || stored->type == StoredNumber::Type::kNone) return Of(text, kind);
+  Value v;
+  v.text = text;
+  if (stored->type == StoredNumber::Type::kInt && kind != ColumnKind::kDouble) {
+    v.type = Type::kInt;
+    v.i = stored->i;
+  } else {
+    v.type = Type::kDouble;
+    v.d = stored->type == StoredNumber::Type::kInt ? static_cast<double>(stored->i) : stored->d;
+  }
+  return v;
+}
+
+int CompareValues(const Value& a, const Value& b) {
+  if (a.numeric() && b.numeric()) {
+    if (a.type == Value::Type::kInt && b.type == Value::Type::kInt) return Order(a.i, b.i);
+    const double x = a.AsDouble(), y = b.AsDouble();
+    if (std::abs(x - y) < kEpsilon) return 0;
+    return x < y ? -1 : 1;
+  }
+  const int c = a.text.compare(b.text);
+  return c < 0 ? -1 : (c > 0 ? 1 : 0);
+}
+
+bool ParseCompareOp(std::string_view op, CompareOp& out) {
+  if (op == "=") out = CompareOp::kEq;
+  else if (op == "!=") out = CompareOp::kNe;
+  else if (op == "<") out = CompareOp::kLt;
+  else if (op == "<=") out = CompareOp::kLe;
+  else if (op == ">") out = CompareOp::kGt;
+  else if (op == ">=") out = CompareOp::kGe;
+  else return false;
+  return true;
+}
+
+bool Satisfies(const Value& a, CompareOp op, const Value& b) {
+  int c = 0;
+  if (a.numeric() && b.numeric()) {
+    if (a.type == Value::Type::kInt && b.type == Value::Type::kInt) {
+      c = Order(a.i, b.i);
+    } else {
+      const double x = a.AsDouble(), y = b.AsDouble();
+      if (op == CompareOp::kEq) return std::abs(x - y) < kEpsilon;
+      if (op == CompareOp::kNe) return std::abs(x - y) >= kEpsilon;
+      c = Order(x, y);
+    }
+  } else {
+    c = a.text.compare(b.text);
+  }
+  switch (op) {
+    case CompareOp::kEq: return c == 0;
+    case CompareOp::kNe: return c != 0;
+    case CompareOp::kLt: return c < 0;
+    case CompareOp::kLe: return c <= 0;
+    case CompareOp::kGt: return c > 0;
+    case CompareOp::kGe: return c >= 0;
+  }
+  return false;
+}
+
+void AppendKey(const Value& v, std::string& key) {
+  if (v.type == Value::Type::kNull) {
+    key.push_back('\x00');
+    return;
+  }
+  if (v.numeric()) {
+    // Sortable double first; ints add their exact value so large ones stay apart.
+    double d = v.AsDouble();
+    if (d == 0) d = 0;  // -0.0
+    uint64_t bits = 0;
+    std::memcpy(&bits, &d, sizeof(bits));
+    bits = (bits >> 63) ? ~bits : bits | (uint64_t{1} << 63);
+    key.push_back('\x01');
+    PutBigEndian(bits, key);
+    if (v.type == Value::Type::kInt) {
+      key.push_back('\x01');
+      PutBigEndian(static_cast<uint64_t>(v.i) ^ (uint64_t{1} << 63), key);
+    } else {
+      key.push_back('\x00');
+    }
+    return;
+  }
+  key.push_back('\x02');
+  key.append(v.text);
+  key.push_back('\x00');
+}
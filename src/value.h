@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "db_types.h"
+#include "storage/record_codec.h"
+
+// A cell as the execution engine compares, groups and aggregates it. The
+// column's declared type picks the parse: int columns go straight to int64,
+// double columns to double; any other text is a number only when all of it
+// parses as one, which is the rule the string-based code always applied.
+// `text` is the original bytes and is not owned.
+struct Value {
+  enum class Type : uint8_t { kNull, kInt, kDouble, kText };
+
+  Type type = Type::kText;
+  int64_t i = 0;
+  double d = 0;
+  std::string_view text;
+
+  static Value Of(std::string_view text, ColumnKind kind);
+  // A typed cell whose binary number the decoder kept (see
+  // RecordView::numbers) is taken as is; anything else is parsed as above.
+  static Value Of(std::string_view text, ColumnKind kind, const StoredNumber* stored);
+  // Literals and untyped (derived) columns.
+  static Value Untyped(std::string_view text) { return Of(text, ColumnKind::kText); }
+
+  bool numeric() const { return type == Type::kInt || type == Type::kDouble; }
+  double AsDouble() const { return type == Type::kInt ? static_cast<double>(i) : d; }
+};
+
+// Two numbers compare numerically (ints exactly, doubles within 1e-9); any
+// other pair compares by text, NULL included.
+int CompareValues(const Value& a, const Value& b);
+
+enum class CompareOp : uint8_t { kEq, kNe, kLt, kLe, kGt, kGe };
+bool ParseCompareOp(std::string_view op, CompareOp& out);
+// Equality allows the same 1e-9 slack as CompareValues; ordering is strict.
+bool Satisfies(const Value& a, CompareOp op, const Value& b);
+
+// Appends an order-preserving encoding of v (NULL < numbers < text), so a
+// concatenation of keys sorts and compares like the tuple of values.
+void AppendKey(const Value& v, std::string& key);